@@ -30,9 +30,13 @@
 #include <clicknet/udp.h>
 #include <clicknet/tcp.h>
 #include <clicknet/icmp.h>
+#include <clicknet/ip6.h>
 #include <click/packet_anno.hh>
 #include <click/nameinfo.hh>
 #include <click/userutils.hh>
+#if HAVE_IP6
+# include <click/ip6address.hh>
+#endif
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -75,6 +79,8 @@ FromIPSummaryDump::configure(Vector<String> &conf, ErrorHandler *errh)
     _sampling_prob = (1 << SAMPLING_SHIFT);
     String default_contents, default_flowid, data;
 
+    if (_ff.configure_keywords(conf, this, errh) < 0)
+	return -1;
     if (Args(conf, this, errh)
 	.read_p("FILENAME", FilenameArg(), _ff.filename())
 	.read("STOP", stop)
@@ -110,7 +116,8 @@ FromIPSummaryDump::configure(Vector<String> &conf, ErrorHandler *errh)
     _allow_nonexistent = allow_nonexistent;
     _have_timing = false;
     _multipacket = multipacket;
-    _have_flowid = _have_aggregate = _binary = false;
+    _have_flowid = _have_aggregate = _binary = _columnar = false;
+    _column_remaining = 0;
     if (default_contents)
 	bang_data(default_contents, errh);
     if (default_flowid)
@@ -318,7 +325,9 @@ FromIPSummaryDump::bang_binary(const String &line, ErrorHandler *errh)
 {
     Vector<String> words;
     cp_spacevec(line, words);
-    if (words.size() != 1)
+    if (words.size() == 2 && words[1] == "columnar")
+	_columnar = true;
+    else if (words.size() != 1)
 	_ff.error(errh, "bad !binary specification");
     _binary = true;
     _ff.set_landmark_pattern("%f:record %l");
@@ -352,6 +361,67 @@ set_checksums(WritablePacket *q, click_ip *iph)
     }
 }
 
+static void
+set_checksums6(WritablePacket *q, int ip_p)
+{
+    const click_ip6 *ip6h = q->ip6_header();
+    uint16_t *sump;
+    if (ip_p == IP_PROTO_TCP)
+	sump = &q->tcp_header()->th_sum;
+    else if (ip_p == IP_PROTO_UDP)
+	sump = &q->udp_header()->uh_sum;
+    else if (ip_p == IP_PROTO_ICMP6)
+	sump = &q->icmp_header()->icmp_cksum;
+    else
+	return;
+    *sump = 0;
+    unsigned csum = click_in_cksum(q->transport_header(), q->transport_length());
+    *sump = click_in6_cksum_pseudohdr(csum, &ip6h->ip6_src, &ip6h->ip6_dst, ip_p, q->transport_length());
+    if (ip_p == IP_PROTO_UDP && *sump == 0)
+	*sump = 0xFFFF;
+}
+
+// Returns the end of the binary field starting at data, or null if the
+// field is malformed or unknown.
+static const uint8_t *
+binary_field_end(IPSummaryDump::PacketOdesc &d,
+		 const IPSummaryDump::FieldReader *f,
+		 const uint8_t *data, const uint8_t *end)
+{
+    int nbytes;
+    if (!f->inb)
+	return 0;
+    switch (f->type) {
+      case IPSummaryDump::B_0:
+	nbytes = 0;
+	break;
+      case IPSummaryDump::B_1:
+	nbytes = 1;
+	break;
+      case IPSummaryDump::B_2:
+	nbytes = 2;
+	break;
+      case IPSummaryDump::B_4:
+      case IPSummaryDump::B_4NET:
+	nbytes = 4;
+	break;
+      case IPSummaryDump::B_6PTR:
+	nbytes = 6;
+	break;
+      case IPSummaryDump::B_8:
+	nbytes = 8;
+	break;
+      case IPSummaryDump::B_16:
+	nbytes = 16;
+	break;
+      case IPSummaryDump::B_SPECIAL:
+	return f->inb(d, data, end, f);
+      default:
+	return 0;
+    }
+    return (data + nbytes <= end ? data + nbytes : 0);
+}
+
 Packet *
 FromIPSummaryDump::read_packet(ErrorHandler *errh)
 {
@@ -362,7 +432,12 @@ FromIPSummaryDump::read_packet(ErrorHandler *errh)
     const char *end;
 
     while (1) {
-	if ((binary = _binary)) {
+	if (_column_remaining > 0) {
+	    // next packet from the current columnar block
+	    binary = true;
+	    data = end = 0;
+	    break;
+	} else if ((binary = _binary)) {
 	    int result = read_binary(line, errh);
 	    if (result <= 0)
 		goto eof;
@@ -377,7 +452,22 @@ FromIPSummaryDump::read_packet(ErrorHandler *errh)
 	data = line.begin();
 	end = line.end();
 
-	if (data == end)
+	if (binary && _columnar) {
+	    String msg;
+	    Vector<int> widths;
+	    for (int i = 0; i < _fields.size(); i++)
+		widths.push_back(IPSummaryDump::column_width(_fields[i]->type));
+	    int n = _columns.decode(line, widths, &msg);
+	    if (n < 0)
+		_ff.error(errh, "%s", msg.c_str());
+	    else if (n > 0) {
+		_column_pos.resize(_fields.size());
+		for (int i = 0; i < _fields.size(); i++)
+		    _column_pos[i] = _columns.column_begin(i);
+		_column_remaining = n;
+	    }
+	    continue;
+	} else if (data == end)
 	    /* do nothing */;
 	else if (binary || (data[0] != '!' && data[0] != '#'))
 	    /* real packet */
@@ -416,52 +506,31 @@ FromIPSummaryDump::read_packet(ErrorHandler *errh)
 
     // new code goes here
     if (_binary) {
-	Vector<const unsigned char *> args;
-	int nbytes;
-	for (const IPSummaryDump::FieldReader * const *fp = _fields.begin(); fp != _fields.end(); ++fp) {
-	    if (!(*fp)->inb)
-		goto bad_field;
-	    switch ((*fp)->type) {
-	      case IPSummaryDump::B_0:
-		nbytes = 0;
-		goto got_nbytes;
-	      case IPSummaryDump::B_1:
-		nbytes = 1;
-		goto got_nbytes;
-	      case IPSummaryDump::B_2:
-		nbytes = 2;
-		goto got_nbytes;
-	      case IPSummaryDump::B_4:
-	      case IPSummaryDump::B_4NET:
-		nbytes = 4;
-		goto got_nbytes;
-	      case IPSummaryDump::B_6PTR:
-		nbytes = 6;
-		goto got_nbytes;
-	      case IPSummaryDump::B_8:
-		nbytes = 8;
-		goto got_nbytes;
-	      case IPSummaryDump::B_16:
-		nbytes = 16;
-		goto got_nbytes;
-	      got_nbytes:
-		if (data + nbytes <= end) {
-		    args.push_back((const unsigned char *) data);
-		    data += nbytes;
-		} else
-		    goto bad_field;
-		break;
-	      case IPSummaryDump::B_SPECIAL:
-		args.push_back((const unsigned char *) data);
-		data = (const char *) (*fp)->inb(d, (const uint8_t *) data, (const uint8_t *) end, *fp);
-		break;
-	      bad_field:
-	      default:
+	Vector<const unsigned char *> args, ends;
+	for (int i = 0; i < _fields.size(); i++) {
+	    const uint8_t *fdata, *fend, *next;
+	    if (_columnar) {
+		fdata = _column_pos[i];
+		fend = _columns.column_end(i);
+	    } else {
+		fdata = (const uint8_t *) data;
+		fend = (const uint8_t *) end;
+	    }
+	    if ((next = binary_field_end(d, _fields[i], fdata, fend))) {
+		args.push_back(fdata);
+		fdata = next;
+	    } else {
 		args.push_back(0);
-		data = end;
-		break;
+		fdata = fend;
 	    }
+	    ends.push_back(fend);
+	    if (_columnar)
+		_column_pos[i] = fdata;
+	    else
+		data = (const char *) fdata;
 	}
+	if (_columnar)
+	    --_column_remaining;
 
 	for (int *fip = _field_order.begin();
 	     fip != _field_order.end() && d.p;
@@ -470,7 +539,7 @@ FromIPSummaryDump::read_packet(ErrorHandler *errh)
 	    if (!args[*fip] || !f->inject)
 		continue;
 	    d.clear_values();
-	    if (f->inb(d, args[*fip], (const uint8_t *) end, f)) {
+	    if (f->inb(d, args[*fip], ends[*fip], f)) {
 		f->inject(d, f);
 		nfields++;
 	    }
@@ -530,7 +599,50 @@ FromIPSummaryDump::read_packet(ErrorHandler *errh)
     if (d.p && d.is_ip && d.p->ip_header())
 	(void) d.make_transp();
 
-    if (d.p && d.is_ip && d.p->ip_header()) {
+    if (d.p && d.is_ip6) {
+	// set IPv6 payload length
+	click_ip6 *ip6h = d.p->ip6_header();
+	uint32_t ip_len;
+	if (!ip6h->ip6_plen) {
+	    ip_len = d.want_len;
+	    if (ip_len >= (uint32_t) d.p->network_header_offset())
+		ip_len -= d.p->network_header_offset();
+	    if (ip_len > 0xFFFF + sizeof(click_ip6))
+		ip_len = 0xFFFF + sizeof(click_ip6);
+	    else if (ip_len < sizeof(click_ip6))
+		ip_len = d.p->network_length();
+	    ip6h->ip6_plen = htons(ip_len - sizeof(click_ip6));
+	} else
+	    ip_len = ntohs(ip6h->ip6_plen) + sizeof(click_ip6);
+
+	// a packet without an upper-layer protocol has no next header
+	int ip_p = d.ip_proto();
+	if (!ip_p && d.p->transport_length() == 0)
+	    d.ip_proto() = IP6PROTO_NONE;
+
+	// set UDP length
+	if (ip_p == IP_PROTO_UDP && d.ip6_firstfrag
+	    && d.p->transport_length() >= (int) sizeof(click_udp)
+	    && !d.p->udp_header()->uh_ulen)
+	    d.p->udp_header()->uh_ulen = htons(ip_len - d.p->network_header_length());
+
+#if HAVE_IP6
+	// set destination IP address annotation
+	SET_DST_IP6_ANNO(d.p, ip6h->ip6_dst);
+#endif
+
+	// set checksum
+	if (_checksum && d.ip6_firstfrag) {
+	    uint32_t xlen = 0;
+	    if (ip_len > (uint32_t) d.p->network_length())
+		xlen = ip_len - d.p->network_length();
+	    if (!xlen || (d.p = d.p->put(xlen))) {
+		if (xlen && _zero)
+		    memset(d.p->end_data() - xlen, 0, xlen);
+		set_checksums6(d.p, ip_p);
+	    }
+	}
+    } else if (d.p && d.is_ip && d.p->ip_header()) {
 	// set IP length
 	uint32_t ip_len;
 	if (!d.p->ip_header()->ip_len) {
@@ -580,7 +692,18 @@ inline Packet *
 set_packet_lengths(Packet *p, uint32_t extra_length)
 {
     uint32_t length = p->length() + extra_length;
-    if (htons(length) != p->ip_header()->ip_len) {
+    if (p->ip_header()->ip_v == 6) {
+	const click_ip6 *ip6h = p->ip6_header();
+	if (htons(length - sizeof(click_ip6)) == ip6h->ip6_plen)
+	    return p;
+	else if (WritablePacket *q = p->uniqueify()) {
+	    q->ip6_header()->ip6_plen = htons(length - sizeof(click_ip6));
+	    if (q->ip6_header()->ip6_nxt == IP_PROTO_UDP)
+		q->udp_header()->uh_ulen = htons(length - q->network_header_length());
+	    return q;
+	} else
+	    return 0;
+    } else if (htons(length) != p->ip_header()->ip_len) {
 	if (WritablePacket *q = p->uniqueify()) {
 	    click_ip *ip = q->ip_header();
 	    ip->ip_len = htons(length);
@@ -8,12 +8,13 @@
 #include <click/ipflowid.hh>
 #include <click/fromfile.hh>
 #include "ipsumdumpinfo.hh"
+#include "ipsumdumpcolumnar.hh"
 CLICK_DECLS
 
 /*
 =c
 
-FromIPSummaryDump(FILENAME [, I<keywords> STOP, TIMING, ACTIVE, ZERO, CHECKSUM, PROTO, MULTIPACKET, SAMPLE, FIELDS, FLOWID, DATA])
+FromIPSummaryDump(FILENAME [, I<keywords> STOP, TIMING, ACTIVE, ZERO, CHECKSUM, PROTO, MULTIPACKET, SAMPLE, FIELDS, FLOWID, DATA, MMAP])
 
 =s traces
 
@@ -32,6 +33,9 @@ FromIPSummaryDump reads from the file named FILENAME unless FILENAME is a
 single dash 'C<->', in which case it reads from the standard input. It will
 not uncompress the standard input, however.
 
+FromIPSummaryDump reads ASCII, binary, and columnar binary dumps. Columnar
+blocks are decoded a whole block at a time.
+
 Keyword arguments are:
 
 =over 8
@@ -111,14 +115,19 @@ Defaults to false.
 String. If set, FromIPSummaryDump reads from the DATA string, rather than
 from a file.
 
+=item MMAP
+
+Boolean. If true, then FromIPSummaryDump will use mmap(2) to access the file.
+This can be faster for binary and columnar dumps. Default is true.
+
 =back
 
 Only available in user-level processes.
 
 =n
 
-Packets generated by FromIPSummaryDump always have IP version 4 and a correct
-IP header length. The default IP protocol is TCP (6) and the default
+Packets generated by FromIPSummaryDump have IP version 4, or version 6 if
+the dump sets IPv6 fields, and a correct IP header length. The default IP protocol is TCP (6) and the default
 time-to-live is 100. The rest of the packet data is zero or garbage, unless
 set by the dump. Generated packets will usually have short lengths, but the
 extra header length annotations are set correctly.
@@ -198,6 +207,7 @@ class FromIPSummaryDump : public Element, public IPSummaryDumpInfo { public:
     bool _timing : 1;
     bool _have_timing : 1;
     bool _allow_nonexistent : 1;
+    bool _columnar : 1;
     Packet *_work_packet;
     uint32_t _multipacket_length;
     Timestamp _multipacket_timestamp_delta;
@@ -211,6 +221,10 @@ class FromIPSummaryDump : public Element, public IPSummaryDumpInfo { public:
     int _minor_version;
     IPFlowID _given_flowid;
 
+    IPSummaryDump::ColumnDecoder _columns;
+    Vector<const uint8_t *> _column_pos;
+    int _column_remaining;
+
     int read_binary(String &, ErrorHandler *);
 
     static int sort_fields_compare(const void *, const void *, void *);
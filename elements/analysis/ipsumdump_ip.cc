@@ -26,6 +26,7 @@
 #include <clicknet/ip.h>
 #include <clicknet/tcp.h>
 #include <clicknet/udp.h>
+#include <clicknet/ip6.h>
 #include <click/args.hh>
 #include <click/ipflowid.hh>
 CLICK_DECLS
@@ -87,6 +88,10 @@ static bool ip_extract(PacketDesc& d, const FieldWriter *f)
 	d.v = ntohs(d.iph->ip_sum);
 	return true;
       case T_IP_PROTO:
+	if (d.ip6h && d.ip6_p >= 0) {
+	    d.v = d.ip6_p;
+	    return true;
+	}
 	CHECK(10);
 	d.v = d.iph->ip_p;
 	return true;
@@ -103,6 +108,10 @@ static bool ip_extract(PacketDesc& d, const FieldWriter *f)
       case T_IP_LEN:
 	if (d.iph)
 	    d.v = ntohs(d.iph->ip_len);
+	else if (d.ip6h && d.ip6h->ip6_plen)
+	    d.v = sizeof(click_ip6) + ntohs(d.ip6h->ip6_plen);
+	else if (d.ip6h)
+	    d.v = network_length;
 	else
 	    d.v = d.length();
 	if (d.force_extra_length)
@@ -113,8 +122,12 @@ static bool ip_extract(PacketDesc& d, const FieldWriter *f)
 	d.v = d.iph->ip_hl << 2;
 	return true;
       case T_IP_CAPTURE_LEN: {
-	  uint32_t allow_len = (d.iph ? network_length : d.length());
-	  uint32_t len = (d.iph ? ntohs(d.iph->ip_len) : allow_len);
+	  uint32_t allow_len = (d.iph || d.ip6h ? network_length : d.length());
+	  uint32_t len = allow_len;
+	  if (d.iph)
+	      len = ntohs(d.iph->ip_len);
+	  else if (d.ip6h && d.ip6h->ip6_plen)
+	      len = sizeof(click_ip6) + ntohs(d.ip6h->ip6_plen);
 	  d.v = (len < allow_len ? len : allow_len);
 	  return true;
       }
@@ -136,6 +149,15 @@ static void ip_inject(PacketOdesc& d, const FieldReader *f)
     if (!d.make_ip(0))
 	return;
 
+    // only the protocol and length fields apply to IPv6 packets
+    if (d.is_ip6) {
+	if (f->user_data == T_IP_PROTO)
+	    d.ip_proto() = d.v;
+	else if (f->user_data == T_IP_LEN)
+	    d.want_len = d.p->network_header_offset() + d.v;
+	return;
+    }
+
     click_ip *iph = d.p->ip_header();
     switch (f->user_data) {
 	// IP header properties
@@ -370,10 +392,14 @@ static bool transport_extract(PacketDesc& d, const FieldWriter *f)
     case T_SPORT:
     case T_DPORT: {
 	bool dport = (f->user_data == T_DPORT);
-	if (d.iph
-	    && d.network_length() > (uint32_t) (d.iph->ip_hl << 2)
-	    && IP_FIRSTFRAG(d.iph)
-	    && ip_proto_has_udp_ports(d.iph->ip_p)
+	if (((d.iph
+	      && d.network_length() > (uint32_t) (d.iph->ip_hl << 2)
+	      && IP_FIRSTFRAG(d.iph)
+	      && ip_proto_has_udp_ports(d.iph->ip_p))
+	     || (d.ip6h
+		 && d.ip6_firstfrag
+		 && ip_proto_has_udp_ports(d.ip6_p)
+		 && d.network_length() > (uint32_t) p->network_header_length()))
 	    && d.transport_length() >= (dport ? 4 : 2)) {
 	    const click_udp *udph = p->udp_header();
 	    d.v = ntohs(dport ? udph->uh_dport : udph->uh_sport);
@@ -389,8 +415,7 @@ static void transport_inject(PacketOdesc& d, const FieldReader *f)
 {
     if (!d.make_ip(0) || !d.make_transp())
 	return;
-    click_ip *iph = d.p->ip_header();
-    if (iph->ip_p && !ip_proto_has_udp_ports(iph->ip_p))
+    if (d.ip_proto() && !ip_proto_has_udp_ports(d.ip_proto()))
 	return;
 
     switch (f->user_data) {
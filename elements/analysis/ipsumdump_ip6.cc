@@ -0,0 +1,395 @@
+// -*- mode: c++; c-basic-offset: 4 -*-
+/*
+ * ipsumdump_ip6.{cc,hh} -- IPv6 network layer IP summary dump unparsers
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+
+#include "ipsumdump_ip6.hh"
+#include <click/packet.hh>
+#include <click/packet_anno.hh>
+#include <clicknet/ip.h>
+#include <clicknet/ip6.h>
+#include <click/args.hh>
+#include <click/ip6address.hh>
+CLICK_DECLS
+
+enum { T_IP6_SRC, T_IP6_DST, T_IP6_FLOWLABEL, T_IP6_CLASS, T_IP6_HLIM,
+       T_IP6_EXTHDR };
+
+namespace IPSummaryDump {
+
+static bool ip6_extract(PacketDesc& d, const FieldWriter *f)
+{
+    // ip_prepare() ensures that d.ip6h has a complete header
+    if (!d.ip6h)
+	return field_missing(d, MISSING_IP6, sizeof(click_ip6));
+    switch (f->user_data) {
+    case T_IP6_SRC:
+	d.vptr[0] = reinterpret_cast<const uint8_t *>(&d.ip6h->ip6_src);
+	return true;
+    case T_IP6_DST:
+	d.vptr[0] = reinterpret_cast<const uint8_t *>(&d.ip6h->ip6_dst);
+	return true;
+    case T_IP6_FLOWLABEL:
+	d.v = ntohl(d.ip6h->ip6_flow) & IP6_FLOW_MASK;
+	return true;
+    case T_IP6_CLASS:
+	d.v = (ntohl(d.ip6h->ip6_flow) & IP6_CLASS_MASK) >> IP6_CLASS_SHIFT;
+	return true;
+    case T_IP6_HLIM:
+	d.v = d.ip6h->ip6_hlim;
+	return true;
+    case T_IP6_EXTHDR:
+	if (d.ip6_p < 0)
+	    return field_missing(d, MISSING_IP6, d.network_length() + 1);
+	return true;
+    default:
+	return false;
+    }
+}
+
+// The extension header chain is stored as ip6_walk_exthdrs() returns it:
+// one protocol byte per header, with the two-byte offset field following
+// a fragment header's protocol.
+static int exthdr_count(const uint8_t *s, const uint8_t *end)
+{
+    int n = 0;
+    while (s < end) {
+	switch (*s) {
+	case IP6PROTO_HOPOPTS:
+	case IP6PROTO_ROUTING:
+	case IP6PROTO_AH:
+	case IP6PROTO_DSTOPTS:
+	    ++s;
+	    break;
+	case IP6PROTO_FRAGMENT:
+	    if (s + 3 > end)
+		return -1;
+	    s += 3;
+	    break;
+	default:
+	    return -1;
+	}
+	++n;
+    }
+    return n;
+}
+
+static const struct {
+    int proto;
+    const char *name;
+} exthdr_names[] = {
+    { IP6PROTO_HOPOPTS, "hop" }, { IP6PROTO_ROUTING, "rt" },
+    { IP6PROTO_FRAGMENT, "frag" }, { IP6PROTO_AH, "ah" },
+    { IP6PROTO_DSTOPTS, "dst" }
+};
+
+static const char *exthdr_name(int proto)
+{
+    for (size_t i = 0; i < sizeof(exthdr_names) / sizeof(exthdr_names[0]); ++i)
+	if (exthdr_names[i].proto == proto)
+	    return exthdr_names[i].name;
+    return 0;
+}
+
+static void unparse_exthdrs(StringAccum &sa, const uint8_t *s, const uint8_t *end)
+{
+    if (s == end)
+	sa << '.';
+    for (const char *sep = ""; s < end; sep = ";") {
+	sa << sep << exthdr_name(*s);
+	if (*s == IP6PROTO_FRAGMENT) {
+	    uint16_t off = (s[1] << 8) | s[2];
+	    if (off)
+		sa << ':' << (off & IP6_OFFMASK) << (off & IP6_MF ? "+" : "");
+	    s += 3;
+	} else
+	    ++s;
+    }
+}
+
+static void ip6_outa(const PacketDesc& d, const FieldWriter *f)
+{
+    switch (f->user_data) {
+    case T_IP6_SRC:
+    case T_IP6_DST:
+	*d.sa << IP6Address(d.vptr[0]);
+	break;
+    case T_IP6_EXTHDR: {
+	StringAccum chain;
+	uint32_t off;
+	bool firstfrag;
+	(void) ip6_walk_exthdrs(d.ip6h, d.network_length(), off, firstfrag, &chain);
+	unparse_exthdrs(*d.sa, (const uint8_t *) chain.begin(), (const uint8_t *) chain.end());
+	break;
+    }
+    }
+}
+
+static void ip6_outb(const PacketDesc& d, bool ok, const FieldWriter *f)
+{
+    switch (f->user_data) {
+    case T_IP6_SRC:
+    case T_IP6_DST:
+	if (char *c = d.sa->extend(16)) {
+	    if (d.vptr[0])
+		memcpy(c, d.vptr[0], 16);
+	    else
+		memset(c, 0, 16);
+	}
+	break;
+    case T_IP6_EXTHDR: {
+	StringAccum chain;
+	uint32_t off;
+	bool firstfrag;
+	if (ok)
+	    (void) ip6_walk_exthdrs(d.ip6h, d.network_length(), off, firstfrag, &chain);
+	if (chain.length() > 255)
+	    chain.clear();
+	*d.sa << (char) chain.length();
+	d.sa->append(chain.data(), chain.length());
+	break;
+    }
+    }
+}
+
+static bool ip6_ina(PacketOdesc& d, const String &s, const FieldReader *f)
+{
+    switch (f->user_data) {
+    case T_IP6_SRC:
+    case T_IP6_DST: {
+	IP6Address a;
+	if (IP6AddressArg().parse(s, a, d.e)) {
+	    d.sa.clear();
+	    d.sa.append(a.data(), 16);
+	    d.vptr[0] = (const uint8_t *) d.sa.begin();
+	    return true;
+	}
+	break;
+    }
+    case T_IP6_EXTHDR: {
+	d.sa.clear();
+	if (s.equals(".", 1)) {
+	    d.vptr[0] = d.vptr[1] = 0;
+	    return true;
+	}
+	const char *x = s.begin(), *end = s.end();
+	while (x < end) {
+	    const char *word = x;
+	    while (x < end && *x != ';' && *x != ':')
+		++x;
+	    String name = s.substring(word, x);
+	    int proto = -1;
+	    for (size_t i = 0; i < sizeof(exthdr_names) / sizeof(exthdr_names[0]); ++i)
+		if (name == exthdr_names[i].name)
+		    proto = exthdr_names[i].proto;
+	    if (proto < 0
+		&& (!IntArg().parse(name, proto) || !exthdr_name(proto)))
+		return false;
+	    d.sa << (char) proto;
+	    if (proto == IP6PROTO_FRAGMENT) {
+		uint32_t off = 0;
+		if (x < end && *x == ':') {
+		    const char *num = x + 1;
+		    x = cp_integer(num, end, 10, &off);
+		    if (x == num || off > IP6_OFFMASK || (off & 7))
+			return false;
+		    if (x < end && *x == '+') {
+			off |= IP6_MF;
+			++x;
+		    }
+		}
+		d.sa << (char) (off >> 8) << (char) off;
+	    }
+	    if (x < end && *x != ';')
+		return false;
+	    else if (x < end && ++x == end)
+		return false;
+	}
+	d.vptr[0] = (const uint8_t *) d.sa.begin();
+	d.vptr[1] = (const uint8_t *) d.sa.end();
+	return true;
+    }
+    }
+    return false;
+}
+
+static const uint8_t *ip6_inb(PacketOdesc& d, const uint8_t *s, const uint8_t *ends, const FieldReader *f)
+{
+    if (f->user_data == T_IP6_EXTHDR) {
+	if (s < ends && s + s[0] + 1 <= ends) {
+	    d.vptr[0] = s + 1;
+	    d.vptr[1] = d.vptr[0] + s[0];
+	    return s + s[0] + 1;
+	}
+    } else if (s + 16 <= ends) {
+	d.vptr[0] = s;
+	return s + 16;
+    }
+    d.clear_values();
+    return ends;
+}
+
+static void inject_exthdrs(PacketOdesc& d)
+{
+    const uint8_t *s = d.vptr[0], *end = d.vptr[1];
+    int n = exthdr_count(s, end);
+    if (n <= 0 || d.p->network_length() != (int) sizeof(click_ip6))
+	return;
+
+    uint8_t upper_p = d.ip_proto();
+    if (!(d.p = d.p->put(n * 8)))
+	return;
+    uint8_t *h = d.p->network_header() + sizeof(click_ip6);
+    memset(h, 0, n * 8);
+    uint8_t *nxtp = &d.p->ip6_header()->ip6_nxt;
+    for (; s < end; h += 8) {
+	*nxtp = *s;
+	nxtp = h;
+	// every header is 8 bytes long, with a zero length field
+	if (*s == IP6PROTO_FRAGMENT) {
+	    h[2] = s[1];
+	    h[3] = s[2];
+	    if (((s[1] << 8) | s[2]) & IP6_OFFMASK)
+		d.ip6_firstfrag = false;
+	    s += 3;
+	} else {
+	    if (*s == IP6PROTO_HOPOPTS || *s == IP6PROTO_DSTOPTS) {
+		h[2] = 1;	// PadN option covering the rest
+		h[3] = 4;
+	    }
+	    ++s;
+	}
+    }
+    *nxtp = upper_p;
+    d.ip6_nxt_off = nxtp - d.p->network_header();
+    d.p->set_ip6_header(d.p->ip6_header(), sizeof(click_ip6) + n * 8);
+}
+
+static bool ip6_value_zero(const PacketOdesc& d, const FieldReader *f)
+{
+    switch (f->user_data) {
+    case T_IP6_SRC:
+    case T_IP6_DST:
+	for (int i = 0; d.vptr[0] && i < 16; ++i)
+	    if (d.vptr[0][i])
+		return false;
+	return true;
+    case T_IP6_EXTHDR:
+	return d.vptr[0] == d.vptr[1];
+    default:
+	return d.v == 0;
+    }
+}
+
+static void ip6_inject(PacketOdesc& d, const FieldReader *f)
+{
+    // Binary dumps store zeros for the IPv6 fields of other packets, so
+    // zero values never turn a packet into an IPv6 packet.
+    if (ip6_value_zero(d, f) ? !d.is_ip6 : !d.make_ip6())
+	return;
+
+    click_ip6 *ip6h = d.p->ip6_header();
+    switch (f->user_data) {
+    case T_IP6_SRC:
+	if (d.vptr[0])
+	    memcpy(&ip6h->ip6_src, d.vptr[0], 16);
+	break;
+    case T_IP6_DST:
+	if (d.vptr[0])
+	    memcpy(&ip6h->ip6_dst, d.vptr[0], 16);
+	break;
+    case T_IP6_FLOWLABEL:
+	ip6h->ip6_flow = htonl((ntohl(ip6h->ip6_flow) & ~IP6_FLOW_MASK)
+			       | (d.v & IP6_FLOW_MASK));
+	break;
+    case T_IP6_CLASS:
+	ip6h->ip6_flow = htonl((ntohl(ip6h->ip6_flow) & ~IP6_CLASS_MASK)
+			       | ((d.v << IP6_CLASS_SHIFT) & IP6_CLASS_MASK));
+	break;
+    case T_IP6_HLIM:
+	ip6h->ip6_hlim = d.v;
+	break;
+    case T_IP6_EXTHDR:
+	inject_exthdrs(d);
+	break;
+    }
+}
+
+static const FieldWriter ip6_writers[] = {
+    { "ip6_src", B_16, T_IP6_SRC,
+      ip_prepare, ip6_extract, ip6_outa, ip6_outb },
+    { "ip6_dst", B_16, T_IP6_DST,
+      ip_prepare, ip6_extract, ip6_outa, ip6_outb },
+    { "ip6_flowlabel", B_4, T_IP6_FLOWLABEL,
+      ip_prepare, ip6_extract, num_outa, outb },
+    { "ip6_class", B_1, T_IP6_CLASS,
+      ip_prepare, ip6_extract, num_outa, outb },
+    { "ip6_hlim", B_1, T_IP6_HLIM,
+      ip_prepare, ip6_extract, num_outa, outb },
+    { "ip6_exthdr", B_SPECIAL, T_IP6_EXTHDR,
+      ip_prepare, ip6_extract, ip6_outa, ip6_outb }
+};
+
+// IPv6 fields come before IPv4 fields, so a packet with IPv6 fields becomes
+// an IPv6 packet, and addresses come first since they usually create the
+// header.
+static const FieldReader ip6_readers[] = {
+    { "ip6_src", B_16, T_IP6_SRC, order_net - 4,
+      ip6_ina, ip6_inb, ip6_inject },
+    { "ip6_dst", B_16, T_IP6_DST, order_net - 4,
+      ip6_ina, ip6_inb, ip6_inject },
+    { "ip6_flowlabel", B_4, T_IP6_FLOWLABEL, order_net - 3,
+      num_ina, inb, ip6_inject },
+    { "ip6_class", B_1, T_IP6_CLASS, order_net - 3,
+      num_ina, inb, ip6_inject },
+    { "ip6_hlim", B_1, T_IP6_HLIM, order_net - 3,
+      num_ina, inb, ip6_inject },
+    { "ip6_exthdr", B_SPECIAL, T_IP6_EXTHDR, order_net - 3,
+      ip6_ina, ip6_inb, ip6_inject }
+};
+
+static const FieldSynonym ip6_synonyms[] = {
+    { "ip6_flow", "ip6_flowlabel" },
+    { "ip6_tclass", "ip6_class" },
+    { "ip6_hlimit", "ip6_hlim" }
+};
+
+}
+
+void IPSummaryDump_IP6::static_initialize()
+{
+    using namespace IPSummaryDump;
+    for (size_t i = 0; i < sizeof(ip6_writers) / sizeof(ip6_writers[0]); ++i)
+	FieldWriter::add(&ip6_writers[i]);
+    for (size_t i = 0; i < sizeof(ip6_readers) / sizeof(ip6_readers[0]); ++i)
+	FieldReader::add(&ip6_readers[i]);
+    for (size_t i = 0; i < sizeof(ip6_synonyms) / sizeof(ip6_synonyms[0]); ++i)
+	FieldSynonym::add(&ip6_synonyms[i]);
+}
+
+void IPSummaryDump_IP6::static_cleanup()
+{
+    using namespace IPSummaryDump;
+    for (size_t i = 0; i < sizeof(ip6_writers) / sizeof(ip6_writers[0]); ++i)
+	FieldWriter::remove(&ip6_writers[i]);
+    for (size_t i = 0; i < sizeof(ip6_readers) / sizeof(ip6_readers[0]); ++i)
+	FieldReader::remove(&ip6_readers[i]);
+    for (size_t i = 0; i < sizeof(ip6_synonyms) / sizeof(ip6_synonyms[0]); ++i)
+	FieldSynonym::remove(&ip6_synonyms[i]);
+}
+
+ELEMENT_REQUIRES(userlevel IPSummaryDump ip6)
+ELEMENT_PROVIDES(IPSummaryDump_IP6)
+CLICK_ENDDECLS
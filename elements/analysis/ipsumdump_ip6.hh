@@ -0,0 +1,12 @@
+#ifndef CLICK_IPSUMDUMP_IP6_HH
+#define CLICK_IPSUMDUMP_IP6_HH
+#include "ipsumdumpinfo.hh"
+CLICK_DECLS
+
+class IPSummaryDump_IP6 { public:
+    static void static_initialize();
+    static void static_cleanup();
+};
+
+CLICK_ENDDECLS
+#endif
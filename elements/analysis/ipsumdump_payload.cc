@@ -26,6 +26,7 @@
 #include <clicknet/ip.h>
 #include <clicknet/tcp.h>
 #include <clicknet/udp.h>
+#include <clicknet/ip6.h>
 #include <click/confparse.hh>
 #include <click/ipflowid.hh>
 CLICK_DECLS
@@ -34,27 +35,36 @@ namespace IPSummaryDump {
 
 enum { T_PAYLOAD_LEN, T_PAYLOAD, T_PAYLOAD_MD5, T_PAYLOAD_MD5_HEX };
 
-static void payload_info(const Packet *p, const click_ip *iph, int tailpad,
+// 'ip6_p' is the IPv6 upper-layer protocol, or -1 for later fragments.
+static void payload_info(const Packet *p, const click_ip *iph,
+			 const click_ip6 *ip6h, int ip6_p, int tailpad,
 			 int32_t &off, uint32_t &len)
 {
-    if (iph) {
-	len = ntohs(iph->ip_len);
+    if (iph || ip6h) {
+	int ip_p = -1;
+	if (iph) {
+	    len = ntohs(iph->ip_len);
+	    if (IP_FIRSTFRAG(iph))
+		ip_p = iph->ip_p;
+	} else {
+	    len = (ip6h->ip6_plen ? sizeof(click_ip6) + ntohs(ip6h->ip6_plen) : 0);
+	    ip_p = ip6_p;
+	}
 	off = p->transport_header_offset();
 	uint32_t nlen = len + p->network_header_offset();
-	if (IP_FIRSTFRAG(iph))
-	    switch (iph->ip_p) {
-	    case IP_PROTO_TCP:
-		if (p->transport_length() - tailpad >= 13
-		    && ((uint32_t) off + (p->tcp_header()->th_off << 2) <= nlen
-			|| len == 0))
-		    off += (p->tcp_header()->th_off << 2);
-		break;
-	    case IP_PROTO_UDP:
-	    case IP_PROTO_UDPLITE:
-		if (off + sizeof(click_udp) <= nlen || len == 0)
-		    off += sizeof(click_udp);
-		break;
-	    }
+	switch (ip_p) {
+	case IP_PROTO_TCP:
+	    if (p->transport_length() - tailpad >= 13
+		&& ((uint32_t) off + (p->tcp_header()->th_off << 2) <= nlen
+		    || len == 0))
+		off += (p->tcp_header()->th_off << 2);
+	    break;
+	case IP_PROTO_UDP:
+	case IP_PROTO_UDPLITE:
+	    if (off + sizeof(click_udp) <= nlen || len == 0)
+		off += sizeof(click_udp);
+	    break;
+	}
 	len -= off - p->network_header_offset();
     } else {
 	off = 0;
@@ -67,8 +77,8 @@ static bool payload_extract(PacketDesc &d, const FieldWriter *f)
     switch (f->user_data) {
     case T_PAYLOAD_LEN: {
 	int32_t off;
-	payload_info(d.p, d.iph, d.tailpad, off, d.v);
-	if (!d.iph || d.force_extra_length)
+	payload_info(d.p, d.iph, d.ip6h, d.ip6_firstfrag ? d.ip6_p : -1, d.tailpad, off, d.v);
+	if ((!d.iph && !d.ip6h) || d.force_extra_length)
 	    d.v += EXTRA_LENGTH_ANNO(d.p);
 	return true;
     }
@@ -83,9 +93,11 @@ static bool payload_extract(PacketDesc &d, const FieldWriter *f)
 
 static void account_payload_len(PacketOdesc &d, int32_t &off, uint32_t plen)
 {
-    if (!d.is_ip || (d.p->ip_header()->ip_len == 0 && d.want_len == 0))
+    if (!d.is_ip
+	|| (d.is_ip6 && d.p->ip6_header()->ip6_plen == 0 && d.want_len == 0)
+	|| (!d.is_ip6 && d.p->ip_header()->ip_len == 0 && d.want_len == 0))
 	d.want_len = off + plen;
-    else {
+    else if (!d.is_ip6) {
 	click_ip *iph = d.p->ip_header();
         click_tcp *tcph;
 	uint32_t ip_len = (iph->ip_len ? ntohs(iph->ip_len) : d.want_len)
@@ -133,7 +145,10 @@ static void payload_inject(PacketOdesc &d, const FieldReader *f)
 
     int32_t off;
     uint32_t len;
-    payload_info(d.p, d.is_ip ? d.p->ip_header() : 0, 0, off, len);
+    if (d.is_ip6)
+	payload_info(d.p, 0, d.p->ip6_header(), d.ip6_firstfrag ? d.ip_proto() : -1, 0, off, len);
+    else
+	payload_info(d.p, d.is_ip ? d.p->ip_header() : 0, 0, -1, 0, off, len);
     switch (f->user_data) {
     case T_PAYLOAD: {
 	if (!d.vptr[0] || d.vptr[0] == d.vptr[1])
@@ -160,7 +175,7 @@ static void payload_outa(const PacketDesc& d, const FieldWriter *f)
     case T_PAYLOAD_MD5_HEX: {
 	int32_t off;
 	uint32_t len;
-	payload_info(d.p, d.iph, d.tailpad, off, len);
+	payload_info(d.p, d.iph, d.ip6h, d.ip6_firstfrag ? d.ip6_p : -1, d.tailpad, off, len);
 	if (off + len > d.length())
 	    len = d.length() - off;
 	if (f->user_data == T_PAYLOAD) {
@@ -218,7 +233,7 @@ static void payload_outb(const PacketDesc& d, bool, const FieldWriter *f)
     case T_PAYLOAD_MD5_HEX: {
 	int32_t off;
 	uint32_t len;
-	payload_info(d.p, d.iph, d.tailpad, off, len);
+	payload_info(d.p, d.iph, d.ip6h, d.ip6_firstfrag ? d.ip6_p : -1, d.tailpad, off, len);
 	if (off + len > (uint32_t) d.length())
 	    len = d.length() - off;
 	md5_state_t pms;
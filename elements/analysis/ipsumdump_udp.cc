@@ -57,7 +57,7 @@ static void udp_inject(PacketOdesc& d, const FieldReader *f)
 {
     if (!d.make_ip(0) || !d.make_transp())
 	return;
-    int ip_p = d.p->ip_header()->ip_p;
+    int ip_p = d.ip_proto();
     if (ip_p && ip_p != IP_PROTO_UDP && ip_p != IP_PROTO_UDPLITE)
 	return;
     if (d.p->transport_length() < (int) sizeof(click_udp)
@@ -0,0 +1,591 @@
+// -*- mode: c++; c-basic-offset: 4 -*-
+/*
+ * ipsumdumpcolumnar.{cc,hh} -- columnar block format for IP summary dumps
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "ipsumdumpcolumnar.hh"
+#include <click/error.hh>
+#include <unistd.h>
+CLICK_DECLS
+
+namespace IPSummaryDump {
+
+int
+column_width(int type)
+{
+    if (type == B_SPECIAL || type < 0)
+	return 0;
+    else
+	return type & 255;
+}
+
+static inline void
+put_be4(char *p, uint32_t v)
+{
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+static inline uint32_t
+get_be4(const uint8_t *p)
+{
+    return (p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+static inline void
+put_varint(StringAccum &sa, uint32_t v)
+{
+    if (char *x = sa.reserve(5)) {
+	char *s = x;
+	while (v >= 0x80) {
+	    *x++ = (v & 0x7F) | 0x80;
+	    v >>= 7;
+	}
+	*x++ = v;
+	sa.adjust_length(x - s);
+    }
+}
+
+static inline const uint8_t *
+get_varint(const uint8_t *p, const uint8_t *end, uint32_t &v)
+{
+    v = 0;
+    for (int shift = 0; p < end && shift < 35; shift += 7) {
+	v |= (uint32_t) (*p & 0x7F) << shift;
+	if (!(*p++ & 0x80))
+	    return p;
+    }
+    return 0;
+}
+
+// Delta coding splits each value into big-endian lanes so that, for
+// instance, the seconds and microseconds halves of a timestamp are
+// differenced separately.
+static inline int
+lane_size(int width)
+{
+    if ((width & 3) == 0)
+	return 4;
+    else if ((width & 1) == 0)
+	return 2;
+    else
+	return 1;
+}
+
+static inline uint32_t
+get_lane(const uint8_t *p, int l)
+{
+    if (l == 4)
+	return get_be4(p);
+    else if (l == 2)
+	return (p[0] << 8) | p[1];
+    else
+	return p[0];
+}
+
+static inline void
+put_lane(char *p, int l, uint32_t v)
+{
+    if (l == 4)
+	put_be4(p, v);
+    else if (l == 2) {
+	p[0] = v >> 8;
+	p[1] = v;
+    } else
+	p[0] = v;
+}
+
+static void
+encode_delta(StringAccum &sa, const uint8_t *data, int width, int count)
+{
+    int l = lane_size(width), nlanes = width / l, shift = 32 - 8 * l;
+    uint32_t prev[16];
+    memset(prev, 0, sizeof(prev));
+    for (int i = 0; i < count; ++i)
+	for (int j = 0; j < nlanes; ++j, data += l) {
+	    uint32_t cur = get_lane(data, l);
+	    int32_t d = (int32_t) ((cur - prev[j]) << shift) >> shift;
+	    put_varint(sa, ((uint32_t) d << 1) ^ (uint32_t) (d >> 31));
+	    prev[j] = cur;
+	}
+}
+
+
+ColumnWriter::ColumnWriter()
+    : _fd(-1), _block(0), _in_record(false), _free(0), _out_pos(0), _error(0)
+{
+#if HAVE_USER_MULTITHREAD
+    _running = false;
+#endif
+}
+
+ColumnWriter::~ColumnWriter()
+{
+    stop();
+}
+
+int
+ColumnWriter::start(int fd, const Vector<int> &widths, int block_packets,
+		    ErrorHandler *errh)
+{
+    assert(_fd < 0 && widths.size() > 0 && block_packets > 0);
+    _fd = fd;
+    _widths = widths;
+    _mark.assign(widths.size(), 0);
+    _block_packets = block_packets;
+    _error = 0;
+    _block = get_block();
+
+    off_t pos = lseek(fd, 0, SEEK_CUR);
+    _out_pos = (pos < 0 ? 0 : pos);
+
+#if HAVE_USER_MULTITHREAD
+    _queue_head = 0;
+    _queue_tail = &_queue_head;
+    _nqueued = 0;
+    _stopping = _flush_request = false;
+    pthread_mutex_init(&_lock, 0);
+    pthread_cond_init(&_work_cond, 0);
+    pthread_cond_init(&_done_cond, 0);
+    if (int err = pthread_create(&_thread, 0, thread_main, this)) {
+	pthread_cond_destroy(&_done_cond);
+	pthread_cond_destroy(&_work_cond);
+	pthread_mutex_destroy(&_lock);
+	errh->warning("cannot start writer thread: %s", strerror(err));
+    } else
+	_running = true;
+#else
+    (void) errh;
+#endif
+    return 0;
+}
+
+void
+ColumnWriter::stop()
+{
+    if (_fd < 0)
+	return;
+    flush();
+#if HAVE_USER_MULTITHREAD
+    if (_running) {
+	pthread_mutex_lock(&_lock);
+	_stopping = true;
+	pthread_cond_signal(&_work_cond);
+	pthread_mutex_unlock(&_lock);
+	pthread_join(_thread, 0);
+	pthread_cond_destroy(&_done_cond);
+	pthread_cond_destroy(&_work_cond);
+	pthread_mutex_destroy(&_lock);
+	_running = false;
+    }
+#endif
+    put_block(_block);
+    _block = 0;
+    while (Block *b = _free) {
+	_free = b->next;
+	delete[] b->col;
+	delete b;
+    }
+    _fd = -1;
+}
+
+ColumnWriter::Block *
+ColumnWriter::get_block()
+{
+    Block *b;
+#if HAVE_USER_MULTITHREAD
+    if (_running)
+	pthread_mutex_lock(&_lock);
+#endif
+    if ((b = _free))
+	_free = b->next;
+#if HAVE_USER_MULTITHREAD
+    if (_running)
+	pthread_mutex_unlock(&_lock);
+#endif
+    if (b) {
+	for (int i = 0; i < _widths.size(); ++i)
+	    b->col[i].clear();
+	b->text.clear();
+    } else {
+	b = new Block;
+	b->col = new StringAccum[_widths.size()];
+    }
+    b->count = 0;
+    b->is_text = false;
+    b->next = 0;
+    return b;
+}
+
+void
+ColumnWriter::put_block(Block *b)
+{
+#if HAVE_USER_MULTITHREAD
+    if (_running)
+	pthread_mutex_lock(&_lock);
+#endif
+    b->next = _free;
+    _free = b;
+#if HAVE_USER_MULTITHREAD
+    if (_running)
+	pthread_mutex_unlock(&_lock);
+#endif
+}
+
+void
+ColumnWriter::submit(Block *b)
+{
+#if HAVE_USER_MULTITHREAD
+    if (_running) {
+	pthread_mutex_lock(&_lock);
+	while (_nqueued >= MAX_QUEUED)
+	    pthread_cond_wait(&_done_cond, &_lock);
+	*_queue_tail = b;
+	_queue_tail = &b->next;
+	++_nqueued;
+	pthread_cond_signal(&_work_cond);
+	pthread_mutex_unlock(&_lock);
+	return;
+    }
+#endif
+    write_block(b);
+    put_block(b);
+}
+
+void
+ColumnWriter::submit_current()
+{
+    if (_block->count) {
+	submit(_block);
+	_block = get_block();
+    }
+}
+
+void
+ColumnWriter::write_text(const String &s)
+{
+    Block *tb = get_block();
+    tb->is_text = true;
+    tb->text << s;
+    if (_in_record) {
+	// The current record belongs after the text: move its values into
+	// a fresh block and submit the completed records first.
+	Block *nb = get_block();
+	for (int i = 0; i < _widths.size(); ++i) {
+	    StringAccum &col = _block->col[i];
+	    nb->col[i].append(col.data() + _mark[i], col.length() - _mark[i]);
+	    col.set_length(_mark[i]);
+	    _mark[i] = 0;
+	}
+	if (_block->count)
+	    submit(_block);
+	else
+	    put_block(_block);
+	_block = nb;
+    } else
+	submit_current();
+    submit(tb);
+}
+
+void
+ColumnWriter::flush()
+{
+    if (_fd < 0)
+	return;
+    if (!_in_record)
+	submit_current();
+#if HAVE_USER_MULTITHREAD
+    if (_running) {
+	pthread_mutex_lock(&_lock);
+	_flush_request = true;
+	pthread_cond_signal(&_work_cond);
+	while (_flush_request || _nqueued)
+	    pthread_cond_wait(&_done_cond, &_lock);
+	pthread_mutex_unlock(&_lock);
+	return;
+    }
+#endif
+    write_out(true);
+}
+
+#if HAVE_USER_MULTITHREAD
+void *
+ColumnWriter::thread_main(void *arg)
+{
+    ColumnWriter *w = static_cast<ColumnWriter *>(arg);
+    pthread_mutex_lock(&w->_lock);
+    while (1) {
+	if (Block *b = w->_queue_head) {
+	    if (!(w->_queue_head = b->next))
+		w->_queue_tail = &w->_queue_head;
+	    pthread_mutex_unlock(&w->_lock);
+	    w->write_block(b);
+	    pthread_mutex_lock(&w->_lock);
+	    b->next = w->_free;
+	    w->_free = b;
+	    --w->_nqueued;
+	    pthread_cond_broadcast(&w->_done_cond);
+	} else if (w->_flush_request) {
+	    pthread_mutex_unlock(&w->_lock);
+	    w->write_out(true);
+	    pthread_mutex_lock(&w->_lock);
+	    w->_flush_request = false;
+	    pthread_cond_broadcast(&w->_done_cond);
+	} else if (w->_stopping)
+	    break;
+	else
+	    pthread_cond_wait(&w->_work_cond, &w->_lock);
+    }
+    pthread_mutex_unlock(&w->_lock);
+    return 0;
+}
+#endif
+
+bool
+ColumnWriter::encode_dict(const uint8_t *data, int width, int count, int limit)
+{
+    int tsize = 64;
+    while (tsize < 2 * count)
+	tsize *= 2;
+    _dict_table.assign(tsize, -1);
+    _dict_first.clear();
+    _index_sa.clear();
+
+    for (int i = 0; i < count; ++i) {
+	const uint8_t *v = data + i * width;
+	uint32_t h = 2166136261U;
+	for (int j = 0; j < width; ++j)
+	    h = (h ^ v[j]) * 16777619U;
+	int slot = h & (tsize - 1);
+	while (_dict_table[slot] >= 0
+	       && memcmp(data + _dict_first[_dict_table[slot]] * width, v, width) != 0)
+	    slot = (slot + 1) & (tsize - 1);
+	if (_dict_table[slot] < 0) {
+	    _dict_table[slot] = _dict_first.size();
+	    _dict_first.push_back(i);
+	    if (_dict_first.size() * width + _index_sa.length() >= limit)
+		return false;
+	}
+	put_varint(_index_sa, _dict_table[slot]);
+    }
+
+    _dict_sa.clear();
+    put_varint(_dict_sa, _dict_first.size());
+    for (int *fp = _dict_first.begin(); fp != _dict_first.end(); ++fp)
+	_dict_sa.append((const char *) data + *fp * width, width);
+    _dict_sa << _index_sa;
+    return _dict_sa.length() < limit;
+}
+
+void
+ColumnWriter::encode_column(const StringAccum &col, int width, int count)
+{
+    const uint8_t *data = reinterpret_cast<const uint8_t *>(col.data());
+    int len = col.length();
+    int encoding = COL_RAW, best = len;
+
+    if (width > 0 && len == width * count && count > 1) {
+	_delta_sa.clear();
+	encode_delta(_delta_sa, data, width, count);
+	if (_delta_sa.length() < best) {
+	    encoding = COL_DELTA;
+	    best = _delta_sa.length();
+	}
+	if (width >= 2 && encode_dict(data, width, count, best)) {
+	    encoding = COL_DICT;
+	    best = _dict_sa.length();
+	}
+    }
+
+    char *x = _out.extend(6);
+    x[0] = encoding;
+    x[1] = width;
+    put_be4(x + 2, best);
+    if (encoding == COL_DELTA)
+	_out << _delta_sa;
+    else if (encoding == COL_DICT)
+	_out << _dict_sa;
+    else
+	_out.append(col.data(), len);
+}
+
+void
+ColumnWriter::write_block(Block *b)
+{
+    int start = _out.length();
+    if (b->is_text) {
+	put_be4(_out.extend(4), (b->text.length() + 4) | 0x80000000U);
+	_out << b->text;
+    } else {
+	put_be4(_out.extend(8) + 4, b->count);
+	for (int i = 0; i < _widths.size(); ++i)
+	    encode_column(b->col[i], _widths[i], b->count);
+	put_be4(_out.data() + start, _out.length() - start);
+    }
+    write_out(false);
+}
+
+void
+ColumnWriter::write_out(bool all)
+{
+    // Write only whole WRITE_UNIT-aligned extents of the file unless asked
+    // to write everything.
+    int n = _out.length();
+    if (!all) {
+	off_t end = _out_pos + n;
+	n = (end - end % WRITE_UNIT) - _out_pos;
+	if (n <= 0)
+	    return;
+    }
+
+    const char *p = _out.data();
+    for (int left = n; left > 0 && !_error; ) {
+	ssize_t w = ::write(_fd, p, left);
+	if (w >= 0) {
+	    p += w;
+	    left -= w;
+	} else if (errno != EINTR)
+	    _error = errno;
+    }
+
+    memmove(_out.data(), _out.data() + n, _out.length() - n);
+    _out.set_length(_out.length() - n);
+    _out_pos += n;
+}
+
+
+ColumnDecoder::ColumnDecoder()
+    : _cols(0), _ncols(0)
+{
+}
+
+ColumnDecoder::~ColumnDecoder()
+{
+    delete[] _cols;
+}
+
+bool
+ColumnDecoder::decode_column(int i, int encoding, int width, int count,
+			     const uint8_t *data, const uint8_t *end)
+{
+    if (encoding == COL_RAW) {
+	// variable-length values are checked as they are read
+	if (width && ((uint32_t) (end - data) % width != 0
+		      || (uint32_t) (end - data) / width != (uint32_t) count))
+	    return false;
+	_begin[i] = data;
+	_end[i] = end;
+	return true;
+    }
+
+    // every encoded value takes at least one byte
+    if (width == 0 || (uint32_t) count > (uint32_t) (end - data)
+	|| (uint32_t) count > 0x7FFFFFFFU / width)
+	return false;
+    StringAccum &sa = _cols[i];
+    sa.clear();
+    char *x = sa.extend(count * width);
+    if (!x)
+	return false;
+    uint32_t v;
+
+    if (encoding == COL_DELTA) {
+	int l = lane_size(width), nlanes = width / l;
+	uint32_t mask = (l == 4 ? 0xFFFFFFFFU : (1U << (8 * l)) - 1);
+	uint32_t prev[16];
+	if (nlanes > (int) (sizeof(prev) / sizeof(prev[0])))
+	    return false;
+	memset(prev, 0, sizeof(prev));
+	for (int k = 0; k < count; ++k)
+	    for (int j = 0; j < nlanes; ++j, x += l) {
+		if (!(data = get_varint(data, end, v)))
+		    return false;
+		prev[j] = (prev[j] + ((v >> 1) ^ -(v & 1))) & mask;
+		put_lane(x, l, prev[j]);
+	    }
+    } else if (encoding == COL_DICT) {
+	if (!(data = get_varint(data, end, v))
+	    || v > (uint32_t) (end - data) / width)
+	    return false;
+	const uint8_t *dict = data;
+	uint32_t dsize = v;
+	data += dsize * width;
+	for (int k = 0; k < count; ++k, x += width) {
+	    if (!(data = get_varint(data, end, v)) || v >= dsize)
+		return false;
+	    memcpy(x, dict + v * width, width);
+	}
+    } else
+	return false;
+
+    _begin[i] = reinterpret_cast<const uint8_t *>(sa.data());
+    _end[i] = _begin[i] + sa.length();
+    return data == end;
+}
+
+int
+ColumnDecoder::decode(const String &record, const Vector<int> &widths,
+		      String *errmsg)
+{
+    _record = record;
+    const uint8_t *data = reinterpret_cast<const uint8_t *>(record.data());
+    const uint8_t *end = data + record.length();
+    if (end - data < 4) {
+	*errmsg = "columnar block too short";
+	return -1;
+    }
+    int count = get_be4(data);
+    int nfields = widths.size();
+    data += 4;
+
+    if (_ncols < nfields) {
+	delete[] _cols;
+	_cols = new StringAccum[nfields];
+	_ncols = nfields;
+    }
+    _begin.resize(nfields);
+    _end.resize(nfields);
+
+    for (int i = 0; i < nfields; ++i) {
+	if (end - data < 6) {
+	    *errmsg = "columnar block has too few columns";
+	    return -1;
+	}
+	int encoding = data[0], width = data[1];
+	uint32_t len = get_be4(data + 2);
+	data += 6;
+	if (len > (uint32_t) (end - data)
+	    || count < 0
+	    || width != widths[i]
+	    || !decode_column(i, encoding, width, count, data, data + len)) {
+	    *errmsg = "bad columnar block";
+	    return -1;
+	}
+	data += len;
+    }
+
+    if (data != end) {
+	*errmsg = "columnar block has too many columns";
+	return -1;
+    }
+    return count;
+}
+
+}
+
+ELEMENT_REQUIRES(userlevel IPSummaryDump)
+ELEMENT_PROVIDES(IPSummaryDump_Columnar)
+CLICK_ENDDECLS
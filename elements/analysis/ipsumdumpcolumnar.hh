@@ -0,0 +1,152 @@
+// -*- mode: c++; c-basic-offset: 4 -*-
+#ifndef CLICK_IPSUMDUMPCOLUMNAR_HH
+#define CLICK_IPSUMDUMPCOLUMNAR_HH
+#include "ipsumdumpinfo.hh"
+#include <click/vector.hh>
+#if HAVE_USER_MULTITHREAD
+# include <pthread.h>
+#endif
+CLICK_DECLS
+class ErrorHandler;
+
+namespace IPSummaryDump {
+
+// Columnar binary dumps ('!binary columnar') use the same record framing as
+// binary dumps, but each regular record holds a block of packets stored
+// column by column.  Block record layout:
+//
+//   uint32  record length (high bit clear)
+//   uint32  number of packets N
+//   for each field in '!data' order:
+//     uint8   encoding (COL_RAW, COL_DELTA, COL_DICT)
+//     uint8   value width in bytes, or 0 for variable-length fields
+//     uint32  encoded column length
+//     ...     encoded column
+//
+// A decoded column is the concatenation of the N values' binary-format
+// representations.  COL_DELTA stores each value as zigzag varint deltas
+// from the previous value, lane by lane (4-, 2- or 1-byte big-endian
+// lanes).  COL_DICT stores a varint dictionary size D, D distinct values,
+// and N varint indexes.  All state resets at each block.
+
+enum { COL_RAW = 0, COL_DELTA = 1, COL_DICT = 2 };
+
+int column_width(int type);
+
+class ColumnWriter { public:
+
+    ColumnWriter();
+    ~ColumnWriter();
+
+    int start(int fd, const Vector<int> &widths, int block_packets, ErrorHandler *errh);
+    void stop();
+
+    StringAccum &column(int i) const	{ return _block->col[i]; }
+    inline void begin_record();
+    inline void end_record();
+    void write_text(const String &s);
+    void flush();
+    int error() const			{ return _error; }
+
+    enum { WRITE_UNIT = 262144 };
+
+  private:
+
+    struct Block {
+	StringAccum *col;
+	StringAccum text;
+	int count;
+	bool is_text;
+	Block *next;
+    };
+
+    int _fd;
+    Vector<int> _widths;
+    int _block_packets;
+    Block *_block;
+    Vector<int> _mark;
+    bool _in_record;
+
+    Block *_free;
+    StringAccum _out;
+    off_t _out_pos;
+    int _error;
+
+    // encoding scratch, used only by the writing thread
+    StringAccum _delta_sa;
+    StringAccum _dict_sa;
+    StringAccum _index_sa;
+    Vector<int> _dict_table;
+    Vector<int> _dict_first;
+
+#if HAVE_USER_MULTITHREAD
+    enum { MAX_QUEUED = 8 };
+    pthread_t _thread;
+    pthread_mutex_t _lock;
+    pthread_cond_t _work_cond;
+    pthread_cond_t _done_cond;
+    Block *_queue_head;
+    Block **_queue_tail;
+    int _nqueued;
+    bool _running;
+    bool _stopping;
+    bool _flush_request;
+
+    static void *thread_main(void *);
+#endif
+
+    Block *get_block();
+    void put_block(Block *b);
+    void submit(Block *b);
+    void submit_current();
+    void write_block(Block *b);
+    void write_out(bool all);
+    void encode_column(const StringAccum &col, int width, int count);
+    bool encode_dict(const uint8_t *data, int width, int count, int limit);
+
+};
+
+class ColumnDecoder { public:
+
+    ColumnDecoder();
+    ~ColumnDecoder();
+
+    int decode(const String &record, const Vector<int> &widths, String *errmsg);
+
+    const uint8_t *column_begin(int i) const	{ return _begin[i]; }
+    const uint8_t *column_end(int i) const	{ return _end[i]; }
+
+  private:
+
+    String _record;
+    StringAccum *_cols;
+    int _ncols;
+    Vector<const uint8_t *> _begin;
+    Vector<const uint8_t *> _end;
+
+    bool decode_column(int i, int encoding, int width, int count,
+		       const uint8_t *data, const uint8_t *end);
+
+};
+
+
+inline void
+ColumnWriter::begin_record()
+{
+    for (int i = 0; i < _widths.size(); ++i)
+	_mark[i] = _block->col[i].length();
+    _in_record = true;
+}
+
+inline void
+ColumnWriter::end_record()
+{
+    _in_record = false;
+    if (++_block->count >= _block_packets)
+	submit_current();
+}
+
+}
+
+CLICK_ENDDECLS
+#endif
@@ -28,6 +28,8 @@
 #include <clicknet/tcp.h>
 #include <clicknet/udp.h>
 #include <clicknet/icmp.h>
+#include <clicknet/ip6.h>
+#include <clicknet/ether.h>
 CLICK_DECLS
 
 static Vector<const void *> *writers;
@@ -183,21 +185,30 @@ static const char *field_missing_proto_name(int proto)
 bool hard_field_missing(const PacketDesc &d, int proto, int l)
 {
     if (d.bad_sa && !*d.bad_sa) {
+	int ip_p = d.ip6_p;
+	if (d.iph && d.network_length() > (int) offsetof(click_ip, ip_p))
+	    ip_p = d.iph->ip_p;
 	if (proto == MISSING_ETHERNET)
 	    *d.bad_sa << "!bad Ethernet header\n";
-	else if (!d.iph)
+	else if (!d.iph && !d.ip6h)
 	    *d.bad_sa << "!bad no IP header\n";
-	else if (proto == MISSING_IP)
+	else if ((proto == MISSING_IP && !d.iph)
+		 || (proto == MISSING_IP6 && !d.ip6h))
+	    // a field for the other IP version is a silent error
+	    return false;
+	else if (proto == MISSING_IP || proto == MISSING_IP6)
 	    *d.bad_sa << "!bad truncated IP header capture\n";
-	else if (d.network_length() > (int) offsetof(click_ip, ip_p)
+	else if (d.ip6h && ip_p < 0)
+	    *d.bad_sa << "!bad truncated IPv6 extension header capture\n";
+	else if (ip_p >= 0
 		 && ((proto > MISSING_IP && proto < 256
-		      && d.iph->ip_p != proto)
+		      && ip_p != proto)
 		     || (proto == IP_PROTO_TCP_OR_UDP
-			 && d.iph->ip_p != IP_PROTO_TCP
-			 && d.iph->ip_p != IP_PROTO_UDP)))
+			 && ip_p != IP_PROTO_TCP
+			 && ip_p != IP_PROTO_UDP)))
 	    // wrong protocol is a silent error, not a bad packet
 	    return false;
-	else if (!IP_FIRSTFRAG(d.iph))
+	else if (d.iph ? !IP_FIRSTFRAG(d.iph) : !d.ip6_firstfrag)
 	    *d.bad_sa << "!bad fragmented " << field_missing_proto_name(proto) << " header\n";
 	else if ((int) (d.transport_length() + EXTRA_LENGTH_ANNO(d.p)) >= l)
 	    *d.bad_sa << "!bad truncated " << field_missing_proto_name(proto) << " header capture\n";
@@ -359,7 +370,23 @@ void ip_prepare(PacketDesc &d, const FieldWriter *)
 	/* nada */;
     else if (p->network_length() < (int) offsetof(click_ip, ip_id))
 	BAD("truncated IP header", d.iph);
-    else if (d.iph->ip_v != 4)
+    else if (d.iph->ip_v == 6) {
+	d.ip6h = reinterpret_cast<const click_ip6 *>(d.iph);
+	d.iph = 0;
+	if (p->network_length() < (int) sizeof(click_ip6))
+	    BAD("truncated IPv6 header", d.ip6h);
+	else if (d.ip6h->ip6_plen) {
+	    // truncate packet length to IPv6 length if necessary
+	    int ip_len = sizeof(click_ip6) + ntohs(d.ip6h->ip6_plen);
+	    if (p->network_length() > ip_len)
+		d.tailpad = p->network_length() - ip_len;
+	    else if (d.careful_trunc && p->network_length() + EXTRA_LENGTH_ANNO(p) < (uint32_t) ip_len) {
+		int scratch;
+		BAD2("truncated IP missing ", (ip_len - p->network_length() - EXTRA_LENGTH_ANNO(p)), scratch);
+		(void) scratch;
+	    }
+	}
+    } else if (d.iph->ip_v != 4)
 	BAD2("IP version ", d.iph->ip_v, d.iph);
     else if (d.iph->ip_hl < (sizeof(click_ip) >> 2))
 	BAD2("IP header length ", d.iph->ip_hl, d.iph);
@@ -402,6 +429,24 @@ void ip_prepare(PacketDesc &d, const FieldWriter *)
 	|| d.iph->ip_p != IP_PROTO_ICMP
 	|| !IP_FIRSTFRAG(d.iph))
 	d.icmph = 0;
+
+    // find IPv6 upper-layer header, which follows any extension headers
+    if (d.ip6h) {
+	uint32_t off;
+	d.ip6_p = ip6_walk_exthdrs(d.ip6h, d.network_length(), off, d.ip6_firstfrag);
+	if (d.ip6_p >= 0) {
+	    p->set_ip6_header(d.ip6h, off);
+	    if (d.ip6_firstfrag && d.network_length() > off) {
+		if (d.ip6_p == IP_PROTO_TCP) {
+		    d.tcph = p->tcp_header();
+		    if (d.transport_length() > 12
+			&& d.tcph->th_off < (sizeof(click_tcp) >> 2))
+			BAD2("TCP header length ", d.tcph->th_off, d.tcph);
+		} else if (d.ip6_p == IP_PROTO_UDP)
+		    d.udph = p->udp_header();
+	    }
+	}
+    }
 #undef BAD
 #undef BAD2
 
@@ -412,6 +457,57 @@ void ip_prepare(PacketDesc &d, const FieldWriter *)
 	    SET_EXTRA_LENGTH_ANNO(p, 0);
 	else
 	    SET_EXTRA_LENGTH_ANNO(p, full_len - 0xFFFF);
+    } else if (d.ip6h && d.ip6h->ip6_plen)
+	SET_EXTRA_LENGTH_ANNO(p, 0);
+}
+
+// Returns the protocol of the first IPv6 header that is not an extension
+// header and sets 'off' to its offset, or returns -1 if the chain is
+// truncated.  Later fragments stop after their fragment header.  Each
+// extension header appends its protocol to 'chain', and a fragment header
+// also appends its offset field.
+int ip6_walk_exthdrs(const click_ip6 *ip6h, uint32_t len, uint32_t &off,
+		     bool &firstfrag, StringAccum *chain)
+{
+    const uint8_t *data = reinterpret_cast<const uint8_t *>(ip6h);
+    int nxt = ip6h->ip6_nxt;
+    off = sizeof(click_ip6);
+    firstfrag = true;
+    while (1) {
+	uint32_t hlen;
+	switch (nxt) {
+	case IP6PROTO_HOPOPTS:
+	case IP6PROTO_ROUTING:
+	case IP6PROTO_DSTOPTS:
+	    if (off + 2 > len)
+		return -1;
+	    hlen = (data[off + 1] + 1) << 3;
+	    break;
+	case IP6PROTO_AH:
+	    if (off + 2 > len)
+		return -1;
+	    hlen = (data[off + 1] + 2) << 2;
+	    break;
+	case IP6PROTO_FRAGMENT:
+	    hlen = sizeof(click_ip6_fragment);
+	    break;
+	default:
+	    return nxt;
+	}
+	if (off + hlen > len)
+	    return -1;
+	if (chain) {
+	    *chain << (char) nxt;
+	    if (nxt == IP6PROTO_FRAGMENT)
+		chain->append(reinterpret_cast<const char *>(data + off + 2), 2);
+	}
+	if (nxt == IP6PROTO_FRAGMENT
+	    && (reinterpret_cast<const click_ip6_fragment *>(data + off)->ip6_frag_offset & htons(IP6_OFFMASK)))
+	    firstfrag = false;
+	nxt = data[off];
+	off += hlen;
+	if (!firstfrag)
+	    return nxt;
     }
 }
 
@@ -441,12 +537,34 @@ bool PacketOdesc::hard_make_ip()
     return true;
 }
 
+bool PacketOdesc::hard_make_ip6()
+{
+    // fails if the packet already has an IPv4 header
+    if (!is_ip || (p->has_network_header() && p->network_length() > 0))
+	return false;
+    if (!p->has_network_header())
+	p->set_network_header(p->data(), 0);
+    if (!(p = p->put(sizeof(click_ip6))))
+	return false;
+    click_ip6 *ip6h = reinterpret_cast<click_ip6 *>(p->network_header());
+    p->set_ip6_header(ip6h, sizeof(click_ip6));
+    memset(ip6h, 0, sizeof(click_ip6));
+    ip6h->ip6_flow = htonl(6 << IP6_V_SHIFT);
+    ip6h->ip6_nxt = default_ip_p;
+    ip6h->ip6_hlim = 100;
+    if (p->mac_header() && p->network_header() - p->mac_header() >= 14
+	&& p->ether_header()->ether_type == htons(ETHERTYPE_IP))
+	p->ether_header()->ether_type = htons(ETHERTYPE_IP6);
+    is_ip6 = true;
+    ip6_nxt_off = offsetof(click_ip6, ip6_nxt);
+    return true;
+}
+
 bool PacketOdesc::hard_make_transp()
 {
-    click_ip *iph = p->ip_header();
-    if (IP_FIRSTFRAG(iph)) {
+    if (is_ip6 ? ip6_firstfrag : IP_FIRSTFRAG(p->ip_header())) {
 	int len;
-	switch (iph->ip_p) {
+	switch (ip_proto()) {
 	case IP_PROTO_TCP:
 	    len = sizeof(click_tcp);
 	    break;
@@ -458,6 +576,7 @@ bool PacketOdesc::hard_make_transp()
 	    len = 12;
 	    break;
 	case IP_PROTO_ICMP:
+	case IP_PROTO_ICMP6:
 	    len = sizeof(click_icmp);
 	    break;
 	default:
@@ -471,7 +590,7 @@ bool PacketOdesc::hard_make_transp()
 	    int xlen = (len < 4 ? 4 : len);
 	    if (!(p = p->put(xlen - p->transport_length())))
 		return false;
-	    if (p->ip_header()->ip_p == IP_PROTO_TCP && len >= 13)
+	    if (ip_proto() == IP_PROTO_TCP && len >= 13)
 		p->tcp_header()->th_off = sizeof(click_tcp) >> 2;
 	    if (default_ip_flowid) {
 		click_udp *udph = p->udp_header();
@@ -7,6 +7,7 @@
 CLICK_DECLS
 class Element;
 class IPFlowID;
+struct click_ip6;
 
 namespace IPSummaryDump {
 
@@ -24,6 +25,9 @@ struct PacketDesc {
     const click_udp *udph;
     const click_tcp *tcph;
     const click_icmp *icmph;
+    const click_ip6 *ip6h;
+    int ip6_p;			// IPv6 upper-layer protocol, or -1 if unknown
+    bool ip6_firstfrag;
     int tailpad;		// # bytes extraneous data at end of packet
 
     union {
@@ -63,6 +67,8 @@ struct PacketDesc {
 struct PacketOdesc {
     WritablePacket* p;
     bool is_ip;
+    bool is_ip6;
+    bool ip6_firstfrag : 1;
     bool have_icmp_type : 1;
     bool have_icmp_code : 1;
     bool have_ip_hl : 1;
@@ -81,13 +87,17 @@ struct PacketOdesc {
     const IPFlowID *default_ip_flowid;
     int minor_version;
     uint32_t want_len;
+    int ip6_nxt_off;		// offset of the IPv6 upper-layer protocol byte
 
     inline PacketOdesc(const Element *e, WritablePacket *p, int default_ip_p, const IPFlowID *default_ip_flowid, int minor_version);
     void clear_values()			{ vptr[0] = vptr[1] = 0; }
     bool make_ip(int ip_p);
+    bool make_ip6();
     bool make_transp();
+    inline uint8_t &ip_proto() const;
   private:
     bool hard_make_ip();
+    bool hard_make_ip6();
     bool hard_make_transp();
 };
 
@@ -174,12 +184,15 @@ bool num_ina(PacketOdesc&, const String &, const FieldReader *);
 const uint8_t *inb(PacketOdesc&, const uint8_t*, const uint8_t*, const FieldReader *);
 
 enum { MISSING_IP = 0,
-       MISSING_ETHERNET = 260 };
+       MISSING_ETHERNET = 260,
+       MISSING_IP6 = 261 };
 inline bool field_missing(const PacketDesc &d, int proto, int l);
 bool hard_field_missing(const PacketDesc &d, int proto, int l);
 
 // particular parsers
 void ip_prepare(PacketDesc &, const FieldWriter *);
+int ip6_walk_exthdrs(const click_ip6 *ip6h, uint32_t len, uint32_t &off,
+		     bool &firstfrag, StringAccum *chain = 0);
 
 enum { DO_IPOPT_PADDING = 1,
        DO_IPOPT_ROUTE = 2,
@@ -210,22 +223,35 @@ void unparse_tcp_opt_binary(StringAccum&, const uint8_t*, int olen, int mask);
 void unparse_tcp_opt_binary(StringAccum&, const click_tcp*, int mask);
 
 inline PacketDesc::PacketDesc(const Element *e_, Packet* p_, StringAccum* sa_, StringAccum* bad_sa_, bool careful_trunc_, bool force_extra_length_)
-    : p(p_), iph(0), udph(0), tcph(0), tailpad(0), sa(sa_), bad_sa(bad_sa_),
+    : p(p_), iph(0), udph(0), tcph(0), icmph(0), ip6h(0), ip6_p(-1),
+      ip6_firstfrag(true), tailpad(0), sa(sa_), bad_sa(bad_sa_),
       careful_trunc(careful_trunc_), force_extra_length(force_extra_length_),
       e(e_)
 {
 }
 
 inline PacketOdesc::PacketOdesc(const Element *e_, WritablePacket* p_, int default_ip_p_, const IPFlowID *default_ip_flowid_, int minor_version_)
-    : p(p_), is_ip(true), have_icmp_type(false), have_icmp_code(false),
+    : p(p_), is_ip(true), is_ip6(false), ip6_firstfrag(true),
+      have_icmp_type(false), have_icmp_code(false),
       have_ip_hl(false), have_tcp_hl(false),
       e(e_), default_ip_p(default_ip_p_), default_ip_flowid(default_ip_flowid_),
-      minor_version(minor_version_), want_len(0)
+      minor_version(minor_version_), want_len(0), ip6_nxt_off(0)
 {
 }
 
+inline uint8_t &PacketOdesc::ip_proto() const
+{
+    // assumes make_ip() or make_ip6()
+    if (is_ip6)
+	return p->network_header()[ip6_nxt_off];
+    else
+	return p->ip_header()->ip_p;
+}
+
 inline bool PacketOdesc::make_ip(int ip_p)
 {
+    if (is_ip6)
+	return !ip_p || !ip_proto() || ip_proto() == ip_p;
     if ((!is_ip || !p->has_network_header()
 	 || p->network_length() < (int) sizeof(click_ip))
 	&& !hard_make_ip())
@@ -233,11 +259,16 @@ inline bool PacketOdesc::make_ip(int ip_p)
     return !ip_p || !p->ip_header()->ip_p || p->ip_header()->ip_p == ip_p;
 }
 
+inline bool PacketOdesc::make_ip6()
+{
+    return is_ip6 || hard_make_ip6();
+}
+
 inline bool PacketOdesc::make_transp()
 {
-    // assumes make_ip()
+    // assumes make_ip() or make_ip6()
     assert(is_ip && p->network_header());
-    if (!IP_FIRSTFRAG(p->ip_header()))
+    if (is_ip6 ? !ip6_firstfrag : !IP_FIRSTFRAG(p->ip_header()))
 	return false;
     if (p->transport_length() < 8)
 	return hard_make_transp();
@@ -19,6 +19,7 @@
 
 #include <click/config.h>
 #include "toipsumdump.hh"
+#include "ipsumdumpcolumnar.hh"
 #include <click/standard/scheduleinfo.hh>
 #include <click/args.hh>
 #include <click/error.hh>
@@ -31,12 +32,13 @@
 CLICK_DECLS
 
 ToIPSummaryDump::ToIPSummaryDump()
-    : _f(0), _task(this)
+    : _f(0), _cw(0), _task(this)
 {
 }
 
 ToIPSummaryDump::~ToIPSummaryDump()
 {
+    delete _cw;
 }
 
 int
@@ -50,6 +52,8 @@ ToIPSummaryDump::configure(Vector<String> &conf, ErrorHandler *errh)
     bool binary = false;
     bool header = true;
     bool extra_length = true;
+    bool columnar = false;
+    _block_packets = 4096;
 
     if (Args(conf, this, errh)
 	.read_mp("FILENAME", FilenameArg(), _filename)
@@ -64,8 +68,14 @@ ToIPSummaryDump::configure(Vector<String> &conf, ErrorHandler *errh)
 	.read("CAREFUL_TRUNC", careful_trunc)
 	.read("EXTRA_LENGTH", extra_length)
 	.read("BINARY", binary)
+	.read("COLUMNAR", columnar)
+	.read("BLOCK_PACKETS", _block_packets)
 	.complete() < 0)
 	return -1;
+    if (columnar)
+	binary = true;
+    if (_block_packets <= 0 || _block_packets > 1048576)
+	errh->error("BLOCK_PACKETS out of range");
 
     Vector<String> v;
     cp_spacevec(save, v);
@@ -107,6 +117,7 @@ ToIPSummaryDump::configure(Vector<String> &conf, ErrorHandler *errh)
     _careful_trunc = careful_trunc;
     _multipacket = multipacket;
     _binary = binary;
+    _columnar = columnar;
     _header = header;
     _extra_length = extra_length;
 
@@ -162,19 +173,34 @@ ToIPSummaryDump::initialize(ErrorHandler *errh)
     sa << '\n';
 
     // binary marker
-    if (_binary)
+    if (_columnar)
+	sa << "!binary columnar\n";
+    else if (_binary)
 	sa << "!binary\n";
 
     // print output
     if (_header)
 	ignore_result(fwrite(sa.data(), 1, sa.length(), _f));
 
+    // columnar blocks bypass stdio
+    if (_columnar) {
+	fflush(_f);
+	Vector<int> widths;
+	for (int i = 0; i < _fields.size(); i++)
+	    widths.push_back(IPSummaryDump::column_width(_fields[i]->type));
+	_cw = new IPSummaryDump::ColumnWriter;
+	if (_cw->start(fileno(_f), widths, _block_packets, errh) < 0)
+	    return -1;
+    }
+
     return 0;
 }
 
 void
 ToIPSummaryDump::cleanup(CleanupStage)
 {
+    if (_cw)
+	_cw->stop();
     if (_f && _f != stdout)
 	fclose(_f);
     _f = 0;
@@ -188,7 +214,15 @@ ToIPSummaryDump::summary(Packet* p, StringAccum& sa, StringAccum* bad_sa) const
     for (int i = 0; i < _prepare_fields.size(); i++)
 	_prepare_fields[i]->prepare(d, _prepare_fields[i]);
 
-    if (_binary) {
+    if (_columnar) {
+	for (int i = 0; i < _fields.size(); i++) {
+	    d.sa = &_cw->column(i);
+	    d.clear_values();
+	    bool ok = _fields[i]->extract(d, _fields[i]);
+	    _fields[i]->outb(d, ok, _fields[i]);
+	}
+	d.sa = &sa;
+    } else if (_binary) {
 	sa.extend(4);
 	for (int i = 0; i < _fields.size(); i++) {
 	    d.clear_values();
@@ -244,6 +278,17 @@ ToIPSummaryDump::write_packet(Packet* p, int multipacket)
 		p->timestamp_anno() += timestamp_delta;
 	}
 
+    } else if (_columnar) {
+	_bad_sa.clear();
+
+	_cw->begin_record();
+	summary(p, _sa, (_bad_packets ? &_bad_sa : 0));
+	if (_bad_packets && _bad_sa)
+	    _cw->write_text(_bad_sa.take_string());
+	_cw->end_record();
+
+	_output_count++;
+
     } else {
 	_sa.clear();
 	_bad_sa.clear();
@@ -288,6 +333,10 @@ ToIPSummaryDump::write_line(const String& s)
 {
     if (s.length()) {
 	assert(s.back() == '\n');
+	if (_cw) {
+	    _cw->write_text(s);
+	    return;
+	}
 	if (_binary) {
 	    uint32_t marker = htonl(s.length() | 0x80000000U);
 	    ignore_result(fwrite(&marker, 4, 1, _f));
@@ -301,6 +350,10 @@ ToIPSummaryDump::add_note(const String &s)
 {
     if (s.length()) {
 	int extra = 1 + (s.back() == '\n' ? 0 : 1);
+	if (_cw) {
+	    _cw->write_text("#" + s + (extra > 1 ? "\n" : ""));
+	    return;
+	}
 	if (_binary) {
 	    uint32_t marker = htonl((s.length() + extra) | 0x80000000U);
 	    ignore_result(fwrite(&marker, 4, 1, _f));
@@ -316,7 +369,9 @@ int
 ToIPSummaryDump::flush_handler(const String &, Element *e, void *, ErrorHandler *)
 {
     ToIPSummaryDump *tod = (ToIPSummaryDump *) e;
-    if (tod->_f)
+    if (tod->_cw)
+	tod->_cw->flush();
+    else if (tod->_f)
 	fflush(tod->_f);
     return 0;
 }
@@ -329,6 +384,6 @@ ToIPSummaryDump::add_handlers()
     add_write_handler("flush", flush_handler);
 }
 
-ELEMENT_REQUIRES(userlevel IPSummaryDump IPSummaryDump_Anno IPSummaryDump_IP IPSummaryDump_TCP IPSummaryDump_UDP IPSummaryDump_ICMP IPSummaryDump_Payload IPSummaryDump_Link)
+ELEMENT_REQUIRES(userlevel IPSummaryDump IPSummaryDump_Anno IPSummaryDump_IP IPSummaryDump_TCP IPSummaryDump_UDP IPSummaryDump_ICMP IPSummaryDump_Payload IPSummaryDump_Link IPSummaryDump_Columnar)
 EXPORT_ELEMENT(ToIPSummaryDump)
 CLICK_ENDDECLS
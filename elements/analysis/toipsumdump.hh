@@ -7,6 +7,7 @@
 #include <click/notifier.hh>
 #include "ipsumdumpinfo.hh"
 CLICK_DECLS
+namespace IPSummaryDump { class ColumnWriter; }
 
 /*
 =c
@@ -23,7 +24,8 @@ Writes summary information about incoming packets to FILENAME in a simple
 ASCII format---each line corresponds to a packet.  The FIELDS keyword
 argument determines what information is written.  Writes to standard output if
 FILENAME is a single dash `C<->'.  The BINARY keyword argument writes a packed
-binary format to save space.
+binary format to save space, and the COLUMNAR keyword argument writes a
+compressed block-columnar binary format.
 
 ToIPSummaryDump uses packets' extra-length and extra-packet-count annotations.
 
@@ -64,6 +66,12 @@ contain those fields. Valid field names, with examples, are:
    ip_ttl       IP time-to-live: '254'
    ip_sum       IP checksum: '43812'
    ip_opt       IP options (see below)
+   ip6_src      IPv6 source address: '2001:db8::1'
+   ip6_dst      IPv6 destination address: 'fe80::2'
+   ip6_flowlabel  IPv6 flow label: '74565'
+   ip6_class    IPv6 traffic class: '184'
+   ip6_hlim     IPv6 hop limit: '64'
+   ip6_exthdr   IPv6 extension header chain (see below)
    sport        TCP/UDP source port: '22'
    dport        TCP/UDP destination port: '2943'
    tcp_seq      TCP sequence number: '93167339'
@@ -110,6 +118,11 @@ contain those fields. Valid field names, with examples, are:
 
 If a field does not apply to a particular packet -- for example, 'C<sport>' on
 an ICMP packet -- ToIPSummaryDump prints a single dash for that value.
+The 'C<ip6_>' fields apply only to IPv6 packets, and the 'C<ip_>' header
+fields other than 'C<ip_proto>', 'C<ip_len>', and 'C<ip_capture_len>' apply
+only to IPv4 packets. For IPv6, 'C<ip_proto>' is the upper-layer protocol
+following any extension headers, and transport fields apply to
+unfragmented packets and first fragments.
 
 Default FIELDS is 'ip_src ip_dst'. You may also use spaces instead of
 underscores, in which case you must quote field names that contain a space --
@@ -137,6 +150,16 @@ of the dump. Ignored if HEADER is false.
 Boolean. If true, then output packet records in a binary format (explained
 below). Defaults to false.
 
+=item COLUMNAR
+
+Boolean.  If true, then write the columnar binary format described below.
+Implies BINARY.  Default is false.
+
+=item BLOCK_PACKETS
+
+Integer.  The number of packets per block in COLUMNAR output.  Default is
+4096.
+
 =item MULTIPACKET
 
 Boolean. If true, and the FIELDS option doesn't contain 'C<count>', then
@@ -253,6 +276,22 @@ contain a semicolon.) Any invalid option causes the entire field to be
 replaced by a single question mark 'C<?>'. A period 'C<.>' is used for packets
 with no options (except possibly EOL and NOP).
 
+=head1 IPV6 EXTENSION HEADERS
+
+The 'C<ip6_exthdr>' field lists the extension headers between the IPv6 header
+and the upper-layer protocol, in order, separated by semicolons.
+
+    Hop-by-hop      'hop'
+    Routing         'rt'
+    Fragment        'frag' (offset 0, no MF), 'frag:1448'
+                    (offset in bytes), 'frag:0+' ('+' adds MF)
+    Authentication  'ah'
+    Destination     'dst'
+
+A period 'C<.>' is used for packets with no extension headers. Header contents
+other than the fragment offset are not recorded; FromIPSummaryDump creates
+minimal 8-byte headers.
+
 =head1 TCP OPTIONS
 
 Single TCP option fields have the following representations.
@@ -314,6 +353,12 @@ the 'C<!data>' line, as follows:
                          ('F', 'f', or '.')
    ip_fragoff       2    IP fragment offset field
    ip_opt           ?    IP options
+   ip6_src         16    IPv6 source address
+   ip6_dst         16    IPv6 destination address
+   ip6_flowlabel    4    IPv6 flow label
+   ip6_class        1    IPv6 traffic class
+   ip6_hlim         1    IPv6 hop limit
+   ip6_exthdr       ?    IPv6 extension header chain
    tcp_seq          4    TCP sequence number
    tcp_ack          4    TCP ack number
    tcp_flags        1    TCP flags
@@ -338,6 +383,34 @@ The data stored in a metadata record is just an ASCII string, ending with
 newline, same as in a regular ASCII IPSummaryDump file. 'C<!bad>' records, for
 example, are stored this way.
 
+=head1 COLUMNAR FORMAT
+
+Columnar files use the 'C<!binary columnar>' marker line and the same record
+framing as binary files, but each regular record holds a block of up to
+BLOCK_PACKETS packets. The block starts with a 4-byte packet count, followed
+by one column per 'C<!data>' field:
+
+   +--------+--------+---------------+------------...
+   |encoding| width  | column length |    data
+   +--------+--------+---------------+------------...
+    <1 byte> <1 byte> <---4 bytes--->
+
+A decoded column is the concatenation of the block's values for that field, in
+the binary format above. Width is the field's length, or 0 for variable-length
+fields. Encoding 0 stores the decoded column as is. Encoding 1 stores each
+value as differences from the previous value, in 4-byte (or, for fields whose
+length is not a multiple of 4, 2- or 1-byte) big-endian lanes; each
+difference is zigzag-encoded and written as a varint (7 bits per byte, least
+significant first, high bit set on all but the last byte). Encoding 2 stores
+a varint dictionary size D, then D distinct values, then a varint dictionary
+index per packet. ToIPSummaryDump picks the smallest encoding for each column
+of each block, so timestamps and counters are usually delta-coded and
+addresses dictionary-coded. Every block decodes independently.
+
+ToIPSummaryDump writes columnar output in large writes aligned to 256 kB
+file offsets. In multithreaded user-level drivers, blocks are encoded and
+written by a background thread.
+
 =h flush write-only
 
 Flush all internal buffers to disk.
@@ -383,7 +456,10 @@ class ToIPSummaryDump : public Element, public IPSummaryDumpInfo { public:
     bool _binary : 1;
     bool _header : 1;
     bool _extra_length : 1;
+    bool _columnar : 1;
     int32_t _binary_size;
+    int _block_packets;
+    IPSummaryDump::ColumnWriter *_cw;
     uint32_t _output_count;
     Task _task;
     NotifierSignal _signal;
@@ -0,0 +1,499 @@
+/*
+ * fqcodel.{cc,hh} -- element implements FQ-CoDel flow queueing with
+ * per-flow CoDel dropping
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "fqcodel.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/straccum.hh>
+#include <click/integers.hh>
+#include <click/packet_anno.hh>
+#include <click/packetbatch.hh>
+#include <click/ipflowid.hh>
+#if HAVE_IP6
+# include <click/ip6flowid.hh>
+#endif
+#include <clicknet/ip.h>
+#include <clicknet/ip6.h>
+CLICK_DECLS
+
+FQCoDel::FQCoDel()
+    : _flows(0), _nactive(0), _npackets(0), _bytes(0), _highwater_length(0),
+      _sleepiness(0), _codel_drops(0), _overlimit_drops(0)
+{
+    _new_flows.head = _new_flows.tail = 0;
+    _old_flows.head = _old_flows.tail = 0;
+}
+
+FQCoDel::~FQCoDel()
+{
+}
+
+void *
+FQCoDel::cast(const char *n)
+{
+    if (strcmp(n, "FQCoDel") == 0)
+	return (FQCoDel *) this;
+    else if (strcmp(n, "Storage") == 0)
+	return (Storage *) this;
+    else if (strcmp(n, Notifier::EMPTY_NOTIFIER) == 0)
+	return static_cast<Notifier *>(&_empty_note);
+    else
+	return Element::cast(n);
+}
+
+int
+FQCoDel::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    uint32_t limit = 10240, nflows = 1024, quantum = 1514;
+    _memory_limit = 32 << 20;
+    _target = Timestamp::make_msec(0, 5);
+    _interval = Timestamp::make_msec(0, 100);
+    if (Args(conf, this, errh)
+	.read_p("LIMIT", limit)
+	.read("MEMORY_LIMIT", _memory_limit)
+	.read("FLOWS", nflows)
+	.read("QUANTUM", quantum)
+	.read("TARGET", _target)
+	.read("INTERVAL", _interval)
+	.complete() < 0)
+	return -1;
+    if (limit == 0 || limit > 0x7FFFFFFFU)
+	return errh->error("LIMIT out of range");
+    if (nflows == 0 || nflows > (1U << 24))
+	return errh->error("FLOWS out of range");
+    if (quantum == 0 || quantum > 0x7FFFFFFFU)
+	return errh->error("QUANTUM out of range");
+    if (_interval <= Timestamp())
+	return errh->error("INTERVAL must be positive");
+
+    _nflows = 1;
+    while (_nflows < nflows)
+	_nflows <<= 1;
+    _flow_mask = _nflows - 1;
+    _quantum = quantum;
+    _interval16 = Timestamp::make_usec(_interval.usecval() * 16);
+    set_capacity(limit);
+    _empty_note.initialize(Notifier::EMPTY_NOTIFIER, router());
+    return 0;
+}
+
+int
+FQCoDel::initialize(ErrorHandler *errh)
+{
+    if (!(_flows = new Flow[_nflows]))
+	return errh->error("out of memory");
+    for (uint32_t i = 0; i < _nflows; ++i) {
+	Flow &f = _flows[i];
+	f.head = f.tail = 0;
+	f.next = 0;
+	f.npackets = f.backlog = 0;
+	f.deficit = 0;
+	f.active = f.dropping = false;
+	f.count = f.lastcount = 0;
+    }
+    _perturbation = click_random();
+    set_head(0);
+    set_tail(0);
+    return 0;
+}
+
+void
+FQCoDel::cleanup(CleanupStage)
+{
+    if (_flows)
+	drop_all();
+    delete[] _flows;
+    _flows = 0;
+}
+
+inline void
+FQCoDel::list_push(FlowList &l, Flow *f)
+{
+    f->next = 0;
+    if (l.tail)
+	l.tail->next = f;
+    else
+	l.head = f;
+    l.tail = f;
+}
+
+inline FQCoDel::Flow *
+FQCoDel::list_pop(FlowList &l)
+{
+    Flow *f = l.head;
+    if (!(l.head = f->next))
+	l.tail = 0;
+    f->next = 0;
+    return f;
+}
+
+inline FQCoDel::Flow *
+FQCoDel::classify(Packet *p) const
+{
+    hashcode_t h = 0;
+    if (p->has_network_header()) {
+	const click_ip *iph = p->ip_header();
+	if (iph->ip_v == 4) {
+	    if (IP_FIRSTFRAG(iph) && p->has_transport_header()
+		&& (iph->ip_p == IP_PROTO_TCP || iph->ip_p == IP_PROTO_UDP))
+		h = IPFlowID(p).hashcode();
+	    else
+		h = IPFlowID(iph->ip_src, 0, iph->ip_dst, 0).hashcode() ^ iph->ip_p;
+	}
+#if HAVE_IP6
+	else if (iph->ip_v == 6) {
+	    const click_ip6 *ip6h = p->ip6_header();
+	    if (p->has_transport_header()
+		&& (ip6h->ip6_nxt == IP_PROTO_TCP || ip6h->ip6_nxt == IP_PROTO_UDP))
+		h = IP6FlowID(p).hashcode();
+	    else
+		h = IP6FlowID(IP6Address(ip6h->ip6_src), 0,
+			      IP6Address(ip6h->ip6_dst), 0).hashcode() ^ ip6h->ip6_nxt;
+	}
+#endif
+    }
+    // Perturb the hash so that colliding flows differ between runs, then
+    // take high-order bits of a multiplicative hash.
+    uint64_t x = (uint64_t) (h ^ _perturbation) * 0x9E3779B97F4A7C15ULL;
+    return &_flows[(uint32_t) (x >> 32) & _flow_mask];
+}
+
+inline void
+FQCoDel::enqueue(Packet *p, const Timestamp &now)
+{
+    Flow *f = classify(p);
+    SET_FIRST_TIMESTAMP_ANNO(p, now);
+    p->set_next(0);
+    if (f->tail)
+	f->tail->set_next(p);
+    else
+	f->head = p;
+    f->tail = p;
+    ++f->npackets;
+    f->backlog += p->length();
+    if (!f->active) {
+	// A newly active flow goes to the new-flows list with a full quantum.
+	f->active = true;
+	f->deficit = _quantum;
+	list_push(_new_flows, f);
+	++_nactive;
+    }
+
+    ++_npackets;
+    _bytes += p->buffer_length();
+    if (_npackets > _highwater_length)
+	_highwater_length = _npackets;
+    if (_npackets > (uint32_t) capacity() || _bytes > _memory_limit)
+	overlimit_drop();
+}
+
+inline Packet *
+FQCoDel::flow_pop(Flow *f)
+{
+    Packet *p = f->head;
+    if (p) {
+	if (!(f->head = p->next()))
+	    f->tail = 0;
+	p->set_next(0);
+	--f->npackets;
+	f->backlog -= p->length();
+	--_npackets;
+	_bytes -= p->buffer_length();
+    }
+    return p;
+}
+
+void
+FQCoDel::overlimit_drop()
+{
+    // Drop from the head of the flow with the largest backlog, as Linux's
+    // fq_codel does: half its bytes, but at most DROP_BATCH packets.
+    Flow *fat = 0;
+    for (Flow *f = _new_flows.head; f; f = f->next)
+	if (!fat || f->backlog > fat->backlog)
+	    fat = f;
+    for (Flow *f = _old_flows.head; f; f = f->next)
+	if (!fat || f->backlog > fat->backlog)
+	    fat = f;
+    assert(fat && fat->head);
+
+    uint32_t threshold = fat->backlog / 2, dropped = 0;
+    int n = 0;
+    do {
+	Packet *p = flow_pop(fat);
+	dropped += p->length();
+	++_overlimit_drops;
+	checked_output_push(1, p);
+    } while (++n < DROP_BATCH && fat->head && dropped < threshold);
+}
+
+inline bool
+FQCoDel::should_drop(Flow *f, Packet *p, const Timestamp &now)
+{
+    f->sojourn = now - FIRST_TIMESTAMP_ANNO(p);
+    if (f->sojourn < _target || f->backlog <= (uint32_t) _quantum) {
+	// Went below target, or too few bytes left to matter: stay put.
+	f->first_above_time = Timestamp();
+	return false;
+    }
+    if (!f->first_above_time) {
+	f->first_above_time = now + _interval;
+	return false;
+    }
+    return now >= f->first_above_time;
+}
+
+inline Timestamp
+FQCoDel::control_law(const Timestamp &t, uint32_t count) const
+{
+    // t + interval / sqrt(count), with 4 extra bits of precision in the
+    // square root.
+    if (count > (1U << 23))
+	count = 1U << 23;
+    uint64_t usec = int_divide((uint64_t) _interval.usecval() << 4,
+			       int_sqrt(count << 8));
+    return t + Timestamp::make_usec((Timestamp::value_type) usec);
+}
+
+inline Packet *
+FQCoDel::codel_dequeue(Flow *f, const Timestamp &now)
+{
+    Packet *p = flow_pop(f);
+    if (!p) {
+	f->dropping = false;
+	return 0;
+    }
+
+    bool drop = should_drop(f, p, now);
+    if (f->dropping) {
+	if (!drop)
+	    f->dropping = false;
+	else
+	    while (f->dropping && now >= f->drop_next) {
+		++f->count;
+		++_codel_drops;
+		checked_output_push(1, p);
+		if (!(p = flow_pop(f)) || !should_drop(f, p, now))
+		    f->dropping = false;
+		else
+		    f->drop_next = control_law(f->drop_next, f->count);
+	    }
+    } else if (drop) {
+	++_codel_drops;
+	checked_output_push(1, p);
+	if ((p = flow_pop(f)))
+	    (void) should_drop(f, p, now);
+	f->dropping = true;
+	// If we were dropping recently, resume near the old drop rate.
+	uint32_t delta = f->count - f->lastcount;
+	if (delta > 1 && now - f->drop_next < _interval16)
+	    f->count = delta;
+	else
+	    f->count = 1;
+	f->lastcount = f->count;
+	f->drop_next = control_law(now, f->count);
+    }
+    return p;
+}
+
+inline Packet *
+FQCoDel::dequeue(const Timestamp &now)
+{
+    while (1) {
+	FlowList *l = &_new_flows;
+	Flow *f = l->head;
+	if (!f) {
+	    l = &_old_flows;
+	    if (!(f = l->head))
+		return 0;
+	}
+
+	if (f->deficit <= 0) {
+	    // Out of credit: refill and move to the back of the old flows.
+	    f->deficit += _quantum;
+	    list_push(_old_flows, list_pop(*l));
+	    continue;
+	}
+
+	if (Packet *p = codel_dequeue(f, now)) {
+	    f->deficit -= p->length();
+	    return p;
+	}
+
+	// The flow is empty.  A new flow moves to the old flows first, so
+	// that a flow cannot stay new by emptying its queue every round.
+	list_pop(*l);
+	if (l == &_new_flows && _old_flows.head)
+	    list_push(_old_flows, f);
+	else {
+	    f->active = false;
+	    --_nactive;
+	}
+    }
+}
+
+inline void
+FQCoDel::dequeue_failure()
+{
+    if (_sleepiness >= SLEEPINESS_TRIGGER)
+	_empty_note.sleep();
+    else
+	++_sleepiness;
+}
+
+void
+FQCoDel::push(int, Packet *p)
+{
+    enqueue(p, Timestamp::now());
+    set_tail(_npackets);
+    _empty_note.wake();
+}
+
+Packet *
+FQCoDel::pull(int)
+{
+    Packet *p = 0;
+    if (_nactive) {
+	p = dequeue(Timestamp::now());
+	set_tail(_npackets);
+    }
+    if (p)
+	_sleepiness = 0;
+    else
+	dequeue_failure();
+    return p;
+}
+
+void
+FQCoDel::push_batch(int, PacketBatch *batch)
+{
+    Timestamp now = Timestamp::now();
+    while (Packet *p = batch->pop_front())
+	enqueue(p, now);
+    set_tail(_npackets);
+    _empty_note.wake();
+}
+
+void
+FQCoDel::pull_batch(int, PacketBatch *batch, unsigned max)
+{
+    unsigned n = 0;
+    if (_nactive) {
+	Timestamp now = Timestamp::now();
+	for (; n < max; ++n) {
+	    Packet *p = dequeue(now);
+	    if (!p)
+		break;
+	    batch->append(p);
+	}
+	set_tail(_npackets);
+    }
+    if (n)
+	_sleepiness = 0;
+    else
+	dequeue_failure();
+}
+
+void
+FQCoDel::drop_all()
+{
+    for (uint32_t i = 0; i < _nflows; ++i) {
+	Flow &f = _flows[i];
+	while (Packet *p = flow_pop(&f))
+	    p->kill();
+	f.next = 0;
+	f.active = f.dropping = false;
+	f.count = f.lastcount = 0;
+	f.first_above_time = Timestamp();
+    }
+    _new_flows.head = _new_flows.tail = 0;
+    _old_flows.head = _old_flows.tail = 0;
+    _nactive = 0;
+    set_tail(_npackets);
+}
+
+String
+FQCoDel::read_handler(Element *e, void *user_data)
+{
+    FQCoDel *fq = static_cast<FQCoDel *>(e);
+    switch (reinterpret_cast<uintptr_t>(user_data)) {
+    case h_length:
+	return String(fq->_npackets);
+    case h_highwater_length:
+	return String(fq->_highwater_length);
+    case h_capacity:
+	return String(fq->capacity());
+    case h_bytes:
+	return String(fq->_bytes);
+    case h_flows:
+	return String(fq->_nactive);
+    case h_drops:
+	return String(fq->_codel_drops + fq->_overlimit_drops);
+    case h_codel_drops:
+	return String(fq->_codel_drops);
+    case h_overlimit_drops:
+	return String(fq->_overlimit_drops);
+    case h_flow_stats: {
+	StringAccum sa;
+	for (uint32_t i = 0; i < fq->_nflows; ++i) {
+	    const Flow &f = fq->_flows[i];
+	    if (f.active)
+		sa << i << ' ' << f.npackets << ' ' << f.backlog << ' '
+		   << f.sojourn << ' ' << (f.dropping ? 1 : 0) << '\n';
+	}
+	return sa.take_string();
+    }
+    default:
+	return String();
+    }
+}
+
+int
+FQCoDel::write_handler(const String &, Element *e, void *user_data, ErrorHandler *)
+{
+    FQCoDel *fq = static_cast<FQCoDel *>(e);
+    switch (reinterpret_cast<uintptr_t>(user_data)) {
+    case h_reset_counts:
+	fq->_codel_drops = fq->_overlimit_drops = 0;
+	fq->_highwater_length = fq->_npackets;
+	return 0;
+    case h_reset:
+	fq->drop_all();
+	return 0;
+    default:
+	return -1;
+    }
+}
+
+void
+FQCoDel::add_handlers()
+{
+    add_read_handler("length", read_handler, h_length);
+    add_read_handler("highwater_length", read_handler, h_highwater_length);
+    add_read_handler("capacity", read_handler, h_capacity);
+    add_read_handler("bytes", read_handler, h_bytes);
+    add_read_handler("flows", read_handler, h_flows);
+    add_read_handler("drops", read_handler, h_drops);
+    add_read_handler("codel_drops", read_handler, h_codel_drops);
+    add_read_handler("overlimit_drops", read_handler, h_overlimit_drops);
+    add_read_handler("flow_stats", read_handler, h_flow_stats);
+    add_write_handler("reset_counts", write_handler, h_reset_counts, Handler::BUTTON);
+    add_write_handler("reset", write_handler, h_reset, Handler::BUTTON);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(int64)
+EXPORT_ELEMENT(FQCoDel)
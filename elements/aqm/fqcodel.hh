@@ -0,0 +1,239 @@
+#ifndef CLICK_FQCODEL_HH
+#define CLICK_FQCODEL_HH
+#include <click/element.hh>
+#include <click/notifier.hh>
+#include <click/timestamp.hh>
+#include <click/standard/storage.hh>
+CLICK_DECLS
+
+/*
+=c
+
+FQCoDel([LIMIT, I<KEYWORDS>])
+
+=s aqm
+
+stores packets in per-flow queues managed by P<CoDel>
+
+=d
+
+Implements FQ-CoDel, CoDel active queue management applied separately to
+many flows, with the flows served round-robin.
+
+Incoming packets are hashed by flow into one of FLOWS buckets.  IPv4 and
+IPv6 packets are hashed by their IPFlowID or IP6FlowID; other protocols and
+later fragments are hashed by addresses only, and non-IP packets all share
+one bucket.  The network header annotation must be set.  Each bucket is a
+separate FIFO sub-queue.  Buckets are served with deficit round robin,
+QUANTUM bytes per round, and a bucket that has just become active is served
+before the ones that stayed backlogged (DRR++), so sparse flows see almost
+no queueing delay.
+
+Each bucket runs the CoDel control law on its own packets: once a bucket's
+sojourn time has stayed above TARGET for INTERVAL, FQCoDel drops packets
+from that bucket's head at a rate that increases with the square root of
+the number of drops, until the sojourn time falls below TARGET.  A single
+elephant flow is therefore held to a short queue without delaying other
+flows.  FQCoDel sets each packet's first timestamp annotation to its
+enqueue time.
+
+When the total queue exceeds LIMIT packets or MEMORY_LIMIT bytes of packet
+buffers, FQCoDel drops packets from the head of the bucket with the largest
+backlog: half of its packets, at most 64.
+
+FQCoDel acts like a Queue.  It is a Storage element, so AQM elements like
+RED can find it, and it has an empty notifier, so pullers such as Unqueue
+sleep while it is empty.  Dropped packets are emitted on output 1 if that
+output exists.
+
+Memory use is bounded: the bucket table takes a fixed amount of memory per
+bucket (under 100 bytes), allocated at initialization, and queued packets
+are limited by LIMIT and MEMORY_LIMIT.  For 100,000 concurrent flows, use
+FLOWS 131072, which takes about 9 MB on 64-bit machines.
+
+Keyword arguments are:
+
+=over 8
+
+=item LIMIT
+
+Integer.  Maximum number of packets queued in all buckets.  Default is
+10240.
+
+=item MEMORY_LIMIT
+
+Integer.  Maximum total buffer_length() of queued packets, in bytes.
+Default is 32 MB.
+
+=item FLOWS
+
+Integer.  Number of flow buckets, rounded up to a power of two.  Default is
+1024.
+
+=item QUANTUM
+
+Integer.  Bytes a bucket may send per round.  Default is 1514.
+
+=item TARGET
+
+Timestamp.  Target sojourn time.  Default is 5 ms.
+
+=item INTERVAL
+
+Timestamp.  Sliding minimum window width.  Default is 100 ms.
+
+=back
+
+=e
+
+  FromDevice(eth0) -> CheckIPHeader(14) -> q :: FQCoDel(FLOWS 4096)
+    -> ToDevice(eth1);
+
+=h length read-only
+
+Returns the current number of packets queued.
+
+=h highwater_length read-only
+
+Returns the maximum number of packets that have ever been queued at once.
+
+=h capacity read-only
+
+Returns LIMIT.
+
+=h bytes read-only
+
+Returns the total buffer_length() of the queued packets.
+
+=h flows read-only
+
+Returns the number of active flow buckets, i.e. buckets that have queued
+packets or are waiting in the round robin.
+
+=h drops read-only
+
+Returns the number of packets dropped so far, by CoDel or because of
+overflow.
+
+=h codel_drops read-only
+
+Returns the number of packets dropped by the per-flow CoDel control law.
+
+=h overlimit_drops read-only
+
+Returns the number of packets dropped because LIMIT or MEMORY_LIMIT was
+exceeded.
+
+=h flow_stats read-only
+
+Returns one line per active bucket: the bucket number, its queued packets,
+its queued bytes, the sojourn time of the last packet it sent, and whether
+it is in CoDel's dropping state.
+
+=h reset_counts write-only
+
+When written, resets the drop counters and C<highwater_length>.
+
+=h reset write-only
+
+When written, drops all queued packets.
+
+=a CoDel, Queue, RED
+
+Kathleen Nichols and Van Jacobson. I<Controlling Queue Delay>.
+ACM Queue, 2012, vol.10, no.5.
+
+T. Hoeiland-Joergensen et al. I<The Flow Queue CoDel Packet Scheduler and
+Active Queue Management Algorithm>. RFC 8290, 2018. */
+
+class FQCoDel : public Element, public Storage { public:
+
+    FQCoDel() CLICK_COLD;
+    ~FQCoDel() CLICK_COLD;
+
+    const char *class_name() const		{ return "FQCoDel"; }
+    const char *port_count() const		{ return PORTS_1_1X2; }
+    const char *processing() const		{ return "h/lh"; }
+    void *cast(const char *);
+
+    int configure(Vector<String> &conf, ErrorHandler *errh) CLICK_COLD;
+    int initialize(ErrorHandler *errh) CLICK_COLD;
+    void cleanup(CleanupStage) CLICK_COLD;
+    void add_handlers() CLICK_COLD;
+
+    void push(int port, Packet *p);
+    Packet *pull(int port);
+    void push_batch(int port, PacketBatch *batch);
+    void pull_batch(int port, PacketBatch *batch, unsigned max);
+
+  private:
+
+    struct Flow {
+	Packet *head;		// queued packets, linked by next()
+	Packet *tail;
+	Flow *next;		// link in _new_flows or _old_flows
+	uint32_t npackets;
+	uint32_t backlog;	// queued bytes
+	int32_t deficit;	// DRR++ credit, in bytes
+	bool active;		// true iff in _new_flows or _old_flows
+	bool dropping;		// CoDel: in dropping state
+	uint32_t count;		// CoDel: drops since entering dropping state
+	uint32_t lastcount;	// CoDel: count when last leaving it
+	Timestamp first_above_time;
+	Timestamp drop_next;
+	Timestamp sojourn;	// sojourn time of the last packet sent
+    };
+
+    struct FlowList {
+	Flow *head;
+	Flow *tail;
+    };
+
+    Flow *_flows;
+    uint32_t _flow_mask;
+    uint32_t _perturbation;
+    FlowList _new_flows;
+    FlowList _old_flows;
+    uint32_t _nactive;
+
+    uint32_t _npackets;
+    uint32_t _bytes;
+    uint32_t _highwater_length;
+    uint32_t _memory_limit;
+    uint32_t _nflows;
+    int32_t _quantum;
+    Timestamp _target;
+    Timestamp _interval;
+    Timestamp _interval16;
+
+    ActiveNotifier _empty_note;
+    int _sleepiness;
+
+    uint32_t _codel_drops;
+    uint32_t _overlimit_drops;
+
+    enum { SLEEPINESS_TRIGGER = 9, DROP_BATCH = 64 };
+
+    static inline void list_push(FlowList &l, Flow *f);
+    static inline Flow *list_pop(FlowList &l);
+    inline Flow *classify(Packet *p) const;
+    inline void enqueue(Packet *p, const Timestamp &now);
+    inline Packet *flow_pop(Flow *f);
+    inline bool should_drop(Flow *f, Packet *p, const Timestamp &now);
+    inline Timestamp control_law(const Timestamp &t, uint32_t count) const;
+    inline Packet *codel_dequeue(Flow *f, const Timestamp &now);
+    inline Packet *dequeue(const Timestamp &now);
+    inline void dequeue_failure();
+    void overlimit_drop();
+    void drop_all();
+
+    enum { h_length, h_highwater_length, h_capacity, h_bytes, h_flows,
+	   h_drops, h_codel_drops, h_overlimit_drops, h_flow_stats,
+	   h_reset_counts, h_reset };
+    static String read_handler(Element *e, void *user_data) CLICK_COLD;
+    static int write_handler(const String &str, Element *e, void *user_data, ErrorHandler *errh) CLICK_COLD;
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -22,100 +22,112 @@
 #include <click/ip6address.hh>
 #include <click/args.hh>
 #include <click/straccum.hh>
-#include <click/bitvector.hh>
 #include <click/error.hh>
 #include <click/glue.hh>
 CLICK_DECLS
 
 IP6NDSolicitor::IP6NDSolicitor()
-: _expire_timer(expire_hook, this)
+    : _ndt(0), _my_ndt(false)
 {
     // input 0: IP6 packets
     // input 1: ether/N.Advertisement responses
     // output 0: ether/IP6 and ether/N.Solicitation queries
-  for (int i = 0; i < NMAP; i++)
-    _map[i] = 0;
 }
 
 IP6NDSolicitor::~IP6NDSolicitor()
 {
 }
 
+void *
+IP6NDSolicitor::cast(const char *name)
+{
+    if (strcmp(name, "IP6NDTable") == 0)
+	return _ndt;
+    else if (strcmp(name, "IP6NDSolicitor") == 0)
+	return this;
+    else
+	return Element::cast(name);
+}
+
 int
 IP6NDSolicitor::configure(Vector<String> &conf, ErrorHandler *errh)
 {
-    return Args(conf, this, errh)
+    uint32_t capacity, entry_capacity, entry_packet_capacity, capacity_slim_factor, max_solicit;
+    Timestamp reachable_time, timeout;
+    bool have_capacity, have_entry_capacity, have_entry_packet_capacity, have_capacity_slim_factor,
+	have_reachable_time, have_timeout, have_max_solicit;
+    _ndt = 0;
+    if (Args(this, errh).bind(conf)
+	.read("CAPACITY", capacity).read_status(have_capacity)
+	.read("ENTRY_CAPACITY", entry_capacity).read_status(have_entry_capacity)
+	.read("ENTRY_PACKET_CAPACITY", entry_packet_capacity).read_status(have_entry_packet_capacity)
+	.read("CAPACITY_SLIM_FACTOR", capacity_slim_factor).read_status(have_capacity_slim_factor)
+	.read("REACHABLE_TIME", reachable_time).read_status(have_reachable_time)
+	.read("TIMEOUT", timeout).read_status(have_timeout)
+	.read("MAX_SOLICIT", max_solicit).read_status(have_max_solicit)
+	.read("TABLE", ElementCastArg("IP6NDTable"), _ndt)
+	.consume() < 0)
+	return -1;
+
+    if (Args(conf, this, errh)
 	.read_mp("IP", _my_ip6)
 	.read_mp("ETH", _my_en)
-	.complete();
+	.complete() < 0)
+	return -1;
+
+    if (!_ndt) {
+	Vector<String> subconf;
+	if (have_capacity)
+	    subconf.push_back("CAPACITY " + String(capacity));
+	if (have_entry_capacity)
+	    subconf.push_back("ENTRY_CAPACITY " + String(entry_capacity));
+	if (have_entry_packet_capacity)
+	    subconf.push_back("ENTRY_PACKET_CAPACITY " + String(entry_packet_capacity));
+	if (have_capacity_slim_factor)
+	    subconf.push_back("CAPACITY_SLIM_FACTOR " + String(capacity_slim_factor));
+	if (have_reachable_time)
+	    subconf.push_back("REACHABLE_TIME " + reachable_time.unparse());
+	if (have_timeout)
+	    subconf.push_back("TIMEOUT " + timeout.unparse());
+	if (have_max_solicit)
+	    subconf.push_back("MAX_SOLICIT " + String(max_solicit));
+	_ndt = new IP6NDTable;
+	_ndt->attach_router(router(), -1);
+	_my_ndt = true;
+	if (_ndt->configure(subconf, errh) < 0)
+	    return -1;
+    }
+    return 0;
 }
 
 int
 IP6NDSolicitor::initialize(ErrorHandler *)
 {
-  _expire_timer.initialize(this);
-  _expire_timer.schedule_after_msec(EXPIRE_TIMEOUT_MS);
   _arp_queries = 0;
   _pkts_killed = 0;
   return 0;
 }
 
 void
-IP6NDSolicitor::cleanup(CleanupStage)
+IP6NDSolicitor::cleanup(CleanupStage stage)
 {
-  for (int i = 0; i < NMAP; i++) {
-    for (NDEntry *t = _map[i]; t; ) {
-      NDEntry *n = t->next;
-      if (t->p)
-	t->p->kill();
-      delete t;
-      t = n;
-    }
-    _map[i] = 0;
+  if (_my_ndt) {
+    _ndt->cleanup(stage);
+    delete _ndt;
   }
 }
 
 void
-IP6NDSolicitor::take_state(Element *e, ErrorHandler *)
+IP6NDSolicitor::take_state(Element *e, ErrorHandler *errh)
 {
   IP6NDSolicitor *arpq = (IP6NDSolicitor *)e->cast("IP6NDSolicitor");
   if (!arpq || _my_ip6 != arpq->_my_ip6 || _my_en != arpq->_my_en)
     return;
 
-  NDEntry *save[NMAP];
-  memcpy(save, _map, sizeof(NDEntry *) * NMAP);
-  memcpy(_map, arpq->_map, sizeof(NDEntry *) * NMAP);
-  memcpy(arpq->_map, save, sizeof(NDEntry *) * NMAP);
-}
-
-void
-IP6NDSolicitor::expire_hook(Timer *, void *thunk)
-{
-  IP6NDSolicitor *arpq = (IP6NDSolicitor *)thunk;
-  click_jiffies_t jiff = click_jiffies();
-  for (int i = 0; i < NMAP; i++) {
-    NDEntry *prev = 0;
-    while (1) {
-      NDEntry *e = (prev ? prev->next : arpq->_map[i]);
-      if (!e)
-	break;
-      if (e->ok) {
-	int gap = jiff - e->last_response_jiffies;
-	if (gap > 120*CLICK_HZ) {
-	  // delete entry from map
-	  if (prev) prev->next = e->next;
-	  else arpq->_map[i] = e->next;
-	  if (e->p)
-	    e->p->kill();
-	  delete e;
-	  continue;		// don't change prev
-	} else if (gap > 60*CLICK_HZ)
-	  e->polling = 1;
-      }
-      prev = e;
-    }
-  }
-  arpq->_expire_timer.schedule_after_msec(EXPIRE_TIMEOUT_MS);
+  if (_my_ndt && arpq->_my_ndt)
+    _ndt->take_state(arpq->_ndt, errh);
+  _arp_queries = arpq->_arp_queries;
+  _pkts_killed = arpq->_pkts_killed;
 }
 
 void
@@ -127,7 +139,7 @@ IP6NDSolicitor::send_query_for(const u_char want_ip6[16])
   WritablePacket *q = Packet::make(sizeof(*e) + sizeof(*ip6) + sizeof(*ea));
   if (q == 0) {
     click_chatter("in ndsol: cannot make packet!");
-    assert(0);
+    return;
   }
 
   memset(q->data(), '\0', q->length());
@@ -188,98 +200,86 @@ IP6NDSolicitor::send_query_for(const u_char want_ip6[16])
  * If the packet's IP6 address is in the table, add an ethernet header
  * and push it out.
  * Otherwise push out a query packet.
- * May save the packet in the NDEntry table for later sending.
+ * May save the packet in the IP6NDTable for later sending.
  * May call p->kill().
  */
 void
-IP6NDSolicitor::handle_ip6(Packet *p)
+IP6NDSolicitor::handle_ip6(Packet *p, bool response)
 {
-  IP6Address ipa = DST_IP6_ANNO(p);
-  int bucket = (ipa.data()[0] + ipa.data()[15]) % NMAP;
-  NDEntry *ae = _map[bucket];
-  while (ae && ae->ip6 != ipa)
-    ae = ae->next;
-
-  if (ae) {
-    if (ae->polling) {
-      send_query_for(ae->ip6.data());
-      ae->polling = 0;
-    }
-    //find the match IP address, send to output 0
-    if (ae->ok) {
-      Packet *q = p->push(sizeof(click_ether));
-      click_ether *e = (click_ether *)q->data();
-      memcpy(e->ether_shost, _my_en.data(), 6);
-      memcpy(e->ether_dhost, ae->en.data(), 6);
-      e->ether_type = htons(ETHERTYPE_IP6);
-      output(0).push(q);
-    } else {
-      if (ae->p) {
-        ae->p->kill();
-	_pkts_killed++;
-      }
-      ae->p = p;
-      send_query_for(DST_IP6_ANNO(p).data());
-    }
+  // make room for Ethernet header
+  WritablePacket *q;
+  if (response) {
+    assert(!p->shared());
+    q = p->uniqueify();
+  } else if (!(q = p->push_mac_header(sizeof(click_ether)))) {
+    ++_pkts_killed;
+    return;
+  }
 
-  } else {
-    NDEntry *ae = new NDEntry;
-    ae->ip6 = ipa;
-    ae->ok = ae->polling = 0;
-    ae->p = p;
-    ae->next = _map[bucket];
-    _map[bucket] = ae;
+  IP6Address ipa = DST_IP6_ANNO(q);
+  EtherAddress *dst_eth = reinterpret_cast<EtherAddress *>(q->ether_header()->ether_dhost);
 
-    send_query_for(DST_IP6_ANNO(p).data());
+  // Easy case: requires only read lock
+ retry_read_lock:
+  int r = _ndt->lookup(ipa, dst_eth);
+  if (r < 0) {
+    r = _ndt->append_query(ipa, q);
+    if (r == -EAGAIN)
+      goto retry_read_lock;
+    if (r < 0) {
+      q->kill();
+      ++_pkts_killed;
+    }
+    if (r > 0)
+      send_query_for(ipa.data()); // q is on the entry's queue
+    return;
   }
+  if (r > 0)
+    send_query_for(ipa.data());
+
+  click_ether *e = q->ether_header();
+  memcpy(e->ether_shost, _my_en.data(), 6);
+  e->ether_type = htons(ETHERTYPE_IP6);
+  output(0).push(q);
 }
 
 /*
  * Got an Neighborhood Advertisement (response to N. Solicitation Message)
- * Update our NDEntry table.
- * If there was a packet waiting to be sent, return it.
+ * Update our IP6NDTable.
+ * If there were packets waiting to be sent, send them.
  */
 void
 IP6NDSolicitor::handle_response(Packet *p)
 {
-  if (p->length() < sizeof(click_ether) + sizeof(click_ip6) + sizeof(click_nd_sol))
+  if (p->length() < sizeof(click_ether) + sizeof(click_ip6) + sizeof(click_nd_adv))
     return;
 
-  click_ether *ethh = (click_ether *) p->data();
-  click_ip6 *ip6h = (click_ip6 *)(ethh+1);
-  click_nd_adv * eah = (click_nd_adv*)(ip6h+1);
+  const click_ether *ethh = (const click_ether *) p->data();
+  const click_ip6 *ip6h = (const click_ip6 *)(ethh+1);
+  const click_nd_adv *eah = (const click_nd_adv *)(ip6h+1);
 
   IP6Address ipa = IP6Address(eah->nd_tpa);
   EtherAddress ena = EtherAddress(eah->nd_tha);
-    if (ntohs(ethh->ether_type) == ETHERTYPE_IP6
-	&& eah->type == ND_ADV) {
-//        && !ena.is_group()) {
-     int bucket = (ipa.data()[0] + ipa.data()[15]) % NMAP;
-      NDEntry *ae = _map[bucket];
-      while (ae && ae->ip6 != ipa)
-        ae = ae->next;
-      if (!ae)
-        return;
-
-      if (ae->ok && ae->en != ena)
-        click_chatter("IP6NDSolicitor overwriting an entry");
-      ae->en = ena;
-      ae->ok = 1;
-      ae->polling = 0;
-      ae->last_response_jiffies = click_jiffies();
-      Packet *cached_packet = ae->p;
-      ae->p = 0;
+  if (ntohs(ethh->ether_type) == ETHERTYPE_IP6
+      && eah->type == ND_ADV
+      && !ena.is_group()) {
+    Packet *cached_packet;
+    _ndt->insert(ipa, ena, &cached_packet);
 
-      if (cached_packet){
-        handle_ip6(cached_packet);}
+    // Send out packets in the order in which they arrived
+    while (cached_packet) {
+      Packet *next = cached_packet->next();
+      handle_ip6(cached_packet, true);
+      cached_packet = next;
     }
+  }
 }
 
 void
 IP6NDSolicitor::push(int port, Packet *p)
 {
-   if (port == 0){
-     handle_ip6(p); }
+  if (port == 0)
+    handle_ip6(p, false);
   else {
     handle_response(p);
     p->kill();
@@ -287,32 +287,46 @@ IP6NDSolicitor::push(int port, Packet *p)
 }
 
 String
-IP6NDSolicitor::read_table(Element *e, void *)
+IP6NDSolicitor::read_handler(Element *e, void *thunk)
 {
-    IP6NDSolicitor *q = (IP6NDSolicitor *)e;
-    StringAccum sa;
-    for (int i = 0; i < NMAP; i++)
-	for (NDEntry *e = q->_map[i]; e; e = e->next)
-	    sa << e->ip6 << ' ' << (e->ok ? 1 : 0) << ' ' << e->en << '\n';
-    return sa.take_string();
+  IP6NDSolicitor *q = (IP6NDSolicitor *)e;
+  switch (reinterpret_cast<uintptr_t>(thunk)) {
+  case h_table:
+    return q->_ndt->read_handler(q->_ndt, (void *) (uintptr_t) IP6NDTable::h_table);
+  case h_stats:
+    return
+      String(q->_pkts_killed.value() + q->_ndt->drops()) + " packets killed\n" +
+      String(q->_arp_queries.value()) + " ND Solicitation Message sent\n";
+  default:
+    return String();
+  }
 }
 
-static String
-IP6NDSolicitor_read_stats(Element *e, void *)
+int
+IP6NDSolicitor::write_handler(const String &str, Element *e, void *thunk, ErrorHandler *errh)
 {
   IP6NDSolicitor *q = (IP6NDSolicitor *)e;
-  return
-    String(q->_pkts_killed) + " packets killed\n" +
-    String(q->_arp_queries) + " ND Solicitation Message sent\n";
+  switch (reinterpret_cast<uintptr_t>(thunk)) {
+  case h_insert:
+    return q->_ndt->write_handler(str, q->_ndt, (void *) (uintptr_t) IP6NDTable::h_insert, errh);
+  case h_clear:
+    q->_arp_queries = q->_pkts_killed = 0;
+    return q->_ndt->write_handler(str, q->_ndt, (void *) (uintptr_t) IP6NDTable::h_clear, errh);
+  default:
+    return -1;
+  }
 }
 
 void
 IP6NDSolicitor::add_handlers()
 {
-  add_read_handler("table", read_table, 0);
-  add_read_handler("stats", IP6NDSolicitor_read_stats, 0);
+  add_read_handler("table", read_handler, h_table);
+  add_read_handler("stats", read_handler, h_stats);
+  add_write_handler("insert", write_handler, h_insert);
+  add_write_handler("clear", write_handler, h_clear);
 }
 
 CLICK_ENDDECLS
-ELEMENT_REQUIRES(ip6)
+ELEMENT_REQUIRES(IP6NDTable)
 EXPORT_ELEMENT(IP6NDSolicitor)
+ELEMENT_MT_SAFE(IP6NDSolicitor)
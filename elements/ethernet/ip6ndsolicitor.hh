@@ -3,12 +3,13 @@
 #include <click/element.hh>
 #include <click/etheraddress.hh>
 #include <click/ip6address.hh>
-#include <click/timer.hh>
+#include <click/sync.hh>
+#include "ip6ndtable.hh"
 CLICK_DECLS
 
 /*
  * =c
- * IP6NDSolicitor(IP, ETH)
+ * IP6NDSolicitor(IP, ETH, I<keywords>)
  * =s ip6
  *
  * =d
@@ -33,6 +34,27 @@ CLICK_DECLS
  * IP6NDSolicitor may have one or two outputs. If it has two, then ARP queries
  * are sent to the second output.
  *
+ * The neighbor cache is kept in an IP6NDTable. Several IP6NDSolicitors, for
+ * instance one per thread transmitting on the same link, can share a single
+ * IP6NDTable. Packets to known neighbors only take the table's read lock.
+ *
+ * Keyword arguments are:
+ *
+ * =over 8
+ *
+ * =item TABLE
+ *
+ * Element. Names an IP6NDTable element that holds this element's neighbor
+ * cache. By default IP6NDSolicitor creates its own internal IP6NDTable and
+ * uses that. If TABLE is specified, CAPACITY, ENTRY_CAPACITY,
+ * ENTRY_PACKET_CAPACITY, REACHABLE_TIME, TIMEOUT and MAX_SOLICIT are ignored.
+ *
+ * =item CAPACITY, ENTRY_CAPACITY, ENTRY_PACKET_CAPACITY, REACHABLE_TIME, TIMEOUT, MAX_SOLICIT
+ *
+ * Configure the internal IP6NDTable; see IP6NDTable.
+ *
+ * =back
+ *
  * =e
  *    c :: Classifier(12/86dd 20/3aff 54/87,
  *		      12/86dd 20/3aff 54/88,
@@ -43,8 +65,22 @@ CLICK_DECLS
  *    c[2] -> ... -> nds[0];
  *    nds[0] -> ... -> ToDevice(eth0);
  *
+ * =h table r
+ * Returns a textual representation of the neighbor cache. See IP6NDTable's
+ * table handler.
+ *
+ * =h stats r
+ * Returns textual statistics (packets killed and solicitations sent).
+ *
+ * =h insert w
+ * Adds an entry to the neighbor cache. The input string should have the form
+ * "IP6 ETH".
+ *
+ * =h clear w
+ * Clears the neighbor cache.
+ *
  * =a
- * IP6NDAdvertiser
+ * IP6NDAdvertiser, IP6NDTable
  */
 
 class IP6NDSolicitor : public Element {
@@ -57,6 +93,7 @@ class IP6NDSolicitor : public Element {
   const char *port_count() const		{ return "2/1-2"; }
   const char *processing() const		{ return PUSH; }
   const char *flow_code() const			{ return "xy/x"; }
+  void *cast(const char *name);
 
   void add_handlers() CLICK_COLD;
 
@@ -67,41 +104,25 @@ class IP6NDSolicitor : public Element {
 
   void push(int port, Packet *);
 
-  Packet *make_query(unsigned char tpa[16],
-                     unsigned char sha[6], unsigned char spa[16]);
-
-  void insert(IP6Address, EtherAddress);
-
-   struct NDEntry {
-    IP6Address ip6;
-    EtherAddress en;
-    click_jiffies_t last_response_jiffies;
-    unsigned ok: 1;
-    unsigned polling: 1;
-    Packet *p;
-    struct NDEntry *next;
-  };
-
-  // statistics
-  int _arp_queries;
-  int _pkts_killed;
-
  private:
 
-  enum { NMAP = 256 };
-  NDEntry *_map[NMAP];
+  IP6NDTable *_ndt;
   EtherAddress _my_en;
   IP6Address _my_ip6;
-  Timer _expire_timer;
+  bool _my_ndt;
+
+  // statistics
+  atomic_uint32_t _arp_queries;
+  atomic_uint32_t _pkts_killed;
 
   void send_query_for(const u_char want_ip6[16]);
 
-  void handle_ip6(Packet *);
+  void handle_ip6(Packet *, bool response);
   void handle_response(Packet *);
 
-  enum { EXPIRE_TIMEOUT_MS = 15 * 1000 };
-  static void expire_hook(Timer *, void *);
-  static String read_table(Element *, void *);
+  enum { h_table, h_stats, h_insert, h_clear };
+  static String read_handler(Element *, void *) CLICK_COLD;
+  static int write_handler(const String &, Element *, void *, ErrorHandler *) CLICK_COLD;
 
 };
 
@@ -0,0 +1,390 @@
+/*
+ * ip6ndtable.{cc,hh} -- IPv6 neighbor cache element
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "ip6ndtable.hh"
+#include <click/args.hh>
+#include <click/straccum.hh>
+#include <click/error.hh>
+#include <click/glue.hh>
+CLICK_DECLS
+
+IP6NDTable::IP6NDTable()
+    : _entry_capacity(0), _byte_capacity(256 * 1024), _entry_packet_capacity(0),
+      _capacity_slim_factor(2), _max_solicit(3), _expire_timer(this)
+{
+    _entry_count = _packet_count = _byte_count = _drops = 0;
+}
+
+IP6NDTable::~IP6NDTable()
+{
+}
+
+int
+IP6NDTable::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    Timestamp reachable_time(30), timeout(300);
+    if (Args(conf, this, errh)
+	.read("CAPACITY", _byte_capacity)
+	.read("ENTRY_CAPACITY", _entry_capacity)
+	.read("ENTRY_PACKET_CAPACITY", _entry_packet_capacity)
+	.read("CAPACITY_SLIM_FACTOR", _capacity_slim_factor)
+	.read("REACHABLE_TIME", reachable_time)
+	.read("TIMEOUT", timeout)
+	.read("MAX_SOLICIT", _max_solicit)
+	.complete() < 0)
+	return -1;
+    if (_capacity_slim_factor == 0)
+	return errh->error("CAPACITY_SLIM_FACTOR cannot be zero");
+    set_reachable_time(reachable_time);
+    set_timeout(timeout);
+    if (!_expire_timer.initialized())
+	_expire_timer.initialize(this);
+    _expire_timer.schedule_after_sec(1);
+    return 0;
+}
+
+void
+IP6NDTable::cleanup(CleanupStage)
+{
+    clear();
+}
+
+void
+IP6NDTable::clear()
+{
+    // Walk the neighbor cache and free any stored packets and entries.
+    for (Table::iterator it = _table.begin(); it; ) {
+	NDEntry *ae = _table.erase(it);
+	while (Packet *p = ae->_head) {
+	    ae->_head = p->next();
+	    p->kill();
+	    ++_drops;
+	}
+	_alloc.deallocate(ae);
+    }
+    _entry_count = _packet_count = _byte_count = 0;
+    _age.__clear();
+    _pending.__clear();
+}
+
+void
+IP6NDTable::take_state(Element *e, ErrorHandler *errh)
+{
+    IP6NDTable *ndt = (IP6NDTable *)e->cast("IP6NDTable");
+    if (!ndt)
+	return;
+    if (_table.size() > 0) {
+	errh->error("late take_state");
+	return;
+    }
+
+    _table.swap(ndt->_table);
+    _age.swap(ndt->_age);
+    _pending.swap(ndt->_pending);
+    _entry_count = ndt->_entry_count;
+    _packet_count = ndt->_packet_count;
+    _byte_count = ndt->_byte_count;
+    _drops = ndt->_drops;
+    _alloc.swap(ndt->_alloc);
+
+    ndt->_entry_count = 0;
+    ndt->_packet_count = 0;
+    ndt->_byte_count = 0;
+}
+
+// Drops the packets saved on ae.
+void
+IP6NDTable::drop_packets(NDEntry *ae)
+{
+    if (!ae->_head)
+	return;
+    while (Packet *p = ae->_head) {
+	ae->_head = p->next();
+	p->kill();
+	++_drops;
+    }
+    ae->_tail = 0;
+    _packet_count -= ae->_entry_packet_count;
+    _byte_count -= ae->_entry_byte_count;
+    ae->_entry_packet_count = ae->_entry_byte_count = 0;
+    _pending.erase(ae);
+}
+
+void
+IP6NDTable::slim(click_jiffies_t now)
+{
+    NDEntry *ae;
+
+    // Delete old entries.
+    while ((ae = _age.front())
+	   && (ae->expired(now, _timeout_j)
+	       || (_entry_capacity && _entry_count > _entry_capacity))) {
+	_table.erase(ae->_ip);
+	_age.pop_front();
+	drop_packets(ae);
+	_alloc.deallocate(ae);
+	--_entry_count;
+    }
+
+    // Delete packets to make space, starting with those that have waited
+    // longest.
+    if (_byte_capacity && _byte_count > _byte_capacity) {
+	uint32_t slim_capacity = _byte_capacity - _byte_capacity / _capacity_slim_factor;
+	ae = _pending.front();
+	while (_byte_count > slim_capacity && ae) {
+	    NDEntry *next = ae->_pending_link.next();
+	    while (ae->_head && _byte_count > slim_capacity) {
+		Packet *p = ae->_head;
+		if (!(ae->_head = p->next()))
+		    ae->_tail = 0;
+		--_packet_count;
+		_byte_count -= p->length();
+		--ae->_entry_packet_count;
+		ae->_entry_byte_count -= p->length();
+		p->kill();
+		++_drops;
+	    }
+	    if (!ae->_head)
+		_pending.erase(ae);
+	    ae = next;
+	}
+    }
+}
+
+void
+IP6NDTable::run_timer(Timer *timer)
+{
+    // Expire old entries, and give up on INCOMPLETE entries that did not
+    // answer their last solicitation within a second.
+    click_jiffies_t now = click_jiffies();
+    _lock.acquire_write();
+    slim(now);
+    if (_max_solicit)
+	for (NDEntry *ae = _pending.front(); ae; ) {
+	    NDEntry *next = ae->_pending_link.next();
+	    if (ae->_num_polls_since_reply >= _max_solicit
+		&& !click_jiffies_less(now, ae->_polled_at_j + CLICK_HZ))
+		drop_packets(ae);
+	    ae = next;
+	}
+    _lock.release_write();
+    timer->schedule_after_sec(1);
+}
+
+IP6NDTable::NDEntry *
+IP6NDTable::ensure(const IP6Address &ip, click_jiffies_t now)
+{
+    _lock.acquire_write();
+    Table::iterator it = _table.find(ip);
+    if (!it) {
+	void *x = _alloc.allocate();
+	if (!x) {
+	    _lock.release_write();
+	    return 0;
+	}
+
+	++_entry_count;
+	if (_entry_capacity && _entry_count > _entry_capacity)
+	    slim(now);
+
+	NDEntry *ae = new(x) NDEntry(ip);
+	ae->_live_at_j = now;
+	ae->_polled_at_j = ae->_live_at_j - CLICK_HZ;
+	_table.set(it, ae);
+
+	_age.push_back(ae);
+    }
+    return it.get();
+}
+
+int
+IP6NDTable::insert(const IP6Address &ip, const EtherAddress &eth, Packet **head)
+{
+    click_jiffies_t now = click_jiffies();
+    NDEntry *ae = ensure(ip, now);
+    if (!ae)
+	return -ENOMEM;
+
+    ae->_eth = eth;
+    ae->_known = !eth.is_broadcast();
+
+    ae->_live_at_j = now;
+    ae->_num_polls_since_reply = 0;
+    ae->_polled_at_j = ae->_live_at_j - CLICK_HZ;
+
+    if (ae->_age_link.next()) {
+	_age.erase(ae);
+	_age.push_back(ae);
+    }
+
+    if (head) {
+	*head = ae->_head;
+	if (ae->_head)
+	    _pending.erase(ae);
+	ae->_head = ae->_tail = 0;
+	_packet_count -= ae->_entry_packet_count;
+	_byte_count -= ae->_entry_byte_count;
+	ae->_entry_packet_count = ae->_entry_byte_count = 0;
+    }
+
+    _table.balance();
+    _lock.release_write();
+    return 0;
+}
+
+/* Saves p until ip is resolved. Returns -EAGAIN if ip has become known in
+ * the meantime, -ENOMEM if p could not be saved, 1 if the caller should
+ * solicit ip, and 0 otherwise. */
+int
+IP6NDTable::append_query(const IP6Address &ip, Packet *p)
+{
+    click_jiffies_t now = click_jiffies();
+    NDEntry *ae = ensure(ip, now);
+    if (!ae)
+	return -ENOMEM;
+
+    if (ae->known(now, _timeout_j)) {
+	_lock.release_write();
+	return -EAGAIN;
+    }
+
+    // Keep the entry just this side of expiring while we are still trying to
+    // send to it, so that slim() does not delete it below.
+    if (_timeout_j) {
+	click_jiffies_t live_at_j_min = now - _timeout_j;
+	if (click_jiffies_less(ae->_live_at_j, live_at_j_min)) {
+	    ae->_live_at_j = live_at_j_min;
+	    NDEntry *ae_next = ae->_age_link.next(), *next = ae_next;
+	    while (next && click_jiffies_less(next->_live_at_j, ae->_live_at_j))
+		next = next->_age_link.next();
+	    if (ae_next != next) {
+		_age.erase(ae);
+		_age.insert(next /* might be null */, ae);
+	    }
+	}
+    }
+
+    if ((_entry_packet_capacity && ae->_entry_packet_count >= _entry_packet_capacity)
+	|| (_byte_capacity && p->length() > _byte_capacity)) {
+	_drops++;
+	_lock.release_write();
+	return -ENOMEM;
+    }
+
+    if (!ae->_head)
+	_pending.push_back(ae);
+    if (ae->_tail)
+	ae->_tail->set_next(p);
+    else
+	ae->_head = p;
+    ae->_tail = p;
+    p->set_next(0);
+    ++ae->_entry_packet_count;
+    ae->_entry_byte_count += p->length();
+    ++_packet_count;
+    _byte_count += p->length();
+    if (_byte_capacity && _byte_count > _byte_capacity)
+	slim(now);
+
+    int r;
+    if (ae->allow_poll(now)) {
+	ae->mark_poll(now);
+	r = 1;
+    } else
+	r = 0;
+
+    _table.balance();
+    _lock.release_write();
+    return r;
+}
+
+String
+IP6NDTable::read_handler(Element *e, void *user_data)
+{
+    IP6NDTable *ndt = (IP6NDTable *) e;
+    StringAccum sa;
+    click_jiffies_t now = click_jiffies();
+    switch (reinterpret_cast<uintptr_t>(user_data)) {
+    case h_table:
+	ndt->_lock.acquire_read();
+	for (NDEntry *ae = ndt->_age.front(); ae; ae = ae->_age_link.next()) {
+	    const char *state;
+	    if (!ae->known(now, ndt->_timeout_j))
+		state = "INCOMPLETE";
+	    else if (ae->stale(now, ndt->_reachable_j))
+		state = "STALE";
+	    else
+		state = "REACHABLE";
+	    sa << ae->_ip << ' ' << state << ' ' << ae->_eth << ' '
+	       << Timestamp::make_jiffies(now - ae->_live_at_j) << '\n';
+	}
+	ndt->_lock.release_read();
+	break;
+    }
+    return sa.take_string();
+}
+
+int
+IP6NDTable::write_handler(const String &str, Element *e, void *user_data, ErrorHandler *errh)
+{
+    IP6NDTable *ndt = (IP6NDTable *) e;
+    switch (reinterpret_cast<uintptr_t>(user_data)) {
+      case h_insert: {
+	  IP6Address ip;
+	  EtherAddress eth;
+	  if (Args(ndt, errh).push_back_words(str)
+	      .read_mp("IP", ip)
+	      .read_mp("ETH", eth)
+	      .complete() < 0)
+	      return -1;
+	  ndt->insert(ip, eth);
+	  return 0;
+      }
+      case h_delete: {
+	  IP6Address ip;
+	  if (Args(ndt, errh).push_back_words(str)
+	      .read_mp("IP", ip)
+	      .complete() < 0)
+	      return -1;
+	  ndt->insert(ip, EtherAddress::make_broadcast());
+	  return 0;
+      }
+      case h_clear:
+	ndt->_lock.acquire_write();
+	ndt->clear();
+	ndt->_lock.release_write();
+	return 0;
+      default:
+	return -1;
+    }
+}
+
+void
+IP6NDTable::add_handlers()
+{
+    add_read_handler("table", read_handler, h_table);
+    add_data_handlers("drops", Handler::OP_READ, &_drops);
+    add_data_handlers("count", Handler::OP_READ, &_entry_count);
+    add_data_handlers("length", Handler::OP_READ, &_packet_count);
+    add_data_handlers("bytes", Handler::OP_READ, &_byte_count);
+    add_write_handler("insert", write_handler, h_insert);
+    add_write_handler("delete", write_handler, h_delete);
+    add_write_handler("clear", write_handler, h_clear);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(ip6)
+EXPORT_ELEMENT(IP6NDTable)
+ELEMENT_MT_SAFE(IP6NDTable)
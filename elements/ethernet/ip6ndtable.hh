@@ -0,0 +1,323 @@
+#ifndef CLICK_IP6NDTABLE_HH
+#define CLICK_IP6NDTABLE_HH
+#include <click/element.hh>
+#include <click/etheraddress.hh>
+#include <click/ip6address.hh>
+#include <click/hashcontainer.hh>
+#include <click/hashallocator.hh>
+#include <click/sync.hh>
+#include <click/timer.hh>
+#include <click/list.hh>
+CLICK_DECLS
+
+/*
+=c
+
+IP6NDTable(I<keywords>)
+
+=s ip6
+
+stores IP6-to-Ethernet mappings
+
+=d
+
+The IP6NDTable element is an IPv6 neighbor cache: it stores IP6-to-Ethernet
+mappings learned through Neighbor Discovery, and the packets waiting for a
+mapping to be resolved.  IP6NDTable is an information element, with no inputs
+or outputs.  IP6NDSolicitor normally encapsulates access to an IP6NDTable
+element.  A separate IP6NDTable is useful if several IP6NDSolicitor elements,
+possibly running on different threads, should share a neighbor cache.
+
+Lookups only take the table's read lock, which is per-CPU in SMP Click, so
+lookups from different threads do not contend with each other.  Inserting
+entries and saving packets take the write lock.
+
+Each entry is in one of three reachability states.  An INCOMPLETE entry has
+no known Ethernet address; packets sent to it are saved until a Neighbor
+Advertisement arrives.  A REACHABLE entry was confirmed less than
+REACHABLE_TIME ago.  A STALE entry is still used, but IP6NDSolicitor
+solicits it again.  Entries not confirmed for TIMEOUT are deleted.  An
+INCOMPLETE entry that was solicited MAX_SOLICIT times, without a reply, drops
+its saved packets one second after the last solicitation (RFC 4861).
+
+Keyword arguments are:
+
+=over 8
+
+=item CAPACITY
+
+Unsigned integer.  The maximum number of bytes of saved IP6 packets the
+IP6NDTable will hold at a time, for all entries together.  Default is 256K;
+zero means unlimited.
+
+=item ENTRY_CAPACITY
+
+Unsigned integer.  The maximum number of entries the IP6NDTable will hold at
+a time.  Default is zero, which means unlimited.
+
+=item ENTRY_PACKET_CAPACITY
+
+Unsigned integer.  The maximum number of saved IP6 packets the IP6NDTable
+will hold for any given entry at a time.  Default is zero, which means
+unlimited.
+
+=item CAPACITY_SLIM_FACTOR
+
+Unsigned integer.  IP6NDTable removes 1/CAPACITY_SLIM_FACTOR of saved bytes
+on exceeding CAPACITY.  Default is 2.
+
+=item REACHABLE_TIME
+
+Time value.  The amount of time after which a REACHABLE entry becomes STALE.
+Default is 30 seconds.  Zero means entries never become STALE.
+
+=item TIMEOUT
+
+Time value.  The amount of time after which an entry will expire.  Default is
+5 minutes.  Zero means entries never expire.
+
+=item MAX_SOLICIT
+
+Unsigned integer.  The number of solicitations after which an INCOMPLETE
+entry drops its saved packets.  Default is 3.  Zero means saved packets are
+only dropped on timeouts or capacity limits.
+
+=back
+
+=h table r
+
+Return a table of the entries.  The returned string has four space-separated
+columns: an IP6 address, the entry's state, the corresponding Ethernet
+address, and finally, the amount of time since the entry was last updated.
+
+=h drops r
+
+Return the number of packets dropped because of timeouts, failed resolutions
+or capacity limits.
+
+=h insert w
+
+Add an entry to the table.  The format should be "IP6 ETH".
+
+=h delete w
+
+Delete an entry from the table.  The string should consist of an IP6 address.
+
+=h clear w
+
+Clear the table, deleting all entries.
+
+=h count r
+
+Return the number of entries in the table.
+
+=h length r
+
+Return the number of packets stored in the table.
+
+=h bytes r
+
+Return the number of bytes of packets stored in the table.
+
+=a
+
+IP6NDSolicitor, IP6NDAdvertiser, ARPTable
+*/
+
+class IP6NDTable : public Element { public:
+
+    IP6NDTable() CLICK_COLD;
+    ~IP6NDTable() CLICK_COLD;
+
+    const char *class_name() const		{ return "IP6NDTable"; }
+
+    int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
+    bool can_live_reconfigure() const		{ return true; }
+    void take_state(Element *, ErrorHandler *);
+    void add_handlers() CLICK_COLD;
+    void cleanup(CleanupStage) CLICK_COLD;
+
+    int lookup(const IP6Address &ip, EtherAddress *eth);
+    EtherAddress lookup(const IP6Address &ip);
+    int insert(const IP6Address &ip, const EtherAddress &en, Packet **head = 0);
+    int append_query(const IP6Address &ip, Packet *p);
+    void clear();
+
+    uint32_t capacity() const {
+	return _byte_capacity;
+    }
+    void set_capacity(uint32_t capacity) {
+	_byte_capacity = capacity;
+    }
+    uint32_t entry_capacity() const {
+	return _entry_capacity;
+    }
+    void set_entry_capacity(uint32_t entry_capacity) {
+	_entry_capacity = entry_capacity;
+    }
+    uint32_t entry_packet_capacity() const {
+	return _entry_packet_capacity;
+    }
+    void set_entry_packet_capacity(uint32_t entry_packet_capacity) {
+	_entry_packet_capacity = entry_packet_capacity;
+    }
+    uint32_t capacity_slim_factor() const {
+	return _capacity_slim_factor;
+    }
+    void set_capacity_slim_factor(uint32_t capacity_slim_factor) {
+	assert(capacity_slim_factor != 0);
+	_capacity_slim_factor = capacity_slim_factor;
+    }
+    Timestamp reachable_time() const {
+	return Timestamp::make_jiffies((click_jiffies_t) _reachable_j);
+    }
+    void set_reachable_time(const Timestamp &reachable_time) {
+	_reachable_j = timestamp_jiffies(reachable_time);
+    }
+    Timestamp timeout() const {
+	return Timestamp::make_jiffies((click_jiffies_t) _timeout_j);
+    }
+    void set_timeout(const Timestamp &timeout) {
+	_timeout_j = timestamp_jiffies(timeout);
+    }
+
+    uint32_t drops() const {
+	return _drops;
+    }
+    uint32_t count() const {
+	return _entry_count;
+    }
+    uint32_t length() const {
+	return _packet_count;
+    }
+    uint32_t bytes() const {
+	return _byte_count;
+    }
+
+    void run_timer(Timer *);
+
+    enum {
+	h_table, h_insert, h_delete, h_clear
+    };
+    static String read_handler(Element *e, void *user_data) CLICK_COLD;
+    static int write_handler(const String &str, Element *e, void *user_data, ErrorHandler *errh) CLICK_COLD;
+
+    struct NDEntry {
+	IP6Address _ip;
+	NDEntry *_hashnext;
+	EtherAddress _eth;
+	bool _known;
+	uint8_t _num_polls_since_reply;
+	click_jiffies_t _live_at_j;
+	click_jiffies_t _polled_at_j;
+	Packet *_head;
+	Packet *_tail;
+	uint32_t _entry_packet_count;
+	uint32_t _entry_byte_count;
+	List_member<NDEntry> _age_link;
+	List_member<NDEntry> _pending_link;
+	typedef IP6Address key_type;
+	typedef const IP6Address &key_const_reference;
+	NDEntry(const IP6Address &ip)
+	    : _ip(ip), _hashnext(), _eth(EtherAddress::make_broadcast()),
+	      _known(false), _num_polls_since_reply(0), _head(), _tail(),
+	      _entry_packet_count(0), _entry_byte_count(0) {
+	}
+	key_const_reference hashkey() const {
+	    return _ip;
+	}
+	bool expired(click_jiffies_t now, uint32_t timeout_j) const {
+	    return click_jiffies_less(_live_at_j + timeout_j, now)
+		&& timeout_j;
+	}
+	bool known(click_jiffies_t now, uint32_t timeout_j) const {
+	    return _known && !expired(now, timeout_j);
+	}
+	bool stale(click_jiffies_t now, uint32_t reachable_j) const {
+	    return reachable_j
+		&& !click_jiffies_less(now, _live_at_j + reachable_j);
+	}
+	bool allow_poll(click_jiffies_t now) const {
+	    click_jiffies_t thresh_j = _polled_at_j
+		+ (_num_polls_since_reply >= 10 ? CLICK_HZ * 2 : CLICK_HZ / 10);
+	    return !click_jiffies_less(now, thresh_j);
+	}
+	void mark_poll(click_jiffies_t now) {
+	    _polled_at_j = now;
+	    if (_num_polls_since_reply < 255)
+		++_num_polls_since_reply;
+	}
+    };
+
+  private:
+
+    ReadWriteLock _lock;
+
+    typedef HashContainer<NDEntry> Table;
+    Table _table;
+    typedef List<NDEntry, &NDEntry::_age_link> AgeList;
+    AgeList _age;
+    // entries with saved packets, in the order they were first solicited
+    typedef List<NDEntry, &NDEntry::_pending_link> PendingList;
+    PendingList _pending;
+    atomic_uint32_t _entry_count;
+    atomic_uint32_t _packet_count;
+    atomic_uint32_t _byte_count;
+    uint32_t _entry_capacity;
+    uint32_t _byte_capacity;
+    uint32_t _entry_packet_capacity;
+    uint32_t _capacity_slim_factor;
+    uint32_t _reachable_j;
+    uint32_t _timeout_j;
+    uint32_t _max_solicit;
+    atomic_uint32_t _drops;
+    SizedHashAllocator<sizeof(NDEntry)> _alloc;
+    Timer _expire_timer;
+
+    static uint32_t timestamp_jiffies(const Timestamp &t) {
+	if ((uint32_t) t.sec() >= (uint32_t) 0xFFFFFFFFU / CLICK_HZ)
+	    return 0;
+	else
+	    return t.jiffies();
+    }
+
+    NDEntry *ensure(const IP6Address &ip, click_jiffies_t now);
+    void drop_packets(NDEntry *ae);
+    void slim(click_jiffies_t now);
+
+};
+
+/* Returns -1 if ip has no known Ethernet address, 0 if it is REACHABLE, and 1
+ * if it is STALE and the caller should solicit it again. */
+inline int
+IP6NDTable::lookup(const IP6Address &ip, EtherAddress *eth)
+{
+    _lock.acquire_read();
+    int r = -1;
+    if (Table::iterator it = _table.find(ip)) {
+	click_jiffies_t now = click_jiffies();
+	if (it->known(now, _timeout_j)) {
+	    *eth = it->_eth;
+	    if (it->stale(now, _reachable_j) && it->allow_poll(now)) {
+		it->mark_poll(now);
+		r = 1;
+	    } else
+		r = 0;
+	}
+    }
+    _lock.release_read();
+    return r;
+}
+
+inline EtherAddress
+IP6NDTable::lookup(const IP6Address &ip)
+{
+    EtherAddress eth;
+    if (lookup(ip, &eth) >= 0)
+	return eth;
+    else
+	return EtherAddress::make_broadcast();
+}
+
+CLICK_ENDDECLS
+#endif
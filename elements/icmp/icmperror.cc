@@ -180,6 +180,7 @@ ICMPError::simple_action(Packet *p)
   click_ip *nip;
   click_icmp *icp;
   unsigned hlen, xlen;
+  uint32_t csum;
   static int id = 1;
 
   if (!p->has_network_header())
@@ -282,8 +283,8 @@ ICMPError::simple_action(Packet *p)
     q->take(xlen - p->network_length());
     xlen = p->network_length();
   }
-  memcpy((uint8_t *)(icp + 1), p->network_header(), xlen);
-  icp->icmp_cksum = click_in_cksum((unsigned char *)icp, sizeof(click_icmp) + xlen);
+  csum = click_in_cksum_copy_partial((uint8_t *)(icp + 1), p->network_header(), xlen, 0);
+  icp->icmp_cksum = click_in_cksum_fold(click_in_cksum_partial((unsigned char *)icp, sizeof(click_icmp), csum));
 
   // finish off IP header
   nip->ip_len = htons(q->network_length());
@@ -33,6 +33,7 @@
 #include <click/error.hh>
 #include <click/algorithm.hh>
 #include <click/heap.hh>
+#include <click/master.hh>
 
 #ifdef CLICK_LINUXMODULE
 #include <click/cxxprotect.h>
@@ -63,12 +64,30 @@ IPMapper::rewrite_flowid(IPRewriterInput *, const IPFlowID &, IPFlowID &,
     return IPRewriterBase::rw_drop;
 }
 
+//
+// IPRewriterShard
+//
+
+IPRewriterShard::IPRewriterShard(IPRewriterBase *rw_, int index_,
+				 size_t flow_size)
+    : map(0), heap(new IPRewriterHeap), allocator(flow_size),
+      gc_timer(IPRewriterBase::shard_gc_timer_hook, this),
+      rw(rw_), index(index_), mapped_foutput(-1), mapped_routput(-1)
+{
+}
+
+IPRewriterShard::~IPRewriterShard()
+{
+    heap->unuse();
+}
+
 //
 // IPRewriterBase
 //
 
 IPRewriterBase::IPRewriterBase()
-    : _map(0), _heap(new IPRewriterHeap), _gc_timer(gc_timer_hook, this)
+    : _map(0), _heap(new IPRewriterHeap), _gc_timer(gc_timer_hook, this),
+      _shard_flow_size(0)
 {
     _timeouts[0] = default_timeout;
     _timeouts[1] = default_guarantee;
@@ -77,6 +96,8 @@ IPRewriterBase::IPRewriterBase()
 
 IPRewriterBase::~IPRewriterBase()
 {
+    for (int i = 0; i < _shards.size(); ++i)
+	delete _shards[i];
     if (_heap)
 	_heap->unuse();
 }
@@ -150,8 +171,10 @@ int
 IPRewriterBase::configure(Vector<String> &conf, ErrorHandler *errh)
 {
     String capacity_word;
+    int nshards = 1;
 
     if (Args(this, errh).bind(conf)
+	.read("SHARDS", nshards)
 	.read("CAPACITY", AnyArg(), capacity_word)
 	.read("MAPPING_CAPACITY", AnyArg(), capacity_word)
 	.read("TIMEOUT", SecondsArg(), _timeouts[0])
@@ -168,6 +191,8 @@ IPRewriterBase::configure(Vector<String> &conf, ErrorHandler *errh)
 	    /* OK */;
 	else if ((e = cp_element(capacity_word, this))
 		 && (rwb = (IPRewriterBase *) e->cast("IPRewriterBase"))) {
+	    if (rwb->_shards.size())
+		return errh->error("%<%s%> uses SHARDS and cannot share MAPPING_CAPACITY", rwb->name().c_str());
 	    rwb->_heap->use();
 	    _heap->unuse();
 	    _heap = rwb->_heap;
@@ -175,6 +200,18 @@ IPRewriterBase::configure(Vector<String> &conf, ErrorHandler *errh)
 	    return errh->error("bad MAPPING_CAPACITY");
     }
 
+    if (nshards == 0)
+	nshards = master()->nthreads();
+    if (nshards < 0)
+	return errh->error("bad SHARDS");
+    else if (nshards > 1 && !_shard_flow_size)
+	return errh->error("%s does not support SHARDS", class_name());
+    else if (nshards > 1 && _heap->_use_count != 1)
+	return errh->error("SHARDS cannot share MAPPING_CAPACITY");
+    else if (nshards > 1 && _shards.empty())
+	for (int i = 0; i < nshards; ++i)
+	    _shards.push_back(new IPRewriterShard(this, i, _shard_flow_size));
+
     if (conf.size() != ninputs())
 	return errh->error("need %d arguments, one per input port", ninputs());
 
@@ -197,19 +234,39 @@ IPRewriterBase::initialize(ErrorHandler *errh)
 	PrefixErrorHandler cerrh(errh, "input spec " + String(i) + ": ");
 	if (_input_specs[i].reply_element->_heap != _heap)
 	    cerrh.error("reply element %<%s%> must share this MAPPING_CAPACITY", i, _input_specs[i].reply_element->name().c_str());
+	if (_shards.size() && _input_specs[i].reply_element != this)
+	    cerrh.error("SHARDS requires replies to return to this element");
+	if (_shards.size() && !_input_specs[i].shardable())
+	    cerrh.error("SHARDS requires patterns that vary a port or address");
+	if (_shards.size() && _input_specs[i].kind == IPRewriterInput::i_pattern)
+	    _input_specs[i].u.pattern->set_nshards(_shards.size());
 	if (_input_specs[i].kind == IPRewriterInput::i_mapper)
 	    _input_specs[i].u.mapper->notify_rewriter(this, &_input_specs[i], &cerrh);
     }
-    _gc_timer.initialize(this);
-    if (_gc_interval_sec)
-	_gc_timer.schedule_after_sec(_gc_interval_sec);
+    if (_shards.empty()) {
+	_gc_timer.initialize(this);
+	if (_gc_interval_sec)
+	    _gc_timer.schedule_after_sec(_gc_interval_sec);
+    }
+
+    // Split the capacity among the shards, and spread their GC timers over
+    // the threads.
+    int nthreads = master()->nthreads();
+    for (int i = 0; i < _shards.size(); ++i) {
+	IPRewriterShard *sh = _shards[i];
+	sh->heap->_capacity = shard_capacity();
+	sh->gc_timer.initialize(this);
+	sh->gc_timer.move_thread(i % nthreads);
+	if (_gc_interval_sec)
+	    sh->gc_timer.schedule_after_sec(_gc_interval_sec);
+    }
     return errh->nerrors() ? -1 : 0;
 }
 
 void
 IPRewriterBase::cleanup(CleanupStage)
 {
-    shrink_heap(true);
+    shrink_heaps(true);
     for (int i = 0; i < _input_specs.size(); ++i)
 	if (_input_specs[i].kind == IPRewriterInput::i_pattern)
 	    _input_specs[i].u.pattern->unuse();
@@ -219,15 +276,20 @@ IPRewriterBase::cleanup(CleanupStage)
 IPRewriterEntry *
 IPRewriterBase::get_entry(int ip_p, const IPFlowID &flowid, int input)
 {
-    IPRewriterEntry *m = _map.get(flowid);
+    IPRewriterShard *sh = flow_shard(flowid);
+    if (sh)
+	sh->lock.acquire();
+    IPRewriterEntry *m = (sh ? sh->map.get(flowid) : _map.get(flowid));
     if (m && ip_p && m->flow()->ip_p() && m->flow()->ip_p() != ip_p)
-	return 0;
-    if (!m && (unsigned) input < (unsigned) _input_specs.size()) {
+	m = 0;
+    else if (!m && (unsigned) input < (unsigned) _input_specs.size()) {
 	IPRewriterInput &is = _input_specs[input];
 	IPFlowID rewritten_flowid = IPFlowID::uninitialized_t();
 	if (is.rewrite_flowid(flowid, rewritten_flowid, 0) == rw_addmap)
 	    m = add_flow(ip_p, flowid, rewritten_flowid, input);
     }
+    if (sh)
+	sh->lock.release();
     return m;
 }
 
@@ -242,6 +304,18 @@ IPRewriterBase::store_flow(IPRewriterFlow *flow, int input,
 	return 0;
     }
 
+    IPRewriterHeap *heap = _heap;
+    if (IPRewriterShard *sh = flow_shard(flow->entry(false).flowid())) {
+	// Mappers may pick a reply that belongs to another shard.
+	if (flow_shard_index(flow->entry(true).flowid(), _shards.size()) != sh->index) {
+	    destroy_flow(flow);
+	    ++_input_specs[input].failures;
+	    return 0;
+	}
+	heap = sh->heap;
+	reply_map_ptr = &sh->map;
+    }
+
     IPRewriterEntry *old = map.set(&flow->entry(false));
     assert(!old);
 
@@ -250,16 +324,32 @@ IPRewriterBase::store_flow(IPRewriterFlow *flow, int input,
     old = reply_map_ptr->set(&flow->entry(true));
     if (unlikely(old)) {		// Assume every map has the same heap.
 	if (likely(old->flow() != flow))
-	    old->flow()->destroy(_heap);
+	    old->flow()->destroy(heap);
     }
 
-    Vector<IPRewriterFlow *> &myheap = _heap->_heaps[flow->guaranteed()];
+    if (!store_flow_heap(flow, input, heap))
+	return 0;
+
+    if (map.unbalanced())
+	map.rehash(map.bucket_count() + 1);
+    if (reply_map_ptr != &map && reply_map_ptr->unbalanced())
+	reply_map_ptr->rehash(reply_map_ptr->bucket_count() + 1);
+    return &flow->entry(false);
+}
+
+/* Adds a flow, already in its maps, to @a heap.  Returns false if the heap
+   was full and the flow was destroyed to make room. */
+bool
+IPRewriterBase::store_flow_heap(IPRewriterFlow *flow, int input,
+				IPRewriterHeap *heap)
+{
+    Vector<IPRewriterFlow *> &myheap = heap->_heaps[flow->guaranteed()];
     myheap.push_back(flow);
     push_heap(myheap.begin(), myheap.end(),
 	      IPRewriterFlow::heap_less(), IPRewriterFlow::heap_place());
     ++_input_specs[input].count;
 
-    if (unlikely(_heap->size() > _heap->capacity())) {
+    if (unlikely(heap->size() > heap->capacity())) {
 	// This may destroy the newly added mapping, if it has the lowest
 	// expiration time.  How can we tell?  If (1) flows are added to the
 	// heap one at a time, so the heap was formerly no bigger than the
@@ -267,76 +357,111 @@ IPRewriterBase::store_flow(IPRewriterFlow *flow, int input,
 	// destroy 'flow' if it's the top of the heap.
 	click_jiffies_t now_j = click_jiffies();
 	assert(click_jiffies_less(now_j, flow->expiry())
-	       && _heap->size() == _heap->capacity() + 1);
-	if (shrink_heap_for_new_flow(flow, now_j)) {
+	       && heap->size() == heap->capacity() + 1);
+	if (shrink_heap_for_new_flow(heap, flow, now_j)) {
 	    ++_input_specs[input].failures;
-	    return 0;
+	    return false;
 	}
     }
-
-    if (map.unbalanced())
-	map.rehash(map.bucket_count() + 1);
-    if (reply_map_ptr != &map && reply_map_ptr->unbalanced())
-	reply_map_ptr->rehash(reply_map_ptr->bucket_count() + 1);
-    return &flow->entry(false);
+    return true;
 }
 
 void
-IPRewriterBase::shift_heap_best_effort(click_jiffies_t now_j)
+IPRewriterBase::shift_heap_best_effort(IPRewriterHeap *heap,
+				       click_jiffies_t now_j)
 {
     // Shift flows with expired guarantees to the best-effort heap.
-    Vector<IPRewriterFlow *> &guaranteed_heap = _heap->_heaps[1];
+    Vector<IPRewriterFlow *> &guaranteed_heap = heap->_heaps[1];
     while (guaranteed_heap.size() && guaranteed_heap[0]->expired(now_j)) {
 	IPRewriterFlow *mf = guaranteed_heap[0];
 	click_jiffies_t new_expiry = mf->owner()->owner->best_effort_expiry(mf);
-	mf->change_expiry(_heap, false, new_expiry);
+	mf->change_expiry(heap, false, new_expiry);
     }
 }
 
 bool
-IPRewriterBase::shrink_heap_for_new_flow(IPRewriterFlow *flow,
+IPRewriterBase::shrink_heap_for_new_flow(IPRewriterHeap *heap,
+					 IPRewriterFlow *flow,
 					 click_jiffies_t now_j)
 {
-    shift_heap_best_effort(now_j);
+    shift_heap_best_effort(heap, now_j);
     // At this point, all flows in the guarantee heap expire in the future.
     // So remove the next-to-expire best-effort flow, unless there are none.
     // In that case we always remove the current flow to honor previous
     // guarantees (= admission control).
     IPRewriterFlow *deadf;
-    if (_heap->_heaps[0].empty()) {
+    if (heap->_heaps[0].empty()) {
 	assert(flow->guaranteed());
 	deadf = flow;
     } else
-	deadf = _heap->_heaps[0][0];
-    deadf->destroy(_heap);
+	deadf = heap->_heaps[0][0];
+    deadf->destroy(heap);
     return deadf == flow;
 }
 
 void
-IPRewriterBase::shrink_heap(bool clear_all)
+IPRewriterBase::shrink_heap(IPRewriterHeap *heap, bool clear_all)
 {
     click_jiffies_t now_j = click_jiffies();
-    shift_heap_best_effort(now_j);
-    Vector<IPRewriterFlow *> &best_effort_heap = _heap->_heaps[0];
+    shift_heap_best_effort(heap, now_j);
+    Vector<IPRewriterFlow *> &best_effort_heap = heap->_heaps[0];
     while (best_effort_heap.size() && best_effort_heap[0]->expired(now_j))
-	best_effort_heap[0]->destroy(_heap);
+	best_effort_heap[0]->destroy(heap);
 
-    int32_t capacity = clear_all ? 0 : _heap->_capacity;
-    while (_heap->size() > capacity) {
-	IPRewriterFlow *deadf = _heap->_heaps[_heap->_heaps[0].empty()][0];
-	deadf->destroy(_heap);
+    int32_t capacity = clear_all ? 0 : heap->_capacity;
+    while (heap->size() > capacity) {
+	IPRewriterFlow *deadf = heap->_heaps[heap->_heaps[0].empty()][0];
+	deadf->destroy(heap);
     }
 }
 
+void
+IPRewriterBase::shrink_heaps(bool clear_all)
+{
+    if (_shards.empty())
+	shrink_heap(_heap, clear_all);
+    for (int i = 0; i < _shards.size(); ++i) {
+	IPRewriterShard *sh = _shards[i];
+	sh->lock.acquire();
+	shrink_heap(sh->heap, clear_all);
+	sh->lock.release();
+    }
+}
+
+void
+IPRewriterBase::lock_shards()
+{
+    for (int i = 0; i < _shards.size(); ++i)
+	_shards[i]->lock.acquire();
+}
+
+void
+IPRewriterBase::unlock_shards()
+{
+    for (int i = _shards.size() - 1; i >= 0; --i)
+	_shards[i]->lock.release();
+}
+
 void
 IPRewriterBase::gc_timer_hook(Timer *t, void *user_data)
 {
     IPRewriterBase *rw = static_cast<IPRewriterBase *>(user_data);
-    rw->shrink_heap(false);
+    rw->shrink_heap(rw->_heap, false);
     if (rw->_gc_interval_sec)
 	t->reschedule_after_sec(rw->_gc_interval_sec);
 }
 
+void
+IPRewriterBase::shard_gc_timer_hook(Timer *t, void *user_data)
+{
+    IPRewriterShard *sh = static_cast<IPRewriterShard *>(user_data);
+    sh->lock.acquire();
+    sh->rw->shrink_heap(sh->heap, false);
+    sh->lock.release();
+    if (sh->rw->_gc_interval_sec)
+	t->reschedule_after_sec(sh->rw->_gc_interval_sec);
+}
+
 String
 IPRewriterBase::read_handler(Element *e, void *user_data)
 {
@@ -348,19 +473,26 @@ IPRewriterBase::read_handler(Element *e, void *user_data)
     case h_nmappings: {
 	uint32_t count = 0;
 	for (int i = 0; i < rw->_input_specs.size(); ++i)
-	    count += rw->_input_specs[i].count;
+	    count += rw->_input_specs[i].count.value();
 	sa << count;
 	break;
     }
     case h_mapping_failures: {
 	uint32_t count = 0;
 	for (int i = 0; i < rw->_input_specs.size(); ++i)
-	    count += rw->_input_specs[i].failures;
+	    count += rw->_input_specs[i].failures.value();
 	sa << count;
 	break;
     }
     case h_size:
-	sa << rw->_heap->size();
+	if (rw->_shards.empty())
+	    sa << rw->_heap->size();
+	else {
+	    uint32_t size = 0;
+	    for (int i = 0; i < rw->_shards.size(); ++i)
+		size += rw->_shards[i]->heap->size();
+	    sa << size;
+	}
 	break;
     case h_capacity:
 	sa << rw->_heap->_capacity;
@@ -386,8 +518,8 @@ IPRewriterBase::read_handler(Element *e, void *user_data)
 		sa << "<mapper>";
 		break;
 	    }
-	    if (rw->_input_specs[i].count)
-		sa << " [" << rw->_input_specs[i].count << ']';
+	    if (uint32_t count = rw->_input_specs[i].count.value())
+		sa << " [" << count << ']';
 	    sa << '\n';
 	}
 	break;
@@ -405,10 +537,12 @@ IPRewriterBase::write_handler(const String &str, Element *e, void *user_data, Er
 	    .read_mp("CAPACITY", rw->_heap->_capacity)
 	    .complete() < 0)
 	    return -1;
-	rw->shrink_heap(false);
+	for (int i = 0; i < rw->_shards.size(); ++i)
+	    rw->_shards[i]->heap->_capacity = rw->shard_capacity();
+	rw->shrink_heaps(false);
 	return 0;
     } else if (what == h_clear) {
-	rw->shrink_heap(true);
+	rw->shrink_heaps(true);
 	return 0;
     } else
 	return -1;
@@ -423,22 +557,29 @@ IPRewriterBase::pattern_write_handler(const String &str, Element *e, void *user_
     int r = rw->parse_input_spec(str, is, what, errh);
     if (r >= 0) {
 	IPRewriterInput *spec = &rw->_input_specs[what];
+	if (rw->_shards.size() && is.kind == IPRewriterInput::i_pattern)
+	    is.u.pattern->set_nshards(rw->_shards.size());
 
 	// remove all existing flows created by this input
-	for (int which_heap = 0; which_heap < 2; ++which_heap) {
-	    Vector<IPRewriterFlow *> &myheap = rw->_heap->_heaps[which_heap];
-	    for (int i = myheap.size() - 1; i >= 0; --i)
-		if (myheap[i]->owner() == spec) {
-		    myheap[i]->destroy(rw->_heap);
-		    if (i < myheap.size())
-			++i;
-		}
+	rw->lock_shards();
+	for (int s = 0; s < rw->_shards.size() || s == 0; ++s) {
+	    IPRewriterHeap *heap = (rw->_shards.empty() ? rw->_heap : rw->_shards[s]->heap);
+	    for (int which_heap = 0; which_heap < 2; ++which_heap) {
+		Vector<IPRewriterFlow *> &myheap = heap->_heaps[which_heap];
+		for (int i = myheap.size() - 1; i >= 0; --i)
+		    if (myheap[i]->owner() == spec) {
+			myheap[i]->destroy(heap);
+			if (i < myheap.size())
+			    ++i;
+		    }
+	    }
 	}
 
 	// change pattern
 	if (spec->kind == IPRewriterInput::i_pattern)
 	    spec->u.pattern->unuse();
 	*spec = is;
+	rw->unlock_shards();
     }
     return 0;
 }
@@ -4,9 +4,12 @@
 #include <click/timer.hh>
 #include "elements/ip/iprwmapping.hh"
 #include <click/bitvector.hh>
+#include <click/hashallocator.hh>
+#include <click/sync.hh>
 CLICK_DECLS
 class IPMapper;
 class IPRewriterPattern;
+class IPRewriterShard;
 
 class IPRewriterInput { public:
     enum {
@@ -18,15 +21,17 @@ class IPRewriterInput { public:
     int foutput;
     IPRewriterBase *reply_element;
     int routput;
-    uint32_t count;
-    uint32_t failures;
+    atomic_uint32_t count;
+    atomic_uint32_t failures;
     union {
 	IPRewriterPattern *pattern;
 	IPMapper *mapper;
     } u;
 
     IPRewriterInput()
-	: kind(i_drop), foutput(-1), routput(-1), count(0), failures(0) {
+	: kind(i_drop), foutput(-1), routput(-1) {
+	count = 0;
+	failures = 0;
 	u.pattern = 0;
     }
 
@@ -37,6 +42,12 @@ class IPRewriterInput { public:
     inline int rewrite_flowid(const IPFlowID &flowid,
 			      IPFlowID &rewritten_flowid,
 			      Packet *p, int mapid = mapid_default);
+    inline bool shardable() const;
+
+    // A mapper picks the outputs of the flow it is rewriting; a sharded
+    // rewriter keeps that choice in the flow's shard.
+    inline void set_mapped_outputs(const IPFlowID &flowid, int fo, int ro);
+    inline void flow_outputs(const IPFlowID &flowid, int &fo, int &ro) const;
 };
 
 class IPRewriterHeap { public:
@@ -78,6 +89,27 @@ class IPRewriterHeap { public:
 
 };
 
+/* One partition of a sharded rewriter's flows.  A flow lives in the shard
+   picked by the symmetric hash of its flow ID, and its reply lives in the
+   same shard, so a shard's map, heap, allocator, and mapped outputs are
+   only touched with that shard's lock held. */
+class IPRewriterShard { public:
+
+    IPRewriterShard(IPRewriterBase *rw, int index, size_t flow_size);
+    ~IPRewriterShard();
+
+    HashContainer<IPRewriterEntry> map;
+    IPRewriterHeap *heap;
+    HashAllocator allocator;
+    SimpleSpinlock lock;
+    Timer gc_timer;
+    IPRewriterBase *rw;
+    int index;
+    int mapped_foutput;		// set by an IPMapper for the flow being added
+    int mapped_routput;
+
+};
+
 class IPRewriterBase : public Element { public:
 
     typedef HashContainer<IPRewriterEntry> Map;
@@ -107,6 +139,17 @@ class IPRewriterBase : public Element { public:
     const IPRewriterHeap *flow_heap() const {
 	return _heap;
     }
+    int nshards() const {
+	return _shards.size();
+    }
+    static int flow_shard_index(const IPFlowID &flowid, int nshards) {
+	return flowid.symmetric_hashcode() % (uint32_t) nshards;
+    }
+    IPRewriterShard *flow_shard(const IPFlowID &flowid) const {
+	if (likely(_shards.empty()))
+	    return 0;
+	return _shards[flow_shard_index(flowid, _shards.size())];
+    }
     IPRewriterBase *reply_element(int input) const {
 	return _input_specs[input].reply_element;
     }
@@ -140,6 +183,9 @@ class IPRewriterBase : public Element { public:
     uint32_t _gc_interval_sec;
     Timer _gc_timer;
 
+    Vector<IPRewriterShard *> _shards;	// empty unless SHARDS > 1
+    size_t _shard_flow_size;		// 0 if the subclass can't be sharded
+
     enum {
 	default_timeout = 300,	   // 5 minutes
 	default_guarantee = 5,	   // 5 seconds
@@ -152,13 +198,22 @@ class IPRewriterBase : public Element { public:
 
     IPRewriterEntry *store_flow(IPRewriterFlow *flow, int input,
 				Map &map, Map *reply_map_ptr = 0);
+    bool store_flow_heap(IPRewriterFlow *flow, int input,
+			 IPRewriterHeap *heap);
     inline void unmap_flow(IPRewriterFlow *flow,
 			   Map &map, Map *reply_map_ptr = 0);
 
     static void gc_timer_hook(Timer *t, void *user_data);
+    static void shard_gc_timer_hook(Timer *t, void *user_data);
+    int32_t shard_capacity() const {
+	int32_t n = _shards.size();
+	return _heap->_capacity / n + (_heap->_capacity % n != 0);
+    }
+    void lock_shards();
+    void unlock_shards();
 
-    int parse_input_spec(const String &str, IPRewriterInput &is,
-			 int input_number, ErrorHandler *errh);
+    virtual int parse_input_spec(const String &str, IPRewriterInput &is,
+				 int input_number, ErrorHandler *errh);
 
     enum {			// < 0 because individual patterns are >= 0
 	h_nmappings = -1, h_mapping_failures = -2, h_patterns = -3,
@@ -173,11 +228,14 @@ class IPRewriterBase : public Element { public:
 
   private:
 
-    void shift_heap_best_effort(click_jiffies_t now_j);
-    bool shrink_heap_for_new_flow(IPRewriterFlow *flow, click_jiffies_t now_j);
-    void shrink_heap(bool clear_all);
+    void shift_heap_best_effort(IPRewriterHeap *heap, click_jiffies_t now_j);
+    bool shrink_heap_for_new_flow(IPRewriterHeap *heap, IPRewriterFlow *flow,
+				  click_jiffies_t now_j);
+    void shrink_heap(IPRewriterHeap *heap, bool clear_all);
+    void shrink_heaps(bool clear_all);
 
     friend class IPRewriterFlow;
+    friend class IPRewriterShard;
 
 };
 
@@ -197,6 +255,37 @@ class IPMapper { public:
 };
 
 
+inline bool
+IPRewriterInput::shardable() const
+{
+    return kind != i_pattern || u.pattern->shardable();
+}
+
+inline void
+IPRewriterInput::set_mapped_outputs(const IPFlowID &flowid, int fo, int ro)
+{
+    if (IPRewriterShard *sh = owner->flow_shard(flowid)) {
+	sh->mapped_foutput = fo;
+	sh->mapped_routput = ro;
+    } else {
+	foutput = fo;
+	routput = ro;
+    }
+}
+
+inline void
+IPRewriterInput::flow_outputs(const IPFlowID &flowid, int &fo, int &ro) const
+{
+    IPRewriterShard *sh;
+    if (kind == i_mapper && (sh = owner->flow_shard(flowid))) {
+	fo = sh->mapped_foutput;
+	ro = sh->mapped_routput;
+    } else {
+	fo = foutput;
+	ro = routput;
+    }
+}
+
 inline int
 IPRewriterInput::rewrite_flowid(const IPFlowID &flowid,
 				IPFlowID &rewritten_flowid,
@@ -211,7 +300,15 @@ IPRewriterInput::rewrite_flowid(const IPFlowID &flowid,
 	return IPRewriterBase::rw_addmap;
     case i_pattern: {
 	HashContainer<IPRewriterEntry> *reply_map;
-	if (likely(mapid == mapid_default))
+	if (unlikely(!reply_element->_shards.empty())) {
+	    // Only pick rewritten flows whose replies land in this shard.
+	    int nshards = reply_element->_shards.size();
+	    int shard = IPRewriterBase::flow_shard_index(flowid, nshards);
+	    reply_map = &reply_element->_shards[shard]->map;
+	    i = u.pattern->rewrite_flowid(flowid, rewritten_flowid, *reply_map,
+					  shard, nshards);
+	    goto check_for_failure;
+	} else if (likely(mapid == mapid_default))
 	    reply_map = &reply_element->_map;
 	else
 	    reply_map = reply_element->get_map(mapid);
@@ -40,8 +40,10 @@ IPRewriterFlow::IPRewriterFlow(IPRewriterInput *owner, const IPFlowID &flowid,
       _guaranteed(guaranteed), _reply_anno(0),
       _owner(owner)
 {
-    _e[0].initialize(flowid, owner->foutput, false);
-    _e[1].initialize(rewritten_flowid.reverse(), owner->routput, true);
+    int foutput, routput;
+    owner->flow_outputs(flowid, foutput, routput);
+    _e[0].initialize(flowid, foutput, false);
+    _e[1].initialize(rewritten_flowid.reverse(), routput, true);
 
     // set checksum deltas
     const uint16_t *swords = reinterpret_cast<const uint16_t *>(&flowid);
@@ -166,6 +166,7 @@ class IPRewriterFlow { public:
 
     friend class IPRewriterBase;
     friend class IPRewriterEntry;
+    friend class IP6Rewriter;
 
   private:
 
@@ -44,6 +44,12 @@ IPRewriterPattern::IPRewriterPattern(const IPAddress &saddr, int sport,
 {
 }
 
+IPRewriterPattern::IPRewriterPattern()
+    : _sport(0), _dport(0), _variation_top(0), _next_variation(0),
+      _is_napt(false), _sequential(false), _same_first(false), _refcount(0)
+{
+}
+
 namespace {
 enum { PE_SYNTAX, PE_NOPATTERN, PE_SADDR, PE_SPORT, PE_DADDR, PE_DPORT };
 static const char* const pe_messages[] = {
@@ -216,11 +222,26 @@ IPRewriterPattern::parse_with_ports(const String &conf, IPRewriterInput *input,
 	&& parse_ports(port_words, input, e, errh);
 }
 
+void
+IPRewriterPattern::set_nshards(int nshards)
+{
+    for (int i = _shard_next.size(); i < nshards; ++i) {
+	_shard_next.push_back(IPRewriterShardCursor());
+	_shard_next.back().value = 0;
+    }
+}
+
 int
 IPRewriterPattern::rewrite_flowid(const IPFlowID &flowid,
 				  IPFlowID &rewritten_flowid,
-				  const HashContainer<IPRewriterEntry> &reply_map)
+				  const HashContainer<IPRewriterEntry> &reply_map,
+				  int shard, int nshards)
 {
+    // A sharded rewriter keeps a flow's reply in the flow's own shard, so
+    // each shard only allocates the variations whose replies hash there,
+    // starting from its own cursor.
+#define IN_SHARD(f)	(nshards <= 1 || IPRewriterBase::flow_shard_index((f), nshards) == shard)
+
     rewritten_flowid = flowid;
     if (_saddr)
 	rewritten_flowid.set_saddr(_saddr);
@@ -239,13 +260,14 @@ IPRewriterPattern::rewrite_flowid(const IPFlowID &flowid,
 	if (_same_first
 	    && (val = ntohs(flowid.sport()) - base) <= _variation_top) {
 	    lookup.set_dport(flowid.sport());
-	    if (!reply_map.find(lookup))
+	    if (IN_SHARD(lookup) && !reply_map.find(lookup))
 		goto found_variation;
 	}
 
-	if (_sequential)
-	    val = (_next_variation > _variation_top ? 0 : _next_variation);
-	else
+	if (_sequential) {
+	    uint32_t next = (nshards > 1 ? _shard_next[shard].value.value() : _next_variation);
+	    val = (next > _variation_top ? 0 : next);
+	} else
 	    val = click_random(0, _variation_top);
 
 	for (uint32_t count = 0; count <= _variation_top;
@@ -254,7 +276,7 @@ IPRewriterPattern::rewrite_flowid(const IPFlowID &flowid,
 		lookup.set_dport(htons(base + val));
 	    else
 		lookup.set_daddr(htonl(base + val));
-	    if (!reply_map.find(lookup))
+	    if (IN_SHARD(lookup) && !reply_map.find(lookup))
 		goto found_variation;
 	}
 
@@ -265,10 +287,15 @@ IPRewriterPattern::rewrite_flowid(const IPFlowID &flowid,
 	    rewritten_flowid.set_sport(lookup.dport());
 	else
 	    rewritten_flowid.set_saddr(lookup.daddr());
-	_next_variation = val + 1;
-    }
+	if (nshards > 1)
+	    _shard_next[shard].value = val + 1;
+	else
+	    _next_variation = val + 1;
+    } else if (!IN_SHARD(rewritten_flowid))
+	return IPRewriterBase::rw_drop;
 
     return IPRewriterBase::rw_addmap;
+#undef IN_SHARD
 }
 
 String
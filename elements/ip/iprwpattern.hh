@@ -4,17 +4,27 @@
 #include <click/element.hh>
 #include <click/hashcontainer.hh>
 #include <click/ipflowid.hh>
+#include <click/atomic.hh>
 CLICK_DECLS
 class IPRewriterFlow;
 class IPRewriterEntry;
 class IPRewriterInput;
 
+/* A per-shard allocation cursor.  Shards run on different threads, so each
+   cursor gets its own cache line. */
+struct IPRewriterShardCursor {
+    atomic_uint32_t value;
+    char pad[CLICK_CACHE_LINE_SIZE - sizeof(atomic_uint32_t)];
+};
+
 class IPRewriterPattern { public:
 
     IPRewriterPattern(const IPAddress &saddr, int sport,
 		      const IPAddress &daddr, int dport,
 		      bool is_napt, bool sequential, bool same_first,
 		      uint32_t variation);
+    virtual ~IPRewriterPattern() {
+    }
     static bool parse(const Vector<String> &words, IPRewriterPattern **result,
 		      Element *context, ErrorHandler *errh);
     static bool parse_ports(const Vector<String> &words, IPRewriterInput *input,
@@ -36,11 +46,24 @@ class IPRewriterPattern { public:
     IPAddress daddr() const {
 	return _daddr;
     }
+    // A sharded rewriter keeps a flow's reply in the flow's shard, which
+    // takes a choice of ports or addresses unless the flow is unchanged.
+    bool shardable() const {
+	return _variation_top || !*this;
+    }
+    // Give each of a sharded rewriter's shards its own sequential cursor.
+    // Call before the pattern is used; cursors are never removed.
+    void set_nshards(int nshards);
 
     int rewrite_flowid(const IPFlowID &flowid, IPFlowID &rewritten_flowid,
-		       const HashContainer<IPRewriterEntry> &reply_map);
+		       const HashContainer<IPRewriterEntry> &reply_map,
+		       int shard = 0, int nshards = 1);
+
+    virtual String unparse() const;
+
+  protected:
 
-    String unparse() const;
+    IPRewriterPattern();
 
   private:
 
@@ -51,6 +74,7 @@ class IPRewriterPattern { public:
 
     uint32_t _variation_top;
     uint32_t _next_variation;
+    Vector<IPRewriterShardCursor> _shard_next;
 
     bool _is_napt;
     bool _sequential;
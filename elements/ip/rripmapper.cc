@@ -59,7 +59,8 @@ RoundRobinIPMapper::configure(Vector<String> &conf, ErrorHandler *errh)
 	}
     }
 
-    _last_pattern = 0;
+    _last_pattern.push_back(IPRewriterShardCursor());
+    _last_pattern.back().value = 0;
     return errh->nerrors() ? -1 : 0;
 }
 
@@ -78,6 +79,13 @@ RoundRobinIPMapper::notify_rewriter(IPRewriterBase *user,
 	if (_is[i].foutput >= user->noutputs()
 	    || _is[i].routput >= input->reply_element->noutputs())
 	    errh->error("output port out of range in %s pattern %d", declaration().c_str(), i);
+	if (input->reply_element->nshards() && !_is[i].shardable())
+	    errh->error("SHARDS requires patterns that vary a port or address, unlike %s pattern %d", declaration().c_str(), i);
+	_is[i].u.pattern->set_nshards(input->reply_element->nshards());
+    }
+    while (_last_pattern.size() < input->reply_element->nshards()) {
+	_last_pattern.push_back(IPRewriterShardCursor());
+	_last_pattern.back().value = 0;
     }
 }
 
@@ -87,20 +95,27 @@ RoundRobinIPMapper::rewrite_flowid(IPRewriterInput *input,
 				   IPFlowID &rewritten_flowid,
 				   Packet *p, int mapid)
 {
+    // Each shard of a sharded rewriter keeps its own place in the rotation,
+    // and patterns are tried through a copy so that the shared inputs are
+    // never written.
+    IPRewriterShard *sh = input->owner->flow_shard(flowid);
+    atomic_uint32_t &last = _last_pattern[sh ? sh->index : 0].value;
+    uint32_t k = last.value();
     for (int i = 0; i < _is.size(); ++i) {
-	IPRewriterInput &is = _is[_last_pattern];
-	++_last_pattern;
-	if (_last_pattern == _is.size())
-	    _last_pattern = 0;
+	if (k >= (uint32_t) _is.size())
+	    k = 0;
+	IPRewriterInput is = _is[k];
+	++k;
 	is.reply_element = input->reply_element;
 	int result = is.rewrite_flowid(flowid, rewritten_flowid, p, mapid);
 	if (result != IPRewriterBase::rw_drop
 	    || is.kind == IPRewriterInput::i_drop) {
-	    input->foutput = is.foutput;
-	    input->routput = is.routput;
+	    last = k;
+	    input->set_mapped_outputs(flowid, is.foutput, is.routput);
 	    return result;
 	}
     }
+    last = k;
     return IPRewriterBase::rw_drop;
 }
 
@@ -1,6 +1,7 @@
 #ifndef CLICK_RRIPMAPPER_HH
 #define CLICK_RRIPMAPPER_HH
 #include "elements/ip/iprewriterbase.hh"
+#include "elements/ip/iprwpattern.hh"
 CLICK_DECLS
 
 /*
@@ -40,7 +41,7 @@ class RoundRobinIPMapper : public Element, public IPMapper { public:
  private:
 
     Vector<IPRewriterInput> _is;
-    int _last_pattern;
+    Vector<IPRewriterShardCursor> _last_pattern; // one per rewriter shard
 
 };
 
@@ -125,6 +125,9 @@ SourceIPHashMapper::notify_rewriter(IPRewriterBase *user,
 	if (_is[i].foutput >= user->noutputs()
 	    || _is[i].routput >= input->reply_element->noutputs())
 	    errh->error("output port out of range in %s pattern %d", declaration().c_str(), i);
+	if (input->reply_element->nshards() && !_is[i].shardable())
+	    errh->error("SHARDS requires patterns that vary a port or address, unlike %s pattern %d", declaration().c_str(), i);
+	_is[i].u.pattern->set_nshards(input->reply_element->nshards());
     }
 }
 
@@ -146,10 +149,11 @@ SourceIPHashMapper::rewrite_flowid(IPRewriterInput *input,
     tmp = tmp % INT_MAX;
 
     int v = _hasher->hash2ind (tmp);
-    _is[v].reply_element = input->reply_element;
-    input->foutput = _is[v].foutput;
-    input->routput = _is[v].routput;
-    return _is[v].rewrite_flowid(flowid, rewritten_flowid, p, mapid);
+    // Work on a copy, since several shards may share this pattern input.
+    IPRewriterInput is = _is[v];
+    is.reply_element = input->reply_element;
+    input->set_mapped_outputs(flowid, is.foutput, is.routput);
+    return is.rewrite_flowid(flowid, rewritten_flowid, p, mapid);
 }
 
 CLICK_ENDDECLS
@@ -17,6 +17,7 @@
 #include "addresstranslator.hh"
 #include <click/args.hh>
 #include <click/error.hh>
+#include <click/straccum.hh>
 #include <clicknet/ip.h>
 #include <clicknet/ip6.h>
 #include <clicknet/icmp.h>
@@ -26,7 +27,9 @@
 CLICK_DECLS
 
 AddressTranslator::AddressTranslator()
-  : _dynamic_mapping_allocation_direction(0),
+  : _static_inner(-1), _static_mapped(-1), _binding_inner(-1), _binding_mapped(-1),
+    _free_head(-1), _free_tail(-1), _nfree(0),
+    _dynamic_mapping_allocation_direction(0),
     _in_map(0), _out_map(0), _rover(0), _rover2(0), _nmappings(0)
 {
     // input 0: IPv6 arriving outward packets
@@ -172,7 +175,17 @@ AddressTranslator::add_map(IP6Address &mai,  bool binding)
      }
   e._binding = binding;
   e._static = false;
+  e._free_next = -1;
   _v.push_back(e);
+
+  //append the new entry to the free list, so addresses are allocated in configuration order
+  int i = _v.size() - 1;
+  if (_free_tail >= 0)
+    _v[_free_tail]._free_next = i;
+  else
+    _free_head = i;
+  _free_tail = i;
+  _nfree++;
 }
 
 //add an entry to the mapping table for static address (and port) mapping
@@ -196,13 +209,55 @@ AddressTranslator::add_map(IP6Address &iai, unsigned short ipi, IP6Address &mai,
 
  e._binding = binding;
  e._static = true;
+ e._free_next = -1;
  _v.push_back(e);
+
+ int i = _v.size() - 1;
+ index_entry(_static_inner, EntryKey(e._iai, _static_mapping[1] ? e._ipi : 0), i);
+ index_entry(_static_mapped, EntryKey(e._mai, _static_mapping[1] ? e._mpi : 0), i);
+}
+
+//make key refer to entry i, unless an earlier entry already has that key
+void
+AddressTranslator::index_entry(EntryTable &table, const EntryKey &key, int i)
+{
+  EntryTable::iterator it = table.find_insert(key);
+  if (it.value() < 0)
+    it.value() = i;
+}
+
+//return the index in _v of the first static or bound dynamic entry that matches, or -1
+int
+AddressTranslator::find_entry(IP6Address &iai, unsigned short ipi, IP6Address &mai, unsigned short mpi, bool lookup_direction) const
+{
+  //static entries come before the dynamic ones in _v, so they take precedence
+  if (_number_of_smap > 0)
+    {
+      int i;
+      if (lookup_direction == _dynamic_mapping_allocation_direction)
+	i = _static_inner.get(EntryKey(iai, _static_mapping[1] ? ipi : 0));
+      else
+	i = _static_mapped.get(EntryKey(mai, _static_mapping[1] ? mpi : 0));
+      if (i >= 0)
+	return i;
+    }
+
+  if (lookup_direction == 0) //outward, check if the inner address matches
+    return _binding_inner.get(EntryKey(iai, 0));
+  else //inward, check if the map address matches
+    return _binding_mapped.get(EntryKey(mai, 0));
 }
 
 int
 AddressTranslator::configure(Vector<String> &conf, ErrorHandler *errh)
 {
   _v.clear();
+  _static_inner.clear();
+  _static_mapped.clear();
+  _binding_inner.clear();
+  _binding_mapped.clear();
+  _free_head = _free_tail = -1;
+  _nfree = 0;
   int s = 0;
   IP6Address ia, ma, ea;
   int ip, mp, ep = 0;
@@ -219,6 +274,8 @@ AddressTranslator::configure(Vector<String> &conf, ErrorHandler *errh)
     {
 
       s = _number_of_smap+2;
+      _static_inner.rehash(_number_of_smap);
+      _static_mapped.rehash(_number_of_smap);
       if (!BoolArg().parse(conf[1], _static_portmapping))
 	errh->error("argument %d should be : bool", 2);
 
@@ -314,63 +371,39 @@ AddressTranslator::lookup(IP6Address &iai, unsigned short &ipi, IP6Address &mai,
   if (( _number_of_smap >0 ) || (!_dynamic_portmapping))
     {
       //find the mapped entry in the table
-      for (int i=0; i<_v.size(); i++)
+      int i = find_entry(iai, ipi, mai, mpi, lookup_direction);
+      if (i >= 0 && _v[i]._static) //this is a static mapping entry
 	{
-	  bool match = true;
-	  if (_v[i]._static) //this is a static mapping entry
+	  if (_static_mapping[2] && (lookup_direction == _dynamic_mapping_allocation_direction))
+	    mai = _v[i]._mai;
+	  else if (_static_mapping[2] && (lookup_direction != _dynamic_mapping_allocation_direction))
+	    iai = _v[i]._iai;
+	  else if (lookup_direction == _dynamic_mapping_allocation_direction)
+	    mai = iai;
+	  else if (lookup_direction != _dynamic_mapping_allocation_direction)
+	    iai = _v[i]._iai;
+
+	  if (_static_mapping[3])
+	    mpi = _v[i]._mpi;
+	  else if (lookup_direction == _dynamic_mapping_allocation_direction)
+	    mpi = ipi;
+	  else if (lookup_direction !=_dynamic_mapping_allocation_direction)
+	    ipi = mpi;
+	  return (true);
+	}
+      else if (i >= 0) //this is a dynamic binding entry
+	{
+	  if (lookup_direction==0) //outward packet
 	    {
-
-	      if (_static_mapping[0]  && (lookup_direction ==_dynamic_mapping_allocation_direction))
-		match =  match && (_v[i]._iai == iai);
-	      if (_static_mapping[1]  && (lookup_direction ==_dynamic_mapping_allocation_direction))
-		match =  match && (_v[i]._ipi == ipi);
-	      if (_static_mapping[0] && (lookup_direction != _dynamic_mapping_allocation_direction))
-		match =  match && (_v[i]._mai == mai);
-	      if (_static_mapping[1] && (lookup_direction != _dynamic_mapping_allocation_direction))
-		match =  match && (_v[i]._mpi == mpi);
-
-	      if (match)
-		{
-		  if (_static_mapping[2] && (lookup_direction == _dynamic_mapping_allocation_direction))
-		    mai = _v[i]._mai;
-		  else if (_static_mapping[2] && (lookup_direction != _dynamic_mapping_allocation_direction))
-		    iai = _v[i]._iai;
-		  else if (lookup_direction == _dynamic_mapping_allocation_direction)
-		    mai = iai;
-		  else if (lookup_direction != _dynamic_mapping_allocation_direction)
-		    iai = _v[i]._iai;
-
-		  if (_static_mapping[3])
-		    mpi = _v[i]._mpi;
-		  else if (lookup_direction == _dynamic_mapping_allocation_direction)
-		    mpi = ipi;
-		  else if (lookup_direction !=_dynamic_mapping_allocation_direction)
-		    ipi = mpi;
-		  return (true);
-		}
+	      mai = _v[i]._mai;
+	      mpi = ipi;
 	    }
-
-	  else  if (_v[i]._binding) //this is a dynamic bindign entry
+	  else //inward packet
 	    {
-	      if (lookup_direction ==0)
-		match =  (_v[i]._iai == iai);  //outward, check if the inner address matches
-	      else
-		match = (_v[i]._mai == mai); //inward, check if the map address matches
-	      if (match)
-		{
-		  if (lookup_direction==0) //outward packet
-		    {
-		      mai = _v[i]._mai;
-		      mpi = ipi;
-		    }
-		  else //inward packet
-		    {
-		      iai = _v[i]._iai;
-		      ipi = mpi;
-		    }
-		   return (true);
-		}
+	      iai = _v[i]._iai;
+	      ipi = mpi;
 	    }
+	  return (true);
 	}
 
       //no match found
@@ -379,33 +412,34 @@ AddressTranslator::lookup(IP6Address &iai, unsigned short &ipi, IP6Address &mai,
       if (_dynamic_mapping_allocation_direction != lookup_direction)
 	return false;
 
-      if (!_dynamic_portmapping) // dynamic address mapping only, try to allocate an address
+      if (!_dynamic_portmapping && _free_head >= 0) // dynamic address mapping only, allocate the first free address
 	{
+	  i = _free_head;
+	  _free_head = _v[i]._free_next;
+	  if (_free_head < 0)
+	    _free_tail = -1;
+	  _nfree--;
 
-	  for (int i=0; i<_v.size(); i++) {
-	    if ((_v[i]._binding == false ) && ((!_v[i]._static)))
-	      {
-		if (lookup_direction == 0) //outward packet
-		  {
-		    _v[i]._iai = iai;
-		    mai = _v[i]._mai;
-		    mpi = ipi;
-		  }
-		else  //inward packet
-		  {
-		    _v[i]._mai = mai;
-		    iai = _v[i]._iai;
-		    ipi = mpi;
-		  }
-
-		_v[i]._binding = true;
-		//_v[i]._t = time(NULL);
-		//_v[i]._t = MyEWMA2::now();
-
-		return (true);
-	      }
-
-	  }
+	  if (lookup_direction == 0) //outward packet
+	    {
+	      _v[i]._iai = iai;
+	      mai = _v[i]._mai;
+	      mpi = ipi;
+	    }
+	  else  //inward packet
+	    {
+	      _v[i]._mai = mai;
+	      iai = _v[i]._iai;
+	      ipi = mpi;
+	    }
+	  _v[i]._binding = true;
+	  _v[i]._free_next = -1;
+	  index_entry(_binding_inner, EntryKey(_v[i]._iai, 0), i);
+	  index_entry(_binding_mapped, EntryKey(_v[i]._mai, 0), i);
+	  //_v[i]._t = time(NULL);
+	  //_v[i]._t = MyEWMA2::now();
+
+	  return (true);
 	}
       return false;
     }
@@ -781,5 +815,48 @@ click_ip6 *ip6 = (click_ip6 *)p->data();
     }
 }
 
+String
+AddressTranslator::table_stats(const EntryTable &table)
+{
+  //the entries of a bucket are found after 1, 2, ... probes
+  Vector<int> probes;
+  for (EntryTable::size_type b = 0; b < table.bucket_count(); b++)
+    for (EntryTable::size_type n = table.bucket_size(b); n > 0; n--)
+      {
+	if (probes.size() < (int) n + 1)
+	  probes.resize(n + 1, 0);
+	probes[n]++;
+      }
+
+  StringAccum sa;
+  sa << table.size() << " entries, " << table.bucket_count() << " buckets, probe lengths";
+  if (probes.size() == 0)
+    sa << " -";
+  for (int i = 1; i < probes.size(); i++)
+    if (probes[i])
+      sa << ' ' << i << ':' << probes[i];
+  return sa.take_string();
+}
+
+String
+AddressTranslator::read_handler(Element *e, void *)
+{
+  AddressTranslator *at = static_cast<AddressTranslator *>(e);
+  StringAccum sa;
+  sa << "static inner: " << table_stats(at->_static_inner) << '\n'
+     << "static mapped: " << table_stats(at->_static_mapped) << '\n'
+     << "binding inner: " << table_stats(at->_binding_inner) << '\n'
+     << "binding mapped: " << table_stats(at->_binding_mapped) << '\n'
+     << "free addresses: " << at->_nfree << '\n'
+     << "port mappings: " << at->_out_map.size() << '\n';
+  return sa.take_string();
+}
+
+void
+AddressTranslator::add_handlers()
+{
+  add_read_handler("table_stats", read_handler, 0);
+}
+
 EXPORT_ELEMENT(AddressTranslator)
 CLICK_ENDDECLS
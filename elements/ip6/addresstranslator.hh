@@ -5,6 +5,7 @@
 #include <click/vector.hh>
 #include <click/element.hh>
 #include <click/bighashmap.hh>
+#include <click/hashtable.hh>
 #include <click/ip6flowid.hh>
 CLICK_DECLS
 
@@ -61,7 +62,17 @@ CLICK_DECLS
  * If there is,  use the mapped flowID of that entry for the packet.  Otherwise, it will try to
  * find an unsed port and create a mapped flowID for the flow and insert the entry, if the packet
  * comes from the right direction.
-
+ *
+ * Static entries and bound dynamic-address entries are indexed by hash tables
+ * keyed on (inner address, inner port) and (mapped address, mapped port), and
+ * unbound dynamic addresses are kept on a free list, so neither lookups nor
+ * address allocation depend on the number of entries.
+ *
+ * =h table_stats read-only
+ * Returns the occupancy of the static and dynamic-address entry tables,
+ * together with a histogram of the number of probes needed to find each
+ * entry (e.g. "1:40 2:3" means 40 entries are found on the first probe
+ * and 3 on the second).
  *
  * =a ProtocolTranslator64, ProtocolTranslator46 */
 
@@ -85,6 +96,7 @@ class AddressTranslator : public Element {
 
   bool lookup(IP6Address &, unsigned short &, IP6Address &, unsigned short &, IP6Address &, unsigned short &, bool);
   void cleanup(CleanupStage) CLICK_COLD;
+  void add_handlers() CLICK_COLD;
 
 protected:
 
@@ -102,9 +114,35 @@ protected:
    //unsigned char _state;
     bool _binding;
     bool _static;
+    int _free_next; //the next unbound dynamic entry on the free list, or -1
 };
   Vector<EntryMap> _v;
 
+  //an (address, port) pair; the port is 0 when ports are not mapped
+  struct EntryKey {
+    IP6Address _addr;
+    unsigned short _port;
+    EntryKey() : _port(0) { }
+    EntryKey(const IP6Address &addr, unsigned short port) : _addr(addr), _port(port) { }
+    hashcode_t hashcode() const { return _addr.hashcode() ^ _port; }
+    bool operator==(const EntryKey &x) const { return _port == x._port && _addr == x._addr; }
+  };
+  //maps a key to the index in _v of the first entry with that key, or -1
+  typedef HashTable<EntryKey, int> EntryTable;
+
+  EntryTable _static_inner;   //static entries by (_iai, _ipi)
+  EntryTable _static_mapped;  //static entries by (_mai, _mpi)
+  EntryTable _binding_inner;  //bound dynamic entries by _iai
+  EntryTable _binding_mapped; //bound dynamic entries by _mai
+  int _free_head;             //the first unbound dynamic entry, or -1
+  int _free_tail;
+  int _nfree;
+
+  static void index_entry(EntryTable &, const EntryKey &, int);
+  int find_entry(IP6Address &, unsigned short, IP6Address &, unsigned short, bool) const;
+  static String table_stats(const EntryTable &);
+  static String read_handler(Element *, void *) CLICK_COLD;
+
 
   int _number_of_smap; // number of static-mapping entry
   bool _static_portmapping;
@@ -24,17 +24,24 @@
 #include <click/glue.hh>
 #include <click/args.hh>
 #include <click/error.hh>
+#include <click/straccum.hh>
 #include <click/standard/alignmentinfo.hh>
 CLICK_DECLS
 
+const char * const CheckIP6Header::reason_texts[NREASONS] = {
+  "tiny packet", "bad IP6 length", "bad IP6 version", "bad source address",
+  "bad extension header"
+};
+
 CheckIP6Header::CheckIP6Header()
-  : _bad_src(0), _drops(0)
 {
+  _drops = 0;
+  for (int i = 0; i < NREASONS; i++)
+    _reason_drops[i] = 0;
 }
 
 CheckIP6Header::~CheckIP6Header()
 {
-  delete[] _bad_src;
 }
 
 int
@@ -42,56 +49,64 @@ CheckIP6Header::configure(Vector<String> &conf, ErrorHandler *errh)
 {
  String badaddrs = String::make_empty();
  _offset = 0;
- Vector<String> ips;
- // ips.push_back("0::0"); // this address is only bad if we are a router
- ips.push_back("ffff:ffff:ffff:ffff:ffff:ffff:ffff:ffff"); // bad IP6 address
 
  if (Args(conf, this, errh)
-     .read_p("BADADDRS", badaddrs)
+     .read_p("BADADDRS", AnyArg(), badaddrs)
      .read_p("OFFSET", _offset)
      .complete() < 0)
     return -1;
 
-  if (badaddrs) {
-    Vector<String> words;
-    cp_spacevec(badaddrs, words);
-    IP6Address a;
-    for (int j = 0; j < words.size(); j++) {
-      if (!cp_ip6_address(words[j], (unsigned char *)&a)) {
-        return errh->error("expects IP6ADDRESS -a ");
-      }
-      for (int j = 0; j < ips.size(); j++) {
-	    IP6Address b = IP6Address(ips[j]);
-	    if (b == a)
-	      goto repeat;
-      }
-      ips.push_back(a.s());
-      repeat: ;
-    }
-  }
-
-  _n_bad_src = ips.size();
-  _bad_src = new IP6Address [_n_bad_src];
-
-  for (int i = 0; i<_n_bad_src; i++) {
-    _bad_src[i]= IP6Address(ips[i]);
+  _bad_src.clear();
+  // _bad_src.add(IP6Address(), IP6Address::make_prefix(128), IP6Address(), 0); // this address is only bad if we are a router
+  _bad_src.add(IP6Address("ffff:ffff:ffff:ffff:ffff:ffff:ffff:ffff"), IP6Address::make_prefix(128), IP6Address(), 0); // bad IP6 address
+
+  Vector<String> words;
+  cp_spacevec(badaddrs, words);
+  for (int j = 0; j < words.size(); j++) {
+    IP6Address a, mask;
+    if (!IP6PrefixArg(true).parse(words[j], a, mask, this))
+      return errh->error("BADADDRS expects IP6 addresses or prefixes, not %<%s%>", words[j].c_str());
+    if (_bad_src.add(a, mask, IP6Address(), 0) < 0)
+      return errh->error("BADADDRS mask %s is not a prefix", mask.unparse().c_str());
   }
 
   return 0;
 }
 
-void
-CheckIP6Header::drop_it(Packet *p)
+Packet *
+CheckIP6Header::drop(Reason reason, Packet *p)
 {
   if (_drops == 0)
-    click_chatter("IP6 header check failed");
+    click_chatter("%s: IP6 header check failed: %s", name().c_str(), reason_texts[reason]);
   _drops++;
-  
+  _reason_drops[reason]++;
+
   if (noutputs() == 2) {
     output(1).push(p);
   }else  {
     p->kill();
   }
+  return 0;
+}
+
+void
+CheckIP6Header::push_batch(int, PacketBatch *batch)
+{
+  PacketBatch good;
+  while (Packet *p = batch->pop_front())
+    if ((p = CheckIP6Header::simple_action(p)))
+      good.append(p);
+  output(0).push_batch(&good);
+}
+
+void
+CheckIP6Header::pull_batch(int, PacketBatch *batch, unsigned max)
+{
+  PacketBatch pulled;
+  input(0).pull_batch(&pulled, max);
+  while (Packet *p = pulled.pop_front())
+    if ((p = CheckIP6Header::simple_action(p)))
+      batch->append(p);
 }
 
 Packet *
@@ -100,21 +115,22 @@ CheckIP6Header::simple_action(Packet *p)
   const click_ip6 *ip = reinterpret_cast <const click_ip6 *>( p->data() + _offset);
   unsigned plen = p->length() - _offset;
   unsigned remaining_packet_length = p->length() - _offset;
-  class IP6Address src;
+  IP6Address gw;
+  int index;
 
   // check if the packet is smaller than ip6 header
   // cast to int so very large plen is interpreted as negative
   if((int)plen < (int)sizeof(click_ip6))
-    goto bad;
+    return drop(MINISCULE_PACKET, p);
     
     
    // check if the PayloadLength field is valid
    if(ntohs(ip->ip6_plen) > (plen-40))
-     goto bad;
+     return drop(BAD_IP6_LEN, p);
 
   // check version
   if(ip->ip6_v != 6)
-    goto bad;
+    return drop(BAD_VERSION, p);
 
 
 
@@ -123,11 +139,8 @@ CheckIP6Header::simple_action(Packet *p)
    * Configuration string should have listed all subnet
    * broadcast addresses known to this router.
    */
-   src=ip->ip6_src;
-   for(int i = 0; i < _n_bad_src; i++) {
-     if(src == _bad_src[i])
-       goto bad;
-   }
+   if (_bad_src.lookup(IP6Address(ip->ip6_src), gw, index))
+     return drop(BAD_SADDR, p);
 
   /*
    * discard illegal destinations.
@@ -155,20 +168,17 @@ CheckIP6Header::simple_action(Packet *p)
        goto bad; // bad drops the original packet
      }
    } catch (Packet *error_packet) {
-     output(1).push(p); // we came across an error that also outputs an icmpv6 error message
+     if (error_packet) // we came across an error that also outputs an icmpv6 error message
+       checked_output_push(1, error_packet);
      goto bad; // bad drops the original packet
    }
 
   
   p->set_ip6_header(ip);
-
-  output(0).push(p);
-  return 0;
+  return p;
 
  bad:
-  drop_it(p);
-  return 0;
-  
+  return drop(BAD_EXTENSION_HEADER, p);
 }
 
 
@@ -258,17 +268,29 @@ CheckIP6Header::check_fragment(click_ip6_fragment *fragment_header, unsigned rem
   throw false;
 }
 
-static String
-CheckIP6Header_read_drops(Element *xf, void *)
+String
+CheckIP6Header::read_handler(Element *e, void *thunk)
 {
-  CheckIP6Header *f = (CheckIP6Header *)xf;
-  return String(f->drops());
+  CheckIP6Header *c = reinterpret_cast<CheckIP6Header *>(e);
+  switch (reinterpret_cast<uintptr_t>(thunk)) {
+  case 0:
+    return String(c->drops());
+  case 1: {
+    StringAccum sa;
+    for (int i = 0; i < NREASONS; i++)
+      sa << c->_reason_drops[i] << '\t' << reason_texts[i] << '\n';
+    return sa.take_string();
+  }
+  default:
+    return String();
+  }
 }
 
 void
 CheckIP6Header::add_handlers()
 {
-  add_read_handler("drops", CheckIP6Header_read_drops);
+  add_read_handler("drops", read_handler, 0);
+  add_read_handler("drops_by_reason", read_handler, 1);
 }
 
 /* private functions */
@@ -333,4 +355,5 @@ CheckIP6Header::create_parameter_problem_message(uint8_t* packet_content, uint8_
 }
 
 CLICK_ENDDECLS
+ELEMENT_REQUIRES(ip6)
 EXPORT_ELEMENT(CheckIP6Header)
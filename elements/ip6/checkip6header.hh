@@ -2,6 +2,8 @@
 #define CLICK_CHECKIP6HEADER_HH
 #include <click/element.hh>
 #include <click/glue.hh>
+#include <click/atomic.hh>
+#include <click/ip6table.hh>
 #include <clicknet/ip6.h>
 CLICK_DECLS
 
@@ -18,7 +20,8 @@ CLICK_DECLS
  * IP6 source address is a legal unicast address. Shortens packets to the IP6
  * length, if the IP length is shorter than the nominal packet length (due to
  * Ethernet padding, for example). Pushes invalid packets out on output 1,
- * unless output 1 was unused; if so, drops invalid packets.
+ * unless output 1 was unused; if so, drops invalid packets. The valid packets
+ * of a batch are passed on together as one batch.
  *
  * Keyword arguments are:
  *
@@ -26,9 +29,12 @@ CLICK_DECLS
  *
  * =item BADADDRS
  *
- * The BADADDRS argument is a space-separated list of IP6 addresses that are
- * not to be tolerated as source addresses. 0::0 is a bad address for routers,
- * for example, but okay for link local packets.
+ * The BADADDRS argument is a space-separated list of IP6 addresses and
+ * prefixes that are not to be tolerated as source addresses. 0::0 is a bad
+ * address for routers, for example, but okay for link local packets; bogon
+ * and documentation prefixes, such as 2001:db8::/32, are other candidates.
+ * The list is compiled into a prefix trie, so checking a source address costs
+ * the same whatever the length of the list.
  *
  * =item OFFSET
  *
@@ -36,18 +42,35 @@ CLICK_DECLS
  *
  * =back
  *
+ * =h drops read-only
+ * Returns the number of incorrect packets CheckIP6Header has seen.
+ *
+ * =h drops_by_reason read-only
+ * Returns a text file showing how many erroneous packets CheckIP6Header has
+ * seen, subdivided by error.
+ *
  * =a MarkIP6Header */
 
 class CheckIP6Header : public Element {
 
   int _offset;
 
-  int _n_bad_src;
-  IP6Address *_bad_src; // array of illegal IP6 src addresses.
+  IP6Table _bad_src; // illegal IP6 src prefixes
 #ifdef CLICK_LINUXMODULE
   bool _aligned;
 #endif
-  int _drops;
+  atomic_uint32_t _drops;
+
+  enum Reason {
+    MINISCULE_PACKET,
+    BAD_IP6_LEN,
+    BAD_VERSION,
+    BAD_SADDR,
+    BAD_EXTENSION_HEADER,
+    NREASONS
+  };
+  atomic_uint32_t _reason_drops[NREASONS];
+  static const char * const reason_texts[NREASONS];
 
  public:
 
@@ -60,15 +83,18 @@ class CheckIP6Header : public Element {
 
   int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
 
-  int drops() const				{ return _drops; }
+  uint32_t drops() const			{ return _drops; }
 
 
   void add_handlers() CLICK_COLD;
 
   Packet *simple_action(Packet *);
-  void drop_it(Packet *);
+  void push_batch(int, PacketBatch *);
+  void pull_batch(int, PacketBatch *, unsigned);
 
  private:
+   Packet *drop(Reason reason, Packet *p);
+   static String read_handler(Element *, void *) CLICK_COLD;
    void check_hbh(click_ip6_hbh *hbh_header, unsigned remaining_packet_length);
    void check_dest(click_ip6_dest *dest_header, unsigned remaining_packet_length);
    void check_rthdr(click_ip6_rthdr *rthdr_header, unsigned remaining_packet_length);
@@ -19,6 +19,7 @@
 #include "fragmentationencap.hh"
 #include <click/args.hh>
 #include <click/error.hh>
+#include <click/packet_anno.hh>
 #include <clicknet/ip6.h>
 CLICK_DECLS
 
@@ -80,6 +81,7 @@ FragmentationEncap::simple_action(Packet *p_in)
     fragmentation_header->ip6_frag_reserved = 0;
     fragmentation_header->ip6_frag_offset = _offset;
     fragmentation_header->ip6_frag_id = _identification;
+    SET_IP6_EXTHDR_FLAGS_ANNO(p, 0);	// the extension header chain changed
     return p;
 }
 
@@ -136,6 +136,8 @@ ICMP6Error::simple_action(Packet *p)
   click_ip6 *nip;
   click_icmp6 *icp;
   unsigned xlen;
+  unsigned char *icp_data;
+  uint32_t csum;
 
 
   if (!p->has_network_header())
@@ -202,15 +204,17 @@ ICMP6Error::simple_action(Packet *p)
     //temporarily use the same as the ICMP parameter pointer, will be dealt later
   }
 
+  // copy the offending packet and checksum it in one pass
   if (_type == ICMP6_REDIRECT && _code == 0) {
     click_icmp6_redirect *icpr = (click_icmp6_redirect *) (nip + 1);
     icpr->icmp6_target = DST_IP6_ANNO(p);
     icpr->icmp6_dst = ipp->ip6_dst;
-    memcpy((void *)(icpr + 1), p->data(), xlen);
+    icp_data = (unsigned char *) (icpr + 1);
   } else
-    memcpy((void *)(icp + 1), p->data(), xlen);
-
-  icp->icmp6_cksum = htons(in6_fast_cksum(&nip->ip6_src, &nip->ip6_dst, nip->ip6_plen, nip->ip6_nxt, 0, (unsigned char *)icp, nip->ip6_plen));
+    icp_data = (unsigned char *) (icp + 1);
+  csum = click_in_cksum_copy_partial(icp_data, p->data(), xlen, 0);
+  csum = click_in_cksum_partial((unsigned char *) icp, icp_data - (unsigned char *) icp, csum);
+  icp->icmp6_cksum = click_in6_cksum_pseudohdr(click_in_cksum_fold(csum), &nip->ip6_src, &nip->ip6_dst, nip->ip6_nxt, ntohs(nip->ip6_plen));
 
   SET_DST_IP6_ANNO(q, IP6Address(nip->ip6_dst));
   SET_FIX_IP_SRC_ANNO(q, 1); // fix_ip_src: shared flag with IPv4
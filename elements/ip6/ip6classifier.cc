@@ -22,13 +22,16 @@
 #include <click/glue.hh>
 #include <click/error.hh>
 #include <click/args.hh>
+#include <click/straccum.hh>
 #include "ip6classifier_lexer.hh"
 #include "ip6classifier_parser.hh"
-#include <fstream>
 
 CLICK_DECLS
 
-IP6Classifier::IP6Classifier() {}
+IP6Classifier::IP6Classifier()
+    : _thread_hits(0), _hits_stride(0), _nthreads(0)
+{
+}
 
 IP6Classifier::~IP6Classifier() {}
 
@@ -37,39 +40,102 @@ IP6Classifier::~IP6Classifier() {}
 // In short: a) Take each pattern an divide it up into tokens
 //           b) Pass the tokens to a Parser
 //           c) The parser returns an Abstract Syntax Tree for each pattern
-//           d) Use this Abstract Syntax Tree to match against packets in the push method
+//           d) Lower the Abstract Syntax Trees into a decision program, which is used to match packets in the push method
 //
 
 int
 IP6Classifier::configure(Vector<String> &conf, ErrorHandler *errh)
 {
-    ErrorHandler *errh2 = ErrorHandler::default_handler();
+    Vector<ip6classification::AST> ast_list;    // a list of ASTs (abstract syntax trees); there is 1 AST per pattern passed by an end-user.
+    bool failed = false;
 
     // Make an Abstract Syntax Tree for each output
     for (int i = 0; i < conf.size(); i++) {
+        PrefixErrorHandler cerrh(errh, "pattern " + String(i) + ": ");
         ip6classification::Lexer lexer(conf[i]);
         Vector<ip6classification::Token*> tokens;
-        int success = lexer.lex(tokens, errh2);
+        int success = lexer.lex(tokens, &cerrh);
         if (success >= 0) {
-// USE BELOW FOR DEBUGGING TOKENS
-//            click_chatter("The tokens in the list are: ");
-//            for (int i = 0; i < tokens.size(); i++) {
-//                tokens[i]->print_name();
-//            }
             ip6classification::Parser parser(tokens);
             ip6classification::AST ast; // an abstract syntax tree
-            success = parser.parse(ast, errh2);
+            success = parser.parse(ast, &cerrh);
             
             if (success >= 0) {
-// USE BELOW FOR DEBUGGING ALREADY COMBINED TOKENS
-                ast.print();
                 ast_list.push_back(ast);    // add this AST to the list of ASTs
             }
         }
+        if (success < 0) {
+            failed = true;  // the outputs would no longer line up with the patterns
+        }
+    }
+    if (failed) {
+        return -1;
     }
+
+    _rules.compile(ast_list);
+    _patterns = conf;
+    return 0;
+}
+
+int
+IP6Classifier::initialize(ErrorHandler *)
+{
+    int per_line = CLICK_CACHE_LINE_SIZE / sizeof(uint64_t);
+    _hits_stride = (_patterns.size() + 1 + per_line - 1) / per_line * per_line;
+    _nthreads = click_max_cpu_ids() ? click_max_cpu_ids() : 1;
+    // one more line than needed, to align the first thread's counts
+    _hits.assign(_nthreads * _hits_stride + per_line, 0);
+    uintptr_t misalignment = reinterpret_cast<uintptr_t>(_hits.begin()) % CLICK_CACHE_LINE_SIZE;
+    _thread_hits = _hits.begin() + (misalignment ? (CLICK_CACHE_LINE_SIZE - misalignment) / sizeof(uint64_t) : 0);
     return 0;
 }
 
+inline uint64_t *
+IP6Classifier::thread_hits()
+{
+    return _thread_hits + _hits_stride * click_current_cpu_id();
+}
+
+uint64_t
+IP6Classifier::hits(int i) const
+{
+    uint64_t n = 0;
+    for (int t = 0; t < _nthreads; t++)
+        n += _thread_hits[t * _hits_stride + i];
+    return n;
+}
+
+String
+IP6Classifier::read_handler(Element *element, void *thunk)
+{
+    IP6Classifier *classifier = static_cast<IP6Classifier *>(element);
+    switch (reinterpret_cast<uintptr_t>(thunk)) {
+    case h_program:
+        return classifier->_rules.unparse();
+    case h_hits: {
+        StringAccum sa;
+        for (int i = 0; i < classifier->_patterns.size(); i++)
+            sa << classifier->hits(i) << '\t' << classifier->_patterns[i] << '\n';
+        sa << classifier->hits(classifier->_patterns.size()) << "\tunmatched\n";
+        return sa.take_string();
+    }
+    case h_drops:
+        if (classifier->noutputs() > classifier->_patterns.size())
+            return String(0);
+        return String(classifier->hits(classifier->_patterns.size()));
+    default:
+        return String();
+    }
+}
+
+void
+IP6Classifier::add_handlers()
+{
+    add_read_handler("program", read_handler, h_program);
+    add_read_handler("hits", read_handler, h_hits);
+    add_read_handler("drops", read_handler, h_drops);
+}
+
 //
 // RUNNING
 // Here we do what was above described in d).
@@ -78,14 +144,35 @@ IP6Classifier::configure(Vector<String> &conf, ErrorHandler *errh)
 void
 IP6Classifier::push(int, Packet *p)
 {
-    for (int i = 0; i < ast_list.size(); i++) {     // for each AST (abstract syntax tree) of the abstract syntax list do
-        const bool matches = ast_list[i].check_whether_packet_matches(p);
-        if (matches) {
-            output(i).push(p);
-            return;
+    int port = _rules.match(p);
+    if (port < 0) {
+        port = _patterns.size();
+    }
+    thread_hits()[port]++;
+    checked_output_push(port, p);
+}
+
+void
+IP6Classifier::push_batch(int, PacketBatch *batch)
+{
+    uint64_t *hits = thread_hits();
+    PacketBatch run;
+    int run_port = -1;
+    while (Packet *p = batch->pop_front()) {
+        int port = _rules.match(p);
+        if (port < 0) {
+            port = _patterns.size();
+        }
+        hits[port]++;
+        if (port != run_port) {
+            checked_output_push_batch(run_port, &run);
         }
+        run_port = port;
+        run.append(p);
     }
+    checked_output_push_batch(run_port, &run);
 }
 
 CLICK_ENDDECLS
+ELEMENT_REQUIRES(IP6Wordwise)
 EXPORT_ELEMENT(IP6Classifier)
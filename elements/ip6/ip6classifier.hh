@@ -4,6 +4,7 @@
 #include <click/element.hh>
 #include <click/vector.hh>
 #include "ip6classifier_AST.hh"
+#include "ip6wordwise.hh"
 #include <click/timestamp.hh>
 
 CLICK_DECLS
@@ -126,6 +127,13 @@ is specified, '==' is assumed.  An example: 'src host == 10.0.0.10' matches
 packets whose source host is 10.0.0.10; 'src host != 10.0.0.10' matches packets 
 whose source host I<is not> 10.0.0.10.
 
+Packets that match no pattern are emitted on the output following the last
+pattern's, if IP6Classifier has one; otherwise they are dropped. A last
+pattern of B<-> also catches every packet.
+
+A batch of packets is pushed on as runs of consecutive packets bound for the
+same output, so packets leave in the order they arrived.
+
 =e
 
   classifier :: IP6Classifier(src host fa80::0202:b3ff:fe1e:8329 or hlim 20, dst host fa80::0202:b3ff:fe1e:8330 and frag)
@@ -133,10 +141,26 @@ whose source host I<is not> 10.0.0.10.
   [1] classifier -> Print(matches the second pattern) -> Discard;
   
 =h program read-only
-Returns a human-readable definition of the program the IPFilter element
-is using to classify packets. At each step in the program, four bytes
-of packet data are ANDed with a mask and compared against four bytes of
-classifier pattern.
+Returns a human-readable definition of the program the IP6Classifier element
+is using to classify packets. The patterns are compiled into the same kind of
+decision program IPFilter uses: at each step, four bytes of packet data are
+ANDed with a mask and compared against four bytes of classifier pattern.
+Tests shared by several patterns are done only once. Patterns containing
+primitives that cannot be compiled this way (B<ip6 frag>, B<ip6 unfrag>,
+B<tcp opt>, B<tcp win>, ordered comparisons of addresses) are listed as
+being matched by walking their syntax tree. Programs that test ports or ICMP
+types read the packet's transport header pointer, so they are only run on
+packets that went through MarkIP6Transport or have no extension headers; the
+patterns are matched by walking their syntax trees for other packets.
+
+=h hits read-only
+Returns, for each pattern, the number of packets that matched it, followed by
+the number of packets that matched no pattern. Each line has the count, a tab,
+and the pattern. Packets are counted per thread, without atomic operations;
+the counts are summed when the handler is read.
+
+=h drops read-only
+Returns the number of packets that matched no pattern and were dropped.
 
 =a
 
@@ -153,11 +177,30 @@ public:
     const char *processing() const		{ return PUSH; }
 
     int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
+    int initialize(ErrorHandler *) CLICK_COLD;
+    void add_handlers() CLICK_COLD;
     
     void push(int, Packet *packet);
+    void push_batch(int, PacketBatch *batch);
 
 private:
-    Vector<ip6classification::AST> ast_list; // a list of ASTs (abstract syntax trees); there is 1 AST per pattern passed by an end-user.
+    ip6::CompiledRules<ip6classification::AST> _rules;  // the ASTs (abstract syntax trees), 1 per pattern, lowered into decision programs
+    Vector<String> _patterns;
+
+    // per-thread hit counts: thread t's count for pattern i is
+    // _thread_hits[t * _hits_stride + i]; index _patterns.size() counts
+    // unmatched packets. Each thread's counts start on their own cache line
+    // of _hits.
+    Vector<uint64_t> _hits;
+    uint64_t *_thread_hits;
+    int _hits_stride;
+    int _nthreads;
+
+    inline uint64_t *thread_hits();
+    uint64_t hits(int i) const;
+
+    enum { h_program, h_hits, h_drops };
+    static String read_handler(Element *, void *) CLICK_COLD;
 };
 
 CLICK_ENDDECLS
@@ -150,6 +150,7 @@ Lexer::lex(Vector<Token*>& tokens, ErrorHandler *errh) {      // to_be_lexed_str
     int i = 0;
     bool just_seen_a_not_keyword = false;  // we use this variable to keep track of a possible not keyword seen (e.g. as in not host 12.5.91.1).
     while (true) {
+        an_operator = EQUALITY; // each primitive starts out without an operator; net primitives never read one
         try {        
             i = skip_blanks(i); // skip the potential blanks at the start and go to the first non blank position
             if (i == -1) {      // end of line was seen after a series of blanks
@@ -403,7 +404,6 @@ Lexer::lex(Vector<Token*>& tokens, ErrorHandler *errh) {      // to_be_lexed_str
                 Token *token;
                 if (is_word_an_operator(current_word, an_operator) >= 0) {
                     skip_blanks_and_read_word(i, current_word, "operator was only followed by blanks, an operator must be followed by data");
-                    i = read_word(i, current_word);
                     token = PortFactory::create_token(current_word, just_seen_a_not_keyword, an_operator);
                 } else {    // no operator was given, equality is assumed and the current word already contains the data
                     token = PortFactory::create_token(current_word, just_seen_a_not_keyword, EQUALITY);
@@ -486,7 +486,11 @@ Lexer::lex(Vector<Token*>& tokens, ErrorHandler *errh) {      // to_be_lexed_str
                     } else {    // no operator was given, equality is assumed and the current word already contains the data
                         token = ICMPTypeFactory::create_token(current_word, just_seen_a_not_keyword, EQUALITY);
                     }
+                } else {
+                    errh->error("unkown keyword '%s' followed icmp, it should be type", current_word.c_str()); return -1;
                 }
+                tokens.push_back(token);
+                just_seen_a_not_keyword = false;
             } else if (current_word == "ip6") {
                 skip_blanks_and_read_word(i, current_word, "no second keyword after ip6; ip6 should be followed by vers, plen, flow, nxt, dscp, ecn, ce, hlim, frag, unfrag.");
                 Token *token;
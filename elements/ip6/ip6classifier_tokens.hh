@@ -6,6 +6,7 @@
 #include <clicknet/ip6.h>
 #include <clicknet/ether.h>
 #include "ip6classifier_AST.hh"
+#include "ip6wordwise.hh"
 #include "ip6classifier_operator.hh"
 CLICK_DECLS
 
@@ -59,6 +60,15 @@ public:
     virtual bool check_whether_packet_matches(Packet *packet) {
         return left_child->check_whether_packet_matches(packet) && right_child->check_whether_packet_matches(packet);
     }
+    virtual bool can_compile() {
+        return left_child->can_compile() && right_child->can_compile();
+    }
+    virtual void compile(Classification::Wordwise::Program &program, Vector<int> &tree) {
+        program.start_subtree(tree);
+        left_child->compile(program, tree);
+        right_child->compile(program, tree);
+        program.finish_subtree(tree, Classification::c_and);
+    }
 };
 
 /*
@@ -78,6 +88,15 @@ public:
     virtual bool check_whether_packet_matches(Packet *packet) {
         return left_child->check_whether_packet_matches(packet) || right_child->check_whether_packet_matches(packet);
     }
+    virtual bool can_compile() {
+        return left_child->can_compile() && right_child->can_compile();
+    }
+    virtual void compile(Classification::Wordwise::Program &program, Vector<int> &tree) {
+        program.start_subtree(tree);
+        left_child->compile(program, tree);
+        right_child->compile(program, tree);
+        program.finish_subtree(tree, Classification::c_or);
+    }
 };
 
 /*
@@ -197,6 +216,12 @@ public:
         (void) packet;  // Remove the warning
         return take_inverse_on_not(true);
     }   
+    virtual bool can_compile() {
+        return true;
+    }
+    virtual void compile(Classification::Wordwise::Program &program, Vector<int> &tree) {
+        ip6::add_constant_insn(program, tree, !is_preceded_by_not_keyword);
+    }
 };
 
 /*
@@ -222,6 +247,12 @@ public:
         (void) packet;  // Remove the warning
         return take_inverse_on_not(false);
     }   
+    virtual bool can_compile() {
+        return true;
+    }
+    virtual void compile(Classification::Wordwise::Program &program, Vector<int> &tree) {
+        ip6::add_constant_insn(program, tree, is_preceded_by_not_keyword);
+    }
 };
 
 class EndOfLineToken : public Token {
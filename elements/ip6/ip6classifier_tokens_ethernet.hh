@@ -3,6 +3,7 @@
 
 #include "ip6classifier_tokens.hh"
 #include "ip6classifier_operator.hh"
+#include <click/etheraddress.hh>
 
 CLICK_DECLS
 
@@ -177,6 +178,17 @@ public:
             return take_inverse_on_not(true);          // they are equal so return true        
         }
     }
+    virtual bool can_compile() {
+        return an_operator == EQUALITY || an_operator == INEQUALITY;    // ordered comparisons of Ethernet addresses are not lowered
+    }
+    virtual void compile(Classification::Wordwise::Program &program, Vector<int> &tree) {
+        program.start_subtree(tree);
+        ip6::add_bytes_insns(program, tree, IPFilter::offset_mac + 8, ether_address, EtherAddress::make_broadcast().data(), 6, false);
+        program.finish_subtree(tree, Classification::c_or);
+        if (is_preceded_by_not_keyword != (an_operator == INEQUALITY)) {
+            program.negate_subtree(tree, true);
+        }
+    }
 private:
     uint8_t	ether_address[6];   // the Ethernet address (= 6 times 1 byte)
 };
@@ -284,6 +296,17 @@ public:
             return take_inverse_on_not(true);          // they are equal so return true        
         }
     }
+    virtual bool can_compile() {
+        return an_operator == EQUALITY || an_operator == INEQUALITY;    // ordered comparisons of Ethernet addresses are not lowered
+    }
+    virtual void compile(Classification::Wordwise::Program &program, Vector<int> &tree) {
+        program.start_subtree(tree);
+        ip6::add_bytes_insns(program, tree, IPFilter::offset_mac + 2, ether_address, EtherAddress::make_broadcast().data(), 6, false);
+        program.finish_subtree(tree, Classification::c_or);
+        if (is_preceded_by_not_keyword != (an_operator == INEQUALITY)) {
+            program.negate_subtree(tree, true);
+        }
+    }
 private:
     uint8_t	ether_address[6];   // the Ethernet address (= 6 times 1 byte)
 };
@@ -21,6 +21,7 @@
 #include <click/confparse.hh>
 #include <click/error.hh>
 #include <click/glue.hh>
+#include <click/packet_anno.hh>
 CLICK_DECLS
 
 IP6Encap::IP6Encap()
@@ -89,6 +90,7 @@ IP6Encap::simple_action(Packet *p_in)
 
     ip6->ip6_plen = htons(p->length() - sizeof(click_ip6));
     p->set_ip6_header(ip6, sizeof(click_ip6));
+    SET_IP6_EXTHDR_FLAGS_ANNO(p, 0);	// they described the inner packet
 
     return p;
 }
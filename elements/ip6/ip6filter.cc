@@ -38,37 +38,49 @@ IP6Filter::~IP6Filter() {}
 int
 IP6Filter::configure(Vector<String> &conf, ErrorHandler *errh)
 {
-    ErrorHandler *errh2 = ErrorHandler::default_handler();
+    Vector<ip6filtering::AST> ast_list; // a list of ASTs (abstract syntax trees)
+    bool failed = false;
 
     // Make an Abstract Syntax Tree for each output
     for (int i = 0; i < conf.size(); i++) {
-        click_chatter("i = %i", i);
+        PrefixErrorHandler cerrh(errh, "pattern " + String(i) + ": ");
         ip6filtering::Lexer lexer(conf[i]);  // or host fe80:0000:0000:0000:0202:b3ff:fe1e:8329
         Vector<ip6filtering::Token*> tokens;
-        int success = lexer.lex(tokens, errh2);
+        int success = lexer.lex(tokens, &cerrh);
         if (success >= 0) {
-            click_chatter("De tokens die in de lijst zaten zijn: ");
-            for (int i = 0; i < tokens.size(); i++) {
-                tokens[i]->print_name();
-            }
-            click_chatter("we hebben success gelijk aan %i , na de lexer", success);
             ip6filtering::Parser parser(tokens);
             ip6filtering::AST ast; // an abstract syntax tree
-            success = parser.parse(ast, errh2);
+            success = parser.parse(ast, &cerrh);
             
-            click_chatter("we hebben success gelijk aan %i , na de parser", success);
             if (success >= 0) {
-                click_chatter("we gaan printen");
-                ast.print();
-                click_chatter("we hebben geprint");
                 ast_list.push_back(ast);    // add this AST to the list of ASTs
             }
         }
-        click_chatter("we zijn aan het einde van de configuration function gekomen");
+        if (success < 0) {
+            failed = true;  // the outputs would no longer line up with the patterns
+        }
+    }
+    if (failed) {
+        return -1;
     }
+
+    _rules.compile(ast_list);
     return 0;
 }
 
+String
+IP6Filter::program_string(Element *element, void *)
+{
+    IP6Filter *filter = static_cast<IP6Filter *>(element);
+    return filter->_rules.unparse();
+}
+
+void
+IP6Filter::add_handlers()
+{
+    add_read_handler("program", program_string);
+}
+
 //
 // RUNNING
 //
@@ -76,17 +88,14 @@ IP6Filter::configure(Vector<String> &conf, ErrorHandler *errh)
 void
 IP6Filter::push(int, Packet *p)
 {
-    click_chatter("push packet");
-    for (int i = 0; i < ast_list.size(); i++) {     // for each AST (abstract syntax tree) of the abstract syntax list do
-        const bool matches = ast_list[i].check_whether_packet_matches(p);
-        if (matches) {
-            click_chatter("it matches"); 
-        } else {
-            click_chatter("it doesn't match");
-        }
+    int port = _rules.match(p);
+    if (port >= 0) {
+        checked_output_push(port, p);
+    } else {
+        p->kill();
     }
 }
 
 CLICK_ENDDECLS
-ELEMENT_REQUIRES(Classification)
+ELEMENT_REQUIRES(Classification IP6Wordwise)
 EXPORT_ELEMENT(IP6Filter)
@@ -4,6 +4,7 @@
 #include <click/element.hh>
 #include <click/vector.hh>
 #include "ip6filterAST.hh"
+#include "ip6wordwise.hh"
 
 CLICK_DECLS
 
@@ -110,10 +111,13 @@ with IPFilter.
            deny all);
 
 =h program read-only
-Returns a human-readable definition of the program the IPFilter element
+Returns a human-readable definition of the program the IP6Filter element
 is using to classify packets. At each step in the program, four bytes
 of packet data are ANDed with a mask and compared against four bytes of
-classifier pattern.
+classifier pattern. Patterns containing primitives that cannot be compiled
+this way are listed as being matched by walking their syntax tree. As in
+IP6Classifier, programs that test ports or ICMP types are only run on packets
+that went through MarkIP6Transport or have no extension headers.
 
 =a
 
@@ -132,12 +136,14 @@ public:
     const char *flags() const			{ return ""; }
 
     int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
+    void add_handlers() CLICK_COLD;
     
     void push(int port, Packet *);
 
 private:
-    Vector<ip6filtering::AST> ast_list; // a list of ASTs (abstract syntax trees)
+    ip6::CompiledRules<ip6filtering::AST> _rules;   // the ASTs (abstract syntax trees), lowered into decision programs
 
+    static String program_string(Element *, void *) CLICK_COLD;
 };
 
 CLICK_ENDDECLS
@@ -3,6 +3,8 @@
 
 #include <click/config.h>
 #include <click/packet.hh>
+#include <click/vector.hh>
+#include "elements/standard/classification.hh"
 CLICK_DECLS
 
 
@@ -30,6 +32,21 @@ public:
         }
     }
     virtual bool check_whether_packet_matches(Packet* packet) = 0;
+    /*
+     * @brief Tells whether this node, and everything below it, can be lowered into a Classification::Wordwise program.
+     * Nodes that cannot be lowered are matched by calling check_whether_packet_matches at run time.
+     */
+    virtual bool can_compile() {
+        return false;
+    }
+    /*
+     * @brief Adds the tests for this node to the given program, as a single subtree.
+     * @pre can_compile() returned true
+     */
+    virtual void compile(Classification::Wordwise::Program &program, Vector<int> &tree) {
+        (void) program;
+        (void) tree;
+    }
     ASTNode* left_child = NULL;     // Initialize the children as NULL pointers
     ASTNode* right_child = NULL;    // Initialize the children as NULL pointers
 };
@@ -59,6 +76,18 @@ public:
     bool check_whether_packet_matches(Packet* packet) {
         return root->check_whether_packet_matches(packet);
     }
+    /*
+     * @brief Tells whether the entire tree can be lowered into a Classification::Wordwise program.
+     */
+    bool can_compile() {
+        return root->can_compile();
+    }
+    /*
+     * @brief Adds the tests for the entire tree to the given program, as a single subtree.
+     */
+    void compile(Classification::Wordwise::Program &program, Vector<int> &tree) {
+        root->compile(program, tree);
+    }
 };
 
 };
@@ -167,6 +167,7 @@ Lexer::lex(Vector<Token*>& tokens, ErrorHandler *errh) {      // to_be_lexed_str
     int i = 0;
     bool just_seen_a_not_keyword = false;  // we use this variable to keep track of a possible not keyword seen (e.g. as in not host 12.5.91.1).
     while (true) {
+        an_operator = EQUALITY; // each primitive starts out without an operator; net primitives never read one
         try {        
             i = skip_blanks(to_be_lexed_string, i); // skip the potential blanks at the start and go to the first non blank position
             if (i == -1) {      // end of line was seen after a series of blanks
@@ -323,12 +324,12 @@ Lexer::lex(Vector<Token*>& tokens, ErrorHandler *errh) {      // to_be_lexed_str
                             i = skip_blanks(to_be_lexed_string, i);
                             if (i != -1) {
                                 i = read_word(to_be_lexed_string, i, current_word);
-                                token = SrcHostFactory::create_token(current_word, just_seen_a_not_keyword, an_operator);
+                                token = DstHostFactory::create_token(current_word, just_seen_a_not_keyword, an_operator);
                             } else {
                                 errh->error("operator was only followed by blanks, that is not allowed, an operator must be followed by data"); return -1;
                             }
                         } else {    // no operator was given, equality is assumed and the current word already contains the data
-                            token = SrcHostFactory::create_token(current_word, just_seen_a_not_keyword, EQUALITY);
+                            token = DstHostFactory::create_token(current_word, just_seen_a_not_keyword, EQUALITY);
                         }
                         
                         if (token != NULL) {    // if the parsing succeeded push the token at the back of the token vector
@@ -452,7 +453,6 @@ Lexer::lex(Vector<Token*>& tokens, ErrorHandler *errh) {      // to_be_lexed_str
                 Token *token;
                 if (is_word_an_operator(current_word, an_operator) >= 0) {
                     skip_blanks_and_read_word(to_be_lexed_string, i, current_word, "operator was only followed by blanks, an operator must be followed by data");
-                    i = read_word(to_be_lexed_string, i, current_word);
                     token = PortFactory::create_token(current_word, just_seen_a_not_keyword, an_operator);
                 } else {    // no operator was given, equality is assumed and the current word already contains the data
                     token = PortFactory::create_token(current_word, just_seen_a_not_keyword, EQUALITY);
@@ -535,14 +535,24 @@ Lexer::lex(Vector<Token*>& tokens, ErrorHandler *errh) {      // to_be_lexed_str
             
             
             } else if (current_word == "icmp") {
-                i = skip_blanks(to_be_lexed_string, i);
-                if (i != -1) {  // if after skipping blanks we are not at the end of the filter line
-                    i = read_word(to_be_lexed_string, i, current_word);
-                    if (current_word == "type") {
-                    
-                    }  
+                skip_blanks_and_read_word(to_be_lexed_string, i, current_word, "no second keyword after icmp; it should be followed by type");
+                Token *token;
+                if (current_word == "type") {
+                    skip_blanks_and_read_word(to_be_lexed_string, i, current_word, "no argument followed after icmp type statement");
+                    if (is_word_an_operator(current_word, an_operator) >= 0) {
+                        skip_blanks_and_read_word(to_be_lexed_string, i, current_word, "operator was only followed by blanks, an operator must be followed by data");
+                        token = ICMPTypeFactory::create_token(current_word, just_seen_a_not_keyword, an_operator);
+                    } else {    // no operator was given, equality is assumed and the current word already contains the data
+                        token = ICMPTypeFactory::create_token(current_word, just_seen_a_not_keyword, EQUALITY);
+                    }
+                    if (token != NULL) {    // if the parsing succeeded push the token at the back of the token vector
+                        tokens.push_back(token);
+                        just_seen_a_not_keyword = false;
+                    } else {
+                        errh->error("icmp type was followed by an unparsable argument '%s'; it should be an integer between 0 and 255", current_word.c_str()); return -1;
+                    }
                 } else {
-                    errh->error("no second keyword after icmp; it should be followed by type");
+                    errh->error("unkown keyword '%s' followed icmp, it should be type", current_word.c_str()); return -1;
                 }
             } else if (current_word == "ip6") {
                 skip_blanks_and_read_word(to_be_lexed_string, i, current_word, "no second keyword after ip6; ip6 should be followed by vers, plen, flow, nxt, dscp, ecn, ce, hlim, frag, unfrag.");
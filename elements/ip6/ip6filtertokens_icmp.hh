@@ -3,6 +3,7 @@
 
 #include "ip6filtertokens.hh"
 #include <clicknet/icmp.h>
+#include "ip6helpers.hh"
 CLICK_DECLS
 
 namespace ip6filtering {
@@ -26,28 +27,37 @@ public:
     }
     
     virtual bool check_whether_packet_matches(Packet *packet) {
-        click_icmp* icmp_header_of_this_packet = (click_icmp*) packet->icmp_header();   
-    
+        const click_icmp* icmp_header_of_this_packet = (const click_icmp*) ip6::get_transport_header(packet);
+        if (!icmp_header_of_this_packet) {
+            return take_inverse_on_not(false);  // a later fragment, it does not contain the ICMP header
+        }
+        uint8_t type = icmp_header_of_this_packet->icmp_type;
         switch (an_operator) {
             case EQUALITY:
-                return take_inverse_on_not((icmp_header_of_this_packet->icmp_type >> 8) == icmp_type); // normally we simply give back the answer of the equality but when the not
-                                                                                                // keyword was seen we give back the inverse of this
+                return take_inverse_on_not(type == icmp_type); // normally we simply give back the answer of the equality but when the not
+                                                                // keyword was seen we give back the inverse of this
             case INEQUALITY:
-                return take_inverse_on_not((icmp_header_of_this_packet->icmp_type >> 8) != icmp_type);
+                return take_inverse_on_not(type != icmp_type);
             
             case GREATER_THAN:
-                return take_inverse_on_not((icmp_header_of_this_packet->icmp_type >> 8) > icmp_type);
+                return take_inverse_on_not(type > icmp_type);
                 
             case LESS_THAN:
-                return take_inverse_on_not((icmp_header_of_this_packet->icmp_type >> 8) < icmp_type);
+                return take_inverse_on_not(type < icmp_type);
                 
             case GREATER_OR_EQUAL_THAN:
-                return take_inverse_on_not((icmp_header_of_this_packet->icmp_type >> 8) >= icmp_type);
+                return take_inverse_on_not(type >= icmp_type);
                 
             default:   // It is an LESS_OR_EQUAL_THAN
-                return take_inverse_on_not((icmp_header_of_this_packet->icmp_type >> 8) <= icmp_type);
+                return take_inverse_on_not(type <= icmp_type);
         }
     }
+    virtual bool can_compile() {
+        return true;
+    }
+    virtual void compile(Classification::Wordwise::Program &program, Vector<int> &tree) {
+        ip6::add_field_insns(program, tree, IPFilter::offset_transp, 0xFF000000, icmp_type, an_operator, is_preceded_by_not_keyword);
+    }
     
     virtual void print_name() {
         click_chatter("ICMPTypePrimitiveToken");
@@ -79,6 +79,18 @@ public:
             return false;
         }
     }
+    virtual bool can_compile() {
+        return an_operator == EQUALITY || an_operator == INEQUALITY;    // ordered comparisons of addresses are not lowered
+    }
+    virtual void compile(Classification::Wordwise::Program &program, Vector<int> &tree) {
+        program.start_subtree(tree);
+        ip6::add_bytes_insns(program, tree, IPFilter::offset_net + 8, ip6_address.s6_addr, IP6Address::make_prefix(128).data(), 16, false);
+        ip6::add_bytes_insns(program, tree, IPFilter::offset_net + 24, ip6_address.s6_addr, IP6Address::make_prefix(128).data(), 16, false);
+        program.finish_subtree(tree, Classification::c_or);
+        if (is_preceded_by_not_keyword != (an_operator == INEQUALITY)) {
+            program.negate_subtree(tree, true);
+        }
+    }
 private:
     in6_addr ip6_address;
 };
@@ -192,6 +204,17 @@ public:
             }
         }    
     }
+    virtual bool can_compile() {
+        return an_operator == EQUALITY || an_operator == INEQUALITY;    // ordered comparisons of addresses are not lowered
+    }
+    virtual void compile(Classification::Wordwise::Program &program, Vector<int> &tree) {
+        program.start_subtree(tree);
+        ip6::add_bytes_insns(program, tree, IPFilter::offset_net + 8, ip6_address.s6_addr, IP6Address::make_prefix(128).data(), 16, false);
+        program.finish_subtree(tree, Classification::c_or);
+        if (is_preceded_by_not_keyword != (an_operator == INEQUALITY)) {
+            program.negate_subtree(tree, true);
+        }
+    }
 private:
     in6_addr ip6_address;
 };
@@ -304,6 +327,17 @@ public:
             }
         }
     }
+    virtual bool can_compile() {
+        return an_operator == EQUALITY || an_operator == INEQUALITY;    // ordered comparisons of addresses are not lowered
+    }
+    virtual void compile(Classification::Wordwise::Program &program, Vector<int> &tree) {
+        program.start_subtree(tree);
+        ip6::add_bytes_insns(program, tree, IPFilter::offset_net + 24, ip6_address.s6_addr, IP6Address::make_prefix(128).data(), 16, false);
+        program.finish_subtree(tree, Classification::c_or);
+        if (is_preceded_by_not_keyword != (an_operator == INEQUALITY)) {
+            program.negate_subtree(tree, true);
+        }
+    }
 private:
     in6_addr ip6_address;
 };
@@ -343,6 +377,12 @@ public:
             return take_inverse_on_not(((*ip6_version_number_of_this_packet & 0b11110000) >> 4) <= version);
         }
     }
+    virtual bool can_compile() {
+        return true;
+    }
+    virtual void compile(Classification::Wordwise::Program &program, Vector<int> &tree) {
+        ip6::add_field_insns(program, tree, IPFilter::offset_net, 0xF0000000, version, an_operator, is_preceded_by_not_keyword);
+    }
 private:
     const uint8_t version;
 };
@@ -382,6 +422,12 @@ public:
             return take_inverse_on_not(htons(*ip6_payload_length_of_this_packet) <= payload_length);
         }        
     }
+    virtual bool can_compile() {
+        return true;
+    }
+    virtual void compile(Classification::Wordwise::Program &program, Vector<int> &tree) {
+        ip6::add_field_insns(program, tree, IPFilter::offset_net + 4, 0xFFFF0000, payload_length, an_operator, is_preceded_by_not_keyword);
+    }
 private:
     const uint16_t payload_length;
 };
@@ -425,6 +471,12 @@ public:
             return take_inverse_on_not(htonl(ip6_flow_label_packet) <= flow_label);
         }
     }
+    virtual bool can_compile() {
+        return true;
+    }
+    virtual void compile(Classification::Wordwise::Program &program, Vector<int> &tree) {
+        ip6::add_field_insns(program, tree, IPFilter::offset_net, 0x000FFFFF, flow_label, an_operator, is_preceded_by_not_keyword);
+    }
 private:
     const uint32_t flow_label;
 };
@@ -464,6 +516,12 @@ public:
             return take_inverse_on_not(*ip6_next_header_of_this_packet <= next_header);
         }
     }
+    virtual bool can_compile() {
+        return true;
+    }
+    virtual void compile(Classification::Wordwise::Program &program, Vector<int> &tree) {
+        ip6::add_field_insns(program, tree, IPFilter::offset_net + 4, 0x0000FF00, next_header, an_operator, is_preceded_by_not_keyword);
+    }
 private:
     const uint8_t next_header;
 };
@@ -507,6 +565,12 @@ public:
         
         
 
+    }
+    virtual bool can_compile() {
+        return true;
+    }
+    virtual void compile(Classification::Wordwise::Program &program, Vector<int> &tree) {
+        ip6::add_field_insns(program, tree, IPFilter::offset_net, 0x0FC00000, dscp, an_operator, is_preceded_by_not_keyword);
     }
 private:
     uint8_t dscp;
@@ -547,6 +611,12 @@ public:
             return take_inverse_on_not(ip6_ECN_of_packet <= ecn);
         }
     }
+    virtual bool can_compile() {
+        return true;
+    }
+    virtual void compile(Classification::Wordwise::Program &program, Vector<int> &tree) {
+        ip6::add_field_insns(program, tree, IPFilter::offset_net, 0x00300000, ecn, an_operator, is_preceded_by_not_keyword);
+    }
 private:
     uint8_t ecn;
 };
@@ -571,6 +641,12 @@ public:
         
         return take_inverse_on_not((*ip6_CE_of_this_packet & 0b00110000) == 0b00110000);
     }
+    virtual bool can_compile() {
+        return true;
+    }
+    virtual void compile(Classification::Wordwise::Program &program, Vector<int> &tree) {
+        ip6::add_field_insns(program, tree, IPFilter::offset_net, 0x00300000, 3, ip6::op_eq, is_preceded_by_not_keyword);
+    }
 
 };
 
@@ -608,6 +684,12 @@ public:
             return take_inverse_on_not(*ip6_hlim_of_this_packet <= hop_limit);
         }
     }
+    virtual bool can_compile() {
+        return true;
+    }
+    virtual void compile(Classification::Wordwise::Program &program, Vector<int> &tree) {
+        ip6::add_field_insns(program, tree, IPFilter::offset_net + 4, 0x000000FF, hop_limit, an_operator, is_preceded_by_not_keyword);
+    }
 private:
     const uint8_t hop_limit;
 };
@@ -690,6 +772,18 @@ public:
         click_ip6 *network_header_of_this_packet = (click_ip6*) packet->network_header();
         return take_inverse_on_not((network_header_of_this_packet->ip6_src & mask) == (address & mask) || (network_header_of_this_packet->ip6_dst & mask) == (address & mask));
     }
+    virtual bool can_compile() {
+        return an_operator == EQUALITY || an_operator == INEQUALITY;    // ordered comparisons of addresses are not lowered
+    }
+    virtual void compile(Classification::Wordwise::Program &program, Vector<int> &tree) {
+        program.start_subtree(tree);
+        ip6::add_bytes_insns(program, tree, IPFilter::offset_net + 8, address.data(), mask.data(), 16, false);
+        ip6::add_bytes_insns(program, tree, IPFilter::offset_net + 24, address.data(), mask.data(), 16, false);
+        program.finish_subtree(tree, Classification::c_or);
+        if (is_preceded_by_not_keyword != (an_operator == INEQUALITY)) {
+            program.negate_subtree(tree, true);
+        }
+    }
 private:
     IP6Address address;
     IP6Address mask;
@@ -719,6 +813,17 @@ public:
         click_ip6 *network_header_of_this_packet = (click_ip6*) packet->network_header();
         return take_inverse_on_not((network_header_of_this_packet->ip6_src & mask) == (address & mask));
     }
+    virtual bool can_compile() {
+        return an_operator == EQUALITY || an_operator == INEQUALITY;    // ordered comparisons of addresses are not lowered
+    }
+    virtual void compile(Classification::Wordwise::Program &program, Vector<int> &tree) {
+        program.start_subtree(tree);
+        ip6::add_bytes_insns(program, tree, IPFilter::offset_net + 8, address.data(), mask.data(), 16, false);
+        program.finish_subtree(tree, Classification::c_or);
+        if (is_preceded_by_not_keyword != (an_operator == INEQUALITY)) {
+            program.negate_subtree(tree, true);
+        }
+    }
 private:
     IP6Address address;
     IP6Address mask;
@@ -748,6 +853,17 @@ public:
         click_ip6 *network_header_of_this_packet = (click_ip6*) packet->network_header();
         return take_inverse_on_not((network_header_of_this_packet->ip6_dst & mask) == (address & mask));
     }
+    virtual bool can_compile() {
+        return an_operator == EQUALITY || an_operator == INEQUALITY;    // ordered comparisons of addresses are not lowered
+    }
+    virtual void compile(Classification::Wordwise::Program &program, Vector<int> &tree) {
+        program.start_subtree(tree);
+        ip6::add_bytes_insns(program, tree, IPFilter::offset_net + 24, address.data(), mask.data(), 16, false);
+        program.finish_subtree(tree, Classification::c_or);
+        if (is_preceded_by_not_keyword != (an_operator == INEQUALITY)) {
+            program.negate_subtree(tree, true);
+        }
+    }
 private:
     IP6Address address;
     IP6Address mask;
@@ -40,7 +40,10 @@ public:
     virtual bool check_whether_packet_matches(Packet *packet) {
         try {
             if (ip6::get_higher_layer_protocol(packet) == 6) {  // 6 means IT IS a TCP packet            
-                click_tcp* tcp_header_of_this_packet = (click_tcp*) packet->tcp_header();
+                const click_tcp* tcp_header_of_this_packet = (const click_tcp*) ip6::get_transport_header(packet);
+                if (!tcp_header_of_this_packet) {
+                    return false;   // a later fragment, it does not contain the TCP header
+                }
                   
                 switch (tcp_option_name) {
                     case SYN:
@@ -97,7 +100,10 @@ public:
     virtual bool check_whether_packet_matches(Packet *packet) {
         try {
             if (ip6::get_higher_layer_protocol(packet) == 6) {  // 6 means IT IS a TCP packet
-                click_tcp* tcp_header_of_this_packet = (click_tcp*) packet->tcp_header();
+                const click_tcp* tcp_header_of_this_packet = (const click_tcp*) ip6::get_transport_header(packet);
+                if (!tcp_header_of_this_packet) {
+                    return false;   // a later fragment, it does not contain the TCP header
+                }
                 
                 switch (an_operator) {
                     case EQUALITY:
@@ -3,6 +3,7 @@
 
 #include "ip6filtertokens.hh"
 #include <clicknet/udp.h>
+#include "ip6helpers.hh"
 
 CLICK_DECLS
 
@@ -36,9 +37,27 @@ public:
         PrimitiveToken::print();
     }
     virtual bool check_whether_packet_matches(Packet *packet) {
-        click_udp* udp_header_of_this_packet = (click_udp*) packet->udp_header();
+        const click_udp* udp_header_of_this_packet = (const click_udp*) ip6::get_transport_header(packet);
+        if (!udp_header_of_this_packet) {
+            return take_inverse_on_not(false);  // a later fragment, it does not contain the ports
+        }
         // normally we simply give back the answer of the equality but when the not keyword was seen we give back the inverse of this    
-        return take_inverse_on_not(htons(udp_header_of_this_packet->uh_sport) == port_value || htons(udp_header_of_this_packet->uh_dport) == port_value);
+        bool either_port_matches = htons(udp_header_of_this_packet->uh_sport) == port_value || htons(udp_header_of_this_packet->uh_dport) == port_value;
+        return take_inverse_on_not(either_port_matches != (an_operator == INEQUALITY));
+    }
+    virtual bool can_compile() {
+        return true;
+    }
+    virtual void compile(Classification::Wordwise::Program &program, Vector<int> &tree) {
+        // "port != 80" means neither port is 80, so != negates the whole "either port" test
+        Operator field_operator = (an_operator == INEQUALITY ? EQUALITY : an_operator);
+        program.start_subtree(tree);
+        ip6::add_field_insns(program, tree, IPFilter::offset_transp, 0xFFFF0000, port_value, field_operator, false);
+        ip6::add_field_insns(program, tree, IPFilter::offset_transp, 0x0000FFFF, port_value, field_operator, false);
+        program.finish_subtree(tree, Classification::c_or);
+        if (is_preceded_by_not_keyword != (an_operator == INEQUALITY)) {
+            program.negate_subtree(tree, true);
+        }
     }
 private:
     uint16_t port_value;
@@ -70,12 +89,19 @@ public:
         PrimitiveToken::print();
     }
     virtual bool check_whether_packet_matches(Packet *packet) {
-        click_udp* udp_header_of_this_packet = (click_udp*) packet->udp_header();
+        const click_udp* udp_header_of_this_packet = (const click_udp*) ip6::get_transport_header(packet);
+        if (!udp_header_of_this_packet) {
+            return take_inverse_on_not(false);  // a later fragment, it does not contain the ports
+        }
         // normally we simply give back the answer of the equality but when the not keyword was seen we give back the inverse of this    
-        click_chatter("udp_header_of_this_packet->uh_sport = %i", htons(udp_header_of_this_packet->uh_sport));
-        click_chatter("port_value = %i", port_value);        
         return take_inverse_on_not(htons(udp_header_of_this_packet->uh_sport) == port_value);
     }
+    virtual bool can_compile() {
+        return true;
+    }
+    virtual void compile(Classification::Wordwise::Program &program, Vector<int> &tree) {
+        ip6::add_field_insns(program, tree, IPFilter::offset_transp, 0xFFFF0000, port_value, an_operator, is_preceded_by_not_keyword);
+    }
 private:
     uint16_t port_value;
 };
@@ -106,10 +132,19 @@ public:
         PrimitiveToken::print();
     }
     virtual bool check_whether_packet_matches(Packet *packet) {
-        click_udp* udp_header_of_this_packet = (click_udp*) packet->udp_header();
+        const click_udp* udp_header_of_this_packet = (const click_udp*) ip6::get_transport_header(packet);
+        if (!udp_header_of_this_packet) {
+            return take_inverse_on_not(false);  // a later fragment, it does not contain the ports
+        }
         // normally we simply give back the answer of the equality but when the not keyword was seen we give back the inverse of this    
         return take_inverse_on_not(htons(udp_header_of_this_packet->uh_dport) == port_value);
     }
+    virtual bool can_compile() {
+        return true;
+    }
+    virtual void compile(Classification::Wordwise::Program &program, Vector<int> &tree) {
+        ip6::add_field_insns(program, tree, IPFilter::offset_transp, 0x0000FFFF, port_value, an_operator, is_preceded_by_not_keyword);
+    }
 private:
     uint16_t port_value;
 };
@@ -21,8 +21,7 @@
 #include <click/args.hh>
 #include <click/error.hh>
 #include <click/glue.hh>
-#include <clicknet/ether.h>
-#include <fstream>
+#include <click/packet_anno.hh>
 CLICK_DECLS
 
 IP6Fragmenter::IP6Fragmenter()
@@ -38,16 +37,31 @@ IP6Fragmenter::~IP6Fragmenter()
 int
 IP6Fragmenter::configure(Vector<String> &conf, ErrorHandler *errh)
 {
-    int return_type = Args(conf, this, errh).read_mp("MTU", _MTU).complete();
-    if (return_type == 0) {
-        if (_MTU > 4960) {
-            return errh->error("The maximum packet size is 4960");
-        } else {
-            return 0;
-        }
-    } else {
-        return return_type;
+    int next = -1;
+    _unfragmentable_part_length = sizeof(click_ip6);
+    _clone = false;
+    if (Args(conf, this, errh)
+        .read_mp("MTU", _MTU)
+        .read("IPV6_HEADER_LENGTH", _unfragmentable_part_length)
+        .read("NEXT", next)
+        .read("CLONE", _clone)
+        .complete() < 0) {
+        return -1;
+    }
+    if (_MTU > 4960) {
+        return errh->error("The maximum packet size is 4960");
+    }
+    if (_unfragmentable_part_length < sizeof(click_ip6) || (_unfragmentable_part_length & 7)) {
+        return errh->error("IPV6_HEADER_LENGTH must be at least 40 and a multiple of 8");
+    }
+    if (_MTU < _unfragmentable_part_length + sizeof(click_ip6_fragment) + 8) {
+        return errh->error("MTU too small for IPV6_HEADER_LENGTH");
+    }
+    if (next > 255) {
+        return errh->error("NEXT must be a protocol number");
     }
+    _next = next;
+    return 0;
 }
 
 //  If the original packet was too big to reach the final destination then
@@ -84,70 +98,144 @@ IP6Fragmenter::configure(Vector<String> &conf, ErrorHandler *errh)
 
 // The fragments have the remaining IPv6 extension headers, higher layer protocol headers,
 // and payload.
+
+// Returns the offset of the next header field that announces the fragmentable part: the one of the IPv6 header, or of
+// the last extension header in the unfragmentable part.
+int
+IP6Fragmenter::next_header_offset(const Packet *p) const
+{
+    int nxt_offset = 6;
+    for (uint32_t offset = sizeof(click_ip6); offset < _unfragmentable_part_length; ) {
+        nxt_offset = offset;
+        offset += (p->data()[offset + 1] + 1) * 8;
+    }
+    return nxt_offset;
+}
+
+// Writes the unfragmentable part of the original packet, whose next header value is original_nxt, and the
+// fragmentation header of the fragment with the given offset and length, at header.
+void
+IP6Fragmenter::write_headers(unsigned char *header, const unsigned char *unfragmentable_part, int nxt_offset,
+                             uint8_t original_nxt, uint32_t offset, uint32_t length, bool more) const
+{
+    // Add unfragmentable part
+    if (header != unfragmentable_part) {
+        memmove(header, unfragmentable_part, _unfragmentable_part_length);
+    }
+    ((click_ip6*) header)->ip6_plen = htons((_unfragmentable_part_length - sizeof(click_ip6)) + sizeof(click_ip6_fragment) + length);
+    header[nxt_offset] = IP6PROTO_FRAGMENT;
+
+    // Add fragment header
+    click_ip6_fragment* ip6_frag_header = (click_ip6_fragment*) (header + _unfragmentable_part_length);
+    ip6_frag_header->ip6_frag_nxt = (_next >= 0 ? _next : original_nxt); // The Next Header value that identifies the first header of the Fragmentable Part of the original packet.
+    ip6_frag_header->ip6_frag_reserved = 0;
+    ip6_frag_header->ip6_frag_offset = htons(offset | (more ? IP6_MF : 0));
+    ip6_frag_header->ip6_frag_id = _id;
+}
+
 void
 IP6Fragmenter::push(int, Packet *p)
 {
     if (p->length() <= _MTU) {
         output(0).push(p);
-    } else {
-        // Fragmentable part
-        uint8_t* fragmentable_part_ptr = (uint8_t*) p->data() + _unfragmentable_part_length;
-        uint32_t fragmentable_part_length = p->length() - _unfragmentable_part_length;      // size of big payload to be distributed over small fragments
-        uint32_t non_last_fragment_length = _MTU - _unfragmentable_part_length - sizeof(click_ip6_fragment);
-        non_last_fragment_length  -= (_MTU - _unfragmentable_part_length - sizeof(click_ip6_fragment)) % 8; // round down to multiple of 8 bytes
-        ((click_ip6*) p->data())->ip6_plen = htons((_unfragmentable_part_length - 40) + sizeof(click_ip6_fragment) + non_last_fragment_length);
-        
-        uint32_t remainder = fragmentable_part_length % non_last_fragment_length;
-        // === SENDING PACKETS ===
-        // Packets that have a size that is a multiple of 8 bytes
-        for (unsigned i = 1; i <= (fragmentable_part_length / non_last_fragment_length); i++) {
-            WritablePacket *packet = Packet::make(0, _unfragmentable_part_length + sizeof(click_ip6_fragment) + non_last_fragment_length);
-            
-            // Add unfragmentable part
-            memcpy((void*) packet->data(), p->data(), _unfragmentable_part_length);
-       
-            // Add fragment header
-            click_ip6_fragment* ip6_frag_header = (click_ip6_fragment*) ((uint8_t*) packet->data() + _unfragmentable_part_length);
-            ip6_frag_header->ip6_frag_nxt = _next; // The Next Header value that identifies the first header of the Fragmentable Part of the original packet.
-            if ((i == fragmentable_part_length / non_last_fragment_length) && (remainder == 0)) {  
-                // special case with no remainder
-                // although it says it is a non_last_fragment it is the last fragment or packet
-                // because of this it must have a zero in the last position indicating 'no more fragments follow'
-                ip6_frag_header->ip6_frag_offset = htons(((((i-1) * (non_last_fragment_length/8)) << 3) & 0b1111111111111000));
-            } else {
-                ip6_frag_header->ip6_frag_offset = htons(((((i-1) * (non_last_fragment_length/8)) << 3) & 0b1111111111111000) | 0b0000000000000001);
+        return;
+    }
+
+    uint32_t header_length = _unfragmentable_part_length + sizeof(click_ip6_fragment);
+    uint32_t fragmentable_part_length = p->length() - _unfragmentable_part_length;      // size of big payload to be distributed over small fragments
+    uint32_t non_last_fragment_length = (_MTU - header_length) & ~7U;   // round down to multiple of 8 bytes
+    int nfragments = (fragmentable_part_length + non_last_fragment_length - 1) / non_last_fragment_length;
+    int nxt_offset = next_header_offset(p);
+    uint8_t original_nxt = p->data()[nxt_offset];
+
+    // In clone mode, fragments 2, 4, ... share the original packet's buffer: their headers are written over the
+    // end of the previous fragment's data, which is copied into its own packet first. Fragment 0 reuses the
+    // original packet, whose unfragmentable part moves into its headroom to make room for the fragmentation
+    // header. Odd fragments are copies.
+    WritablePacket *q = 0;
+    bool in_place = _clone && non_last_fragment_length >= header_length;
+    if (in_place) {
+        if (!(q = p->uniqueify())) {
+            return;
+        }
+        p = q;
+    }
+
+    Packet *fragments[nfragments];
+    for (int i = 0; i < nfragments; i++) {
+        uint32_t offset = i * non_last_fragment_length;
+        uint32_t length = (i < nfragments - 1 ? non_last_fragment_length : fragmentable_part_length - offset);
+        if (in_place && (i & 1) == 0) {
+            fragments[i] = 0;
+            continue;
+        }
+        WritablePacket *packet = Packet::make(0, header_length + length);
+        if (!packet) {
+            fragments[i] = 0;
+            continue;
+        }
+        write_headers(packet->data(), p->data(), nxt_offset, original_nxt, offset, length, i < nfragments - 1);
+        // Add 'i'-th fragment
+        memcpy(packet->data() + header_length, p->data() + _unfragmentable_part_length + offset, length);
+        packet->copy_annotations(p);
+        packet->set_ip6_header((click_ip6 *) packet->data(), _unfragmentable_part_length);
+        fragments[i] = packet;
+    }
+
+    if (in_place) {
+        // headers of the even fragments other than the first, over the copied data of the odd ones: fragment i's
+        // data starts at _unfragmentable_part_length + offset, so its headers start at offset - 8
+        for (int i = 2; i < nfragments; i += 2) {
+            uint32_t offset = i * non_last_fragment_length;
+            uint32_t length = (i < nfragments - 1 ? non_last_fragment_length : fragmentable_part_length - offset);
+            write_headers(q->data() + offset - sizeof(click_ip6_fragment), q->data(),
+                          nxt_offset, original_nxt, offset, length, i < nfragments - 1);
+        }
+
+        // the first fragment
+        if (!(q = q->push(sizeof(click_ip6_fragment)))) {
+            for (int i = 1; i < nfragments; i += 2) {
+                if (fragments[i]) {
+                    fragments[i]->kill();
+                }
             }
-            ip6_frag_header->ip6_frag_id = _id;
-            
-            // Add 'i'-th fragment
-            memcpy(ip6_frag_header + 1, fragmentable_part_ptr + ((i-1) * (non_last_fragment_length)), non_last_fragment_length);
-            
-            output(0).push(packet);
+            return;
         }
-        // Possibly the last packet that might not be a multiple of 8 bytes
-        if (remainder != 0) {
-            WritablePacket *packet = Packet::make(0, _unfragmentable_part_length + sizeof(click_ip6_fragment) + remainder);
-            
-            // Adapt length in original packet header
-            ((click_ip6*) p->data())->ip6_plen = htons((_unfragmentable_part_length - 40) + sizeof(click_ip6_fragment) + remainder);
-            
-            // Add unfragmentable part
-            memcpy((void*) packet->data(), p->data(), _unfragmentable_part_length);
-            
-            // Add fragment header
-            click_ip6_fragment* ip6_frag_header = (click_ip6_fragment*) ((uint8_t*) packet->data() + _unfragmentable_part_length);
-            ip6_frag_header->ip6_frag_nxt = _next; // The Next Header value that identifies the first header of the Fragmentable Part of the original packet.
-            ip6_frag_header->ip6_frag_offset = htons(((((fragmentable_part_length / (non_last_fragment_length + sizeof(click_ip6_fragment))) * (non_last_fragment_length/8)) << 3) & 0b1111111111111000));
-            ip6_frag_header->ip6_frag_id = _id;
-            
-            // Add last fragment
-            memcpy(ip6_frag_header + 1, fragmentable_part_ptr + ((fragmentable_part_length / (non_last_fragment_length + sizeof(click_ip6_fragment))) * (non_last_fragment_length)), remainder);
-            
-            output(0).push(packet);            
+        write_headers(q->data(), q->data() + sizeof(click_ip6_fragment), nxt_offset, original_nxt, 0,
+                      non_last_fragment_length, true);
+        q->set_ip6_header((click_ip6 *) q->data(), _unfragmentable_part_length);
+
+        for (int i = 2; i < nfragments; i += 2) {
+            uint32_t offset = i * non_last_fragment_length;
+            uint32_t length = (i < nfragments - 1 ? non_last_fragment_length : fragmentable_part_length - offset);
+            Packet *clone = q->clone();
+            if (clone) {
+                clone->pull(offset);
+                clone->take(clone->length() - header_length - length);
+                clone->set_ip6_header((const click_ip6 *) clone->data(), _unfragmentable_part_length);
+            }
+            fragments[i] = clone;
+        }
+        q->take(q->length() - header_length - non_last_fragment_length);
+        fragments[0] = q;
+    } else {
+        p->kill();
+    }
+
+    for (int i = 0; i < nfragments; i++) {
+        if (fragments[i]) {
+            // the annotations copied from p describe its extension headers, not the fragment's
+            SET_IP6_EXTHDR_FLAGS_ANNO(fragments[i], 0);
+            output(0).push(fragments[i]);
         }
-        
-        _id ++;
     }
+    _id ++;
+}
+
+void
+IP6Fragmenter::add_handlers()
+{
+    add_data_handlers("clone", Handler::OP_READ | Handler::OP_WRITE | Handler::CHECKBOX, &_clone);
 }
 
 CLICK_ENDDECLS
@@ -22,7 +22,13 @@ CLICK_DECLS
  * into multiple smaller packets of at most size MTU.
  * - IPV6_HEADER_LENGTH: IPv6 header part length (standard header + extension headers).
  * Default value is 40.
- * - NEXT: the protocol after the IPv6 fragmentation extension header
+ * - NEXT: the protocol after the IPv6 fragmentation extension header. Default is the
+ * next header value that announces the fragmentable part in the original packet.
+ * - CLONE: Boolean. If true, fragments share the original packet's buffer instead of
+ * being copied: every other fragment is a clone of the original packet, whose
+ * unfragmentable part and fragmentation header are written in place in front of its
+ * data, and the first fragment is the original packet itself. The fragments emitted
+ * are identical to those of the default mode. Default is false.
  *
  * =e
  * Example:
@@ -32,6 +38,9 @@ CLICK_DECLS
  * -> IP6Fragmenter(MTU 1400)          // 0, 1952
  * -> EtherEncap(0x86dd, 00:0a:95:9d:68:16, 00:0a:95:9d:68:17)
  * -> Discard;
+ *
+ * =h clone read/write
+ * Returns or sets the CLONE parameter.
  */
 
 class IP6Fragmenter : public Element {
@@ -40,10 +49,11 @@ class IP6Fragmenter : public Element {
                         // in case of IPv6 we need to choose the _MTU so it is equal to the minimal MTU of all MTU's on the path
                         // to the destination
   uint32_t _unfragmentable_part_length;   // tells the length of the unfragmentable part (= the part consisting of IPv6 headers)
-  uint8_t _next;                          // tells which value should be inserted as next header value in the fragmentation header
+  int _next;                              // tells which value should be inserted as next header value in the fragmentation header,
+                                          // -1 to keep the one of the original packet
+  bool _clone;                            // emit fragments that share the original packet's buffer
                         
   // OTHER VARIABLES
-  uint32_t _fragment_size;  // size of each fragment sent over the network
   uint32_t _id; // current fragmentation ID
 
  public:
@@ -55,8 +65,15 @@ class IP6Fragmenter : public Element {
   const char *port_count() const		{ return PORTS_1_1X2; }
   const char *processing() const		{ return PUSH; }
   int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
+  void add_handlers() CLICK_COLD;
 
   void push(int, Packet *p);
+
+ private:
+
+  int next_header_offset(const Packet *p) const;
+  void write_headers(unsigned char *header, const unsigned char *unfragmentable_part, int nxt_offset,
+                     uint8_t original_nxt, uint32_t offset, uint32_t length, bool more) const;
 };
 
 CLICK_ENDDECLS
@@ -20,129 +20,230 @@
 #include <click/config.h>
 #include <clicknet/tcp.h>
 #include <clicknet/ip6.h>
+#include <click/packet_anno.hh>
 #include "ip6helpers.hh"
 
 CLICK_DECLS
 namespace ip6 {
 
+/** @brief Returns the flags in the packet's IP6_EXTHDR annotations, or 0 when the annotations do not describe the packet.
+  * Other annotations share their bytes, and the packet's headers may have moved since mark_transport_header() set them,
+  * so they are only used while the network header offset and length they were set for still match the packet.
+  */
+static int cached_exthdr_flags(const Packet *packet) {
+    int flags = IP6_EXTHDR_FLAGS_ANNO(packet);
+    if (!(flags & EXTHDR_VALID) || flags > (EXTHDR_VALID | EXTHDR_FRAGMENT | EXTHDR_LATER_FRAGMENT)
+        || !packet->has_network_header() || IP6_NETWORK_OFFSET_ANNO(packet) != packet->network_header() - packet->buffer()) {
+        return 0;
+    }
+    int network_length;
+    if (flags & EXTHDR_LATER_FRAGMENT) {
+        network_length = packet->end_data() - packet->network_header();
+    } else {
+        network_length = IP6_TRANSPORT_OFFSET_ANNO(packet);
+    }
+    return packet->network_length() == network_length ? flags : 0;
+}
+
 /** @brief Starts at the packet's network header pointer and searches for a fragmentation extension header.
-  * @return true on found, false on not found
+  * Only hop by hop, routing and destination options headers may precede it.
+  * @param prev_nxt_offset set to the offset, relative to the network header, of the next header field that announces the
+  *        fragmentation header (6 when it directly follows the IPv6 header)
+  * @return the offset of the fragmentation header relative to the network header, or -1 when the packet has none
   */
-bool has_fragmentation_extension_header(Packet *packet) {
-    uint8_t nxt = ((click_ip6*) packet->network_header())->ip6_nxt;     // the next header number
-    uint8_t len = 0;
-    uint64_t *nxt_header = (uint64_t*) ((click_ip6*) packet->network_header() + 1);     // a pointer to the next header
-    while ((nxt_header) < (((uint64_t*) packet->end_data()) - 1)) {	// At least needs the space to read an additional extension header (which is 8 octets long)
+int find_fragmentation_extension_header(const Packet *packet, int &prev_nxt_offset) {
+    const uint8_t *network_header = packet->network_header();
+    int length = packet->end_data() - network_header;
+    if (length < (int) sizeof(click_ip6)) {
+        return -1;
+    }
+    uint8_t nxt = ((const click_ip6*) network_header)->ip6_nxt;     // the next header number
+    int nxt_offset = 6;                                             // where nxt was read from
+    int offset = sizeof(click_ip6);                                 // the offset of the next header
+    while (true) {
         if (nxt == 44) {
-            return true;        // We have found the header
-        } else if (nxt == 0) {
-            nxt = ((click_ip6_hbh*) nxt_header)->ip6h_nxt;
-	    len = ((click_ip6_rthdr *) nxt_header)->ip6r_len;
-	    // Skip the first 8 octets
-	    nxt_header = nxt_header + 1;
-	    // Hdr Ext Len is the lengt of this header in 8 octet units not including the first 8 octets
-            nxt_header += len;
-        } else if (nxt == 43) {
-            nxt = ((click_ip6_rthdr *) nxt_header)->ip6r_nxt;
-	    len = ((click_ip6_rthdr *) nxt_header)->ip6r_len;
-	    // Skip the first 8 octets
-	    nxt_header = nxt_header + 1;
-	    // Hdr Ext Len is the lengt of this header in 8 octet units not including the first 8 octets
-            nxt_header += len;
-        } else if (nxt == 60) {
-            nxt = ((click_ip6_dest*) nxt_header)->ip6d_nxt;
-	    len = ((click_ip6_rthdr *) nxt_header)->ip6r_len;
-	    // Skip the first 8 octets
-	    nxt_header = nxt_header + 1;
-	    // Hdr Ext Len is the lengt of this header in 8 octet units not including the first 8 octets
-            nxt_header += len;
+            if (offset + (int) sizeof(click_ip6_fragment) > length) {
+                return -1;
+            }
+            prev_nxt_offset = nxt_offset;
+            return offset;  // We have found the header
+        } else if (nxt == 0 || nxt == 43 || nxt == 60) {
+            // hop by hop, routing and destination options headers all start with a next header and a length field
+            if (offset + 2 > length) {
+                return -1;
+            }
+            nxt = network_header[offset];
+            nxt_offset = offset;
+            // Hdr Ext Len is the length of this header in 8 octet units not including the first 8 octets
+            offset += (network_header[offset + 1] + 1) * 8;
         } else {
-            return false;
+            return -1;
         }
     }
 }
 
-/** @brief Returns the higher layer protocol of this IPv6 packet.
-  * In case extension headers are present, follow the extension
-  * header chain to return the higher layer protocol
-  *
-  * Currently supports hop by hop, destination options, routing and
-  * fragment header extension headers.
+/** @brief Starts at the packet's network header pointer and searches for a fragmentation extension header.
+  * When the packet went through MarkIP6Transport, its annotations are used instead.
+  * @return true on found, false on not found
   */
-uint8_t get_higher_layer_protocol(Packet *packet) {
-//    click_chatter("we enteren get_higher_layer_protocol(Packet *packet)");
-    click_ip6 *network_header_of_this_packet = (click_ip6*) packet->network_header();
-    void* header = network_header_of_this_packet;
-    uint8_t nxt = network_header_of_this_packet->ip6_ctlun.ip6_un1.ip6_un1_nxt;
-    
-    if (nxt == 0) {      // An Hop By Hop extension MAY ONLY occur at the start
-        click_ip6_hbh* hop_by_hop_header = (click_ip6_hbh*) header;
-        hop_by_hop_header = hop_by_hop_header + hop_by_hop_header->ip6h_nxt + 1;
-        header = (void*) hop_by_hop_header;     // Now we start at this header; which is the packet after the Hop By Hop Header
-    }
-    
-    // If it is not an extension header give back the protocol immediatly
-    if (!(nxt == 60    ||       // destination options header
-          nxt == 43    ||       // routing header
-          nxt == 44   ))    {   // fragment header
-        return network_header_of_this_packet->ip6_ctlun.ip6_un1.ip6_un1_nxt;      // give it back immediatly
-    }
-        
-    Vector<uint8_t> nxt_seen_list;
-    while (nxt == 60 || nxt == 43 || nxt == 44) {
-        if (nxt == 43) {
-            click_ip6_rthdr *routing_header = (click_ip6_rthdr*) header;
+bool has_fragmentation_extension_header(Packet *packet) {
+    if (int flags = cached_exthdr_flags(packet)) {
+        return flags & EXTHDR_FRAGMENT;
+    }
+    int prev_nxt_offset;
+    return find_fragmentation_extension_header(packet, prev_nxt_offset) >= 0;
+}
 
-            nxt = routing_header->ip6r_nxt;
-            if (!list_contains_value(nxt_seen_list,nxt)) {
-                nxt_seen_list.push_back(nxt);
+/** @brief Walks the extension header chain of the packet once, starting at its network header.
+  * Does not allocate and does not throw. Hop by hop, routing, destination options, authentication and fragmentation headers
+  * are skipped. The walk stops at the first other header, or right after the fragmentation header of a fragment whose
+  * offset is not 0, since the headers that follow it are in the first fragment.
+  * @param protocol set to the higher layer protocol (the next header value that ends the chain)
+  * @param transport_offset set to the offset of the higher layer header relative to the network header
+  * @param fragment_offset set to the offset of the fragmentation header relative to the network header, or 0 when there is none
+  * @return EXTHDR_VALID, or'ed with EXTHDR_FRAGMENT and EXTHDR_LATER_FRAGMENT when they apply, or -1 when the chain is
+  *         truncated or malformed
+  */
+int walk_extension_headers(const Packet *packet, uint8_t &protocol, int &transport_offset, int &fragment_offset) {
+    const uint8_t *network_header = packet->network_header();
+    int length = packet->end_data() - network_header;
+    if (length < (int) sizeof(click_ip6)) {
+        return -1;
+    }
+    uint8_t nxt = ((const click_ip6*) network_header)->ip6_nxt;
+    int offset = sizeof(click_ip6);
+    int flags = EXTHDR_VALID;
+    fragment_offset = 0;
+    while (true) {
+        if (nxt == 0 || nxt == 43 || nxt == 60 || nxt == 51) {
+            // hop by hop, routing, destination options and authentication headers all start with a next header and a
+            // length field
+            if (offset + 2 > length || (nxt == 0 && offset != (int) sizeof(click_ip6))) {
+                return -1;      // truncated, or a hop by hop header that does not directly follow the IPv6 header
+            }
+            int header_length;
+            if (nxt == 51) {
+                header_length = (network_header[offset + 1] + 2) * 4;  // in 4 octet units, minus 2
             } else {
-                throw String("An error: we have seen the routing header twice");
+                header_length = (network_header[offset + 1] + 1) * 8;  // in 8 octet units, not including the first 8 octets
             }
-            routing_header = routing_header + routing_header->ip6r_len + 1;
-            header = (void*) routing_header;
+            nxt = network_header[offset];
+            offset += header_length;
         } else if (nxt == 44) {
-            click_ip6_fragment *fragment_header = (click_ip6_fragment*) header;
-
-            nxt = fragment_header->ip6_frag_nxt;
-            if (!list_contains_value(nxt_seen_list,nxt)) {
-                nxt_seen_list.push_back(nxt);
-            } else {
-                throw String("An error: we have seen the fragment header twice");
+            if (offset + (int) sizeof(click_ip6_fragment) > length || (flags & EXTHDR_FRAGMENT)) {
+                return -1;
             }
-            fragment_header++;
-            header = (void*) fragment_header;
-        } else if (nxt == 60) {
-            click_ip6_dest *destination_header = (click_ip6_dest*) header;
-
-	    nxt = destination_header->ip6d_nxt;
-            if (!list_contains_value(nxt_seen_list,nxt)) {
-                nxt_seen_list.push_back(nxt);
-            } else {
-                throw String("An error: we have seen the routing header twice");
+            const click_ip6_fragment *fragment_header = (const click_ip6_fragment*) (network_header + offset);
+            flags |= EXTHDR_FRAGMENT;
+            fragment_offset = offset;
+            nxt = fragment_header->ip6_frag_nxt;
+            offset += sizeof(click_ip6_fragment);
+            if (fragment_header->ip6_frag_offset & htons(IP6_OFFMASK)) {
+                flags |= EXTHDR_LATER_FRAGMENT;
+                break;
             }
-            destination_header = destination_header + destination_header->ip6d_len + 1;
-            header = (void*) destination_header;
         } else {
-            if (nxt == 0) {
-                throw String("We enountered a a Hop by Hop header but it was not the first header, this is not allowed");
-            }
-            click_chatter("we gaan %u returnen", nxt);
-            return nxt; // nothing went wrong, send the thing back
+            break;
         }
     }
+    if (offset > length) {
+        return -1;
+    }
+    protocol = nxt;
+    transport_offset = offset;
+    return flags;
 }
-    
-// This function checks whether the next value list, contains the given next value
-uint8_t list_contains_value(Vector<uint8_t> list, uint8_t nxt) {
-    for(int i = 0; i < list.size(); i++) {
-        if (list[i] == nxt) {
-            return true;
-        }
+
+/** @brief Walks the extension header chain of the packet once and caches the result in its IP6_EXTHDR annotations.
+  * Also sets the packet's transport header pointer, so that the network header length is the length of the IPv6 header
+  * and all of its extension headers, or the length of the whole packet for a fragment whose offset is not 0.
+  * The annotations also record the network header's offset in the buffer; together with the network header length, this
+  * is how cached_exthdr_flags() notices annotations that no longer describe the packet.
+  * @return true on success, false when the chain is malformed; the annotations are then marked invalid
+  */
+bool mark_transport_header(Packet *packet) {
+    uint8_t protocol;
+    int transport_offset, fragment_offset;
+    int flags = walk_extension_headers(packet, protocol, transport_offset, fragment_offset);
+    if (flags < 0) {
+        SET_IP6_EXTHDR_FLAGS_ANNO(packet, 0);
+        return false;
+    }
+    if (flags & EXTHDR_LATER_FRAGMENT) {
+        // no higher layer header: let the transport header start at the end of the packet, so that compiled transport
+        // layer tests see a packet that is too short
+        packet->set_network_header(packet->network_header(), packet->end_data() - packet->network_header());
+    } else {
+        packet->set_network_header(packet->network_header(), transport_offset);
+    }
+    int network_offset = packet->network_header() - packet->buffer();
+    if (network_offset > 0xFFFF) {
+        flags = 0;      // cannot be recorded, so the helpers walk the chain themselves
+    }
+    SET_IP6_PROTO_ANNO(packet, protocol);
+    SET_IP6_EXTHDR_FLAGS_ANNO(packet, flags);
+    SET_IP6_TRANSPORT_OFFSET_ANNO(packet, transport_offset);
+    SET_IP6_FRAG_OFFSET_ANNO(packet, fragment_offset);
+    SET_IP6_NETWORK_OFFSET_ANNO(packet, network_offset);
+    return true;
+}
+
+/** @brief Returns the higher layer protocol of this IPv6 packet.
+  * In case extension headers are present, follow the extension
+  * header chain to return the higher layer protocol. When the packet
+  * went through MarkIP6Transport, its annotations are used instead.
+  *
+  * @return the protocol, or 255 (a reserved value) when the extension header chain is malformed
+  */
+uint8_t get_higher_layer_protocol(Packet *packet) {
+    if (cached_exthdr_flags(packet)) {
+        return IP6_PROTO_ANNO(packet);
+    }
+    uint8_t protocol;
+    int transport_offset, fragment_offset;
+    if (walk_extension_headers(packet, protocol, transport_offset, fragment_offset) < 0) {
+        return 255;
+    }
+    return protocol;
+}
+
+/** @brief Returns a pointer to the higher layer header of this IPv6 packet, following the extension header chain.
+  * When the packet went through MarkIP6Transport, its annotations are used instead.
+  * @return the higher layer header, or null when the chain is malformed or when the packet is a fragment whose offset is
+  *         not 0
+  */
+const unsigned char *get_transport_header(Packet *packet) {
+    int flags = cached_exthdr_flags(packet), transport_offset;
+    if (flags) {
+        transport_offset = IP6_TRANSPORT_OFFSET_ANNO(packet);
+    } else {
+        uint8_t protocol;
+        int fragment_offset;
+        flags = walk_extension_headers(packet, protocol, transport_offset, fragment_offset);
+    }
+    if (flags < 0 || (flags & EXTHDR_LATER_FRAGMENT)) {
+        return 0;
     }
-    return false;
-}    
-    
+    return packet->network_header() + transport_offset;
+}
+
+/** @brief Returns true when the packet's transport header pointer is the higher layer header get_transport_header() finds.
+  * That holds after MarkIP6Transport (unless the packet is a fragment whose offset is not 0), and when the IPv6 header is
+  * directly followed by the higher layer header. Decision programs that test the transport header (IPFilter::offset_transp)
+  * may only be used on such packets.
+  */
+bool transport_header_is_exact(const Packet *packet) {
+    if (int flags = cached_exthdr_flags(packet)) {
+        return !(flags & EXTHDR_LATER_FRAGMENT);
+    }
+    if (!packet->has_network_header() || packet->network_header_length() != sizeof(click_ip6)
+        || packet->network_length() < (int) sizeof(click_ip6)) {
+        return false;
+    }
+    uint8_t nxt = ((const click_ip6*) packet->network_header())->ip6_nxt;
+    return nxt != 0 && nxt != 43 && nxt != 44 && nxt != 60 && nxt != 51;
+}
+
 };
 
 CLICK_ENDDECLS
@@ -1,17 +1,28 @@
 #ifndef CLICK_IP6HELPERS_HH
 #define CLICK_IP6HELPERS_HH
 #include <click/packet.hh>
+#include <clicknet/ip6.h>
 #include <click/vector.hh>
 CLICK_DECLS
 
 namespace ip6 {
+    // flags in the IP6_EXTHDR_FLAGS annotation
+    enum {
+        EXTHDR_VALID = 1,               // the IP6_EXTHDR annotations describe the extension header chain of the packet at
+                                        // IP6_NETWORK_OFFSET_ANNO
+        EXTHDR_FRAGMENT = 2,            // the packet has a fragmentation header, at IP6_FRAG_OFFSET_ANNO
+        EXTHDR_LATER_FRAGMENT = 4       // the fragment offset is not 0, so the packet has no higher layer header
+    };
+
     // public functions
     void get_ip6_fragmentation_header(click_ip6_fragment *fragmentation_header, click_ip6 *ip6_header);
     bool has_fragmentation_extension_header(Packet *packet);
+    int find_fragmentation_extension_header(const Packet *packet, int &prev_nxt_offset);
     uint8_t get_higher_layer_protocol(Packet *packet);
-    
-    // functions that should only be accessible from functions in the ip6 namespace
-    uint8_t list_contains_value(Vector<uint8_t> list, uint8_t nxt);
+    const unsigned char *get_transport_header(Packet *packet);
+    bool transport_header_is_exact(const Packet *packet);
+    int walk_extension_headers(const Packet *packet, uint8_t &protocol, int &transport_offset, int &fragment_offset);
+    bool mark_transport_header(Packet *packet);
 };
 
 CLICK_DECLS
@@ -0,0 +1,345 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * ip6reassembler.{cc,hh} -- defragments IPv6 packets
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "ip6reassembler.hh"
+#include "ip6helpers.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/packet_anno.hh>
+#include <click/straccum.hh>
+CLICK_DECLS
+
+// the fragmentable part bytes a held fragment carries, which are the last
+// bytes of the packet
+#define FRAG_OFF(p)		((p)->anno_u16(IPREASSEMBLER_ANNO_OFFSET))
+#define FRAG_LEN(p)		((p)->anno_u16(IPREASSEMBLER_ANNO_OFFSET + 2))
+#define FRAG_DATA(p)		((p)->end_data() - FRAG_LEN(p))
+
+IP6Reassembler::IP6Reassembler()
+    : _index(-1), _free(-1), _oldest(-1), _newest(-1), _nsegments(0),
+      _timer(this), _mem_used(0), _stat_frags_seen(0), _stat_good_assem(0),
+      _stat_failed_assem(0), _stat_bad_pkts(0)
+{
+    static_assert(IPREASSEMBLER_ANNO_OFFSET + IPREASSEMBLER_ANNO_SIZE <= Packet::anno_size, "anno too big");
+    static_assert(IPREASSEMBLER_ANNO_SIZE >= 4, "IPREASSEMBLER_ANNO_SIZE is expected to hold two uint16_t.");
+}
+
+IP6Reassembler::~IP6Reassembler()
+{
+}
+
+int
+IP6Reassembler::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    _mem_high_thresh = 256 * 1024;
+    _max_segments = 1024;
+    _timeout = Timestamp(60);
+    if (Args(conf, this, errh)
+	.read("HIMEM", _mem_high_thresh)
+	.read("MAX_PACKETS", _max_segments)
+	.read("TIMEOUT", _timeout)
+	.complete() < 0)
+	return -1;
+    if (_max_segments == 0)
+	return errh->error("MAX_PACKETS must be positive");
+    _mem_low_thresh = (_mem_high_thresh >> 2) * 3;
+    return 0;
+}
+
+int
+IP6Reassembler::initialize(ErrorHandler *)
+{
+    _segments.resize(_max_segments);
+    for (int i = 0; i < _segments.size(); i++)
+	_segments[i].next = i + 1;
+    _segments.back().next = -1;
+    _free = 0;
+    _index.rehash(_max_segments);
+    _timer.initialize(this);
+    return 0;
+}
+
+void
+IP6Reassembler::cleanup(CleanupStage)
+{
+    while (_oldest >= 0)
+	free_segment(_oldest);
+}
+
+int
+IP6Reassembler::make_segment(const SegmentKey &key)
+{
+    if (_free < 0)
+	drop_segment(_oldest);
+
+    int i = _free;
+    Segment &s = _segments[i];
+    _free = s.next;
+
+    s.key = key;
+    s.head = s.tail = 0;
+    s.total_length = -1;
+    s.received = 0;
+    s.mem_used = 0;
+    s.expiry = Timestamp::now_steady() + _timeout;
+    s.prev = _newest;
+    s.next = -1;
+    if (_newest >= 0)
+	_segments[_newest].next = i;
+    else
+	_oldest = i;
+    _newest = i;
+    _index.set(key, i);
+    _nsegments++;
+
+    if (!_timer.scheduled())
+	_timer.schedule_at_steady(s.expiry);
+    return i;
+}
+
+void
+IP6Reassembler::free_segment(int i)
+{
+    Segment &s = _segments[i];
+    while (Packet *p = s.head) {
+	s.head = p->next();
+	p->kill();
+    }
+
+    if (s.prev >= 0)
+	_segments[s.prev].next = s.next;
+    else
+	_oldest = s.next;
+    if (s.next >= 0)
+	_segments[s.next].prev = s.prev;
+    else
+	_newest = s.prev;
+    s.next = _free;
+    _free = i;
+
+    _index.erase(s.key);
+    _mem_used -= s.mem_used;
+    _nsegments--;
+}
+
+void
+IP6Reassembler::drop_segment(int i)
+{
+    ++_stat_failed_assem;
+
+    // keep the first fragment, which a Time Exceeded message quotes
+    Segment &s = _segments[i];
+    Packet *first = 0;
+    if (noutputs() > 1 && s.head && FRAG_OFF(s.head) == 0) {
+	first = s.head;
+	s.head = first->next();
+	first->set_next(0);
+	first->set_prev(0);
+	first->set_anno_u32(IPREASSEMBLER_ANNO_OFFSET, 0);
+    }
+    free_segment(i);
+
+    if (first)
+	output(1).push(first);
+}
+
+// Links p, which carries fragmentable part bytes [off, off + len), into the
+// offset-ordered fragment list of s. Returns 1 if p was added, 0 if it was a
+// duplicate (p is killed), or -1 if it is inconsistent with the fragments
+// already held.
+int
+IP6Reassembler::add_fragment(Segment &s, Packet *p, int off, int len, bool more)
+{
+    if (!more) {
+	if ((s.total_length >= 0 && s.total_length != off + len)
+	    || (s.tail && FRAG_OFF(s.tail) + FRAG_LEN(s.tail) > off + len))
+	    return -1;
+	s.total_length = off + len;
+    } else if (s.total_length >= 0 && off + len > s.total_length)
+	return -1;
+
+    // in-order fragments go right after the tail
+    Packet *prev = s.tail;
+    while (prev && FRAG_OFF(prev) > off)
+	prev = prev->prev();
+    Packet *next = (prev ? prev->next() : s.head);
+
+    if (prev && FRAG_OFF(prev) == off && FRAG_LEN(prev) == len) {
+	p->kill();
+	return 0;
+    }
+    // RFC 5722: overlapping fragments discard the whole packet
+    if ((prev && FRAG_OFF(prev) + FRAG_LEN(prev) > off)
+	|| (next && off + len > FRAG_OFF(next)))
+	return -1;
+
+    p->set_anno_u16(IPREASSEMBLER_ANNO_OFFSET, off);
+    p->set_anno_u16(IPREASSEMBLER_ANNO_OFFSET + 2, len);
+    p->set_prev(prev);
+    p->set_next(next);
+    if (prev)
+	prev->set_next(p);
+    else
+	s.head = p;
+    if (next)
+	next->set_prev(p);
+    else
+	s.tail = p;
+
+    s.received += len;
+    s.mem_used += FRAG_MEM_USED + p->length();
+    _mem_used += FRAG_MEM_USED + p->length();
+    return 1;
+}
+
+Packet *
+IP6Reassembler::emit_whole_packet(int i, Packet *p_in)
+{
+    Segment &s = _segments[i];
+    Packet *first = s.head;
+
+    // the unfragmentable part, and the next header value of the fragmentable
+    // part, come from the first fragment
+    int prev_nxt_offset;
+    int frag_offset = ip6::find_fragmentation_extension_header(first, prev_nxt_offset);
+    const click_ip6_fragment *fragh = (const click_ip6_fragment *) (first->network_header() + frag_offset);
+    int header_length = first->network_header_offset() + frag_offset;
+
+    WritablePacket *q = Packet::make(first->headroom(), 0, header_length + s.total_length, 0);
+    if (!q) {
+	click_chatter("out of memory");
+	drop_segment(i);
+	return 0;
+    }
+
+    // copy each fragment once
+    memcpy(q->data(), first->data(), header_length);
+    for (Packet *f = first; f; f = f->next())
+	memcpy(q->data() + header_length + FRAG_OFF(f), FRAG_DATA(f), FRAG_LEN(f));
+
+    click_ip6 *q_iph = (click_ip6 *) (q->data() + first->network_header_offset());
+    ((uint8_t *) q_iph)[prev_nxt_offset] = fragh->ip6_frag_nxt;
+    q_iph->ip6_plen = htons(frag_offset - sizeof(click_ip6) + s.total_length);
+    q->set_ip6_header(q_iph);
+    if (first->has_mac_header() && first->mac_header_offset() >= 0)
+	q->set_mac_header(q->data() + first->mac_header_offset(), first->mac_header_length());
+
+    // zero out the annotations we used
+    q->copy_annotations(first);
+    q->set_anno_u32(IPREASSEMBLER_ANNO_OFFSET, 0);
+    SET_IP6_EXTHDR_FLAGS_ANNO(q, 0);	// the fragmentation header is gone
+    q->set_timestamp_anno(p_in->timestamp_anno());
+    q->set_next(0);
+    q->set_prev(0);
+
+    ++_stat_good_assem;
+    free_segment(i);
+    return q;
+}
+
+Packet *
+IP6Reassembler::simple_action(Packet *p)
+{
+    // check common case: not a fragment
+    assert(p->has_network_header());
+    int prev_nxt_offset;
+    int frag_offset = ip6::find_fragmentation_extension_header(p, prev_nxt_offset);
+    if (frag_offset < 0)
+	return p;
+
+    ++_stat_frags_seen;
+
+    // calculate fragment edges
+    const click_ip6 *iph = p->ip6_header();
+    const click_ip6_fragment *fragh = (const click_ip6_fragment *) (p->network_header() + frag_offset);
+    int network_length = sizeof(click_ip6) + ntohs(iph->ip6_plen);
+    int off = ntohs(fragh->ip6_frag_offset) & IP6_OFFMASK;
+    bool more = fragh->ip6_frag_offset & htons(IP6_MF);
+    int len = network_length - frag_offset - (int) sizeof(click_ip6_fragment);
+
+    // check uncommon, but annoying, case: bad length, bad length + offset,
+    // or middle fragment length not a multiple of 8 bytes
+    if (iph->ip6_plen == 0 || len <= 0 || off + len > 0xFFFF
+	|| (more && (len & 7) != 0)
+	|| p->network_length() < network_length) {
+	p->kill();
+	++_stat_bad_pkts;
+	return 0;
+    }
+    p->take(p->network_length() - network_length);
+
+    // clean up memory if necessary
+    while (_mem_used > _mem_high_thresh && _oldest >= 0) {
+	drop_segment(_oldest);
+	if (_mem_used <= _mem_low_thresh)
+	    break;
+    }
+
+    // get its segment
+    SegmentKey key(iph, fragh);
+    int i = _index.get(key);
+    if (i < 0)
+	i = make_segment(key);
+
+    int added = add_fragment(_segments[i], p, off, len, more);
+    if (added < 0) {
+	p->kill();
+	++_stat_bad_pkts;
+	drop_segment(i);
+	return 0;
+    }
+
+    // Are we done with this packet?
+    Segment &s = _segments[i];
+    if (added && s.received == s.total_length)
+	return emit_whole_packet(i, p);
+    return 0;
+}
+
+void
+IP6Reassembler::run_timer(Timer *)
+{
+    Timestamp now = Timestamp::now_steady();
+    while (_oldest >= 0 && _segments[_oldest].expiry <= now)
+	drop_segment(_oldest);
+    if (_oldest >= 0)
+	_timer.schedule_at_steady(_segments[_oldest].expiry);
+}
+
+String
+IP6Reassembler::read_handler(Element *e, void *)
+{
+    IP6Reassembler *r = static_cast<IP6Reassembler *>(e);
+    StringAccum sa;
+    sa <<
+	"frags seen total:    " << r->_stat_frags_seen << "\n"
+	"good reassemblies:   " << r->_stat_good_assem << "\n"
+	"failed reassemblies: " << r->_stat_failed_assem << "\n"
+	"bad fragments seen:  " << r->_stat_bad_pkts << "\n"
+	"packets in progress: " << r->_nsegments << "\n"
+	"memory used:         " << r->_mem_used << "\n";
+    return sa.take_string();
+}
+
+void
+IP6Reassembler::add_handlers()
+{
+    add_read_handler("stats", read_handler);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(IP6Helpers)
+EXPORT_ELEMENT(IP6Reassembler)
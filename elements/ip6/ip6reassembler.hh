@@ -0,0 +1,163 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_IP6REASSEMBLER_HH
+#define CLICK_IP6REASSEMBLER_HH
+#include <click/element.hh>
+#include <click/glue.hh>
+#include <click/ip6address.hh>
+#include <click/hashtable.hh>
+#include <click/timer.hh>
+#include <clicknet/ip6.h>
+CLICK_DECLS
+
+/*
+=c
+
+IP6Reassembler([I<KEYWORDS>])
+
+=s ip6
+
+Reassembles fragmented IPv6 packets
+
+=d
+
+Expects IPv6 packets with their network header annotation set as input to
+port 0. Packets without a fragmentation extension header are emitted
+unchanged on output 0. Fragments are held until all fragments of their packet
+have arrived; the reassembled packet, whose unfragmentable part and MAC header
+are those of the fragment with offset 0, is then emitted on output 0.
+
+Fragments of a packet are kept as they are received, in offset order, and
+copied once into the reassembled packet, so fragments that arrive in order
+cost a single copy each.
+
+A packet that is not completely reassembled TIMEOUT seconds after its first
+fragment arrived is dropped. Packets that overlap (RFC 5722), are
+inconsistent, or are evicted to bound memory usage are dropped too. If
+IP6Reassembler has two outputs, the fragment with offset 0 of every dropped
+packet, when it was received, is pushed onto output 1 instead, for instance to
+generate an ICMPv6 Time Exceeded message.
+
+IP6Reassembler's memory usage is bounded. At most MAX_PACKETS packets are
+reassembled at a time; their state lives in a fixed arena indexed by a hash
+table on (source, destination, identification). When the fragments held use
+more than HIMEM bytes, or the arena is full, IP6Reassembler drops the oldest
+packets being reassembled until memory consumption drops below 3/4*HIMEM
+bytes and a slot is free.
+
+Keyword arguments are:
+
+=over 8
+
+=item HIMEM
+
+The upper bound for memory consumption, in bytes. Default is 256K.
+
+=item MAX_PACKETS
+
+The maximum number of packets being reassembled at a time. Default is 1024.
+
+=item TIMEOUT
+
+Timestamp. The time a packet may take to be reassembled. Default is 60
+seconds (RFC 8200).
+
+=back
+
+=n
+
+The IPREASSEMBLER annotation area is used to store fragment metadata; on
+emitted reassembled packets, this annotation area is set to 0, and the
+extension header annotations set by MarkIP6Transport are marked invalid.
+
+IP6Reassembler destroys its input packets' "next packet" and "previous
+packet" annotations.
+
+=h stats read-only
+
+Returns statistics: fragments seen, packets reassembled, packets dropped and
+bad fragments, with the number of packets being reassembled and the memory
+they use.
+
+=a IPReassembler, IP6Fragmenter, MarkIP6Transport */
+
+class IP6Reassembler : public Element { public:
+
+    IP6Reassembler() CLICK_COLD;
+    ~IP6Reassembler() CLICK_COLD;
+
+    const char *class_name() const	{ return "IP6Reassembler"; }
+    const char *port_count() const	{ return PORTS_1_1X2; }
+    const char *processing() const	{ return PROCESSING_A_AH; }
+
+    int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
+    int initialize(ErrorHandler *) CLICK_COLD;
+    void cleanup(CleanupStage) CLICK_COLD;
+    void add_handlers() CLICK_COLD;
+
+    Packet *simple_action(Packet *);
+    void run_timer(Timer *);
+
+  private:
+
+    enum { FRAG_MEM_USED = 64 };	// overhead charged per fragment
+
+    struct SegmentKey {
+	IP6Address src;
+	IP6Address dst;
+	uint32_t id;
+	SegmentKey() : id(0) { }
+	SegmentKey(const click_ip6 *iph, const click_ip6_fragment *fragh)
+	    : src(iph->ip6_src), dst(iph->ip6_dst), id(fragh->ip6_frag_id) { }
+	hashcode_t hashcode() const {
+	    return src.hashcode() ^ (dst.hashcode() << 7) ^ id;
+	}
+	bool operator==(const SegmentKey &x) const {
+	    return id == x.id && src == x.src && dst == x.dst;
+	}
+    };
+
+    // A packet being reassembled. Segments live in _segments; unused ones
+    // are linked through next from _free, used ones through prev/next in
+    // the order they were created, which is also the order they expire in.
+    struct Segment {
+	SegmentKey key;
+	Packet *head;		// fragments, linked in offset order
+	Packet *tail;
+	int total_length;	// of the fragmentable part, -1 if unknown
+	int received;		// fragmentable part bytes received
+	uint32_t mem_used;
+	Timestamp expiry;
+	int prev;
+	int next;
+    };
+
+    Vector<Segment> _segments;
+    HashTable<SegmentKey, int> _index;
+    int _free;
+    int _oldest;
+    int _newest;
+    int _nsegments;
+    Timer _timer;
+
+    uint32_t _max_segments;
+    uint32_t _mem_used;
+    uint32_t _mem_high_thresh;
+    uint32_t _mem_low_thresh;
+    Timestamp _timeout;
+
+    uint32_t _stat_frags_seen;
+    uint32_t _stat_good_assem;
+    uint32_t _stat_failed_assem;
+    uint32_t _stat_bad_pkts;
+
+    int make_segment(const SegmentKey &key);
+    int add_fragment(Segment &s, Packet *p, int off, int len, bool more);
+    Packet *emit_whole_packet(int i, Packet *p_in);
+    void drop_segment(int i);
+    void free_segment(int i);
+    static String read_handler(Element *, void *) CLICK_COLD;
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -0,0 +1,505 @@
+// -*- mode: c++; c-basic-offset: 4 -*-
+/*
+ * ip6rewriter.{cc,hh} -- rewrites IPv6 packet source and destination
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "ip6rewriter.hh"
+#include "ip6helpers.hh"
+#include <click/args.hh>
+#include <click/straccum.hh>
+#include <click/error.hh>
+#include <click/algorithm.hh>
+#include <clicknet/ip6.h>
+#include <clicknet/tcp.h>
+#include <clicknet/udp.h>
+CLICK_DECLS
+
+//
+// IP6RewriterFlow
+//
+
+IP6RewriterFlow::IP6RewriterFlow(IPRewriterInput *owner,
+				 const IP6FlowID &flowid,
+				 const IP6FlowID &rewritten_flowid,
+				 uint8_t ip_p, bool guaranteed,
+				 click_jiffies_t expiry_j)
+    : IPRewriterFlow(owner, IPFlowID(), IPFlowID(), ip_p, guaranteed, expiry_j)
+{
+    _e6[0].initialize(flowid, owner->foutput, false);
+    _e6[1].initialize(rewritten_flowid.reverse(), owner->routput, true);
+
+    // IPv6 has no header checksum, but the transport checksum covers the
+    // addresses through the pseudo-header
+    const uint16_t *swords = reinterpret_cast<const uint16_t *>(&flowid);
+    const uint16_t *dwords = reinterpret_cast<const uint16_t *>(&rewritten_flowid);
+    _csum_delta = 0;
+    for (int i = 0; i < 18; ++i)
+	click_update_in_cksum(&_csum_delta, swords[i], dwords[i]);
+}
+
+void
+IP6RewriterFlow::apply(WritablePacket *p, unsigned char *transport_header,
+		       uint8_t ip_p, bool direction)
+{
+    click_ip6 *ip6h = p->ip6_header();
+
+    // IPv6 header
+    const IP6FlowID &revflow = _e6[!direction].flowid();
+    ip6h->ip6_src = revflow.daddr().in6_addr();
+    ip6h->ip6_dst = revflow.saddr().in6_addr();
+
+    // UDP/TCP header
+    if (ip_p == IP_PROTO_TCP
+	&& transport_header + 18 <= p->end_data()) {
+	click_tcp *tcph = reinterpret_cast<click_tcp *>(transport_header);
+	tcph->th_sport = revflow.dport();
+	tcph->th_dport = revflow.sport();
+	update_csum(&tcph->th_sum, direction, _csum_delta);
+	if (tcph->th_flags & TH_RST)
+	    _tflags |= 3;
+	else if (tcph->th_flags & TH_FIN)
+	    _tflags |= 1 << direction;
+    } else if (ip_p == IP_PROTO_UDP) {
+	click_udp *udph = reinterpret_cast<click_udp *>(transport_header);
+	udph->uh_sport = revflow.dport();
+	udph->uh_dport = revflow.sport();
+	if (udph->uh_sum)	// 0 checksum is no checksum
+	    update_csum(&udph->uh_sum, direction, _csum_delta);
+    }
+}
+
+void
+IP6RewriterFlow::unparse(StringAccum &sa, bool direction,
+			 click_jiffies_t now) const
+{
+    sa << _e6[direction].flowid().unparse() << " => "
+       << _e6[direction].rewritten_flowid().unparse();
+    unparse_ports(sa, direction, now);
+}
+
+//
+// IP6RewriterPattern
+//
+
+IP6RewriterPattern::IP6RewriterPattern()
+    : _sport(0), _dport(0), _variation_top(0), _next_variation(0),
+      _sequential(false), _same_first(true), _npt(false),
+      _npt_prefix_len(0), _npt_adjustment(0)
+{
+}
+
+static inline uint16_t
+ones_add(uint32_t a, uint32_t b)
+{
+    a += b;
+    return (a & 0xFFFF) + (a >> 16);
+}
+
+static uint16_t
+prefix_sum(const IP6Address &prefix)
+{
+    uint16_t sum = 0;
+    for (int i = 0; i < 8; ++i)
+	sum = ones_add(sum, ntohs(prefix.data16()[i]));
+    return sum;
+}
+
+bool
+IP6RewriterPattern::parse_with_ports(const String &word, const String &str,
+				     IPRewriterInput *input, Element *context,
+				     ErrorHandler *errh)
+{
+    Vector<String> words, port_words;
+    cp_spacevec(str, words);
+
+    if (word == "nptv6" ? words.size() != 4 : words.size() != 6)
+	return errh->error("syntax error"), false;
+    port_words.push_back(words[words.size() - 2]);
+    port_words.push_back(words[words.size() - 1]);
+    words.resize(words.size() - 2);
+    if (!IPRewriterPattern::parse_ports(port_words, input, context, errh))
+	return false;
+
+    IP6RewriterPattern *pat = new IP6RewriterPattern;
+    if (word == "nptv6") {
+	int internal_len, external_len;
+	if (!IP6PrefixArg().parse(words[0], pat->_saddr, internal_len, context))
+	    errh->error("bad internal prefix");
+	else if (!IP6PrefixArg().parse(words[1], pat->_daddr, external_len, context))
+	    errh->error("bad external prefix");
+	else if (internal_len != external_len || internal_len > 64)
+	    errh->error("prefixes must have the same length, at most 64");
+	else {
+	    pat->_npt = true;
+	    pat->_npt_prefix_len = internal_len;
+	    pat->_npt_mask = IP6Address::make_prefix(internal_len);
+	    pat->_saddr &= pat->_npt_mask;
+	    pat->_daddr &= pat->_npt_mask;
+	    // RFC 6296 section 3.1: adding the difference of the prefixes'
+	    // checksums to one word keeps the address checksum unchanged
+	    pat->_npt_adjustment = ones_add(prefix_sum(pat->_saddr),
+					    ~prefix_sum(pat->_daddr) & 0xFFFF);
+	    input->u.pattern = pat;
+	    return true;
+	}
+	delete pat;
+	return false;
+    }
+
+    // NAT66 pattern: SADDR SPORT DADDR DPORT
+    int32_t sport = 0, dport = 0, port2;
+    const String &sp = words[1];
+    const char *end = sp.end();
+    if (end > sp.begin() && end[-1] == '#')
+	pat->_sequential = true, pat->_same_first = false, --end;
+    else if (end > sp.begin() && end[-1] == '?')
+	pat->_same_first = false, --end;
+    const char *dash = find(sp.begin(), end, '-');
+
+    if (!(words[0].equals("-", 1)
+	  || IP6AddressArg().parse(words[0], pat->_saddr, context)))
+	errh->error("bad source address");
+    else if (!(sp.equals("-", 1)
+	       || (dash == end
+		   && IntArg().parse(sp.substring(sp.begin(), end), sport)
+		   && sport > 0 && sport < 65536)
+	       || (dash != end
+		   && IntArg().parse(sp.substring(sp.begin(), dash), sport)
+		   && IntArg().parse(sp.substring(dash + 1, end), port2)
+		   && sport > 0 && port2 >= sport && port2 < 65536
+		   && ((pat->_variation_top = port2 - sport), true))))
+	errh->error("bad source port");
+    else if (!(words[2].equals("-", 1)
+	       || IP6AddressArg().parse(words[2], pat->_daddr, context)))
+	errh->error("bad destination address");
+    else if (!(words[3].equals("-", 1)
+	       || (IntArg().parse(words[3], dport) && dport > 0 && dport < 65536)))
+	errh->error("bad destination port");
+    else {
+	pat->_sport = htons(sport);
+	pat->_dport = htons(dport);
+	input->u.pattern = pat;
+	return true;
+    }
+    delete pat;
+    return false;
+}
+
+bool
+IP6RewriterPattern::rewrite_npt(IP6Address &addr) const
+{
+    if (!addr.matches_prefix(_saddr, _npt_mask))
+	return false;
+    uint16_t *a = addr.data16();
+    const uint16_t *m = _npt_mask.data16(), *x = _daddr.data16();
+    for (int i = 0; i < 8; ++i)
+	a[i] = (a[i] & ~m[i]) | x[i];
+
+    // a /48 or shorter prefix adjusts the subnet word; longer prefixes
+    // adjust the first interface identifier word that is not 0xFFFF
+    int w = 3;
+    if (_npt_prefix_len > 48)
+	for (w = 4; w < 8 && a[w] == 0xFFFF; ++w)
+	    /* nada */;
+    if (w == 8 || a[w] == 0xFFFF)
+	return false;
+    uint16_t v = ones_add(ntohs(a[w]), _npt_adjustment);
+    a[w] = htons(v == 0xFFFF ? 0 : v);
+    return true;
+}
+
+int
+IP6RewriterPattern::rewrite_flowid(const IP6FlowID &flowid,
+				   IP6FlowID &rewritten_flowid,
+				   const HashContainer<IP6RewriterEntry> &reply_map)
+{
+    rewritten_flowid = flowid;
+    if (_npt) {
+	IP6Address saddr = flowid.saddr();
+	if (!rewrite_npt(saddr))
+	    return IPRewriterBase::rw_drop;
+	rewritten_flowid.set_saddr(saddr);
+	return IPRewriterBase::rw_addmap;
+    }
+
+    if (_saddr)
+	rewritten_flowid.set_saddr(_saddr);
+    if (_sport)
+	rewritten_flowid.set_sport(_sport);
+    if (_daddr)
+	rewritten_flowid.set_daddr(_daddr);
+    if (_dport)
+	rewritten_flowid.set_dport(_dport);
+
+    if (_variation_top) {
+	IP6FlowID lookup = rewritten_flowid.reverse();
+	uint32_t base = ntohs(_sport);
+
+	uint32_t val;
+	if (_same_first
+	    && (val = ntohs(flowid.sport()) - base) <= _variation_top) {
+	    lookup.set_dport(flowid.sport());
+	    if (!reply_map.find(lookup))
+		goto found_variation;
+	}
+
+	if (_sequential)
+	    val = (_next_variation > _variation_top ? 0 : _next_variation);
+	else
+	    val = click_random(0, _variation_top);
+
+	for (uint32_t count = 0; count <= _variation_top;
+	     ++count, val = (val == _variation_top ? 0 : val + 1)) {
+	    lookup.set_dport(htons(base + val));
+	    if (!reply_map.find(lookup))
+		goto found_variation;
+	}
+
+	return IPRewriterBase::rw_drop;
+
+    found_variation:
+	rewritten_flowid.set_sport(lookup.dport());
+	_next_variation = val + 1;
+    }
+
+    return IPRewriterBase::rw_addmap;
+}
+
+String
+IP6RewriterPattern::unparse() const
+{
+    StringAccum sa;
+    if (_npt) {
+	sa << "nptv6 " << _saddr << '/' << _npt_prefix_len
+	   << ' ' << _daddr << '/' << _npt_prefix_len;
+	return sa.take_string();
+    }
+
+    if (_saddr)
+	sa << _saddr;
+    else
+	sa << '-';
+    if (!_sport)
+	sa << " -";
+    else if (_variation_top)
+	sa << ' ' << ntohs(_sport) << '-' << (ntohs(_sport) + _variation_top);
+    else
+	sa << ' ' << ntohs(_sport);
+    if (_daddr)
+	sa << ' ' << _daddr;
+    else
+	sa << " -";
+    if (!_dport)
+	sa << " -";
+    else
+	sa << ' ' << ntohs(_dport);
+    return sa.take_string();
+}
+
+//
+// IP6Rewriter
+//
+
+IP6Rewriter::IP6Rewriter()
+    : _map6(0), _udp_map6(0)
+{
+}
+
+IP6Rewriter::~IP6Rewriter()
+{
+}
+
+void *
+IP6Rewriter::cast(const char *n)
+{
+    if (strcmp(n, "IPRewriterBase") == 0)
+	return static_cast<IPRewriterBase *>(this);
+    else if (strcmp(n, "IP6Rewriter") == 0)
+	return this;
+    else
+	return 0;
+}
+
+int
+IP6Rewriter::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    _tcp_done_timeout = 240;	// 4 minutes
+
+    if (Args(this, errh).bind(conf)
+	.read("TCP_DONE_TIMEOUT", SecondsArg(), _tcp_done_timeout)
+	.consume() < 0)
+	return -1;
+
+    _tcp_done_timeout *= CLICK_HZ; // IPRewriterBase handles the others
+
+    return IPRewriterBase::configure(conf, errh);
+}
+
+int
+IP6Rewriter::parse_input_spec(const String &line, IPRewriterInput &is,
+			      int input_number, ErrorHandler *errh)
+{
+    String word, rest;
+    if (!cp_word(line, &word, &rest)
+	|| word == "pass" || word == "passthrough" || word == "nochange"
+	|| word == "keep" || word == "drop" || word == "discard")
+	return IPRewriterBase::parse_input_spec(line, is, input_number, errh);
+
+    PrefixErrorHandler cerrh(errh, "input spec " + String(input_number) + ": ");
+    if (word != "pattern" && word != "nptv6")
+	return cerrh.error("unknown specification");
+
+    is.kind = IPRewriterInput::i_drop;
+    is.owner = this;
+    is.owner_input = input_number;
+    is.reply_element = this;
+    cp_eat_space(rest);
+    if (!IP6RewriterPattern::parse_with_ports(word, rest, &is, this, &cerrh))
+	return -1;
+    is.u.pattern->use();
+    is.kind = IPRewriterInput::i_pattern;
+    if ((unsigned) is.foutput >= (unsigned) noutputs()
+	|| (unsigned) is.routput >= (unsigned) noutputs())
+	return cerrh.error("output port out of range");
+    return 0;
+}
+
+int
+IP6Rewriter::rewrite_flowid(IPRewriterInput &is, const IP6FlowID &flowid,
+			    IP6FlowID &rewritten_flowid, const Map6 &reply_map)
+{
+    switch (is.kind) {
+    case IPRewriterInput::i_nochange:
+	return is.foutput;
+    case IPRewriterInput::i_keep:
+	rewritten_flowid = flowid;
+	return rw_addmap;
+    case IPRewriterInput::i_pattern: {
+	IP6RewriterPattern *pat = static_cast<IP6RewriterPattern *>(is.u.pattern);
+	int i = pat->rewrite_flowid(flowid, rewritten_flowid, reply_map);
+	if (i == rw_drop)
+	    ++is.failures;
+	return i;
+    }
+    default:
+	return rw_drop;
+    }
+}
+
+IP6RewriterEntry *
+IP6Rewriter::add_flow(int ip_p, const IP6FlowID &flowid,
+		      const IP6FlowID &rewritten_flowid, int input)
+{
+    void *data;
+    if (!(data = _allocator.allocate()))
+	return 0;
+
+    IP6RewriterFlow *flow = new(data) IP6RewriterFlow
+	(&_input_specs[input], flowid, rewritten_flowid, ip_p,
+	 !!_timeouts[1], click_jiffies() + relevant_timeout(_timeouts));
+
+    Map6 &map = protocol_map(ip_p);
+    IP6RewriterEntry *old = map.set(&flow->entry6(false));
+    assert(!old);
+    old = map.set(&flow->entry6(true));
+    if (unlikely(old) && likely(old->flow() != flow))
+	old->flow()->destroy(_heap);
+
+    if (!store_flow_heap(flow, input, _heap))
+	return 0;
+
+    if (map.unbalanced())
+	map.rehash(map.bucket_count() + 1);
+    return &flow->entry6(false);
+}
+
+void
+IP6Rewriter::push(int port, Packet *p_in)
+{
+    WritablePacket *p = p_in->uniqueify();
+    if (!p)
+	return;
+
+    // handle non-TCP and non-UDP packets and non-first fragments
+    uint8_t ip_p = ip6::get_higher_layer_protocol(p);
+    unsigned char *th = const_cast<unsigned char *>(ip6::get_transport_header(p));
+    if ((ip_p != IP_PROTO_TCP && ip_p != IP_PROTO_UDP)
+	|| !th || th + 8 > p->end_data()) {
+	const IPRewriterInput &is = _input_specs[port];
+	if (is.kind == IPRewriterInput::i_nochange)
+	    output(is.foutput).push(p);
+	else
+	    p->kill();
+	return;
+    }
+
+    const click_ip6 *ip6h = p->ip6_header();
+    const click_udp *udph = reinterpret_cast<const click_udp *>(th);
+    IP6FlowID flowid(IP6Address(ip6h->ip6_src), udph->uh_sport,
+		     IP6Address(ip6h->ip6_dst), udph->uh_dport);
+    // TCP and UDP flows with the same addresses and ports are different flows
+    Map6 &map = protocol_map(ip_p);
+    IP6RewriterEntry *m = map.get(flowid);
+
+    if (!m) {			// create new mapping
+	IPRewriterInput &is = _input_specs.unchecked_at(port);
+	IP6FlowID rewritten_flowid = IP6FlowID::uninitialized_t();
+	int result = rewrite_flowid(is, flowid, rewritten_flowid, map);
+	if (result == rw_addmap)
+	    m = add_flow(ip_p, flowid, rewritten_flowid, port);
+	if (!m) {
+	    checked_output_push(result, p);
+	    return;
+	}
+    }
+
+    IP6RewriterFlow *mf = m->flow();
+    mf->apply(p, th, ip_p, m->direction());
+
+    click_jiffies_t now_j = click_jiffies();
+    if (_timeouts[1])
+	mf->change_expiry(_heap, true, now_j + _timeouts[1]);
+    else
+	mf->change_expiry(_heap, false, now_j + flow_timeout(mf));
+
+    output(m->output()).push(p);
+}
+
+String
+IP6Rewriter::table_handler(Element *e, void *)
+{
+    IP6Rewriter *rw = static_cast<IP6Rewriter *>(e);
+    click_jiffies_t now = click_jiffies();
+    StringAccum sa;
+    for (Map6::iterator iter = rw->_map6.begin(); iter.live(); ++iter) {
+	iter->flow()->unparse(sa, iter->direction(), now);
+	sa << '\n';
+    }
+    for (Map6::iterator iter = rw->_udp_map6.begin(); iter.live(); ++iter) {
+	iter->flow()->unparse(sa, iter->direction(), now);
+	sa << '\n';
+    }
+    return sa.take_string();
+}
+
+void
+IP6Rewriter::add_handlers()
+{
+    add_read_handler("table", table_handler);
+    add_rewriter_handlers(true);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(IPRewriterBase IP6Helpers)
+EXPORT_ELEMENT(IP6Rewriter)
@@ -0,0 +1,337 @@
+// -*- mode: c++; c-basic-offset: 4 -*-
+#ifndef CLICK_IP6REWRITER_HH
+#define CLICK_IP6REWRITER_HH
+#include "elements/ip/iprewriterbase.hh"
+#include "elements/ip/iprwmapping.hh"
+#include "elements/ip/iprwpattern.hh"
+#include <click/ip6flowid.hh>
+CLICK_DECLS
+class IP6RewriterFlow;
+
+/*
+=c
+
+IP6Rewriter(INPUTSPEC1, ..., INPUTSPECn [, I<keywords>])
+
+=s nat
+
+rewrites IPv6 TCP/UDP packets' addresses and ports
+
+=d
+
+Rewrites the source address, source port, destination address, and/or
+destination port on IPv6 TCP and UDP packets, along with their checksums.
+IP6Rewriter implements NAT66, a network address/port translator for IPv6, and
+NPTv6, IPv6-to-IPv6 network prefix translation (RFC 6296).
+
+IP6Rewriter is the IPv6 counterpart of UDPRewriter, and shares its mapping
+machinery: hash tables indexed by flow identifier, one for TCP and one for
+UDP, guaranteed and
+best-effort flow classes with heap-based expiration, the MAPPING_CAPACITY
+bound, and periodic reaping.  A mapping is written as follows:
+
+    (SA, SP, DA, DP) => (SA', SP', DA', DP') [OUTPUT]
+
+When IP6Rewriter receives a packet, it first looks up that packet in the
+mapping table by flow identifier.  If the table contains a mapping for the
+input packet, then the packet is rewritten according to the mapping and
+emitted on the specified output port.  If there was no mapping, the packet is
+handled by the INPUTSPEC corresponding to the input port on which the packet
+arrived.  The forms of INPUTSPEC are:
+
+=over 5
+
+=item 'drop' or 'discard'
+
+Discards input packets.
+
+=item 'pass OUTPUT'
+
+Sends input packets to output port OUTPUT.  No mappings are installed.
+
+=item 'keep FOUTPUT ROUTPUT'
+
+Installs mappings that preserve the input packet's flow ID, sending the
+packet to FOUTPUT and packets from the reply flow to ROUTPUT.
+
+=item 'pattern SADDR SPORT DADDR DPORT FOUTPUT ROUTPUT'
+
+NAT66.  Creates a mapping according to the pattern 'SADDR SPORT DADDR DPORT'.
+Any pattern field may be a dash '-', in which case the packet's corresponding
+field is left unchanged.  SADDR and DADDR are IPv6 addresses.  SPORT may be a
+port range 'L-H'; IP6Rewriter will choose a source port in that range so that
+the resulting mappings don't conflict with any existing mappings.  As with
+UDPRewriter, the input packet's source port is preferred if it is available,
+a '#' suffix allocates ports sequentially, and a '?' suffix chooses a random
+port without preferring the source.
+
+=item 'nptv6 INTERNAL EXTERNAL FOUTPUT ROUTPUT'
+
+NPTv6.  INTERNAL and EXTERNAL are IPv6 prefixes of the same length, at most
+/64.  Packets whose source address is in INTERNAL have that prefix replaced by
+EXTERNAL, and one 16-bit word of the address adjusted as described in RFC
+6296, so that the translation is checksum-neutral.  Ports are unchanged.
+Packets whose source address is not in INTERNAL are dropped.
+
+=back
+
+IP6Rewriter has no mappings when first initialized.
+
+Input packets must have their IPv6 network header annotations set.  Extension
+headers are skipped, using the annotations set by MarkIP6Transport if
+present.  Non-TCP and UDP packets, and second and subsequent fragments, are
+dropped unless they arrive on a 'pass' input port.
+
+Keyword arguments are:
+
+=over 5
+
+=item TIMEOUT I<time>
+
+Time out connections every I<time> seconds. Default is 5 minutes.
+
+=item TCP_DONE_TIMEOUT I<time>
+
+Time out completed TCP connections every I<time> seconds. Default is 4
+minutes. FIN and RST flags mark TCP connections as complete.
+
+=item GUARANTEE I<time>
+
+Preserve each new mapping for at least I<time> seconds. Default is 5 seconds.
+
+=item REAP_INTERVAL I<time>
+
+Reap timed-out connections every I<time> seconds. Default is 15 minutes.
+
+=item MAPPING_CAPACITY I<capacity>
+
+Set the maximum number of mappings this rewriter can hold to I<capacity>.
+I<Capacity> can either be an integer or the name of another rewriter-like
+element, in which case this element will share the other element's capacity.
+
+=back
+
+=h table read-only
+
+Returns a human-readable description of the IP6Rewriter's current mapping
+table.
+
+=h table_size read-only
+
+Returns the number of mappings in the table.
+
+=h mapping_failures read-only
+
+Returns the number of packets for which no mapping could be installed.
+
+=h clear write-only
+
+Clears the mapping table.
+
+=a UDPRewriter, AddressTranslator, MarkIP6Transport */
+
+class IP6RewriterEntry { public:
+
+    typedef IP6FlowID key_type;
+    typedef const IP6FlowID &key_const_reference;
+
+    IP6RewriterEntry() {
+    }
+
+    void initialize(const IP6FlowID &flowid, uint32_t output, bool direction) {
+	assert(output <= 0xFFFFFF);
+	_flowid = flowid;
+	_output = output;
+	_direction = direction;
+	_hashnext = 0;
+    }
+
+    const IP6FlowID &flowid() const {
+	return _flowid;
+    }
+    inline IP6FlowID rewritten_flowid() const;
+
+    bool direction() const {
+	return _direction;
+    }
+
+    int output() const {
+	return _output;
+    }
+
+    inline IP6RewriterFlow *flow();
+
+    key_const_reference hashkey() const {
+	return _flowid;
+    }
+
+  private:
+
+    IP6FlowID _flowid;
+    uint32_t _output : 24;
+    uint8_t _direction;
+    IP6RewriterEntry *_hashnext;
+
+    friend class HashContainer_adapter<IP6RewriterEntry>;
+
+};
+
+// The IPv6 entries come first, so an entry can find its flow.
+struct IP6RewriterFlowEntries {
+    IP6RewriterEntry _e6[2];
+};
+
+/* An IP6RewriterFlow is an IPRewriterFlow, so it lives in the same expiration
+   heaps as IPv4 flows.  Its IPv4 entries are unused. */
+class IP6RewriterFlow : public IP6RewriterFlowEntries, public IPRewriterFlow { public:
+
+    IP6RewriterFlow(IPRewriterInput *owner, const IP6FlowID &flowid,
+		    const IP6FlowID &rewritten_flowid,
+		    uint8_t ip_p, bool guaranteed, click_jiffies_t expiry_j);
+
+    IP6RewriterEntry &entry6(bool direction) {
+	return _e6[direction];
+    }
+    const IP6RewriterEntry &entry6(bool direction) const {
+	return _e6[direction];
+    }
+
+    bool both_done() const {
+	return (_tflags & 3) == 3;
+    }
+
+    void apply(WritablePacket *p, unsigned char *transport_header,
+	       uint8_t ip_p, bool direction);
+
+    void unparse(StringAccum &sa, bool direction, click_jiffies_t now) const;
+
+  private:
+
+    uint16_t _csum_delta;
+
+};
+
+class IP6RewriterPattern : public IPRewriterPattern { public:
+
+    static bool parse_with_ports(const String &word, const String &str,
+				 IPRewriterInput *input, Element *context,
+				 ErrorHandler *errh);
+
+    int rewrite_flowid(const IP6FlowID &flowid, IP6FlowID &rewritten_flowid,
+		       const HashContainer<IP6RewriterEntry> &reply_map);
+
+    String unparse() const;
+
+  private:
+
+    IP6Address _saddr;
+    int _sport;			// net byte order
+    IP6Address _daddr;
+    int _dport;			// net byte order
+
+    uint32_t _variation_top;
+    uint32_t _next_variation;
+    bool _sequential;
+    bool _same_first;
+
+    // NPTv6: _saddr is the internal prefix, _daddr the external prefix
+    bool _npt;
+    int _npt_prefix_len;
+    IP6Address _npt_mask;
+    uint16_t _npt_adjustment;	// host byte order
+
+    IP6RewriterPattern();
+
+    bool rewrite_npt(IP6Address &addr) const;
+
+};
+
+class IP6Rewriter : public IPRewriterBase { public:
+
+    typedef HashContainer<IP6RewriterEntry> Map6;
+
+    IP6Rewriter() CLICK_COLD;
+    ~IP6Rewriter() CLICK_COLD;
+
+    const char *class_name() const		{ return "IP6Rewriter"; }
+    void *cast(const char *);
+
+    int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
+
+    IPRewriterEntry *get_entry(int, const IPFlowID &, int) {
+	return 0;
+    }
+    IPRewriterEntry *add_flow(int, const IPFlowID &, const IPFlowID &, int) {
+	return 0;
+    }
+    IP6RewriterEntry *add_flow(int ip_p, const IP6FlowID &flowid,
+			       const IP6FlowID &rewritten_flowid, int input);
+    void destroy_flow(IPRewriterFlow *flow);
+    click_jiffies_t best_effort_expiry(const IPRewriterFlow *flow) {
+	return flow->expiry() + flow_timeout(static_cast<const IP6RewriterFlow *>(flow)) - _timeouts[1];
+    }
+
+    void push(int, Packet *);
+
+    void add_handlers() CLICK_COLD;
+
+  protected:
+
+    int parse_input_spec(const String &str, IPRewriterInput &is,
+			 int input_number, ErrorHandler *errh);
+
+  private:
+
+    Map6 _map6;			// TCP flows
+    Map6 _udp_map6;
+    SizedHashAllocator<sizeof(IP6RewriterFlow)> _allocator;
+    uint32_t _tcp_done_timeout;
+
+    uint32_t flow_timeout(const IP6RewriterFlow *mf) const {
+	if (mf->both_done())
+	    return _tcp_done_timeout;
+	else
+	    return _timeouts[0];
+    }
+
+    Map6 &protocol_map(int ip_p) {
+	return ip_p == IP_PROTO_TCP ? _map6 : _udp_map6;
+    }
+    int rewrite_flowid(IPRewriterInput &is, const IP6FlowID &flowid,
+		       IP6FlowID &rewritten_flowid, const Map6 &reply_map);
+
+    static String table_handler(Element *, void *);
+
+};
+
+
+inline IP6FlowID
+IP6RewriterEntry::rewritten_flowid() const
+{
+    return (this + (_direction ? -1 : 1))->_flowid.reverse();
+}
+
+inline IP6RewriterFlow *
+IP6RewriterEntry::flow()
+{
+    IP6RewriterFlowEntries *e = reinterpret_cast<IP6RewriterFlowEntries *>(this - _direction);
+    return static_cast<IP6RewriterFlow *>(e);
+}
+
+inline void
+IP6Rewriter::destroy_flow(IPRewriterFlow *flow)
+{
+    IP6RewriterFlow *mf = static_cast<IP6RewriterFlow *>(flow);
+    Map6 &map = protocol_map(mf->ip_p());
+    Map6::iterator it = map.find(mf->entry6(0).hashkey());
+    if (it.get() == &mf->entry6(0))
+	map.erase(it);
+    it = map.find(mf->entry6(1).hashkey());
+    if (it.get() == &mf->entry6(1))
+	map.erase(it);
+    mf->~IP6RewriterFlow();
+    _allocator.deallocate(mf);
+}
+
+CLICK_ENDDECLS
+#endif
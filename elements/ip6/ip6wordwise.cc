@@ -0,0 +1,152 @@
+/*
+ * ip6wordwise.{cc,hh} -- lowers IP6Classifier and IP6Filter primitives into
+ * Classification::Wordwise programs
+ *
+ * Copyright (c) 2000-2007 Mazu Networks, Inc.
+ * Copyright (c) 2010 Meraki, Inc.
+ * Copyright (c) 2004-2011 Regents of the University of California
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include <click/integers.hh>
+#include "ip6wordwise.hh"
+
+CLICK_DECLS
+namespace ip6 {
+
+void
+add_constant_insn(Classification::Wordwise::Program &program, Vector<int> &tree, bool value)
+{
+    program.add_insn(tree, 0, 0, 0);    // an empty mask matches every packet
+    if (!value) {
+        program.negate_subtree(tree);
+    }
+}
+
+/*
+ * @brief Adds the tests for "field > value", where mask and value are already shifted down to bit 0.
+ * This is the algorithm of IPFilter::Primitive::add_comparison_exprs:
+ * Check the top bit of value.
+ * If the top bit is 0, find the top bits of mask for which value is 0. If the packet has any of those bits set it is greater,
+ *    otherwise continue testing with the lower bits; combine with OR.
+ * If the top bit is 1, find the top bits of mask for which value + 1 is all ones. If the packet does not have all of those bits
+ *    set it is not greater, otherwise continue testing with the lower bits; combine with AND.
+ * Stop testing when value >= mask.
+ */
+static void
+add_greater_than_insns(Classification::Wordwise::Program &program, Vector<int> &tree, int offset, int shift, uint32_t mask, uint32_t value)
+{
+    int high_bit_record = 0;
+    int count = 0;
+
+    while (value < mask) {
+        int high_bit = (value > (mask >> 1));
+        int first_different_bit = 33 - ffs_msb(high_bit ? ~(value + 1) & mask : value);
+        uint32_t upper_mask;
+        if (first_different_bit == 33) {
+            upper_mask = mask;
+        } else {
+            upper_mask = mask & ~((1 << first_different_bit) - 1);
+        }
+        uint32_t upper_value = (high_bit ? 0xFFFFFFFF & upper_mask : 0);
+
+        program.start_subtree(tree);
+        program.add_insn(tree, offset, htonl(upper_value << shift), htonl(upper_mask << shift));
+        if (!high_bit) {
+            program.negate_subtree(tree, true);
+        }
+        high_bit_record = (high_bit_record << 1) | high_bit;
+        count++;
+
+        mask &= ~upper_mask;
+        value &= mask;
+    }
+
+    while (count > 0) {
+        program.finish_subtree(tree, (high_bit_record & 1 ? Classification::c_and : Classification::c_or));
+        high_bit_record >>= 1;
+        count--;
+    }
+}
+
+void
+add_field_insns(Classification::Wordwise::Program &program, Vector<int> &tree, int offset, uint32_t mask, uint32_t value,
+                int op, bool negated)
+{
+    int shift = ffs_lsb(mask) - 1;
+    uint32_t field_mask = mask >> shift;
+
+    // Rewrite everything in terms of '==' and '>':
+    // a != b == !(a == b), a <= b == !(a > b), a >= b == a > b - 1 and a < b == !(a > b - 1)
+    if (op == op_ne || op == op_le || op == op_lt) {
+        negated = !negated;
+    }
+    if (op == op_ge || op == op_lt) {
+        if (value == 0) {       // a >= 0 always holds
+            add_constant_insn(program, tree, !negated);
+            return;
+        }
+        value--;
+    }
+
+    if (value > field_mask) {   // the field can never be equal to, or greater than, value
+        add_constant_insn(program, tree, negated);
+    } else if (op == op_eq || op == op_ne) {
+        program.add_insn(tree, offset, htonl(value << shift), htonl(mask));
+        if (negated) {
+            program.negate_subtree(tree, true);
+        }
+    } else if (value == field_mask) {   // the field can never be greater than its maximum value
+        add_constant_insn(program, tree, negated);
+    } else {
+        add_greater_than_insns(program, tree, offset, shift, field_mask, value);
+        if (negated) {
+            program.negate_subtree(tree, true);
+        }
+    }
+}
+
+void
+add_bytes_insns(Classification::Wordwise::Program &program, Vector<int> &tree, int offset, const unsigned char *value,
+                const unsigned char *mask, int len, bool negated)
+{
+    program.start_subtree(tree);
+    bool added_an_insn = false;
+    for (int i = 0; i < len; i += 4) {
+        union {
+            unsigned char c[4];
+            uint32_t u;
+        } word_value, word_mask;
+        word_value.u = word_mask.u = 0;
+        for (int j = 0; j < 4 && i + j < len; j++) {
+            word_value.c[j] = value[i + j];
+            word_mask.c[j] = mask[i + j];
+        }
+        if (word_mask.u) {      // words that are masked out entirely need no test
+            program.add_insn(tree, offset + i, word_value.u, word_mask.u);
+            added_an_insn = true;
+        }
+    }
+    if (!added_an_insn) {       // e.g. the network ::/0 contains every address
+        program.add_insn(tree, 0, 0, 0);
+    }
+    program.finish_subtree(tree, Classification::c_and);
+    if (negated) {
+        program.negate_subtree(tree, true);
+    }
+}
+
+};
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(IPFilter Classification)
+ELEMENT_PROVIDES(IP6Wordwise)
@@ -0,0 +1,160 @@
+#ifndef CLICK_IP6WORDWISE_HH
+#define CLICK_IP6WORDWISE_HH
+#include <click/packet.hh>
+#include <click/vector.hh>
+#include <click/straccum.hh>
+#include "elements/standard/classification.hh"
+#include "elements/ip/ipfilter.hh"
+#include "ip6helpers.hh"
+CLICK_DECLS
+
+namespace ip6 {
+
+/*
+ * @brief The comparison operators, numbered in the same order as ip6classification::Operator and ip6filtering::Operator.
+ */
+enum {
+    op_eq,
+    op_ne,
+    op_gt,
+    op_ge,
+    op_lt,
+    op_le
+};
+
+/*
+ * @brief Adds a test that always succeeds (when value is true) or always fails (when value is false) to the program.
+ */
+void add_constant_insn(Classification::Wordwise::Program &program, Vector<int> &tree, bool value);
+
+/*
+ * @brief Adds the tests for "field OP value" to the program, as a single subtree.
+ * The field lives in the 32-bit big-endian word at offset (an IPFilter::offset_* based offset), selected by mask. The bits in mask
+ * must be contiguous, value is given unshifted. Ordered comparisons are split up into a series of masked equality tests, like
+ * IPFilter does.
+ * @param negated true when the result must be negated, i.e. when the primitive was preceded by the not keyword
+ */
+void add_field_insns(Classification::Wordwise::Program &program, Vector<int> &tree, int offset, uint32_t mask, uint32_t value,
+                     int op, bool negated);
+
+/*
+ * @brief Adds a test that matches when the len bytes at offset, ANDed with mask, equal value (also ANDed with mask).
+ * Used for IPv6 and Ethernet addresses and networks. All the tests are added as a single subtree.
+ */
+void add_bytes_insns(Classification::Wordwise::Program &program, Vector<int> &tree, int offset, const unsigned char *value,
+                     const unsigned char *mask, int len, bool negated);
+
+/*
+ * @brief The rules of an IP6Classifier or IP6Filter, lowered into IPFilter-style compressed decision programs.
+ *
+ * Consecutive rules whose primitives can all be lowered share one Classification::Wordwise program. That program is optimized
+ * like the programs of IPFilter and Classifier, so tests that several rules have in common (for example "src net 2001:db8::/32")
+ * are done at most once per packet. A rule containing a primitive that cannot be lowered (for example "ip6 frag", which must
+ * walk the extension header chain) is matched by walking its AST.
+ *
+ * Programs test ports and ICMP types at the packet's transport header pointer, while the ASTs find the higher layer header
+ * by walking the extension header chain. So a program that tests the transport header only runs on packets for which
+ * ip6::transport_header_is_exact() holds; for other packets, the ASTs of its rules are walked instead.
+ */
+template <typename AST>
+class CompiledRules {
+public:
+    void compile(const Vector<AST> &ast_list);
+
+    /*
+     * @brief Returns the number of the first rule that matches the packet, or -1 when no rule matches.
+     */
+    inline int match(Packet *packet);
+
+    String unparse() const;
+
+private:
+    struct Step {
+        IPFilter::IPFilterProgram program;
+        int rule;   // -1 when program must be run, otherwise the rule whose AST must be walked
+        int first_rule, last_rule;  // the rules lowered into program, last_rule excluded
+        bool tests_transport_header;
+    };
+
+    Vector<Step> _steps;
+    Vector<AST> _ast_list;
+};
+
+template <typename AST> void
+CompiledRules<AST>::compile(const Vector<AST> &ast_list)
+{
+    _ast_list = ast_list;
+    _steps.clear();
+
+    int i = 0;
+    while (i < _ast_list.size()) {
+        Step step;
+        if (!_ast_list[i].can_compile()) {
+            step.rule = i++;
+        } else {
+            step.rule = -1;
+            step.first_rule = i;
+            Classification::Wordwise::Program program;
+            Vector<int> tree = program.init_subtree();
+            for (; i < _ast_list.size() && _ast_list[i].can_compile(); i++) {
+                program.start_subtree(tree);
+                _ast_list[i].compile(program, tree);
+                program.finish_subtree(tree, Classification::c_and, -i);
+            }
+            program.finish_subtree(tree, Classification::c_or, Classification::j_never, Classification::j_never);
+
+            program.optimize(0, 0, Classification::offset_max);
+            program.bubble_sort_and_exprs(0, 0, Classification::offset_max);
+            step.last_rule = i;
+            step.tests_transport_header = false;
+            for (int j = 0; j < program.ninsn(); j++) {
+                if (program.insn(j).offset >= IPFilter::offset_transp) {
+                    step.tests_transport_header = true;
+                }
+            }
+            step.program.compile(program, IPFilter::PERFORM_BINARY_SEARCH, IPFilter::MIN_BINARY_SEARCH);
+        }
+        _steps.push_back(step);
+    }
+}
+
+template <typename AST> inline int
+CompiledRules<AST>::match(Packet *packet)
+{
+    for (Step *step = _steps.begin(); step != _steps.end(); ++step) {
+        if (step->rule < 0 && step->tests_transport_header && !ip6::transport_header_is_exact(packet)) {
+            for (int rule = step->first_rule; rule < step->last_rule; rule++) {
+                if (_ast_list[rule].check_whether_packet_matches(packet)) {
+                    return rule;
+                }
+            }
+        } else if (step->rule < 0) {
+            int output = IPFilter::match(step->program, packet);
+            if (output < _ast_list.size()) {
+                return output;
+            }
+        } else if (_ast_list[step->rule].check_whether_packet_matches(packet)) {
+            return step->rule;
+        }
+    }
+    return -1;
+}
+
+template <typename AST> String
+CompiledRules<AST>::unparse() const
+{
+    StringAccum sa;
+    for (const Step *step = _steps.begin(); step != _steps.end(); ++step) {
+        if (step->rule < 0) {
+            sa << step->program.unparse();
+        } else {
+            sa << "rule " << step->rule << ": matched by walking its abstract syntax tree\n";
+        }
+    }
+    return sa.take_string();
+}
+
+};
+
+CLICK_ENDDECLS
+#endif /* CLICK_IP6WORDWISE_HH */
@@ -58,8 +58,9 @@ LookupIP6Route::configure(Vector<String> &conf, ErrorHandler *errh)
     }
 
   if (ok && output_num>=0) {
-    _t.add(dst, mask, gw, output_num);
-    if( output_num > maxout)
+    if (_t.add(dst, mask, gw, output_num) < 0)
+      errh->error("argument %d: mask %s is not a prefix", i+1, mask.unparse().c_str());
+    else if( output_num > maxout)
         maxout = output_num;
     } else {
       errh->error("argument %d should be DADDR/MASK [GW] OUTPUT", i+1);
@@ -150,15 +151,28 @@ LookupIP6Route::add_route(IP6Address addr, IP6Address mask, IP6Address gw,
   if (output < 0 && output >= noutputs())
     return errh->error("port number out of range"); // Can't happen...
 
-  _t.add(addr, mask, gw, output);
+  if (_t.add(addr, mask, gw, output) < 0)
+    return errh->error("mask %s is not a prefix", mask.unparse().c_str());
+  _last_addr = IP6Address();	// the cached route might no longer be the best one
+#ifdef IP_RT_CACHE2
+  _last_addr2 = _last_addr;
+#endif
   return 0;
 }
 
 int
 LookupIP6Route::remove_route(IP6Address addr, IP6Address mask,
-			     ErrorHandler *)
+			     ErrorHandler *errh)
 {
-  _t.del(addr, mask);
+  int r = _t.del(addr, mask);
+  if (r == -EINVAL)
+    return errh->error("mask %s is not a prefix", mask.unparse().c_str());
+  else if (r == -ENOENT)
+    return errh->error("no route for %s/%d", addr.unparse().c_str(), mask.mask_to_prefix_len());
+  _last_addr = IP6Address();
+#ifdef IP_RT_CACHE2
+  _last_addr2 = _last_addr;
+#endif
   return 0;
 }
 
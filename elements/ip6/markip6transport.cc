@@ -0,0 +1,50 @@
+/*
+ * markip6transport.{cc,hh} -- element walks the IPv6 extension header chain
+ * and sets the transport header pointer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "markip6transport.hh"
+#include "ip6helpers.hh"
+CLICK_DECLS
+
+MarkIP6Transport::MarkIP6Transport()
+{
+  _drops = 0;
+}
+
+MarkIP6Transport::~MarkIP6Transport()
+{
+}
+
+Packet *
+MarkIP6Transport::simple_action(Packet *p)
+{
+  if (ip6::mark_transport_header(p))
+    return p;
+
+  _drops++;
+  checked_output_push(1, p);
+  return 0;
+}
+
+void
+MarkIP6Transport::add_handlers()
+{
+  add_data_handlers("drops", Handler::OP_READ, &_drops);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(IP6Helpers)
+EXPORT_ELEMENT(MarkIP6Transport)
+ELEMENT_MT_SAFE(MarkIP6Transport)
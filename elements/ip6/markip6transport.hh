@@ -0,0 +1,64 @@
+#ifndef CLICK_MARKIP6TRANSPORT_HH
+#define CLICK_MARKIP6TRANSPORT_HH
+#include <click/element.hh>
+#include <click/atomic.hh>
+CLICK_DECLS
+
+/*
+ * =c
+ * MarkIP6Transport()
+ * =s ip6
+ * walks an IPv6 packet's extension headers and sets its transport header pointer
+ * =d
+ *
+ * Expects IPv6 packets with their network header annotation set, for example
+ * by CheckIP6Header. Walks the packet's extension header chain once, without
+ * allocating memory, and sets the packet's transport header pointer to the
+ * header that follows the chain, like MarkIPHeader does for IPv4. Fragments
+ * whose offset is not 0 have no such header; their transport header pointer is
+ * set to the end of the packet, so that transport layer primitives do not match
+ * their payload.
+ *
+ * The walk's results are also cached in the packet's IP6_EXTHDR annotations:
+ * the higher layer protocol, the offset of the higher layer header and the
+ * offset of the fragmentation header, if any, all relative to the network
+ * header. IP6Classifier, IP6Filter and the other users of the IPv6 helper
+ * functions read those annotations instead of walking the chain again.
+ *
+ * Packets whose extension header chain is truncated or malformed are dropped,
+ * or emitted on output 1 if it exists.
+ *
+ * =n
+ *
+ * The annotations live in bytes 40-47 of the annotation area, which are shared
+ * with the PERFCTR and IPSEC_SA_DATA_REFERENCE annotations. They also record
+ * the offset and length of the network header, and are ignored once these no
+ * longer match the packet, for example after encapsulation. Elements that
+ * change a packet's extension header chain in place clear them.
+ *
+ * =h drops read-only
+ * Returns the number of malformed packets seen.
+ *
+ * =a CheckIP6Header, MarkIPHeader, IP6Classifier, IP6Filter */
+
+class MarkIP6Transport : public Element {
+
+  atomic_uint32_t _drops;
+
+ public:
+
+  MarkIP6Transport() CLICK_COLD;
+  ~MarkIP6Transport() CLICK_COLD;
+
+  const char *class_name() const		{ return "MarkIP6Transport"; }
+  const char *port_count() const		{ return PORTS_1_1X2; }
+  const char *processing() const		{ return PROCESSING_A_AH; }
+
+  void add_handlers() CLICK_COLD;
+
+  Packet *simple_action(Packet *);
+
+};
+
+CLICK_ENDDECLS
+#endif
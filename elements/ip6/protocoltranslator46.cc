@@ -19,6 +19,7 @@
 #include "protocoltranslator46.hh"
 #include <click/confparse.hh>
 #include <click/error.hh>
+#include <click/packet_anno.hh>
 #include <clicknet/ip.h>
 #include <clicknet/ip6.h>
 #include <clicknet/icmp.h>
@@ -28,6 +29,7 @@
 CLICK_DECLS
 
 ProtocolTranslator46::ProtocolTranslator46()
+  : _ncopies(0)
 {
 }
 
@@ -37,148 +39,65 @@ ProtocolTranslator46::~ProtocolTranslator46()
 }
 
 
-//make the ipv4->ipv6 translation of the packet according to SIIT (RFC 2765)
-Packet *
-ProtocolTranslator46::make_translate46(IP6Address src,
-				     IP6Address dst,
-				     click_ip * ip,
-				     unsigned char *a)
+// the one's complement sum of len bytes, as used in Internet checksums
+static inline uint16_t
+ones_sum(const void *data, int len)
 {
-
-  WritablePacket *q = Packet::make(sizeof(click_ip6)-sizeof(click_ip)+ntohs(ip->ip_len));
-
-  if (q==0) {
-    click_chatter("can not make packet!");
-    assert(0);
-  }
-
-  memset(q->data(), '\0', q->length());
-  click_ip6 *ip6=(click_ip6 *)q->data();
-  click_tcp *tcp = (click_tcp *)(ip6+1);
-  click_udp *udp = (click_udp *)(ip6+1);
-
-  //set ipv6 header
-  ip6->ip6_flow = 0;	/* must set first: overlaps vfc */
-  ip6->ip6_v = 6;
-  ip6->ip6_plen = htons(ntohs(ip->ip_len)-sizeof(click_ip));
-  ip6->ip6_hlim = ip->ip_ttl + 0x40-0xff;
-  ip6->ip6_src = src;
-  ip6->ip6_dst = dst;
-  memcpy((unsigned char *)tcp, a, ntohs(ip6->ip6_plen));
-
-  if (ip->ip_p == 6) //TCP
-    {
-      ip6->ip6_nxt = ip->ip_p;
-      tcp->th_sum = htons(in6_fast_cksum(&ip6->ip6_src, &ip6->ip6_dst, ip6->ip6_plen, ip6->ip6_nxt, tcp->th_sum, a, ip6->ip6_plen));
-    }
-
-  else if (ip->ip_p == 17) //UDP
-    {
-      ip6->ip6_nxt = ip->ip_p;
-      udp->uh_sum = htons(in6_fast_cksum(&ip6->ip6_src, &ip6->ip6_dst, ip6->ip6_plen, ip6->ip6_nxt, udp->uh_sum, a, ip6->ip6_plen));
-    }
-
-  else if (ip->ip_p == 1)
-    {
-      ip6->ip6_nxt=0x3a;
-      //icmp 6->4 translation is dealt by caller.
-    }
-
-  else
-    {
-      //will deal other protocols later
-    }
-
-  return q;
-
+  return ~click_in_cksum((const unsigned char *) data, len);
 }
 
-
-Packet *
-ProtocolTranslator46::make_icmp_translate46(IP6Address ip6_src,
-					    IP6Address ip6_dst,
-					    unsigned char *a,
-					    unsigned char payload_length)
+// add two one's complement sums
+static inline uint16_t
+ones_add(uint16_t a, uint16_t b)
 {
-  click_ip *ip=0;
-  unsigned char *ip6=0;
-  unsigned char icmp_type = a[0];
-  unsigned char icmp_code = a[1];
-  unsigned char icmp_pointer = a[4];
-
-  unsigned char icmp6_code = 0;
-  unsigned char icmp6_length;
-
-  WritablePacket *q2 = 0;
-
-  switch (icmp_type)  {
-  case (ICMP_ECHO): ; // icmp_type ==8
-  case (ICMP_ECHOREPLY):  {//icmp_type ==0
-    click_icmp_echo *icmp = (click_icmp_echo *)a;
-    ip = (click_ip *)(icmp+1);
-    icmp6_length = payload_length-sizeof(click_icmp_echo)+sizeof(click_icmp6_echo);
-    q2=Packet::make(icmp6_length);
-    memset(q2->data(), '\0', q2->length());
-    click_icmp6_echo *icmp6 = (click_icmp6_echo *)q2->data();
-    ip6=(unsigned char *)(icmp6+1);
-
-    if (icmp_type == ICMP_ECHO ) { // icmp_type ==8
-      icmp6->icmp6_type = ICMP6_ECHO;  // icmp6_type =128
-    }
-    else if (icmp_type == ICMP_ECHOREPLY ) { // icmp_type ==0
-      icmp6->icmp6_type = ICMP6_ECHOREPLY;              // icmp6_type = 129
-    }
-    icmp6->icmp6_identifier = icmp->icmp_identifier;
-    icmp6->icmp6_sequence = icmp->icmp_sequence;
-    memcpy(ip6, (unsigned char *)ip, icmp6_length);
-    icmp->icmp_cksum  = 0;
-  icmp6->icmp6_cksum = htons(in6_fast_cksum(&ip6_src.in6_addr(), &ip6_dst.in6_addr(), htons(icmp6_length), 0x3a, 0, (unsigned char *)icmp6, htons(icmp6_length)));
-
-  }
-  break;
-
-  case (ICMP_UNREACH):  { //icmp_type ==3
-    click_icmp_unreach *icmp = (click_icmp_unreach *)a;
-    ip = (click_ip *)(icmp+1);
-
-    if (icmp_code == 2 || icmp_code ==4) {
-      switch (icmp_code) {
-      case 2: {
-	icmp6_length = payload_length-sizeof(click_icmp_unreach)+sizeof(click_icmp6_paramprob);
-	q2=Packet::make(icmp6_length);
-	memset(q2->data(), '\0', q2->length());
-	click_icmp6_paramprob *icmp6 = (click_icmp6_paramprob *)q2->data();
-	ip6=(unsigned char *)(icmp6+1);
-	icmp6->icmp6_type = ICMP6_PARAMPROB; //icmp6_type = 4
-	icmp6->icmp6_code = 1;
-	icmp6->icmp6_pointer = 6;
-	memcpy(ip6, (unsigned char *)ip, icmp6_length);
-	icmp->icmp_cksum  = 0;
-	icmp6->icmp6_cksum = htons(in6_fast_cksum(&ip6_src.in6_addr(), &ip6_dst.in6_addr(), htons(icmp6_length), 0x3a, 0, (unsigned char *)icmp6, htons(icmp6_length)));
-      }
-      break;
-
-      case 4: {
-	icmp6_length = payload_length-sizeof(click_icmp_unreach)+sizeof(click_icmp6_pkttoobig);
-	q2=Packet::make(icmp6_length);
-	memset(q2->data(), '\0', q2->length());
-	click_icmp6_pkttoobig *icmp6 = (click_icmp6_pkttoobig *)q2->data();
-	ip6=(unsigned char *)(icmp6+1);
-	icmp6->icmp6_type = ICMP6_PKTTOOBIG; //icmp6_type = 2
-	icmp6->icmp6_code = 0;
-
-	//adjust the mtu field for the difference between the ipv4 and ipv6 header size
+  uint32_t sum = a + b;
+  return sum + (sum >> 16);
+}
 
-	memcpy(ip6, (unsigned char *)ip, icmp6_length);
-	icmp->icmp_cksum  = 0;
-	icmp6->icmp6_cksum = htons(in6_fast_cksum(&ip6_src.in6_addr(), &ip6_dst.in6_addr(), htons(icmp6_length), 0x3a, 0, (unsigned char *)icmp6, htons(icmp6_length)));
-      }
-      break;
-      default: ;
-      }
-    }
-    else {
 
+//translate the ICMP header at icmp, followed by payload_length - 8 bytes, to
+//an ICMPv6 header in place, according to SIIT (RFC 2765). ICMP and ICMPv6
+//headers are both 8 bytes long. The checksum is updated incrementally: the
+//header words that change are taken out, and the IPv6 pseudo header, which
+//ICMP does not cover, is added. Returns false if the message has no ICMPv6
+//equivalent.
+bool
+ProtocolTranslator46::make_icmp_translate46(const IP6Address &ip6_src,
+					    const IP6Address &ip6_dst,
+					    unsigned char *icmp,
+					    unsigned payload_length)
+{
+  unsigned char icmp_type = icmp[0];
+  unsigned char icmp_code = icmp[1];
+  unsigned char icmp_pointer = icmp[4];
+  uint32_t rest;			// bytes 4-7 of the new header
+  memcpy(&rest, icmp + 4, 4);
+
+  uint16_t old_sum = ones_add(ones_sum(icmp, 2), ones_sum(icmp + 4, 4));
+
+  click_icmp6 *icmp6 = (click_icmp6 *) icmp;
+  switch (icmp_type) {
+  case ICMP_ECHO:			// icmp_type == 8
+    icmp6->icmp6_type = ICMP6_ECHO;	// icmp6_type = 128
+    break;
+
+  case ICMP_ECHOREPLY:			// icmp_type == 0
+    icmp6->icmp6_type = ICMP6_ECHOREPLY;	// icmp6_type = 129
+    break;
+
+  case ICMP_UNREACH:			// icmp_type == 3
+    if (icmp_code == 2) {
+      icmp6->icmp6_type = ICMP6_PARAMPROB;	// icmp6_type = 4
+      icmp6->icmp6_code = 1;
+      rest = htonl(6);			// the next header field
+    } else if (icmp_code == 4) {
+      icmp6->icmp6_type = ICMP6_PKTTOOBIG;	// icmp6_type = 2
+      icmp6->icmp6_code = 0;
+      //adjust the mtu for the difference between the ipv4 and ipv6 header size
+      uint16_t mtu = ntohs(((click_icmp_needfrag *) icmp)->icmp_nextmtu);
+      rest = htonl(mtu + sizeof(click_ip6) - sizeof(click_ip));
+    } else {
+      icmp6->icmp6_type = ICMP6_UNREACH;
       switch (icmp_code) {
       case 0 : ;
       case 1 : ;
@@ -186,87 +105,46 @@ ProtocolTranslator46::make_icmp_translate46(IP6Address ip6_src,
       case 7 : ;
       case 8 : ;
       case 11: ;
-      case 12: {
-	icmp6_code = 0;
-      }
-      break;
-      case 3 : {
-	icmp6_code = 4;
-      }
-      break;
-      case 5 : {
-	icmp6_code = 2;
-      }
-      break;
+      case 12: icmp6->icmp6_code = 0; break;
+      case 3 : icmp6->icmp6_code = 4; break;
+      case 5 : icmp6->icmp6_code = 2; break;
       case 9 : ;
-      case 10: {
-	icmp6_code = 1;
-      }
-      break;
-      default:  
-      break;
+      case 10: icmp6->icmp6_code = 1; break;
+      default: icmp6->icmp6_code = 0; break;
       }
-      icmp6_length = payload_length-sizeof(click_icmp_unreach)+sizeof(click_icmp6_unreach);
-      q2=Packet::make(icmp6_length);
-      memset(q2->data(), '\0', q2->length());
-      click_icmp6_unreach *icmp6 = (click_icmp6_unreach *)q2->data();
-      ip6=(unsigned char *)(icmp6+1);
-      icmp6->icmp6_type = ICMP6_UNREACH;
-      icmp6->icmp6_code = icmp6_code;
-      memcpy(ip6, (unsigned char *)ip, icmp6_length);
-      icmp->icmp_cksum  = 0;
-      icmp6->icmp6_cksum = htons(in6_fast_cksum(&ip6_src.in6_addr(), &ip6_dst.in6_addr(), htons(icmp6_length), 0x3a, 0, (unsigned char *)icmp6, htons(icmp6_length)));
+      rest = 0;
     }
-  }
-  break;
+    break;
 
-  case (ICMP_TIMXCEED) : { //icmp ==11
-    click_icmp_timxceed *icmp = (click_icmp_timxceed *)a;
-    ip = (click_ip *)(icmp+1);
-    icmp6_length = payload_length-sizeof(click_icmp_timxceed)+sizeof(click_icmp6_timxceed);
-    q2=Packet::make(icmp6_length);
-    memset(q2->data(), '\0', q2->length());
-    click_icmp6_timxceed *icmp6 = (click_icmp6_timxceed *)q2->data();
-    ip6=(unsigned char *)(icmp6+1);
-    icmp6->icmp6_type=ICMP6_TIMXCEED;
-    icmp6->icmp6_code = icmp_code;
-    memcpy(ip6, (unsigned char *)ip, icmp6_length);
-    icmp->icmp_cksum  = 0;
-    icmp6->icmp6_cksum = htons(in6_fast_cksum(&ip6_src.in6_addr(), &ip6_dst.in6_addr(), htons(icmp6_length), 0x3a, 0, (unsigned char *)icmp6, htons(icmp6_length)));
-  }
-  break;
-
-  case (ICMP_PARAMPROB): { //icmp==12
-    click_icmp_paramprob *icmp = (click_icmp_paramprob *)a;
-    ip = (click_ip *)(icmp+1);
-    icmp6_length = payload_length-sizeof(click_icmp_paramprob)+sizeof(click_icmp6_paramprob);
-    q2=Packet::make(icmp6_length);
-    memset(q2->data(), '\0', q2->length());
-    click_icmp6_paramprob *icmp6 = (click_icmp6_paramprob *)q2->data();
-    ip6=(unsigned char *)(icmp6+1);
-    icmp6->icmp6_type=ICMP6_PARAMPROB;
+  case ICMP_TIMXCEED:			// icmp_type == 11
+    icmp6->icmp6_type = ICMP6_TIMXCEED;
+    rest = 0;
+    break;
 
+  case ICMP_PARAMPROB:			// icmp_type == 12
+    icmp6->icmp6_type = ICMP6_PARAMPROB;
+    icmp6->icmp6_code = 0;
     switch (icmp_pointer) {
-    case 0  : icmp6->icmp6_pointer = 0;  break;
-    case 2  : icmp6->icmp6_pointer = 4;  break;
-    case 8  : icmp6->icmp6_pointer = 7;  break;
-    case 9  : icmp6->icmp6_pointer = 6;  break;
-    case 12 : icmp6->icmp6_pointer = 8;  break;
-    case 16 : icmp6->icmp6_pointer = 24; break;
-    default : icmp6->icmp6_pointer = -1; break;
+    case 0  : rest = htonl(0);  break;
+    case 2  : rest = htonl(4);  break;
+    case 8  : rest = htonl(7);  break;
+    case 9  : rest = htonl(6);  break;
+    case 12 : rest = htonl(8);  break;
+    case 16 : rest = htonl(24); break;
+    default : rest = htonl(-1); break;
     }
-     memcpy(ip6, (unsigned char *)ip, icmp6_length);
-    icmp->icmp_cksum  = 0;
-    icmp6->icmp6_cksum = htons(in6_fast_cksum(&ip6_src.in6_addr(), &ip6_dst.in6_addr(), htons(icmp6_length), 0x3a, 0, (unsigned char *)icmp6, htons(icmp6_length)));
-  }
-  break;
-
-  default: ;
+    break;
 
+  default:
+    return false;
   }
 
-  return q2;
-
+  memcpy(icmp + 4, &rest, 4);
+  uint32_t pseudo[2] = { htonl(payload_length), htonl(IP_PROTO_ICMP6) };
+  uint16_t new_sum = ones_add(ones_add(ones_sum(ip6_src.data(), 16), ones_sum(ip6_dst.data(), 16)), ones_sum(pseudo, 8));
+  new_sum = ones_add(new_sum, ones_add(ones_sum(icmp, 2), ones_sum(icmp + 4, 4)));
+  click_update_in_cksum(&icmp6->icmp6_cksum, old_sum, new_sum);
+  return true;
 }
 
 
@@ -277,44 +155,91 @@ ProtocolTranslator46::push(int, Packet *p)
 }
 
 
+//translate the ipv4 packet p to ipv6 in place, according to SIIT (RFC 2765).
+//The ipv6 header is pushed in front of the transport header, over the ipv4
+//header; the packet is only copied when its data is shared or its headroom
+//is too small.
 void
 ProtocolTranslator46::handle_ip4(Packet *p)
 {
-  click_ip *ip = (click_ip *)p->data();
+  const click_ip *ip = (const click_ip *) p->data();
+  unsigned hlen, len;
+  if (p->length() < sizeof(click_ip)
+      || (hlen = ip->ip_hl << 2) < sizeof(click_ip)
+      || (len = ntohs(ip->ip_len)) < hlen
+      || p->length() < len) {
+    p->kill();
+    return;
+  }
 
   IP6Address ip6a_src = IP6Address(IPAddress(ip->ip_src));
   IP6Address ip6a_dst = IP6Address(IPAddress(ip->ip_dst));
+  uint16_t old_addr_sum = ones_sum(&ip->ip_src, 8);
+  uint8_t proto = ip->ip_p;
+  uint8_t ttl = ip->ip_ttl;
+  unsigned plen = len - hlen;
+  int delta = (int) sizeof(click_ip6) - (int) hlen;
+
+  WritablePacket *q;
+  if (delta > 0) {
+    if (p->shared() || p->headroom() < (unsigned) delta)
+      _ncopies++;
+    q = p->push(delta);
+  } else {
+    if (p->shared())
+      _ncopies++;
+    if ((q = p->uniqueify()))
+      q->pull(-delta);
+  }
+  if (!q)
+    return;
+  q->take(q->length() - sizeof(click_ip6) - plen);
+
+  click_ip6 *ip6 = (click_ip6 *) q->data();
+  unsigned char *payload = (unsigned char *) (ip6 + 1);
+  if (proto == IP_PROTO_ICMP
+      && (plen < sizeof(click_icmp) || !make_icmp_translate46(ip6a_src, ip6a_dst, payload, plen))) {
+    q->kill();
+    return;
+  }
 
-  unsigned char *start_of_p = (unsigned char *)(ip+1);
-  Packet *q = 0;
-  q=make_translate46(ip6a_src, ip6a_dst, ip, start_of_p);
-
-  if (ip->ip_p == 1)
-    {
-      click_ip6 * ip6 = (click_ip6 *)q->data();
-      unsigned char * icmp = (unsigned char *)(ip6+1);
-      Packet *q2 = 0;
-      q2 = make_icmp_translate46(ip6a_src, ip6a_dst, icmp, (q->length() - sizeof(click_ip6)));
-      WritablePacket *q3 = Packet::make(sizeof(click_ip6)+q2->length());
-      memset(q3->data(), '\0', q3->length());
-      click_ip6 *start_of_q3 = (click_ip6 *)q3->data();
-      memcpy(start_of_q3, q->data(), sizeof(click_ip6));
-      unsigned char *start_of_icmp6 = (unsigned char *)(start_of_q3+1);
-      memcpy(start_of_icmp6, q2->data(), q2->length());
-      click_ip6 * ip62=(click_ip6 *)q3->data();
-      ip62->ip6_plen = htons(q3->length()-sizeof(click_ip6));
-
-      p->kill();
-      q->kill();
-      q2->kill();
-      output(0).push(q3);
-    }
-  else
-    {
-      p->kill();
-      output(0).push(q);
+  //set ipv6 header
+  ip6->ip6_flow = 0;	/* must set first: overlaps vfc */
+  ip6->ip6_v = 6;
+  ip6->ip6_plen = htons(plen);
+  ip6->ip6_nxt = (proto == IP_PROTO_ICMP ? IP_PROTO_ICMP6 : proto);
+  ip6->ip6_hlim = ttl + 0x40-0xff;
+  ip6->ip6_src = ip6a_src;
+  ip6->ip6_dst = ip6a_dst;
+
+  //the tcp and udp checksums cover a pseudo header that only differs in the
+  //addresses, so they are updated incrementally
+  uint16_t new_addr_sum = ones_sum(&ip6->ip6_src, 32);
+  if (proto == IP_PROTO_TCP && plen >= sizeof(click_tcp)) {
+    click_tcp *tcp = (click_tcp *) payload;
+    click_update_in_cksum(&tcp->th_sum, old_addr_sum, new_addr_sum);
+  } else if (proto == IP_PROTO_UDP && plen >= sizeof(click_udp)) {
+    click_udp *udp = (click_udp *) payload;
+    if (udp->uh_sum)
+      click_update_in_cksum(&udp->uh_sum, old_addr_sum, new_addr_sum);
+    else {
+      //the udp checksum is mandatory in ipv6
+      uint32_t pseudo[2] = { htonl(plen), htonl(IP_PROTO_UDP) };
+      udp->uh_sum = ~ones_add(ones_add(new_addr_sum, ones_sum(pseudo, 8)), ones_sum(udp, plen));
     }
+    if (!udp->uh_sum)
+      udp->uh_sum = 0xFFFF;
+  }
 
+  q->set_ip6_header(ip6);
+  SET_IP6_EXTHDR_FLAGS_ANNO(q, 0);
+  output(0).push(q);
+}
+
+void
+ProtocolTranslator46::add_handlers()
+{
+  add_data_handlers("copies", Handler::OP_READ, &_ncopies);
 }
 
 CLICK_ENDDECLS
@@ -23,6 +23,15 @@ CLICK_DECLS
  * IPv4/v6 packets; for instance, translated packets have their IP, ICMP/ICMPv6,
  * TCP and/or UDP checksums updated.
  *
+ * Packets are translated in place: the IPv6 header is pushed over the IPv4
+ * header, and the ICMP, TCP and UDP checksums are updated incrementally. Only
+ * packets whose data is shared with other packets, or whose headroom is too
+ * small for the larger header, are copied first. ICMP messages without an
+ * ICMPv6 equivalent are dropped.
+ *
+ * =h copies read-only
+ * Returns the number of packets that had to be copied before they could be
+ * translated.
  *
  * =a AddressTranslator ProtocolTranslator64*/
 
@@ -36,20 +45,19 @@ class ProtocolTranslator46 : public Element {
 
   const char *class_name() const		{ return "ProtocolTranslator46"; }
   const char *port_count() const		{ return PORTS_1_1; }
+  void add_handlers() CLICK_COLD;
+
   void push(int port, Packet *p);
   void handle_ip4(Packet *);
 
 private:
 
-  Packet * make_icmp_translate46(IP6Address ip6_src,
-				 IP6Address ip6_dst,
-				 unsigned char *a,
-				 unsigned char payload_length);
+  uint32_t _ncopies;
 
-  Packet * make_translate46(IP6Address src,
-			    IP6Address dst,
-			    click_ip * ip,
-			    unsigned char *a);
+  bool make_icmp_translate46(const IP6Address &ip6_src,
+			     const IP6Address &ip6_dst,
+			     unsigned char *icmp,
+			     unsigned payload_length);
 
 };
 
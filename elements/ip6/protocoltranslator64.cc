@@ -20,6 +20,7 @@
 #include "protocoltranslator64.hh"
 #include <click/confparse.hh>
 #include <click/error.hh>
+#include <click/packet_anno.hh>
 #include <clicknet/ip.h>
 #include <clicknet/ip6.h>
 #include <clicknet/icmp.h>
@@ -29,6 +30,7 @@
 CLICK_DECLS
 
 ProtocolTranslator64::ProtocolTranslator64()
+  : _ncopies(0)
 {
 }
 
@@ -38,33 +40,144 @@ ProtocolTranslator64::~ProtocolTranslator64()
 }
 
 
-//make the ipv6->ipv4 translation of the packet according to SIIT (RFC 2765)
-Packet *
+// the one's complement sum of len bytes, as used in Internet checksums
+static inline uint16_t
+ones_sum(const void *data, int len)
+{
+  return ~click_in_cksum((const unsigned char *) data, len);
+}
+
+// add two one's complement sums
+static inline uint16_t
+ones_add(uint16_t a, uint16_t b)
+{
+  uint32_t sum = a + b;
+  return sum + (sum >> 16);
+}
+
+
+//translate the ICMPv6 header at icmp6, followed by payload_length - 8 bytes,
+//to an ICMP header in place, according to SIIT (RFC 2765). ICMPv6 and ICMP
+//headers are both 8 bytes long. The checksum is updated incrementally: the
+//IPv6 pseudo header, which ICMP does not cover, and the header words that
+//change are taken out. Returns false if the message has no ICMP equivalent.
+bool
+ProtocolTranslator64::make_icmp_translate64(unsigned char *icmp6,
+					    unsigned payload_length,
+					    const click_ip6 *ip6)
+{
+  unsigned char icmp6_type = icmp6[0];
+  unsigned char icmp6_code = icmp6[1];
+  uint32_t rest;			// bytes 4-7 of the new header
+  memcpy(&rest, icmp6 + 4, 4);
+
+  //the sums that change
+  uint32_t pseudo[2] = { htonl(payload_length), htonl(IP_PROTO_ICMP6) };
+  uint16_t old_sum = ones_add(ones_sum(&ip6->ip6_src, 32), ones_sum(pseudo, 8));
+  old_sum = ones_add(old_sum, ones_add(ones_sum(icmp6, 2), ones_sum(icmp6 + 4, 4)));
+
+  click_icmp *icmp = (click_icmp *) icmp6;
+  switch (icmp6_type) {
+  case ICMP6_ECHO:			// icmp6_type == 128
+    icmp->icmp_type = ICMP_ECHO;	// icmp_type = 8
+    break;
+
+  case ICMP6_ECHOREPLY:			// icmp6_type == 129
+    icmp->icmp_type = ICMP_ECHOREPLY;	// icmp_type = 0
+    break;
+
+  case ICMP6_UNREACH:
+    icmp->icmp_type = ICMP_UNREACH;	// icmp_type = 3
+    switch (icmp6_code) {
+    case 0: icmp->icmp_code = 0;  break;
+    case 1: icmp->icmp_code = 10; break;
+    case 2: icmp->icmp_code = 5;  break;
+    case 3: icmp->icmp_code = 1;  break;
+    case 4: icmp->icmp_code = 3;  break;
+    default: break;
+    }
+    rest = 0;
+    break;
+
+  case ICMP6_PKTTOOBIG: {
+    uint32_t mtu = ntohl(((click_icmp6_pkttoobig *) icmp6)->icmp6_mtusize);
+    icmp->icmp_type = ICMP_UNREACH;	// icmp_type = 3
+    icmp->icmp_code = 4;
+    //adjust the mtu for the difference between the ipv6 and ipv4 header size
+    mtu = (mtu > 0xFFFF + sizeof(click_ip6) - sizeof(click_ip) ? 0xFFFF : mtu - (sizeof(click_ip6) - sizeof(click_ip)));
+    rest = htonl(mtu);
+    break;
+  }
+
+  case ICMP6_TIMXCEED:
+    icmp->icmp_type = ICMP_TIMXCEED;	// icmp_type = 11
+    rest = 0;
+    break;
+
+  case ICMP6_PARAMPROB: {		// icmp6_type == 4
+    uint32_t pointer = ntohl(((click_icmp6_paramprob *) icmp6)->icmp6_pointer);
+    rest = 0;
+    if (icmp6_code == 2 || icmp6_code == 0) {
+      icmp->icmp_type = ICMP_PARAMPROB;	// icmp_type = 12
+      icmp->icmp_code = 0;
+      uint8_t icmp_pointer = -1;
+      if (icmp6_code == 0)
+	switch (pointer) {
+	case 0 : icmp_pointer = 0;  break;
+	case 4 : icmp_pointer = 2;  break;
+	case 7 : icmp_pointer = 8;  break;
+	case 6 : icmp_pointer = 9;  break;
+	case 8 : icmp_pointer = 12; break;
+	default: break;
+	}
+      memcpy(&rest, &icmp_pointer, 1);
+    } else if (icmp6_code == 1) {
+      icmp->icmp_type = ICMP_UNREACH;	// icmp_type = 3
+      icmp->icmp_code = 2;
+    } else
+      return false;
+    break;
+  }
+
+  default:
+    return false;
+  }
+
+  memcpy(icmp6 + 4, &rest, 4);
+  uint16_t new_sum = ones_add(ones_sum(icmp6, 2), ones_sum(icmp6 + 4, 4));
+  click_update_in_cksum(&icmp->icmp_cksum, old_sum, new_sum);
+  return true;
+}
+
+
+//translate the ipv6 packet p to ipv4 in place, according to SIIT (RFC 2765).
+//The ipv4 header overwrites the last 20 bytes of the ipv6 header.
+WritablePacket *
 ProtocolTranslator64::make_translate64(IPAddress src,
-				     IPAddress dst,
-				     click_ip6 * ip6,
-				     unsigned char *a)
+				       IPAddress dst,
+				       WritablePacket *p)
 {
-  click_ip *ip;
-  click_tcp *tcp;
-  click_udp *udp;
-  WritablePacket *q = Packet::make(sizeof(*ip) + ntohs(ip6->ip6_plen));
-
-  if (q==0) {
-    click_chatter("can not make packet!");
-    assert(0);
+  click_ip6 *ip6 = (click_ip6 *) p->data();
+  uint16_t plen = ntohs(ip6->ip6_plen);
+  uint8_t nxt = ip6->ip6_nxt;
+  uint8_t hlim = ip6->ip6_hlim;
+  uint16_t old_addr_sum = ones_sum(&ip6->ip6_src, 32);
+  unsigned char *payload = (unsigned char *) (ip6 + 1);
+
+  if (nxt == IP_PROTO_ICMP6
+      && (plen < sizeof(click_icmp) || !make_icmp_translate64(payload, plen, ip6))) {
+    p->kill();
+    return 0;
   }
 
-  memset(q->data(), '\0', q->length());
-  ip = (click_ip *)q->data();
-  tcp = (click_tcp *)(ip+1);
-  udp = (click_udp *)(ip+1);
+  p->pull(sizeof(click_ip6) - sizeof(click_ip));
+  click_ip *ip = (click_ip *) p->data();
 
   //set ipv4 header
   ip->ip_v = 4;
-  ip->ip_hl =5;
-  ip->ip_tos =0;
-  ip->ip_len = htons(sizeof(*ip) + ntohs(ip6->ip6_plen));
+  ip->ip_hl = sizeof(click_ip) >> 2;
+  ip->ip_tos = 0;
+  ip->ip_len = htons(sizeof(click_ip) + plen);
 
   ip->ip_id = htons(0);
   //need to change
@@ -77,218 +190,36 @@ ProtocolTranslator64::make_translate64(IPAddress src,
   //need to deal with fragmentation later
 
   //we do not change the ttl since the packet has to go through v4 routing table
-  ip->ip_ttl = ip6->ip6_hlim;
-
+  ip->ip_ttl = hlim;
+  ip->ip_p = (nxt == IP_PROTO_ICMP6 ? IP_PROTO_ICMP : nxt);
 
   //set the src and dst address
   ip->ip_src = src.in_addr();
   ip->ip_dst = dst.in_addr();
 
-  //copy the actual payload of packet
-  memcpy((unsigned char *)tcp, a, ntohs(ip6->ip6_plen));
-  //set the tcp header checksum
-  //The tcp checksum for ipv4 packet is include the tcp packet, and the 96 bits
-  //TCP pseudoheader, which consists of Source Address, Destination Address,
-  //1 byte zero, 1 byte PTCL, 2 byte TCP length.
-
-  if (ip6->ip6_nxt == 6) //TCP
-    {
-      ip->ip_p = ip6->ip6_nxt;
-
-      //set the ip header checksum
-      ip->ip_sum = 0;
-      tcp->th_sum = 0;
-
-      uint16_t tlen = ntohs(ip6->ip6_plen);
-      uint16_t csum = click_in_cksum((unsigned char *) tcp, tlen);
-      tcp->th_sum = click_in_cksum_pseudohdr(csum, ip, tlen);
-      ip->ip_sum = click_in_cksum((unsigned char *)ip, sizeof(click_ip));
-
-    }
-
-  else if (ip6->ip6_nxt ==17) //UDP
-    {
-      ip->ip_p = ip6->ip6_nxt;
-
-      //set the ip header checksum
-      ip->ip_sum=0;
-      udp->uh_sum = 0;
-
-      uint16_t tlen = ntohs(ip6->ip6_plen);
-      uint16_t csum = click_in_cksum((unsigned char *) udp, tlen);
-      udp->uh_sum = click_in_cksum_pseudohdr(csum, ip, tlen);
-      ip->ip_sum = click_in_cksum((unsigned char *)ip, sizeof(click_ip));
-
-    }
-
-  else if (ip6->ip6_nxt== 58)
-    {
-      ip->ip_p = 1;
-      //icmp 4->6 translation is dealt by caller
+  ip->ip_sum = 0;
+  ip->ip_sum = click_in_cksum((unsigned char *) ip, sizeof(click_ip));
+
+  //the tcp and udp checksums cover a pseudo header that only differs in the
+  //addresses, so they are updated incrementally
+  uint16_t new_addr_sum = ones_sum(&ip->ip_src, 8);
+  if (nxt == IP_PROTO_TCP && plen >= sizeof(click_tcp)) {
+    click_tcp *tcp = (click_tcp *) (ip + 1);
+    click_update_in_cksum(&tcp->th_sum, old_addr_sum, new_addr_sum);
+  } else if (nxt == IP_PROTO_UDP && plen >= sizeof(click_udp)) {
+    click_udp *udp = (click_udp *) (ip + 1);
+    if (udp->uh_sum) {
+      click_update_in_cksum(&udp->uh_sum, old_addr_sum, new_addr_sum);
+      if (!udp->uh_sum)
+	udp->uh_sum = 0xFFFF;
     }
-
-  else
-    {
-      // will deal with other protocols later
-    }
-  return q;
-
-}
-
-
-Packet *
-ProtocolTranslator64::make_icmp_translate64(unsigned char *a,
-			      unsigned char payload_length)
-{
-
-  click_ip6 *ip6=0;
-  unsigned char *ip=0;
-  unsigned char icmp6_type= a[0];
-  unsigned char icmp6_code= a[1];
-  unsigned char icmp_length;
-  WritablePacket *q2 = 0;
-
-  // set type, code, length , and checksum of ICMP header
-  switch (icmp6_type) {
-   case ICMP6_ECHO: ;
-   case ICMP6_ECHOREPLY : {
-      icmp_length = payload_length -sizeof(click_icmp6_echo) + sizeof(click_icmp_echo);
-      click_icmp6_echo *icmp6 = (click_icmp6_echo *)a;
-      ip6 = (click_ip6 *)(icmp6+1);
-
-      q2 = Packet::make(icmp_length);
-      memset(q2->data(), '\0', q2->length());
-      click_icmp_echo *icmp = (click_icmp_echo *)q2->data();
-      ip = (unsigned char *)(icmp+1);
-
-      if (icmp6_type == ICMP6_ECHO ) { // icmp6_type ==128
-	icmp->icmp_type = ICMP_ECHO;                 // icmp_type =8
-      }
-      else if (icmp6_type == ICMP6_ECHOREPLY ) { // icmp6_type ==129
-	icmp->icmp_type = ICMP_ECHOREPLY;              // icmp_type = 0
-      }
-
-      icmp->icmp_identifier = (icmp6->icmp6_identifier);
-      icmp->icmp_sequence = (icmp6->icmp6_sequence);
-      memcpy(ip, ip6, (payload_length - sizeof(click_icmp6_echo)));
-      icmp->icmp_cksum = click_in_cksum((unsigned char *)icmp, icmp_length);
-
-    }
-  break;
-
-  case  ICMP6_UNREACH : {
-      // icmp6_type ==11
-      icmp_length = payload_length-sizeof(click_icmp6_unreach)+sizeof(click_icmp_unreach);
-      click_icmp6_unreach *icmp6 = (click_icmp6_unreach *)a;
-      ip6 = (click_ip6 *)(icmp6+1);
-      q2 = Packet::make(icmp_length);
-      memset(q2->data(), '\0', q2->length());
-      click_icmp_unreach *icmp = (click_icmp_unreach *)q2->data();
-      ip = (unsigned char *)(icmp+1);
-      icmp->icmp_type = ICMP_UNREACH;             // icmp_type =3
-
-      switch (icmp6_code) {
-      case 0: icmp->icmp_code =0;  break;
-      case 1: icmp->icmp_code =10; break;
-      case 2: icmp->icmp_code =5;  break;
-      case 3: icmp->icmp_code =1;  break;
-      case 4: icmp->icmp_code =3;  break;
-      default: ; break;
-      }
-      memcpy(ip, ip6, (payload_length - sizeof(click_icmp6_unreach)));
-      icmp->icmp_cksum = click_in_cksum((unsigned char *)icmp, icmp_length);
-
-    }
-  break;
-
-  case ICMP6_PKTTOOBIG : {
-      icmp_length = payload_length-sizeof(click_icmp6_pkttoobig)+sizeof(click_icmp_unreach);
-      click_icmp6_pkttoobig *icmp6 = (click_icmp6_pkttoobig*)a;
-      ip6 = (click_ip6 *)(icmp6+1);
-      q2 = Packet::make(icmp_length);
-      memset(q2->data(), '\0', q2->length());
-      click_icmp_unreach *icmp = (click_icmp_unreach *)q2->data();
-      ip = (unsigned char *)(icmp+1);
-      icmp->icmp_type = ICMP_UNREACH; //icmp_type = 3
-      icmp->icmp_code = 4;
-      memcpy(ip, ip6, (payload_length - sizeof(click_icmp6_pkttoobig)));
-      icmp->icmp_cksum = click_in_cksum((unsigned char *)icmp, icmp_length);
-    }
-  break;
-
-  case ICMP6_TIMXCEED : {
-      icmp_length = payload_length-sizeof(click_icmp6_timxceed)+sizeof(click_icmp_timxceed);
-      click_icmp6_timxceed *icmp6 = (click_icmp6_timxceed *)a;
-      ip6 = (click_ip6 *)(icmp6+1);
-      q2 = Packet::make(icmp_length);
-      memset(q2->data(), '\0', q2->length());
-      click_icmp_timxceed *icmp = (click_icmp_timxceed *)q2->data();
-      ip = (unsigned char *)(icmp+1);
-      icmp->icmp_type =ICMP_TIMXCEED;            //icmp_type = 11
-      icmp->icmp_code = icmp6_code;
-      memcpy(ip, ip6, (payload_length - sizeof(click_icmp6_timxceed)));
-      icmp->icmp_cksum = click_in_cksum((unsigned char *)icmp, icmp_length);
-    }
-  break;
-
-  case ICMP6_PARAMPROB : { // icmp6_type == 4
-
-      click_icmp6_paramprob *icmp6 = (click_icmp6_paramprob *)a;
-      ip6=(click_ip6 *)(icmp6+1);
-      if (icmp6_code ==2 || icmp6_code ==0)
-	{
-	  icmp_length = payload_length-sizeof(click_icmp6_paramprob)+sizeof(click_icmp_paramprob);
-	  q2 = Packet::make(icmp_length);
-	  memset(q2->data(), '\0', q2->length());
-	  click_icmp_paramprob *icmp = (click_icmp_paramprob *)q2->data();
-	  ip = (unsigned char *)(icmp +1);
-	  icmp->icmp_type = ICMP_PARAMPROB;         // icmp_type = 12
-	  icmp->icmp_code = 0;
-	  if (icmp6_code ==2) {
-	    icmp->icmp_pointer = -1;
-	  }
-	  else if(icmp6_code ==0)
-	    {
-	      switch (ntohl(icmp6->icmp6_pointer)) {
-	      case 0 : icmp->icmp_pointer = 0;  break;
-	      case 4 : icmp->icmp_pointer = 2;  break;
-	      case 7 : icmp->icmp_pointer = 8;  break;
-	      case 6 : icmp->icmp_pointer = 9;  break;
-	      case 8 : icmp->icmp_pointer = 12; break;
-	      case 24: icmp->icmp_pointer = -1; break;
-	      default: ; break;
-	      }
-
-	    }
-	  memcpy(ip, ip6, (payload_length - sizeof(click_icmp6_paramprob)));
-	  icmp->icmp_cksum = click_in_cksum((unsigned char *)icmp, icmp_length);
-	}
-
-      else if (icmp6_code ==1)
-	{
-	  icmp_length = payload_length-sizeof(click_icmp6_paramprob)+sizeof(click_icmp_unreach);
-	  q2 = Packet::make(icmp_length);
-	  memset(q2->data(), '\0', q2->length());
-	  click_icmp_unreach *icmp = (click_icmp_unreach *)q2->data();
-
-	  ip = (unsigned char *)(icmp +1);
-	  icmp->icmp_type = ICMP_UNREACH; // icmp_type = 3
-	  icmp->icmp_code = 2;
-	  memcpy(ip, ip6, (payload_length - sizeof(click_icmp6_paramprob)));
-	  icmp->icmp_cksum = click_in_cksum((unsigned char *)icmp, icmp_length);
-	}
-  }
-  break;
-
-  default: ; break;
   }
 
-  return q2;
+  p->set_ip_header(ip, sizeof(click_ip));
+  return p;
 }
 
 
-
-
 void
 ProtocolTranslator64::push(int, Packet *p)
 {
@@ -299,54 +230,40 @@ ProtocolTranslator64::push(int, Packet *p)
 void
 ProtocolTranslator64::handle_ip6(Packet *p)
 {
-  click_ip6 *ip6 = (click_ip6 *) p->data();
+  const click_ip6 *ip6 = (const click_ip6 *) p->data();
+  if (p->length() < sizeof(click_ip6)
+      || p->length() < sizeof(click_ip6) + ntohs(ip6->ip6_plen)) {
+    p->kill();
+    return;
+  }
+  unsigned extra_length = p->length() - sizeof(click_ip6) - ntohs(ip6->ip6_plen);
+
   IP6Address ip6_dst = IP6Address(ip6->ip6_dst);
   IP6Address ip6_src = IP6Address(ip6->ip6_src);
-
   IPAddress ipa_dst = ip6_dst.ip4_address(), ipa_src = ip6_src.ip4_address();
-  if (ipa_dst && ipa_src)
-    {
-
-       //translate protocol according to SIIT
-       unsigned char * start_of_p= (unsigned char *)(ip6+1);
-       Packet *q = 0;
-       q = make_translate64(ipa_src, ipa_dst, ip6, start_of_p);
-
-       //see if it is an icmp6 packet, if it is, translate the icmp6 packet
-       if (ip6->ip6_nxt == 0x3a)
-	 {
-	   click_ip * ip4= (click_ip *)q->data();
-	   unsigned char * icmp6 = (unsigned char *)(ip4+1);
-
-	   Packet *q2 = 0;
-	   q2 = make_icmp_translate64(icmp6, (q->length()-sizeof(click_ip)));
-	   WritablePacket *q3=Packet::make(sizeof(click_ip)+q2->length());
-	   memset(q3->data(), '\0', q3->length());
-	   click_ip *ip = (click_ip *)q3->data();
-	   memcpy(ip, q->data(), sizeof(click_ip));
-	   unsigned char *start_of_icmp = (unsigned char *)(ip+1);
-	   memcpy(start_of_icmp, q2->data(), q2->length());
-	   ip->ip_len = htons(q3->length());
-	   ip->ip_sum=0;
-	   ip->ip_sum = click_in_cksum((unsigned char *)ip, q3->length());
-
-	   p->kill();
-	   q->kill();
-	   q2->kill();
-	   output(0).push(q3);
-	 }
-       else
-	 {
-	   p->kill();
-	   output(0).push(q);
-	 }
-    }
+  if (!ipa_dst || !ipa_src) {
+    p->kill();
+    return;
+  }
 
-  else
-    {
-      p->kill();
-      return;
-    }
+  //rewrite in place, unless another packet shares the data
+  if (p->shared())
+    _ncopies++;
+  WritablePacket *q = p->uniqueify();
+  if (!q)
+    return;
+  q->take(extra_length);
+
+  if ((q = make_translate64(ipa_src, ipa_dst, q))) {
+    SET_IP6_EXTHDR_FLAGS_ANNO(q, 0);	// the packet is IPv4 now
+    output(0).push(q);
+  }
+}
+
+void
+ProtocolTranslator64::add_handlers()
+{
+  add_data_handlers("copies", Handler::OP_READ, &_ncopies);
 }
 
 CLICK_ENDDECLS
@@ -4,6 +4,7 @@
 #include <click/ipaddress.hh>
 #include <click/vector.hh>
 #include <click/element.hh>
+#include <clicknet/ip6.h>
 CLICK_DECLS
 
 /*
@@ -22,6 +23,15 @@ CLICK_DECLS
  * IPv4 packets; for instance, translated packets have their IP, ICMP,
  * TCP and/or UDP checksums updated.
  *
+ * Packets are translated in place: the IPv4 header replaces the end of the
+ * IPv6 header, and the ICMP, TCP and UDP checksums are updated incrementally.
+ * Only packets whose data is shared with other packets are copied first.
+ * IPv6 packets whose addresses are not IPv4-mapped (::ffff:0:0/96), and
+ * ICMPv6 messages without an ICMP equivalent, are dropped.
+ *
+ * =h copies read-only
+ * Returns the number of packets that had to be copied before they could be
+ * translated.
  *
  * =a AddressTranslator ProtocolTranslator46*/
 
@@ -35,19 +45,22 @@ class ProtocolTranslator64 : public Element {
 
   const char *class_name() const		{ return "ProtocolTranslator64"; }
   const char *port_count() const		{ return PORTS_1_1; }
+  void add_handlers() CLICK_COLD;
+
   void push(int port, Packet *p);
   void handle_ip6(Packet *);
 
 private:
 
-  Packet * make_icmp_translate64(unsigned char *a,
-				unsigned char payload_length);
+  uint32_t _ncopies;
 
-  Packet * make_translate64(IPAddress src,
-			    IPAddress dst,
-			    click_ip6 * ip6,
-			    unsigned char *a);
+  bool make_icmp_translate64(unsigned char *icmp6,
+			     unsigned payload_length,
+			     const click_ip6 *ip6);
 
+  WritablePacket * make_translate64(IPAddress src,
+				    IPAddress dst,
+				    WritablePacket *p);
 
 
 };
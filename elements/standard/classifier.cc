@@ -254,6 +254,21 @@ Classifier::push(int, Packet *p)
     checked_output_push(_prog.match(p), p);
 }
 
+void
+Classifier::push_batch(int, PacketBatch *batch)
+{
+    PacketBatch run;
+    int run_port = -1;
+    while (Packet *p = batch->pop_front()) {
+	int port = _prog.match(p);
+	if (port != run_port)
+	    checked_output_push_batch(run_port, &run);
+	run_port = port;
+	run.append(p);
+    }
+    checked_output_push_batch(run_port, &run);
+}
+
 CLICK_ENDDECLS
 ELEMENT_REQUIRES(AlignmentInfo Classification)
 EXPORT_ELEMENT(Classifier)
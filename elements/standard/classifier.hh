@@ -37,6 +37,10 @@ CLICK_DECLS
  * could ever match a pattern. Usually, this is because an earlier pattern is
  * more general, or because your pattern is contradictory (`12/0806 12/0800').
  *
+ * A batch of packets is split into runs of consecutive packets that match the
+ * same pattern, and each run is pushed on as a batch.  Packets therefore leave
+ * in the order they arrived.
+ *
  * =n
  *
  * The IPClassifier and IPFilter elements have a friendlier syntax if you are
@@ -87,6 +91,7 @@ class Classifier : public Element { public:
     void add_handlers() CLICK_COLD;
 
     void push(int port, Packet *);
+    void push_batch(int port, PacketBatch *);
 
     Classification::Wordwise::Program empty_program(ErrorHandler *errh) const;
     static void parse_program(Classification::Wordwise::Program &prog,
@@ -107,6 +107,49 @@ Counter::simple_action(Packet *p)
   return p;
 }
 
+void
+Counter::count_batch(const PacketBatch *batch)
+{
+    counter_t old_count = _count, bytes = 0;
+    for (Packet *p = batch->first(); p; p = p->next())
+	bytes += p->length();
+    _count += batch->count();
+    _byte_count += bytes;
+    _rate.update(batch->count());
+    _byte_rate.update(bytes);
+
+  // the triggers fire once per batch, before it is emitted
+  if (old_count < _count_trigger && _count >= _count_trigger
+      && !_count_triggered) {
+    _count_triggered = true;
+    if (_count_trigger_h)
+      (void) _count_trigger_h->call_write();
+  }
+  if (_byte_count >= _byte_trigger && !_byte_triggered) {
+    _byte_triggered = true;
+    if (_byte_trigger_h)
+      (void) _byte_trigger_h->call_write();
+  }
+}
+
+void
+Counter::push_batch(int port, PacketBatch *batch)
+{
+    count_batch(batch);
+    output(port).push_batch(batch);
+}
+
+void
+Counter::pull_batch(int port, PacketBatch *batch, unsigned max)
+{
+    PacketBatch pulled;
+    input(port).pull_batch(&pulled, max);
+    if (!pulled.empty()) {
+	count_batch(&pulled);
+	batch->append(pulled);
+    }
+}
+
 
 enum { H_COUNT, H_BYTE_COUNT, H_RATE, H_BIT_RATE, H_BYTE_RATE, H_RESET,
        H_COUNT_CALL, H_BYTE_COUNT_CALL };
@@ -19,7 +19,8 @@ measures packet count and rate
 =d
 
 Passes packets unchanged from its input to its output, maintaining statistics
-information about packet count and packet rate.
+information about packet count and packet rate.  Packet batches are counted
+in one pass and passed on as a batch.
 
 Keyword arguments are:
 
@@ -114,6 +115,8 @@ class Counter : public Element { public:
     int llrpc(unsigned, void *);
 
     Packet *simple_action(Packet *);
+    void push_batch(int port, PacketBatch *batch);
+    void pull_batch(int port, PacketBatch *batch, unsigned max);
 
   private:
 
@@ -142,6 +145,8 @@ class Counter : public Element { public:
     bool _count_triggered : 1;
     bool _byte_triggered : 1;
 
+    void count_batch(const PacketBatch *batch);
+
     static String read_handler(Element *, void *) CLICK_COLD;
     static int write_handler(const String&, Element*, void*, ErrorHandler*) CLICK_COLD;
 
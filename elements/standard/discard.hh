@@ -31,8 +31,8 @@ Only meaningful in pull context.
 
 =item BURST
 
-Unsigned. Number of packets to pull per scheduling. Default is 1. Only
-meaningful in pull context.
+Unsigned. Number of packets to pull per scheduling, as one batch. Default
+is 1. Only meaningful in pull context.
 
 =back
 
@@ -63,6 +63,7 @@ class Discard : public Element { public:
     void add_handlers() CLICK_COLD;
 
     void push(int, Packet *);
+    void push_batch(int, PacketBatch *);
     bool run_task(Task *);
 
   protected:
@@ -58,6 +58,9 @@ class FrontDropQueue : public NotifierQueue { public:
   void take_state(Element *, ErrorHandler *);
 
   void push(int port, Packet *);
+  void push_batch(int port, PacketBatch *batch) {
+    Element::push_batch(port, batch);
+  }
 
 };
 
@@ -76,6 +76,33 @@ FullNoteQueue::pull(int)
 	return pull_failure();
 }
 
+void
+FullNoteQueue::push_batch(int, PacketBatch *batch)
+{
+    // Code taken from SimpleQueue::push_batch() and push_success().
+    if (enq_batch(batch)) {
+	_empty_note.wake();
+	if (size() == capacity()) {
+	    _full_note.sleep();
+#if HAVE_MULTITHREAD
+	    if (size() < capacity())
+		_full_note.wake();
+#endif
+	}
+    }
+    batch_overflow(batch);
+}
+
+void
+FullNoteQueue::pull_batch(int, PacketBatch *batch, unsigned max)
+{
+    if (deq_batch(batch, max)) {
+	_sleepiness = 0;
+	_full_note.wake();
+    } else
+	(void) pull_failure();
+}
+
 #if CLICK_DEBUG_SCHEDULING
 String
 FullNoteQueue::read_handler(Element *e, void *)
@@ -81,6 +81,9 @@ class MixedQueue : public NotifierQueue { public:
     void *cast(const char *);
 
     void push(int port, Packet *);
+    void push_batch(int port, PacketBatch *batch) {
+	Element::push_batch(port, batch);
+    }
 
 };
 
@@ -90,6 +90,31 @@ NotifierQueue::pull(int)
     return p;
 }
 
+void
+NotifierQueue::push_batch(int, PacketBatch *batch)
+{
+    // Code taken from SimpleQueue::push_batch().
+    if (enq_batch(batch))
+	_empty_note.wake();
+    batch_overflow(batch);
+}
+
+void
+NotifierQueue::pull_batch(int, PacketBatch *batch, unsigned max)
+{
+    // Code taken from NotifierQueue::pull().
+    if (deq_batch(batch, max))
+	_sleepiness = 0;
+    else if (_sleepiness >= SLEEPINESS_TRIGGER) {
+	_empty_note.sleep();
+#if HAVE_MULTITHREAD
+	if (size())
+	    _empty_note.wake();
+#endif
+    } else
+	++_sleepiness;
+}
+
 #if CLICK_DEBUG_SCHEDULING
 String
 NotifierQueue::read_handler(Element *e, void *)
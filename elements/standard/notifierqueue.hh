@@ -79,6 +79,8 @@ class NotifierQueue : public SimpleQueue { public:
 
     void push(int port, Packet *);
     Packet *pull(int port);
+    void push_batch(int port, PacketBatch *batch);
+    void pull_batch(int port, PacketBatch *batch, unsigned max);
 
 #if CLICK_DEBUG_SCHEDULING
     void add_handlers() CLICK_COLD;
@@ -74,6 +74,9 @@ class QuickNoteQueue : public FullNoteQueue { public:
 
     // FullNoteQueue's push() suffices
     Packet *pull(int port);
+    void pull_batch(int port, PacketBatch *batch, unsigned max) {
+	Element::pull_batch(port, batch, max);
+    }
 
 };
 
@@ -0,0 +1,305 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * ringqueue.{cc,hh} -- lock-free multi-producer, multi-consumer queue
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "ringqueue.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/packetbatch.hh>
+CLICK_DECLS
+
+RingQueue::RingQueue()
+    : _ring(0), _mask(0), _capacity(1024)
+{
+    _prod.head = _prod.tail = 0;
+    _cons.head = _cons.tail = 0;
+    _highwater_length = 0;
+    _sleepiness = 0;
+    _drops = 0;
+}
+
+void *
+RingQueue::cast(const char *n)
+{
+    if (strcmp(n, "RingQueue") == 0)
+	return (RingQueue *) this;
+    else if (strcmp(n, Notifier::EMPTY_NOTIFIER) == 0)
+	return static_cast<Notifier *>(&_empty_note);
+    else if (strcmp(n, Notifier::FULL_NOTIFIER) == 0)
+	return static_cast<Notifier *>(&_full_note);
+    else
+	return Element::cast(n);
+}
+
+int
+RingQueue::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    if (Args(conf, this, errh).read_p("CAPACITY", _capacity).complete() < 0)
+	return -1;
+    if (_capacity == 0 || _capacity > 0x40000000U)
+	return errh->error("CAPACITY out of range");
+    _empty_note.initialize(Notifier::EMPTY_NOTIFIER, router());
+    _full_note.initialize(Notifier::FULL_NOTIFIER, router());
+    _full_note.set_active(true, false);
+    return 0;
+}
+
+int
+RingQueue::initialize(ErrorHandler *errh)
+{
+    uint32_t nslots = 1;
+    while (nslots < _capacity)
+	nslots <<= 1;
+    _mask = nslots - 1;
+    if (!(_ring = (Packet **) CLICK_LALLOC(sizeof(Packet *) * nslots)))
+	return errh->error("out of memory");
+    return 0;
+}
+
+void
+RingQueue::cleanup(CleanupStage)
+{
+    if (_ring) {
+	for (uint32_t i = _cons.tail.value(); i != _prod.tail.value(); ++i)
+	    _ring[i & _mask]->kill();
+	CLICK_LFREE(_ring, sizeof(Packet *) * (_mask + 1));
+	_ring = 0;
+    }
+}
+
+/* Reserves up to n slots for enqueueing.  Returns the number reserved, which
+   is zero if the ring is full; on success, sets prod_head to the first
+   reserved index. */
+inline uint32_t
+RingQueue::enqueue_reserve(uint32_t n, uint32_t &prod_head)
+{
+    uint32_t prod_next;
+    do {
+	prod_head = _prod.head.value();
+	click_read_fence();
+	uint32_t free = _capacity + _cons.tail.value() - prod_head;
+	if (n > free)
+	    n = free;
+	if (n == 0)
+	    return 0;
+	prod_next = prod_head + n;
+    } while (_prod.head.compare_swap(prod_head, prod_next) != prod_head);
+    return n;
+}
+
+/* Publishes the n slots starting at prod_head, which the caller has filled.
+   Producers that reserved earlier slots publish first. */
+inline void
+RingQueue::enqueue_publish(uint32_t prod_head, uint32_t n)
+{
+    click_write_fence();
+    while (_prod.tail.value() != prod_head)
+	click_relax_fence();
+    _prod.tail = prod_head + n;
+}
+
+/* Reserves up to n filled slots for dequeueing.  Returns the number reserved,
+   which is zero if the ring is empty; on success, sets cons_head to the
+   first reserved index. */
+inline uint32_t
+RingQueue::dequeue_reserve(uint32_t n, uint32_t &cons_head)
+{
+    uint32_t cons_next;
+    do {
+	cons_head = _cons.head.value();
+	click_read_fence();
+	uint32_t entries = _prod.tail.value() - cons_head;
+	if (n > entries)
+	    n = entries;
+	if (n == 0)
+	    return 0;
+	cons_next = cons_head + n;
+    } while (_cons.head.compare_swap(cons_head, cons_next) != cons_head);
+    click_read_fence();
+    return n;
+}
+
+/* Releases the n slots starting at cons_head, which the caller has emptied,
+   to producers.  Consumers that reserved earlier slots release first. */
+inline void
+RingQueue::dequeue_release(uint32_t cons_head, uint32_t n)
+{
+    click_read_fence();
+    while (_cons.tail.value() != cons_head)
+	click_relax_fence();
+    _cons.tail = cons_head + n;
+}
+
+inline void
+RingQueue::enqueue_success()
+{
+    uint32_t s = size();
+    // Concurrent producers may both see a new maximum; keep the larger.
+    uint32_t hw;
+    while ((hw = _highwater_length.value()) < s
+	   && _highwater_length.compare_swap(hw, s) != hw)
+	/* retry */;
+    _empty_note.wake();
+    if (s >= _capacity) {
+	_full_note.sleep();
+#if HAVE_MULTITHREAD
+	// Work around race condition between push() and pull(), as in Queue.
+	if (size() < _capacity)
+	    _full_note.wake();
+#endif
+    }
+}
+
+inline void
+RingQueue::dequeue_failure()
+{
+    uint32_t sleepiness = _sleepiness.value();
+    if (sleepiness >= SLEEPINESS_TRIGGER) {
+	_empty_note.sleep();
+#if HAVE_MULTITHREAD
+	// Work around race condition between push() and pull(), as in Queue.
+	if (size())
+	    _empty_note.wake();
+#endif
+    } else
+	// Racing consumers may lose an increment, which only delays sleep.
+	_sleepiness = sleepiness + 1;
+}
+
+inline void
+RingQueue::dequeue_success()
+{
+    // Avoid dirtying the consumer line when it is already zero.
+    if (_sleepiness.value())
+	_sleepiness = 0;
+    _full_note.wake();
+}
+
+void
+RingQueue::overflow(Packet *p)
+{
+    if (_drops.value() == 0)
+	click_chatter("%p{element}: overflow", this);
+    ++_drops;
+    checked_output_push(1, p);
+}
+
+void
+RingQueue::push(int, Packet *p)
+{
+    uint32_t prod_head;
+    if (enqueue_reserve(1, prod_head)) {
+	_ring[prod_head & _mask] = p;
+	enqueue_publish(prod_head, 1);
+	enqueue_success();
+    } else
+	overflow(p);
+}
+
+Packet *
+RingQueue::pull(int)
+{
+    uint32_t cons_head;
+    if (dequeue_reserve(1, cons_head)) {
+	Packet *p = _ring[cons_head & _mask];
+	dequeue_release(cons_head, 1);
+	dequeue_success();
+	return p;
+    } else {
+	dequeue_failure();
+	return 0;
+    }
+}
+
+void
+RingQueue::push_batch(int, PacketBatch *batch)
+{
+    uint32_t prod_head;
+    if (uint32_t n = enqueue_reserve(batch->count(), prod_head)) {
+	for (uint32_t i = prod_head; i != prod_head + n; ++i)
+	    _ring[i & _mask] = batch->pop_front();
+	enqueue_publish(prod_head, n);
+	enqueue_success();
+    }
+    if (!batch->empty()) {
+	if (_drops.value() == 0)
+	    click_chatter("%p{element}: overflow", this);
+	_drops += batch->count();
+	checked_output_push_batch(1, batch);
+    }
+}
+
+void
+RingQueue::pull_batch(int, PacketBatch *batch, unsigned max)
+{
+    uint32_t cons_head;
+    if (uint32_t n = dequeue_reserve(max, cons_head)) {
+	for (uint32_t i = cons_head; i != cons_head + n; ++i)
+	    batch->append(_ring[i & _mask]);
+	dequeue_release(cons_head, n);
+	dequeue_success();
+    } else
+	dequeue_failure();
+}
+
+String
+RingQueue::read_handler(Element *e, void *user_data)
+{
+    RingQueue *q = static_cast<RingQueue *>(e);
+    switch (reinterpret_cast<uintptr_t>(user_data)) {
+    case h_length:
+	return String(q->size());
+    case h_highwater_length:
+	return String(q->_highwater_length.value());
+    case h_capacity:
+	return String(q->_capacity);
+    case h_drops:
+	return String(q->_drops.value());
+    default:
+	return String();
+    }
+}
+
+int
+RingQueue::write_handler(const String &, Element *e, void *user_data, ErrorHandler *)
+{
+    RingQueue *q = static_cast<RingQueue *>(e);
+    switch (reinterpret_cast<uintptr_t>(user_data)) {
+    case h_reset_counts:
+	q->_drops = 0;
+	q->_highwater_length = q->size();
+	break;
+    case h_reset:
+	while (Packet *p = q->pull(0))
+	    q->checked_output_push(1, p);
+	break;
+    }
+    return 0;
+}
+
+void
+RingQueue::add_handlers()
+{
+    add_read_handler("length", read_handler, h_length);
+    add_read_handler("highwater_length", read_handler, h_highwater_length);
+    add_read_handler("capacity", read_handler, h_capacity, Handler::h_calm);
+    add_read_handler("drops", read_handler, h_drops);
+    add_write_handler("reset_counts", write_handler, h_reset_counts, Handler::h_button | Handler::h_nonexclusive);
+    add_write_handler("reset", write_handler, h_reset, Handler::h_button);
+}
+
+CLICK_ENDDECLS
+EXPORT_ELEMENT(RingQueue)
+ELEMENT_MT_SAFE(RingQueue)
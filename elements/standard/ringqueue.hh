@@ -0,0 +1,151 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_RINGQUEUE_HH
+#define CLICK_RINGQUEUE_HH
+#include <click/element.hh>
+#include <click/notifier.hh>
+#include <click/atomic.hh>
+CLICK_DECLS
+
+/*
+=c
+
+RingQueue
+RingQueue(CAPACITY)
+
+=s storage
+
+stores packets in a lock-free FIFO ring
+
+=d
+
+Stores incoming packets in a first-in-first-out queue.  Drops incoming
+packets if the queue already holds CAPACITY packets.  The default for
+CAPACITY is 1024.
+
+RingQueue supports any number of concurrent pushers and pullers, like
+ThreadSafeQueue, but it moves packets in bulk: a push_batch() or
+pull_batch() call transfers all the packets that fit with a single atomic
+operation on the ring's indexes.  The ring follows the design of DPDK's
+rte_ring.  Producers first reserve a run of slots by advancing the producer
+head, then fill the slots, then publish them by advancing the producer tail
+in reservation order; consumers do the same with the consumer head and tail.
+Producer and consumer indexes are kept on separate cache lines, so a thread
+that only pushes and a thread that only pulls do not share a cache line
+except for the packet slots themselves.
+
+Like Queue, RingQueue has non-empty and non-full notifiers, so pullers such
+as Unqueue sleep while the ring is empty and are woken when packets arrive.
+
+Dropped packets are emitted on output 1 if that output exists.
+
+=h length read-only
+
+Returns the current number of packets in the queue.
+
+=h highwater_length read-only
+
+Returns the maximum number of packets that have ever been in the queue at once.
+
+=h capacity read-only
+
+Returns the queue's capacity.
+
+=h drops read-only
+
+Returns the number of packets dropped by the queue so far.
+
+=h reset_counts write-only
+
+When written, resets the C<drops> and C<highwater_length> counters.
+
+=h reset write-only
+
+When written, drops all packets in the queue.
+
+=a ThreadSafeQueue, Queue, CPUQueue */
+
+class RingQueue : public Element { public:
+
+    RingQueue() CLICK_COLD;
+
+    const char *class_name() const		{ return "RingQueue"; }
+    const char *port_count() const		{ return PORTS_1_1X2; }
+    const char *processing() const		{ return "h/lh"; }
+    void *cast(const char *);
+
+    int configure(Vector<String> &conf, ErrorHandler *errh) CLICK_COLD;
+    int initialize(ErrorHandler *errh) CLICK_COLD;
+    void cleanup(CleanupStage) CLICK_COLD;
+    void add_handlers() CLICK_COLD;
+
+    void push(int port, Packet *p);
+    Packet *pull(int port);
+    void push_batch(int port, PacketBatch *batch);
+    void pull_batch(int port, PacketBatch *batch, unsigned max);
+
+    unsigned capacity() const			{ return _capacity; }
+    inline unsigned size() const;
+
+  private:
+
+    // Indexes run freely and wrap at 2^32; the slot for index i is
+    // _ring[i & _mask].  Each head is advanced by compare-and-swap to reserve
+    // slots, and each tail is advanced in reservation order to publish them.
+    struct HeadTail {
+	atomic_uint32_t head;
+	atomic_uint32_t tail;
+    };
+
+    // A full cache line of padding on each side keeps the producer and
+    // consumer pairs from sharing a line with each other or with other
+    // members.  (Aligning them instead would make 'new RingQueue' need an
+    // over-aligned allocation.)  Each side's shared counter lives next to
+    // its indexes: only producers raise _highwater_length, and only
+    // consumers update _sleepiness.
+    char _pad0[CLICK_CACHE_LINE_SIZE];
+    HeadTail _prod;
+    atomic_uint32_t _highwater_length;
+    char _pad1[CLICK_CACHE_LINE_SIZE];
+    HeadTail _cons;
+    atomic_uint32_t _sleepiness;
+    char _pad2[CLICK_CACHE_LINE_SIZE];
+
+    Packet **_ring;
+    uint32_t _mask;
+    uint32_t _capacity;
+
+    ActiveNotifier _empty_note;
+    ActiveNotifier _full_note;
+
+    atomic_uint32_t _drops;
+
+    enum { SLEEPINESS_TRIGGER = 9 };
+
+    inline uint32_t enqueue_reserve(uint32_t n, uint32_t &prod_head);
+    inline void enqueue_publish(uint32_t prod_head, uint32_t n);
+    inline uint32_t dequeue_reserve(uint32_t n, uint32_t &cons_head);
+    inline void dequeue_release(uint32_t cons_head, uint32_t n);
+    inline void enqueue_success();
+    inline void dequeue_success();
+    inline void dequeue_failure();
+    void overflow(Packet *p);
+
+    enum { h_length, h_highwater_length, h_capacity, h_drops,
+	   h_reset_counts, h_reset };
+    static String read_handler(Element *e, void *user_data) CLICK_COLD;
+    static int write_handler(const String &str, Element *e, void *user_data, ErrorHandler *errh) CLICK_COLD;
+
+};
+
+inline unsigned
+RingQueue::size() const
+{
+    // Read the consumer tail first: the producer tail can only be ahead of
+    // it.
+    uint32_t cons_tail = _cons.tail.value();
+    click_read_fence();
+    return _prod.tail.value() - cons_tail;
+}
+
+CLICK_ENDDECLS
+#endif
@@ -165,6 +165,21 @@ SimpleQueue::pull(int)
     return deq();
 }
 
+void
+SimpleQueue::push_batch(int, PacketBatch *batch)
+{
+    // If you change this code, also change NotifierQueue::push_batch()
+    // and FullNoteQueue::push_batch().
+    enq_batch(batch);
+    batch_overflow(batch);
+}
+
+void
+SimpleQueue::pull_batch(int, PacketBatch *batch, unsigned max)
+{
+    deq_batch(batch, max);
+}
+
 
 String
 SimpleQueue::read_handler(Element *e, void *thunk)
@@ -21,6 +21,10 @@ Stores incoming packets in a first-in-first-out queue.
 Drops incoming packets if the queue already holds CAPACITY packets.
 The default for CAPACITY is 1000.
 
+A batch of packets pushed to the queue is stored in one pass; the packets that
+do not fit are dropped together.  Pulling a batch dequeues up to the requested
+number of packets at once.
+
 B<Multithreaded Click note:> SimpleQueue is designed to be used in an
 environment with at most one concurrent pusher and at most one concurrent
 puller.  Thus, at most one thread pushes to the SimpleQueue at a time and at
@@ -72,6 +76,8 @@ class SimpleQueue : public Element, public Storage { public:
     inline bool enq(Packet*);
     inline void lifo_enq(Packet*);
     inline Packet* deq();
+    inline unsigned enq_batch(PacketBatch *batch);
+    inline unsigned deq_batch(PacketBatch *batch, unsigned max);
 
     // to be used with care
     Packet* packet(int i) const			{ return _q[i]; }
@@ -96,9 +102,13 @@ class SimpleQueue : public Element, public Storage { public:
 
     void push(int port, Packet*);
     Packet* pull(int port);
+    void push_batch(int port, PacketBatch *batch);
+    void pull_batch(int port, PacketBatch *batch, unsigned max);
 
   protected:
 
+    inline void batch_overflow(PacketBatch *batch);
+
     Packet* volatile * _q;
     volatile int _drops;
     int _highwater_length;
@@ -162,6 +172,57 @@ SimpleQueue::deq()
 	return 0;
 }
 
+/** @brief Store packets from the front of @a batch until the queue is full.
+ *
+ * Returns the number of packets stored.  Packets that did not fit are left
+ * in @a batch. */
+inline unsigned
+SimpleQueue::enq_batch(PacketBatch *batch)
+{
+    Storage::index_type h = head(), t = tail(), nt;
+    unsigned n = 0;
+    while (!batch->empty() && (nt = next_i(t)) != h) {
+	_q[t] = batch->pop_front();
+	t = nt;
+	++n;
+    }
+    if (n) {
+	set_tail(t);
+	int s = size(h, t);
+	if (s > _highwater_length)
+	    _highwater_length = s;
+    }
+    return n;
+}
+
+/** @brief Append up to @a max packets from the queue to @a batch.
+ *
+ * Returns the number of packets dequeued. */
+inline unsigned
+SimpleQueue::deq_batch(PacketBatch *batch, unsigned max)
+{
+    Storage::index_type h = head(), t = tail();
+    unsigned n = 0;
+    for (; h != t && n < max; h = next_i(h), ++n) {
+	assert(_q[h]);
+	batch->append(_q[h]);
+    }
+    if (n)
+	set_head(h);
+    return n;
+}
+
+inline void
+SimpleQueue::batch_overflow(PacketBatch *batch)
+{
+    if (!batch->empty()) {
+	if (_drops == 0 && _capacity > 0)
+	    click_chatter("%p{element}: overflow", this);
+	_drops += batch->count();
+	checked_output_push_batch(1, batch);
+    }
+}
+
 template <typename Filter>
 Packet *
 SimpleQueue::yank1(Filter filter)
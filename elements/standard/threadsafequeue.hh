@@ -62,6 +62,12 @@ class ThreadSafeQueue : public FullNoteQueue { public:
 
     void push(int port, Packet *);
     Packet *pull(int port);
+    void push_batch(int port, PacketBatch *batch) {
+	Element::push_batch(port, batch);
+    }
+    void pull_batch(int port, PacketBatch *batch, unsigned max) {
+	Element::pull_batch(port, batch, max);
+    }
 
   private:
 
@@ -68,19 +68,22 @@ Unqueue::run_task(Task *)
 	    return false;
     }
 
-    while (worked < limit && _active) {
-	if (Packet *p = input(0).pull()) {
-	    ++worked;
-	    ++_count;
-	    output(0).push(p);
-	} else if (!_signal)
-	    goto out;
-	else
+    // Move the burst in bounded batches, so a large BURST never gathers
+    // every queued packet into one batch.
+    while (worked < limit) {
+	int want = (limit - worked < max_batch ? limit - worked : max_batch);
+	PacketBatch batch;
+	input(0).pull_batch(&batch, want);
+	int n = batch.count();
+	worked += n;
+	_count += n;
+	output(0).push_batch(&batch);
+	if (n < want)
 	    break;
     }
 
-    _task.fast_reschedule();
-  out:
+    if (worked == limit || _signal)
+	_task.fast_reschedule();
     return worked > 0;
 }
 
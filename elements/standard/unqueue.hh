@@ -18,8 +18,8 @@ pull-to-push converter
 
 Pulls packets whenever they are available, then pushes them out
 its single output. Pulls a maximum of BURST packets every time
-it is scheduled. Default BURST is 1. If BURST
-is less than 0, pull until nothing comes back.
+it is scheduled, and pushes them on in batches of at most 32 packets. Default
+BURST is 1. If BURST is less than 0, pull until nothing comes back.
 
 Keyword arguments are:
 
@@ -89,6 +89,7 @@ class Unqueue : public Element { public:
     enum {
 	h_active, h_reset, h_burst, h_limit
     };
+    enum { max_batch = 32 };
     static int write_param(const String &, Element *, void *, ErrorHandler *) CLICK_COLD;
 
 };
@@ -31,6 +31,7 @@ CLICK_DECLS
 IPRewriter::IPRewriter()
     : _udp_map(0)
 {
+    _shard_flow_size = 0;	// two maps per element; can't shard
 }
 
 IPRewriter::~IPRewriter()
@@ -99,8 +99,12 @@ TCPFragmenter::push(int, Packet *p)
         click_tcp *tcp = q->tcp_header();
         uint8_t *tcp_data = ((uint8_t *)tcp) + (tcp->th_off<<2);
         int this_len = tcp_len - offset > max_tcp_len ? max_tcp_len : tcp_len - offset;
+        // checksum the payload as it is moved into place
+        uint32_t data_csum;
         if (offset != 0)
-            memcpy(tcp_data, tcp_data + offset, this_len);
+            data_csum = click_in_cksum_copy_partial(tcp_data, tcp_data + offset, this_len, 0);
+        else
+            data_csum = click_in_cksum_partial(tcp_data, this_len, 0);
         q->take(tcp_len - this_len);
         ip->ip_len = htons(q->end_data() - q->network_header());
         ip->ip_sum = 0;
@@ -118,7 +122,7 @@ TCPFragmenter::push(int, Packet *p)
 
         // now calculate tcp header cksum
         int plen = q->end_data() - (uint8_t*)tcp;
-        unsigned csum = click_in_cksum((unsigned char *)tcp, plen);
+        unsigned csum = click_in_cksum_fold(click_in_cksum_partial((unsigned char *)tcp, tcp->th_off << 2, data_csum));
         tcp->th_sum = click_in_cksum_pseudohdr(csum, ip, plen);
         _fragments++;
         output(0).push(q);
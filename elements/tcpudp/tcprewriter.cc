@@ -236,6 +236,7 @@ TCPRewriter::TCPFlow::unparse(StringAccum &sa, bool direction, click_jiffies_t n
 
 TCPRewriter::TCPRewriter()
 {
+    _shard_flow_size = sizeof(TCPFlow);
 }
 
 TCPRewriter::~TCPRewriter()
@@ -285,15 +286,16 @@ IPRewriterEntry *
 TCPRewriter::add_flow(int /*ip_p*/, const IPFlowID &flowid,
 		      const IPFlowID &rewritten_flowid, int input)
 {
+    IPRewriterShard *sh = flow_shard(flowid);
     void *data;
-    if (!(data = _allocator.allocate()))
+    if (!(data = (sh ? sh->allocator.allocate() : _allocator.allocate())))
 	return 0;
 
     TCPFlow *flow = new(data) TCPFlow
 	(&_input_specs[input], flowid, rewritten_flowid,
 	 !!_timeouts[1], click_jiffies() + relevant_timeout(_timeouts));
 
-    return store_flow(flow, input, _map);
+    return store_flow(flow, input, sh ? sh->map : _map);
 }
 
 void
@@ -315,7 +317,10 @@ TCPRewriter::push(int port, Packet *p_in)
     }
 
     IPFlowID flowid(p);
-    IPRewriterEntry *m = _map.get(flowid);
+    IPRewriterShard *sh = flow_shard(flowid);
+    if (sh)
+	sh->lock.acquire();
+    IPRewriterEntry *m = (sh ? sh->map.get(flowid) : _map.get(flowid));
 
     if (!m) {			// create new mapping
 	IPRewriterInput &is = _input_specs.unchecked_at(port);
@@ -324,6 +329,8 @@ TCPRewriter::push(int port, Packet *p_in)
 	if (result == rw_addmap)
 	    m = TCPRewriter::add_flow(IP_PROTO_TCP, flowid, rewritten_flowid, port);
 	if (!m) {
+	    if (sh)
+		sh->lock.release();
 	    checked_output_push(result, p);
 	    return;
 	} else if (_annos & 2)
@@ -333,13 +340,17 @@ TCPRewriter::push(int port, Packet *p_in)
     TCPFlow *mf = static_cast<TCPFlow *>(m->flow());
     mf->apply(p, m->direction(), _annos);
 
+    IPRewriterHeap *heap = (sh ? sh->heap : _heap);
     click_jiffies_t now_j = click_jiffies();
     if (_timeouts[1])
-	mf->change_expiry(_heap, true, now_j + _timeouts[1]);
+	mf->change_expiry(heap, true, now_j + _timeouts[1]);
     else
-	mf->change_expiry(_heap, false, now_j + tcp_flow_timeout(mf));
+	mf->change_expiry(heap, false, now_j + tcp_flow_timeout(mf));
 
-    output(m->output()).push(p);
+    int output_port = m->output();
+    if (sh)
+	sh->lock.release();
+    output(output_port).push(p);
 }
 
 
@@ -349,10 +360,18 @@ TCPRewriter::tcp_mappings_handler(Element *e, void *)
     TCPRewriter *rw = (TCPRewriter *)e;
     click_jiffies_t now = click_jiffies();
     StringAccum sa;
-    for (Map::iterator iter = rw->_map.begin(); iter.live(); ++iter) {
-	TCPFlow *f = static_cast<TCPFlow *>(iter->flow());
-	f->unparse(sa, iter->direction(), now);
-	sa << '\n';
+    for (int s = 0; s < rw->_shards.size() || s == 0; ++s) {
+	IPRewriterShard *sh = (rw->_shards.empty() ? 0 : rw->_shards[s]);
+	Map &map = (sh ? sh->map : rw->_map);
+	if (sh)
+	    sh->lock.acquire();
+	for (Map::iterator iter = map.begin(); iter.live(); ++iter) {
+	    TCPFlow *f = static_cast<TCPFlow *>(iter->flow());
+	    f->unparse(sa, iter->direction(), now);
+	    sa << '\n';
+	}
+	if (sh)
+	    sh->lock.release();
     }
     return sa.take_string();
 }
@@ -372,12 +391,15 @@ TCPRewriter::tcp_lookup_handler(int, String &str, Element *e, const Handler *, E
 	.complete() < 0)
 	return -1;
 
-    HashContainer<IPRewriterEntry> *map = rw->get_map(IPRewriterInput::mapid_default);
+    StringAccum sa;
+    IPFlowID flow(saddr, htons(sport), daddr, htons(dport));
+    IPRewriterShard *sh = rw->flow_shard(flow);
+    HashContainer<IPRewriterEntry> *map = (sh ? &sh->map : rw->get_map(IPRewriterInput::mapid_default));
     if (!map)
 	return errh->error("no map!");
 
-    StringAccum sa;
-    IPFlowID flow(saddr, htons(sport), daddr, htons(dport));
+    if (sh)
+	sh->lock.acquire();
     if (Map::iterator iter = map->find(flow)) {
 	TCPFlow *f = static_cast<TCPFlow *>(iter->flow());
 	const IPFlowID &flowid = f->entry(iter->direction()).rewritten_flowid();
@@ -385,6 +407,8 @@ TCPRewriter::tcp_lookup_handler(int, String &str, Element *e, const Handler *, E
 	sa << flowid.saddr() << " " << ntohs(flowid.sport()) << " "
 	   << flowid.daddr() << " " << ntohs(flowid.dport());
     }
+    if (sh)
+	sh->lock.release();
 
     str = sa.take_string();
     return 0;
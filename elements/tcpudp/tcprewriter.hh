@@ -73,6 +73,22 @@ element, in which case this element will share the other element's capacity.
 Boolean. If true, then set the destination IP address annotation on passing
 packets to the rewritten destination address. Default is true.
 
+=item SHARDS I<n>
+
+Integer. Split the mapping table into I<n> shards, each with its own map,
+expiration heap, memory pool, lock, and reaping timer. SHARDS 0 means one
+shard per driver thread, so the count follows the number of threads Click
+runs with. Flows are placed by a symmetric hash of their flow IDs, and
+patterns only allocate ports or addresses whose replies hash to the same
+shard, so both directions of a connection always use the same shard. When
+threads receive packets already steered by flow, as with symmetric RSS, they
+never contend for a shard. MAPPING_CAPACITY is divided evenly among the
+shards; it cannot be shared with another element, and every reply must
+return to this element. Patterns that rewrite a flow must vary a port or
+address, since a fixed rewrite cannot keep the reply in the flow's shard.
+Each shard keeps its own place in sequential patterns and RoundRobinIPMapper
+rotations. Default is 1.
+
 =back
 
 =h table read-only
@@ -197,6 +213,12 @@ class TCPRewriter : public IPRewriterBase { public:
 inline void
 TCPRewriter::destroy_flow(IPRewriterFlow *flow)
 {
+    if (IPRewriterShard *sh = flow_shard(flow->entry(false).flowid())) {
+	unmap_flow(flow, sh->map, &sh->map);
+	static_cast<TCPFlow *>(flow)->~TCPFlow();
+	sh->allocator.deallocate(flow);
+	return;
+    }
     unmap_flow(flow, _map);
     static_cast<TCPFlow *>(flow)->~TCPFlow();
     _allocator.deallocate(flow);
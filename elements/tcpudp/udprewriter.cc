@@ -68,6 +68,7 @@ UDPRewriter::UDPFlow::apply(WritablePacket *p, bool direction, unsigned annos)
 
 UDPRewriter::UDPRewriter()
 {
+    _shard_flow_size = sizeof(UDPFlow);
 }
 
 UDPRewriter::~UDPRewriter()
@@ -116,15 +117,16 @@ IPRewriterEntry *
 UDPRewriter::add_flow(int ip_p, const IPFlowID &flowid,
 		      const IPFlowID &rewritten_flowid, int input)
 {
+    IPRewriterShard *sh = flow_shard(flowid);
     void *data;
-    if (!(data = _allocator.allocate()))
+    if (!(data = (sh ? sh->allocator.allocate() : _allocator.allocate())))
 	return 0;
 
     UDPFlow *flow = new(data) UDPFlow
 	(&_input_specs[input], flowid, rewritten_flowid, ip_p,
 	 !!_timeouts[1], click_jiffies() + relevant_timeout(_timeouts));
 
-    return store_flow(flow, input, _map);
+    return store_flow(flow, input, sh ? sh->map : _map);
 }
 
 void
@@ -149,7 +151,10 @@ UDPRewriter::push(int port, Packet *p_in)
     }
 
     IPFlowID flowid(p);
-    IPRewriterEntry *m = _map.get(flowid);
+    IPRewriterShard *sh = flow_shard(flowid);
+    if (sh)
+	sh->lock.acquire();
+    IPRewriterEntry *m = (sh ? sh->map.get(flowid) : _map.get(flowid));
 
     if (!m) {			// create new mapping
 	IPRewriterInput &is = _input_specs.unchecked_at(port);
@@ -158,6 +163,8 @@ UDPRewriter::push(int port, Packet *p_in)
 	if (result == rw_addmap)
 	    m = UDPRewriter::add_flow(ip_p, flowid, rewritten_flowid, port);
 	if (!m) {
+	    if (sh)
+		sh->lock.release();
 	    checked_output_push(result, p);
 	    return;
 	} else if (_annos & 2)
@@ -167,13 +174,17 @@ UDPRewriter::push(int port, Packet *p_in)
     UDPFlow *mf = static_cast<UDPFlow *>(m->flow());
     mf->apply(p, m->direction(), _annos);
 
+    IPRewriterHeap *heap = (sh ? sh->heap : _heap);
     click_jiffies_t now_j = click_jiffies();
     if (_timeouts[1])
-	mf->change_expiry(_heap, true, now_j + _timeouts[1]);
+	mf->change_expiry(heap, true, now_j + _timeouts[1]);
     else
-	mf->change_expiry(_heap, false, now_j + udp_flow_timeout(mf));
+	mf->change_expiry(heap, false, now_j + udp_flow_timeout(mf));
 
-    output(m->output()).push(p);
+    int output_port = m->output();
+    if (sh)
+	sh->lock.release();
+    output(output_port).push(p);
 }
 
 
@@ -183,9 +194,17 @@ UDPRewriter::dump_mappings_handler(Element *e, void *)
     UDPRewriter *rw = (UDPRewriter *)e;
     click_jiffies_t now = click_jiffies();
     StringAccum sa;
-    for (Map::iterator iter = rw->_map.begin(); iter.live(); ++iter) {
-	iter->flow()->unparse(sa, iter->direction(), now);
-	sa << '\n';
+    for (int s = 0; s < rw->_shards.size() || s == 0; ++s) {
+	IPRewriterShard *sh = (rw->_shards.empty() ? 0 : rw->_shards[s]);
+	Map &map = (sh ? sh->map : rw->_map);
+	if (sh)
+	    sh->lock.acquire();
+	for (Map::iterator iter = map.begin(); iter.live(); ++iter) {
+	    iter->flow()->unparse(sa, iter->direction(), now);
+	    sa << '\n';
+	}
+	if (sh)
+	    sh->lock.release();
     }
     return sa.take_string();
 }
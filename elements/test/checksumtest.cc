@@ -0,0 +1,219 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * checksumtest.{cc,hh} -- regression test and benchmark element for
+ * Internet checksums
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "checksumtest.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/straccum.hh>
+#include <click/timestamp.hh>
+#include <clicknet/ip.h>
+#if HAVE_IP6
+# include <clicknet/ip6.h>
+#endif
+CLICK_DECLS
+
+ChecksumTest::ChecksumTest()
+    : _benchmark(false), _bytes(1 << 26)
+{
+}
+
+int
+ChecksumTest::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    return Args(conf, this, errh)
+	.read("BENCHMARK", _benchmark)
+	.read("BYTES", _bytes)
+	.complete();
+}
+
+#define CHECK(x) if (!(x)) return errh->error("%s: %s:%d: test `%s' failed", impl, __FILE__, __LINE__, #x);
+
+static const char * const impls[] = { "generic", "sse2", "avx2" };
+
+enum { MAX_LEN = 9216, SLACK = 64 };
+
+// The 16-bit loop click_in_cksum used to be, as a reference.
+static uint16_t
+reference_cksum(const unsigned char *x, int len)
+{
+    uint32_t sum = 0;
+    uint16_t w;
+    for (; len > 1; x += 2, len -= 2) {
+	memcpy(&w, x, 2);
+	sum += w;
+    }
+    if (len == 1) {
+	w = 0;
+	*(unsigned char *) &w = *x;
+	sum += w;
+    }
+    while (sum >> 16)
+	sum = (sum & 0xFFFF) + (sum >> 16);
+    return ~sum & 0xFFFF;
+}
+
+static void
+fill_random(unsigned char *x, int len)
+{
+    for (int i = 0; i < len; i++)
+	x[i] = click_random();
+}
+
+int
+ChecksumTest::check_impl(const char *impl, ErrorHandler *errh)
+{
+    Vector<unsigned char> srcv(MAX_LEN + SLACK, 0), dstv(MAX_LEN + SLACK, 0);
+    unsigned char *src = srcv.begin(), *dst = dstv.begin();
+
+    // all-zero and all-one data
+    for (int len = 0; len < 300; len++)
+	CHECK(click_in_cksum(src + 1, len) == 0xFFFF);
+    memset(src, 0xFF, MAX_LEN + SLACK);
+    for (int len = 0; len < 300; len++)
+	CHECK(click_in_cksum(src, len) == reference_cksum(src, len));
+
+    for (int round = 0; round < 3000; round++) {
+	int len = round < 1000 ? round : click_random(0, MAX_LEN);
+	unsigned char *s = src + click_random(0, SLACK / 2 - 1);
+	unsigned char *d = dst + click_random(1, SLACK / 2);
+	fill_random(src, MAX_LEN + SLACK);
+	fill_random(dst, MAX_LEN + SLACK);
+	uint16_t ref = reference_cksum(s, len);
+	CHECK(click_in_cksum(s, len) == ref);
+
+	// a checksum built from two ranges
+	int split = click_random(0, len) & ~1;
+	uint32_t sum = click_in_cksum_partial(s, split, 0);
+	CHECK(click_in_cksum_fold(click_in_cksum_partial(s + split, len - split, sum)) == ref);
+
+	// copies must not touch the bytes around the destination
+	unsigned char before = d[-1], after = d[len];
+	CHECK(click_in_cksum_copy(d, s, len) == ref);
+	CHECK(memcmp(d, s, len) == 0 && d[-1] == before && d[len] == after);
+	fill_random(d, len);
+	sum = click_in_cksum_copy_partial(d, s, split, 0);
+	sum = click_in_cksum_copy_partial(d + split, s + split, len - split, sum);
+	CHECK(click_in_cksum_fold(sum) == ref);
+	CHECK(memcmp(d, s, len) == 0);
+
+#if HAVE_IP6
+	if (len >= 8 && len < 65536) {
+	    struct in6_addr saddr, daddr;
+	    fill_random((unsigned char *) &saddr, 16);
+	    fill_random((unsigned char *) &daddr, 16);
+	    uint16_t ori_csum;
+	    memcpy(&ori_csum, s + 6, 2);
+	    CHECK(in6_fast_cksum(&saddr, &daddr, htons(len), 17, ori_csum, s, htons(len))
+		  == in6_cksum(&saddr, &daddr, htons(len), 17, ori_csum, s, htons(len)));
+	}
+#endif
+    }
+    return 0;
+}
+
+int
+ChecksumTest::initialize(ErrorHandler *errh)
+{
+    String saved_impl = click_in_cksum_impl();
+    int nimpls = 0;
+    for (size_t i = 0; i < sizeof(impls) / sizeof(impls[0]); i++)
+	if (click_in_cksum_set_impl(impls[i]) == 0) {
+	    ++nimpls;
+	    if (check_impl(impls[i], errh) < 0) {
+		click_in_cksum_set_impl(saved_impl.c_str());
+		return -1;
+	    }
+	}
+    click_in_cksum_set_impl(saved_impl.c_str());
+
+    if (nimpls == 0)
+	return errh->error("no checksum implementations");
+    errh->message("All tests pass!");
+
+    if (_benchmark)
+	return benchmark(errh);
+    return 0;
+}
+
+int
+ChecksumTest::benchmark(ErrorHandler *errh)
+{
+    static const int lengths[] = { 64, 128, 256, 512, 1024, 1500, 4096, 9000 };
+    enum { op_cksum, op_copy, op_memcpy_cksum };
+    static const char * const op_names[] = { "cksum", "copy", "memcpy+cksum" };
+
+    Vector<unsigned char> srcv(MAX_LEN, 0), dstv(MAX_LEN, 0);
+    unsigned char *src = srcv.begin(), *dst = dstv.begin();
+    fill_random(src, MAX_LEN);
+    String saved_impl = click_in_cksum_impl();
+    StringAccum sa;
+    volatile uint32_t sink = 0;
+
+    for (size_t i = 0; i < sizeof(impls) / sizeof(impls[0]); i++) {
+	if (click_in_cksum_set_impl(impls[i]) != 0)
+	    continue;
+	for (size_t j = 0; j < sizeof(lengths) / sizeof(lengths[0]); j++) {
+	    int len = lengths[j];
+	    uint32_t n = _bytes / len + 1;
+	    for (int op = op_cksum; op <= op_memcpy_cksum; op++) {
+		uint32_t x = 0;
+		Timestamp start = Timestamp::now_steady();
+		for (uint32_t k = 0; k < n; k++)
+		    if (op == op_cksum)
+			x += click_in_cksum(src, len);
+		    else if (op == op_copy)
+			x += click_in_cksum_copy(dst, src, len);
+		    else {
+			memcpy(dst, src, len);
+			x += click_in_cksum(dst, len);
+		    }
+		Timestamp elapsed = Timestamp::now_steady() - start;
+		sink += x;
+
+		double nsec = elapsed.doubleval() * 1e9 / n;
+		double gbps = nsec > 0 ? len * 8 / nsec : 0;
+		sa.snprintf(80, "%s %s %d %.1f %.2f\n", impls[i], op_names[op], len, nsec, gbps);
+		errh->message("%s %s %d bytes: %.1f ns, %.2f Gbps", impls[i], op_names[op], len, nsec, gbps);
+	    }
+	}
+    }
+
+    click_in_cksum_set_impl(saved_impl.c_str());
+    _results = sa.take_string();
+    return 0;
+}
+
+String
+ChecksumTest::read_handler(Element *e, void *user_data)
+{
+    ChecksumTest *ct = static_cast<ChecksumTest *>(e);
+    if (user_data)
+	return ct->_results;
+    else
+	return click_in_cksum_impl();
+}
+
+void
+ChecksumTest::add_handlers()
+{
+    add_read_handler("impl", read_handler, 0);
+    add_read_handler("results", read_handler, 1);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(userlevel)
+EXPORT_ELEMENT(ChecksumTest)
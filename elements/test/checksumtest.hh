@@ -0,0 +1,85 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_CHECKSUMTEST_HH
+#define CLICK_CHECKSUMTEST_HH
+#include <click/element.hh>
+CLICK_DECLS
+
+/*
+=c
+
+ChecksumTest([I<keywords>])
+
+=s test
+
+runs regression tests and benchmarks for Internet checksums
+
+=d
+
+Without other arguments, ChecksumTest runs regression tests for Click's
+Internet checksum functions at initialization time.  Every checksum
+implementation the CPU supports ("generic", and on x86 "sse2" and "avx2") is
+checked against a simple 16-bit reference on random data with random
+lengths and alignments.  This covers click_in_cksum, click_in_cksum_partial
+with split ranges, and the fused click_in_cksum_copy.  When IPv6 is
+configured, in6_fast_cksum is checked against in6_cksum.
+
+ChecksumTest does not route packets.
+
+Keyword arguments are:
+
+=over 8
+
+=item BENCHMARK
+
+Boolean. If true, then ChecksumTest also runs a benchmark at initialization
+time.  For every supported implementation and for data lengths from 64
+bytes to 9000 bytes, it measures click_in_cksum, click_in_cksum_copy, and
+memcpy followed by click_in_cksum.  Results are reported on standard error
+and by the C<results> handler.  Default is false.
+
+=item BYTES
+
+Integer. The number of bytes each benchmark measurement processes.  Default
+is 64 MB.
+
+=back
+
+=h impl r
+
+Returns the name of the checksum implementation in use.
+
+=h results r
+
+Returns the results of the last benchmark, one line per measurement: the
+implementation, the operation ("cksum", "copy", or "memcpy+cksum"), the
+data length, nanoseconds per call, and gigabits per second.
+
+=a
+
+SetIPChecksum, SetTCPChecksum, SetUDPChecksum
+*/
+
+class ChecksumTest : public Element { public:
+
+    ChecksumTest() CLICK_COLD;
+
+    const char *class_name() const		{ return "ChecksumTest"; }
+
+    int configure(Vector<String> &conf, ErrorHandler *errh) CLICK_COLD;
+    int initialize(ErrorHandler *errh) CLICK_COLD;
+    void add_handlers() CLICK_COLD;
+
+  private:
+
+    bool _benchmark;
+    uint32_t _bytes;
+    String _results;
+
+    int check_impl(const char *impl, ErrorHandler *errh);
+    int benchmark(ErrorHandler *errh);
+    static String read_handler(Element *e, void *user_data) CLICK_COLD;
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -0,0 +1,169 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * crc32test.{cc,hh} -- regression test and benchmark element for CRC-32
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "crc32test.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/straccum.hh>
+#include <click/timestamp.hh>
+#include <click/crc32.h>
+CLICK_DECLS
+
+CRC32Test::CRC32Test()
+    : _benchmark(false), _bytes(1 << 26)
+{
+}
+
+int
+CRC32Test::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    return Args(conf, this, errh)
+	.read("BENCHMARK", _benchmark)
+	.read("BYTES", _bytes)
+	.complete();
+}
+
+#define CHECK(x) if (!(x)) return errh->error("%s: %s:%d: test `%s' failed", impl, __FILE__, __LINE__, #x);
+
+static const char * const impls[] = { "table", "slice8", "pclmul" };
+
+enum { MAX_LEN = 9216, SLACK = 32 };
+
+static void
+fill_random(unsigned char *x, int len)
+{
+    for (int i = 0; i < len; i++)
+	x[i] = click_random();
+}
+
+int
+CRC32Test::check_impl(const char *impl, ErrorHandler *errh)
+{
+    Vector<unsigned char> datav(MAX_LEN + SLACK, 0);
+    unsigned char *data = datav.begin();
+    Vector<uint32_t> ref;
+
+    // the CRC-32/MPEG-2 check value
+    CHECK(update_crc(0xFFFFFFFF, "123456789", 9) == 0x0376E6E7);
+
+    // compute reference values with the byte-at-a-time table
+    Vector<int> lens, offs;
+    Vector<uint32_t> inits;
+    for (int round = 0; round < 2000; round++) {
+	lens.push_back(round < 600 ? round : click_random(0, MAX_LEN));
+	offs.push_back(click_random(0, SLACK - 1));
+	inits.push_back(round & 1 ? click_random() : 0xFFFFFFFF);
+    }
+    fill_random(data, MAX_LEN + SLACK);
+    click_crc32_set_impl("table");
+    for (int i = 0; i < lens.size(); i++)
+	ref.push_back(update_crc(inits[i], (const char *) data + offs[i], lens[i]));
+
+    click_crc32_set_impl(impl);
+    for (int i = 0; i < lens.size(); i++) {
+	const char *s = (const char *) data + offs[i];
+	CHECK(update_crc(inits[i], s, lens[i]) == ref[i]);
+	// a CRC continued across two blocks
+	int split = click_random(0, lens[i]);
+	uint32_t crc = update_crc(inits[i], s, split);
+	CHECK(update_crc(crc, s + split, lens[i] - split) == ref[i]);
+    }
+    return 0;
+}
+
+int
+CRC32Test::initialize(ErrorHandler *errh)
+{
+    String saved_impl = click_crc32_impl();
+    int nimpls = 0;
+    for (size_t i = 0; i < sizeof(impls) / sizeof(impls[0]); i++)
+	if (click_crc32_set_impl(impls[i]) == 0) {
+	    ++nimpls;
+	    if (check_impl(impls[i], errh) < 0) {
+		click_crc32_set_impl(saved_impl.c_str());
+		return -1;
+	    }
+	}
+    click_crc32_set_impl(saved_impl.c_str());
+
+    if (nimpls == 0)
+	return errh->error("no CRC-32 implementations");
+    errh->message("All tests pass!");
+
+    if (_benchmark)
+	return benchmark(errh);
+    return 0;
+}
+
+int
+CRC32Test::benchmark(ErrorHandler *errh)
+{
+    static const int lengths[] = { 64, 128, 256, 512, 1024, 1500, 4096, 9000 };
+
+    Vector<unsigned char> datav(MAX_LEN, 0);
+    const char *data = (const char *) datav.begin();
+    fill_random(datav.begin(), MAX_LEN);
+    String saved_impl = click_crc32_impl();
+    StringAccum sa;
+    volatile uint32_t sink = 0;
+
+    for (size_t i = 0; i < sizeof(impls) / sizeof(impls[0]); i++) {
+	if (click_crc32_set_impl(impls[i]) != 0)
+	    continue;
+	for (size_t j = 0; j < sizeof(lengths) / sizeof(lengths[0]); j++) {
+	    int len = lengths[j];
+	    uint32_t n = _bytes / len + 1, crc = 0xFFFFFFFF;
+	    Timestamp start = Timestamp::now_steady();
+	    click_cycles_t start_cycles = click_get_cycles();
+	    for (uint32_t k = 0; k < n; k++)
+		crc = update_crc(crc, data, len);
+	    click_cycles_t cycles = click_get_cycles() - start_cycles;
+	    Timestamp elapsed = Timestamp::now_steady() - start;
+	    sink += crc;
+
+	    double bytes = (double) n * len;
+	    double bpc = cycles ? bytes / cycles : 0;
+	    double nsec = elapsed.doubleval() * 1e9;
+	    double gbps = nsec > 0 ? bytes * 8 / nsec : 0;
+	    sa.snprintf(80, "%s %d %.3f %.2f\n", impls[i], len, bpc, gbps);
+	    errh->message("%s %d bytes: %.3f bytes/cycle, %.2f Gbps", impls[i], len, bpc, gbps);
+	}
+    }
+
+    click_crc32_set_impl(saved_impl.c_str());
+    _results = sa.take_string();
+    return 0;
+}
+
+String
+CRC32Test::read_handler(Element *e, void *user_data)
+{
+    CRC32Test *ct = static_cast<CRC32Test *>(e);
+    if (user_data)
+	return ct->_results;
+    else
+	return click_crc32_impl();
+}
+
+void
+CRC32Test::add_handlers()
+{
+    add_read_handler("impl", read_handler, 0);
+    add_read_handler("results", read_handler, 1);
+}
+
+CLICK_ENDDECLS
+EXPORT_ELEMENT(CRC32Test)
@@ -0,0 +1,82 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_CRC32TEST_HH
+#define CLICK_CRC32TEST_HH
+#include <click/element.hh>
+CLICK_DECLS
+
+/*
+=c
+
+CRC32Test([I<keywords>])
+
+=s test
+
+runs regression tests and benchmarks for update_crc
+
+=d
+
+Without other arguments, CRC32Test runs regression tests for update_crc, the
+CRC-32 function used by CheckCRC32 and SetCRC32, at initialization time.
+Every implementation the CPU supports ("table", "slice8", and on x86
+"pclmul") is compared with the byte-at-a-time table on random data with
+random lengths, alignments and initial values.
+
+CRC32Test does not route packets.
+
+Keyword arguments are:
+
+=over 8
+
+=item BENCHMARK
+
+Boolean. If true, then CRC32Test also runs a benchmark at initialization
+time.  For every supported implementation and for data lengths from 64
+bytes to 9000 bytes, it measures update_crc in bytes per CPU cycle and in
+gigabits per second.  Results are reported on standard error and by the
+C<results> handler.  Default is false.
+
+=item BYTES
+
+Integer. The number of bytes each benchmark measurement processes.  Default
+is 64 MB.
+
+=back
+
+=h impl r
+
+Returns the name of the CRC-32 implementation in use.
+
+=h results r
+
+Returns the results of the last benchmark, one line per measurement: the
+implementation, the data length, bytes per cycle, and gigabits per second.
+
+=a
+
+CheckCRC32, SetCRC32
+*/
+
+class CRC32Test : public Element { public:
+
+    CRC32Test() CLICK_COLD;
+
+    const char *class_name() const		{ return "CRC32Test"; }
+
+    int configure(Vector<String> &conf, ErrorHandler *errh) CLICK_COLD;
+    int initialize(ErrorHandler *errh) CLICK_COLD;
+    void add_handlers() CLICK_COLD;
+
+  private:
+
+    bool _benchmark;
+    uint32_t _bytes;
+    String _results;
+
+    int check_impl(const char *impl, ErrorHandler *errh);
+    int benchmark(ErrorHandler *errh);
+    static String read_handler(Element *e, void *user_data) CLICK_COLD;
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -0,0 +1,277 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * ip6tabletest.{cc,hh} -- regression test and benchmark element for IP6Table
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "ip6tabletest.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/timestamp.hh>
+CLICK_DECLS
+
+IP6TableTest::IP6TableTest()
+    : _benchmark(0), _lookups(10000000), _lookup_rate(0)
+{
+}
+
+int
+IP6TableTest::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    return Args(conf, this, errh)
+	.read("BENCHMARK", _benchmark)
+	.read("LOOKUPS", _lookups)
+	.complete();
+}
+
+#define CHECK(x) if (!(x)) return errh->error("%s:%d: test `%s' failed", __FILE__, __LINE__, #x);
+
+namespace {
+
+// The linear table IP6Table used to be, as a reference.
+struct LinearTable {
+    struct Route {
+	IP6Address dst;
+	IP6Address mask;
+	IP6Address gw;
+	int index;
+	bool valid;
+    };
+    Vector<Route> v;
+
+    void add(const IP6Address &dst, const IP6Address &mask, const IP6Address &gw, int index) {
+	del(dst, mask);
+	Route r;
+	r.dst = dst & mask;
+	r.mask = mask;
+	r.gw = gw;
+	r.index = index;
+	r.valid = true;
+	v.push_back(r);
+    }
+    void del(const IP6Address &dst, const IP6Address &mask) {
+	for (int i = 0; i < v.size(); i++)
+	    if (v[i].valid && v[i].dst == (dst & mask) && v[i].mask == mask)
+		v[i].valid = false;
+    }
+    bool lookup(const IP6Address &dst, IP6Address &gw, int &index) const {
+	int best = -1;
+	for (int i = 0; i < v.size(); i++)
+	    if (v[i].valid && dst.matches_prefix(v[i].dst, v[i].mask)
+		&& (best < 0 || v[i].mask.mask_as_specific(v[best].mask)))
+		best = i;
+	if (best < 0)
+	    return false;
+	gw = v[best].gw;
+	index = v[best].index;
+	return true;
+    }
+};
+
+}
+
+static IP6Address
+random_address()
+{
+    IP6Address a;
+    for (int i = 0; i < 4; i++)
+	a.data32()[i] = click_random();
+    return a;
+}
+
+// Returns a random address inside dst/mask.
+static IP6Address
+random_address_in(const IP6Address &dst, const IP6Address &mask)
+{
+    return (dst & mask) | (random_address() & ~mask);
+}
+
+static int
+compare_lookups(const IP6Table &t, const LinearTable &lt, int n, ErrorHandler *errh)
+{
+    for (int i = 0; i < n; i++) {
+	IP6Address a;
+	if (lt.v.size() && click_random(0, 3)) {
+	    const LinearTable::Route &r = lt.v[click_random(0, lt.v.size() - 1)];
+	    a = random_address_in(r.dst, r.mask);
+	} else
+	    a = random_address();
+	IP6Address gw1, gw2;
+	int index1 = -1, index2 = -1;
+	bool found1 = t.lookup(a, gw1, index1);
+	bool found2 = lt.lookup(a, gw2, index2);
+	CHECK(found1 == found2);
+	CHECK(!found1 || (gw1 == gw2 && index1 == index2));
+    }
+    return 0;
+}
+
+int
+IP6TableTest::initialize(ErrorHandler *errh)
+{
+    if (_benchmark > 0)
+	return benchmark(errh);
+
+    IP6Table t;
+    IP6Address gw, zero;
+    int index;
+
+    // an empty table
+    CHECK(!t.lookup(IP6Address("2001:db8::1"), gw, index));
+    CHECK(t.size() == 0);
+
+    // a default route, a /128 and routes ending on and around byte boundaries
+    t.add(IP6Address(), IP6Address(), IP6Address("fe80::1"), 0);
+    t.add(IP6Address("2001:db8::1"), IP6Address::make_prefix(128), zero, 1);
+    t.add(IP6Address("2001:db8::"), IP6Address::make_prefix(32), zero, 2);
+    t.add(IP6Address("2001:db8::"), IP6Address::make_prefix(31), zero, 3);
+    t.add(IP6Address("2001:db8:8000::"), IP6Address::make_prefix(33), zero, 4);
+    CHECK(t.size() == 5);
+    CHECK(t.lookup(IP6Address("2001:db8::1"), gw, index) && index == 1);
+    CHECK(t.lookup(IP6Address("2001:db8::2"), gw, index) && index == 2);
+    CHECK(t.lookup(IP6Address("2001:db9::2"), gw, index) && index == 3);
+    CHECK(t.lookup(IP6Address("2001:db8:8000::2"), gw, index) && index == 4);
+    CHECK(t.lookup(IP6Address("3ffe::1"), gw, index) && index == 0 && gw == IP6Address("fe80::1"));
+
+    // replacing and removing routes
+    t.add(IP6Address("2001:db8::"), IP6Address::make_prefix(32), zero, 5);
+    CHECK(t.size() == 5);
+    CHECK(t.lookup(IP6Address("2001:db8::2"), gw, index) && index == 5);
+    t.del(IP6Address("2001:db8::1"), IP6Address::make_prefix(128));
+    CHECK(t.lookup(IP6Address("2001:db8::1"), gw, index) && index == 5);
+    t.del(IP6Address("2001:db8::"), IP6Address::make_prefix(32));
+    CHECK(t.lookup(IP6Address("2001:db8::1"), gw, index) && index == 3);
+    CHECK(t.del(IP6Address("2001:db8::"), IP6Address::make_prefix(48)) == -ENOENT);
+    CHECK(t.del(IP6Address(), IP6Address()) == 0);
+    CHECK(!t.lookup(IP6Address("3ffe::1"), gw, index));
+    CHECK(t.size() == 2);
+
+    // masks that are not prefixes
+    CHECK(t.add(IP6Address("2001:db8::"), IP6Address("ffff:0:ffff::"), zero, 6) == -EINVAL);
+    CHECK(t.del(IP6Address("2001:db8::"), IP6Address("ffff:0:ffff::")) == -EINVAL);
+    CHECK(t.size() == 2);
+    t.clear();
+    CHECK(t.size() == 0);
+    CHECK(!t.lookup(IP6Address("2001:db8:8000::2"), gw, index));
+
+    // random tables, compared with a linear scan
+    for (int round = 0; round < 4; round++) {
+	LinearTable lt;
+	Vector<IP6Address> prefixes;
+	for (int i = 0; i < 2000; i++) {
+	    IP6Address dst;
+	    int len;
+	    if (prefixes.size() && click_random(0, 1)) {
+		// nest the new prefix inside an earlier one
+		int j = click_random(0, prefixes.size() - 1);
+		len = click_random(prefixes[j].mask_to_prefix_len(), 128);
+		dst = random_address_in(lt.v[j].dst, prefixes[j]);
+	    } else {
+		len = click_random(0, 128);
+		dst = random_address();
+	    }
+	    IP6Address mask = IP6Address::make_prefix(len);
+	    IP6Address gw = random_address();
+	    t.add(dst, mask, gw, i);
+	    lt.add(dst, mask, gw, i);
+	    prefixes.push_back(mask);
+	}
+	if (compare_lookups(t, lt, 20000, errh) < 0)
+	    return -1;
+
+	for (int i = 0; i < lt.v.size(); i++)
+	    if (click_random(0, 1)) {
+		t.del(lt.v[i].dst, lt.v[i].mask);
+		lt.del(lt.v[i].dst, lt.v[i].mask);
+	    }
+	if (compare_lookups(t, lt, 20000, errh) < 0)
+	    return -1;
+
+	for (int i = 0; i < lt.v.size(); i++)
+	    t.del(lt.v[i].dst, lt.v[i].mask);
+	CHECK(t.size() == 0);
+	CHECK(!t.lookup(random_address(), gw, index));
+    }
+
+    errh->message("All tests pass!");
+    return 0;
+}
+
+int
+IP6TableTest::benchmark(ErrorHandler *errh)
+{
+    // Allocations are /32s or shorter; most routes are /48s, /32s and
+    // /40s to /44s inside them.
+    IP6Table t;
+    Vector<IP6Address> blocks;
+    Vector<IP6Address> masks;
+    int nblocks = (_benchmark + 4) / 5;
+    for (int i = 0; i < nblocks; i++)
+	blocks.push_back(random_address_in(IP6Address("2000::"), IP6Address::make_prefix(3)));
+
+    Timestamp start = Timestamp::now_steady();
+    for (int i = 0; i < _benchmark; i++) {
+	int len, r = click_random(0, 99);
+	if (r < 45)
+	    len = 48;
+	else if (r < 65)
+	    len = 32;
+	else if (r < 75)
+	    len = 44;
+	else if (r < 85)
+	    len = 40;
+	else if (r < 92)
+	    len = 36;
+	else if (r < 96)
+	    len = click_random(19, 31);
+	else
+	    len = click_random(49, 64);
+	IP6Address mask = IP6Address::make_prefix(len);
+	IP6Address dst = random_address_in(blocks[click_random(0, nblocks - 1)], IP6Address::make_prefix(32));
+	t.add(dst, mask, IP6Address(), i);
+	blocks.push_back(dst & mask);
+	masks.push_back(mask);
+    }
+    Timestamp add_time = Timestamp::now_steady() - start;
+
+    // look up addresses inside the routes, from a precomputed set
+    enum { naddrs = 1 << 16 };
+    Vector<IP6Address> addrs;
+    for (int i = 0; i < naddrs; i++) {
+	int r = click_random(0, masks.size() - 1);
+	addrs.push_back(random_address_in(blocks[nblocks + r], masks[r]));
+    }
+
+    IP6Address gw;
+    int index, found = 0;
+    start = Timestamp::now_steady();
+    for (int i = 0; i < _lookups; i++)
+	found += t.lookup(addrs[i & (naddrs - 1)], gw, index);
+    Timestamp lookup_time = Timestamp::now_steady() - start;
+
+    uint64_t usec = lookup_time.usecval();
+    _lookup_rate = (uint64_t) _lookups * 1000000 / (usec ? usec : 1);
+    errh->message("%d routes added in %s s", t.size(), add_time.unparse().c_str());
+    errh->message("%d lookups (%d found) in %s s: %u lookups/s", _lookups, found, lookup_time.unparse().c_str(), _lookup_rate);
+    return 0;
+}
+
+void
+IP6TableTest::add_handlers()
+{
+    add_data_handlers("lookup_rate", Handler::OP_READ, &_lookup_rate);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(ip6)
+EXPORT_ELEMENT(IP6TableTest)
@@ -0,0 +1,75 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_IP6TABLETEST_HH
+#define CLICK_IP6TABLETEST_HH
+#include <click/element.hh>
+#include <click/ip6table.hh>
+CLICK_DECLS
+
+/*
+=c
+
+IP6TableTest([I<keywords>])
+
+=s test
+
+runs regression tests and benchmarks for IP6Table
+
+=d
+
+Without other arguments, IP6TableTest runs regression tests for Click's
+IP6Table class, the routing table used by LookupIP6Route, at initialization
+time. The results of longest prefix matches on random tables, before and
+after routes are removed, are compared with those of a linear scan.
+
+IP6TableTest does not route packets.
+
+Keyword arguments are:
+
+=over 8
+
+=item BENCHMARK
+
+Integer. If set to a positive number, then IP6TableTest runs a lookup
+benchmark at initialization time against a synthetic table of BENCHMARK
+routes, whose prefix lengths are distributed roughly like those of the IPv6
+BGP table. The number of lookups per second is reported on standard error
+and by the C<lookup_rate> handler. Default is 0 (don't benchmark).
+
+=item LOOKUPS
+
+Integer. The number of lookups the benchmark does. Default is 10000000.
+
+=back
+
+=h lookup_rate r
+
+Integer. Returns the number of lookups per second measured by the last
+benchmark.
+
+=a
+
+LookupIP6Route
+*/
+
+class IP6TableTest : public Element { public:
+
+    IP6TableTest() CLICK_COLD;
+
+    const char *class_name() const		{ return "IP6TableTest"; }
+
+    int configure(Vector<String> &conf, ErrorHandler *errh) CLICK_COLD;
+    int initialize(ErrorHandler *errh) CLICK_COLD;
+    void add_handlers() CLICK_COLD;
+
+  private:
+
+    int _benchmark;
+    int _lookups;
+    uint32_t _lookup_rate;
+
+    int benchmark(ErrorHandler *errh);
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -19,6 +19,7 @@
 #include <click/config.h>
 #include "packettest.hh"
 #include <click/error.hh>
+#include <click/packetbatch.hh>
 #include <clicknet/ip.h>
 #include <clicknet/ip6.h>
 CLICK_DECLS
@@ -87,6 +88,22 @@ PacketTest::initialize(ErrorHandler *errh)
     p1->kill();
     p3->kill();
 
+    // Check bulk allocation and freeing.
+    PacketBatch batch;
+    CHECK(Packet::make_batch(batch, 40, 10, 60, 4) == 40);
+    CHECK(batch.count() == 40);
+    for (Packet *q = batch.first(); q; q = q->next()) {
+	CHECK(q->headroom() >= 10 && q->length() == 60 && q->tailroom() >= 4);
+	CHECK(!q->shared() && !q->mac_header());
+    }
+    batch.last()->uniqueify()->data()[0] = 'x';
+    p = batch.last()->clone();
+    Packet::kill_batch(batch);
+    CHECK(batch.empty() && batch.count() == 0);
+    CHECK(p->length() == 60);
+    CHECK(p->data()[0] == 'x');
+    p->kill();
+
 #if 0
     // time cloning
     p = Packet::make(4);
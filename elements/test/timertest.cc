@@ -66,9 +66,19 @@ TimerTest::initialize(ErrorHandler *)
 	    ts[i].assign();
 	    ts[i].initialize(this);
 	}
+	Timestamp t0 = Timestamp::now();
 	benchmark_schedules(ts, _benchmark, now);
+	Timestamp t1 = Timestamp::now();
 	benchmark_changes(ts, _benchmark, now);
-	benchmark_fires(ts, _benchmark, now);
+	Timestamp t2 = Timestamp::now();
+	benchmark_cancels(ts, _benchmark, now);
+	Timestamp t3 = Timestamp::now();
+	t3 -= t2;
+	t2 -= t1;
+	t1 -= t0;
+	click_chatter("%p{element}: %s, %d timers: schedule %p{timestamp}, reschedule %p{timestamp}, cancel %p{timestamp}",
+		      this, ts->thread()->timer_set().timer_wheel() ? "wheel" : "heap",
+		      _benchmark, &t1, &t2, &t3);
 	delete[] ts;
     }
 
@@ -91,24 +101,19 @@ TimerTest::benchmark_schedules(Timer *ts, int nts, const Timestamp &now)
 void
 TimerTest::benchmark_changes(Timer *ts, int nts, const Timestamp &now)
 {
-    RouterThread *th = ts->thread();
     for (int i = 0; i < 6 * nts; ++i) {
-	Timer *t;
-	if (click_random(0, 8) < 6) {
-	    t = th->timer_set().next_timer();
+	Timer *t = &ts[click_random(0, nts - 1)];
+	if (click_random(0, 8) < 2)
 	    t->unschedule();
-	} else
-	    t = &ts[click_random(0, nts - 1)];
 	t->schedule_at_steady(now + Timestamp::make_msec(click_random(0, 10000)));
     }
 }
 
 void
-TimerTest::benchmark_fires(Timer *ts, int, const Timestamp &)
+TimerTest::benchmark_cancels(Timer *ts, int nts, const Timestamp &)
 {
-    RouterThread *th = ts->thread();
-    while (Timer *t = th->timer_set().next_timer())
-	t->unschedule();
+    for (int i = 0; i < nts; ++i)
+	ts[i].unschedule();
 }
 
 String
@@ -39,7 +39,10 @@ is printed to standard error.
 
 Integer.  If set to a positive number, then TimerTest runs a timer
 manipulation benchmark at installation time involving BENCHMARK total
-timers.  Default is 0 (don't benchmark).
+timers.  The benchmark schedules every timer, reschedules random timers
+6*BENCHMARK times, and finally cancels every timer, then prints the time
+taken by each phase.  Use a TimerWheel element to benchmark timer wheels
+instead of heaps.  Default is 0 (don't benchmark).
 
 =back
 
@@ -59,6 +62,8 @@ Schedule the TimerTest's timer to fire after a given time.
 
 Unschedule the TimerTest's timer.
 
+=a TimerWheel
+
 */
 
 class TimerTest : public Element { public:
@@ -80,7 +85,7 @@ class TimerTest : public Element { public:
 
     void benchmark_schedules(Timer *ts, int nts, const Timestamp &now);
     void benchmark_changes(Timer *ts, int nts, const Timestamp &now);
-    void benchmark_fires(Timer *ts, int nts, const Timestamp &now);
+    void benchmark_cancels(Timer *ts, int nts, const Timestamp &now);
 
     enum { h_scheduled, h_expiry, h_schedule_after, h_unschedule };
     static String read_handler(Element *e, void *user_data) CLICK_COLD;
@@ -85,5 +85,11 @@ StaticThreadSched::initial_home_thread_id(const Element *e)
 	return THREAD_UNKNOWN;
 }
 
+bool
+StaticThreadSched::initial_migratable(const Element *e)
+{
+    return _next_thread_sched && _next_thread_sched->initial_migratable(e);
+}
+
 CLICK_ENDDECLS
 EXPORT_ELEMENT(StaticThreadSched)
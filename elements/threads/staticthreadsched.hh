@@ -28,6 +28,7 @@ class StaticThreadSched : public Element, public ThreadSched { public:
     int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
 
     int initial_home_thread_id(const Element *e);
+    bool initial_migratable(const Element *e);
 
   private:
     Vector<int> _thread_preferences;
@@ -0,0 +1,93 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * timerwheel.{cc,hh} -- select timer wheels for threads
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "timerwheel.hh"
+#include <click/task.hh>
+#include <click/routerthread.hh>
+#include <click/master.hh>
+#include <click/args.hh>
+#include <click/error.hh>
+CLICK_DECLS
+
+TimerWheel::TimerWheel()
+    : _active(true)
+{
+}
+
+int
+TimerWheel::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    if (Args(this, errh).bind(conf)
+	.read("ACTIVE", _active)
+	.consume() < 0)
+	return -1;
+
+    for (int i = 0; i < conf.size(); ++i) {
+	int tid;
+	if (!IntArg().parse(conf[i], tid))
+	    return errh->error("THREAD should be a thread ID");
+	else if (tid < 0 || tid >= master()->nthreads())
+	    return errh->error("thread %d out of range", tid);
+	_threads.push_back(tid);
+    }
+    if (_threads.empty())
+	for (int tid = 0; tid < master()->nthreads(); ++tid)
+	    _threads.push_back(tid);
+    return 0;
+}
+
+void
+TimerWheel::set_active(bool active)
+{
+    _active = active;
+    for (int *tidp = _threads.begin(); tidp != _threads.end(); ++tidp)
+	master()->thread(*tidp)->timer_set().set_timer_wheel(active);
+}
+
+int
+TimerWheel::initialize(ErrorHandler *)
+{
+    set_active(_active);
+    return 0;
+}
+
+void
+TimerWheel::cleanup(CleanupStage stage)
+{
+    if (stage >= CLEANUP_INITIALIZED)
+	set_active(false);
+}
+
+int
+TimerWheel::write_handler(const String &str, Element *e, void *, ErrorHandler *errh)
+{
+    TimerWheel *tw = static_cast<TimerWheel *>(e);
+    bool active;
+    if (!BoolArg().parse(str, active))
+	return errh->error("syntax error");
+    tw->set_active(active);
+    return 0;
+}
+
+void
+TimerWheel::add_handlers()
+{
+    add_data_handlers("active", Handler::OP_READ | Handler::CHECKBOX, &_active);
+    add_write_handler("active", write_handler, 0);
+}
+
+CLICK_ENDDECLS
+EXPORT_ELEMENT(TimerWheel)
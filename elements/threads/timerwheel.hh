@@ -0,0 +1,57 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_TIMERWHEEL_HH
+#define CLICK_TIMERWHEEL_HH
+#include <click/element.hh>
+#include <click/vector.hh>
+CLICK_DECLS
+
+/*
+ * =c
+ * TimerWheel([THREAD, ..., I<keywords> ACTIVE])
+ * =s threads
+ * keeps threads' timers in timer wheels
+ * =d
+ *
+ * Switches the timer sets of the given threads from a heap to a hierarchical
+ * timer wheel.  If no THREAD is given, all threads are switched.
+ *
+ * A heap schedules and unschedules a timer in O(log n) time, where n is the
+ * number of scheduled timers.  A timer wheel does both in O(1) time for
+ * timers that expire at least a millisecond in the future.  Configurations
+ * with many per-flow or per-entry timers, such as large IPRewriter or
+ * AggregateIPFlows tables, may spend noticeably less time on timer
+ * maintenance with timer wheels.  Timers fire at the same times either way.
+ *
+ * If ACTIVE is false, the threads start out using heaps.  Default is true.
+ * When the TimerWheel element is removed, its threads return to heaps.
+ *
+ * =h active read/write
+ * Whether the threads use timer wheels.
+ *
+ * =a TimerTest
+ */
+
+class TimerWheel : public Element { public:
+
+    TimerWheel() CLICK_COLD;
+
+    const char *class_name() const	{ return "TimerWheel"; }
+    int configure_phase() const		{ return CONFIGURE_PHASE_FIRST; }
+    int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
+
+    int initialize(ErrorHandler *) CLICK_COLD;
+    void cleanup(CleanupStage) CLICK_COLD;
+    void add_handlers() CLICK_COLD;
+
+  private:
+
+    Vector<int> _threads;
+    bool _active;
+
+    void set_active(bool active);
+    static int write_handler(const String &str, Element *e, void *user_data, ErrorHandler *errh) CLICK_COLD;
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -0,0 +1,141 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * workstealingthreadsched.{cc,hh} -- work stealing between threads (SMP Click)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "workstealingthreadsched.hh"
+#include <click/task.hh>
+#include <click/routerthread.hh>
+#include <click/master.hh>
+#include <click/router.hh>
+#include <click/straccum.hh>
+#include <click/args.hh>
+#include <click/error.hh>
+CLICK_DECLS
+
+WorkStealingThreadSched::WorkStealingThreadSched()
+    : _active(true), _next_thread_sched(0)
+{
+}
+
+WorkStealingThreadSched::~WorkStealingThreadSched()
+{
+}
+
+int
+WorkStealingThreadSched::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    String elements;
+    if (Args(conf, this, errh)
+	.read_p("ACTIVE", _active)
+	.read("ELEMENTS", AnyArg(), elements)
+	.complete() < 0)
+	return -1;
+
+    _migratable.assign(router()->nelements(), false);
+    Vector<String> words;
+    cp_spacevec(elements, words);
+    for (String *it = words.begin(); it != words.end(); ++it) {
+	bool found = false;
+	if (Element *e = router()->find(*it, this))
+	    _migratable[e->eindex()] = found = true;
+	else {
+	    String prefix = router()->ename_context(eindex()) + *it + "/";
+	    for (int i = 0; i != router()->nelements(); ++i)
+		if (router()->ename(i).starts_with(prefix))
+		    _migratable[i] = found = true;
+	}
+	if (!found)
+	    errh->error("%<%s%> does not name an element", it->c_str());
+    }
+    if (errh->nerrors())
+	return -1;
+
+    _next_thread_sched = router()->thread_sched();
+    router()->set_thread_sched(this);
+    return 0;
+}
+
+int
+WorkStealingThreadSched::initial_home_thread_id(const Element *e)
+{
+    if (_next_thread_sched)
+	return _next_thread_sched->initial_home_thread_id(e);
+    else
+	return THREAD_UNKNOWN;
+}
+
+bool
+WorkStealingThreadSched::initial_migratable(const Element *e)
+{
+    int eidx = e->eindex();
+    if (eidx >= 0 && eidx < _migratable.size() && _migratable[eidx])
+	return true;
+    return _next_thread_sched && _next_thread_sched->initial_migratable(e);
+}
+
+int
+WorkStealingThreadSched::initialize(ErrorHandler *)
+{
+    master()->set_work_stealing(_active);
+    return 0;
+}
+
+void
+WorkStealingThreadSched::cleanup(CleanupStage stage)
+{
+    if (stage >= CLEANUP_INITIALIZED)
+	master()->set_work_stealing(false);
+}
+
+String
+WorkStealingThreadSched::read_handler(Element *e, void *user_data)
+{
+    Master *m = e->master();
+    StringAccum sa;
+    switch (reinterpret_cast<uintptr_t>(user_data)) {
+    case h_steals:
+	for (int tid = 0; tid < m->nthreads(); ++tid)
+	    sa << m->thread(tid)->steals() << '\n';
+	break;
+    case h_idles:
+	for (int tid = 0; tid < m->nthreads(); ++tid)
+	    sa << m->thread(tid)->idles() << '\n';
+	break;
+    }
+    return sa.take_string();
+}
+
+int
+WorkStealingThreadSched::write_handler(const String &str, Element *e, void *, ErrorHandler *errh)
+{
+    WorkStealingThreadSched *ws = static_cast<WorkStealingThreadSched *>(e);
+    if (!BoolArg().parse(str, ws->_active))
+	return errh->error("syntax error");
+    ws->master()->set_work_stealing(ws->_active);
+    return 0;
+}
+
+void
+WorkStealingThreadSched::add_handlers()
+{
+    add_data_handlers("active", Handler::OP_READ | Handler::CHECKBOX, &_active);
+    add_write_handler("active", write_handler, h_active);
+    add_read_handler("steals", read_handler, h_steals);
+    add_read_handler("idles", read_handler, h_idles);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(multithread)
+EXPORT_ELEMENT(WorkStealingThreadSched)
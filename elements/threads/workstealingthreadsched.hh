@@ -0,0 +1,86 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_WORKSTEALINGTHREADSCHED_HH
+#define CLICK_WORKSTEALINGTHREADSCHED_HH
+#include <click/element.hh>
+#include <click/standard/threadsched.hh>
+CLICK_DECLS
+
+/*
+ * =c
+ * WorkStealingThreadSched([ACTIVE, ELEMENTS])
+ * =s threads
+ * lets idle threads take tasks from busy threads
+ * =d
+ *
+ * Turns on work stealing between the router's threads.  A thread that runs
+ * out of scheduled tasks asks a busy thread for work, and the busy thread
+ * moves one of its scheduled tasks to the idle thread at its next scheduling
+ * iteration.  A thread never gives away its only task.
+ *
+ * Only migratable tasks are ever moved: those of the elements listed in
+ * ELEMENTS, and those whose element called Task::set_migratable(true).  A
+ * task should only be made migratable if it may run on any thread, for
+ * example because it shares no unlocked state with the other tasks of its
+ * thread.
+ *
+ * Unlike BalancedThreadSched, which rebalances on a timer using measured
+ * task costs, work stealing reacts as soon as a thread becomes idle, so it
+ * suits bursty loads.  The two may be combined.
+ *
+ * Keyword arguments are:
+ *
+ * =over 8
+ *
+ * =item ACTIVE
+ *
+ * Boolean.  If false, work stealing starts out off.  Default is true.
+ *
+ * =item ELEMENTS
+ *
+ * Space-separated list of element names.  The tasks of these elements, or of
+ * the elements in these compound elements, are migratable.  Default is empty.
+ *
+ * =back
+ *
+ * =h active read/write
+ * Whether work stealing is on.
+ *
+ * =h steals read-only
+ * Returns one line per thread: the number of tasks that thread has stolen.
+ *
+ * =h idles read-only
+ * Returns one line per thread: the number of times that thread ran out of
+ * tasks while work stealing was on.
+ *
+ * =a BalancedThreadSched, StaticThreadSched
+ */
+
+class WorkStealingThreadSched : public Element, public ThreadSched { public:
+
+    WorkStealingThreadSched() CLICK_COLD;
+    ~WorkStealingThreadSched() CLICK_COLD;
+
+    const char *class_name() const	{ return "WorkStealingThreadSched"; }
+    int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
+
+    int initialize(ErrorHandler *) CLICK_COLD;
+    void cleanup(CleanupStage) CLICK_COLD;
+    void add_handlers() CLICK_COLD;
+
+    int initial_home_thread_id(const Element *e);
+    bool initial_migratable(const Element *e);
+
+  private:
+
+    bool _active;
+    Vector<bool> _migratable;	// indexed by eindex
+    ThreadSched *_next_thread_sched;
+
+    enum { h_active, h_steals, h_idles };
+    static String read_handler(Element *e, void *user_data) CLICK_COLD;
+    static int write_handler(const String &str, Element *e, void *user_data, ErrorHandler *errh) CLICK_COLD;
+
+};
+
+CLICK_ENDDECLS
+#endif
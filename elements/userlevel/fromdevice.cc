@@ -39,6 +39,7 @@
 #include <click/args.hh>
 #include <click/glue.hh>
 #include <click/packet_anno.hh>
+#include <click/router.hh>
 #include <click/standard/scheduleinfo.hh>
 #include <click/userutils.hh>
 #include <unistd.h>
@@ -57,11 +58,14 @@ CLICK_DECLS
 
 FromDevice::FromDevice()
     :
-#if FROMDEVICE_ALLOW_NETMAP || FROMDEVICE_ALLOW_PCAP
+#if FROMDEVICE_ALLOW_NETMAP || FROMDEVICE_ALLOW_PCAP || FROMDEVICE_ALLOW_LINUX_MMAP
       _task(this),
 #endif
 #if FROMDEVICE_ALLOW_PCAP
       _pcap(0), _pcap_complaints(0),
+#endif
+#if FROMDEVICE_ALLOW_LINUX_MMAP
+      _timer(&_task),
 #endif
       _datalink(-1), _count(0), _promisc(0), _snaplen(0)
 {
@@ -84,8 +88,15 @@ FromDevice::configure(Vector<String> &conf, ErrorHandler *errh)
     _headroom += (4 - (_headroom + 2) % 4) % 4; // default 4/2 alignment
     _force_ip = false;
     _burst = 1;
-    String bpf_filter, capture, encap_type;
-    bool has_encap;
+    String bpf_filter, capture, encap_type, fanout_mode = "HASH";
+    bool has_encap, zerocopy = true;
+    int fanout = -1;
+#if FROMDEVICE_ALLOW_LINUX_MMAP
+    int ring_blocks = TPacketRing::default_blocks,
+	ring_block_size = TPacketRing::default_block_size;
+#else
+    int ring_blocks = 0, ring_block_size = 0;
+#endif
     if (Args(conf, this, errh)
 	.read_mp("DEVNAME", _ifname)
 	.read_p("PROMISC", promisc)
@@ -101,6 +112,11 @@ FromDevice::configure(Vector<String> &conf, ErrorHandler *errh)
 	.read("ENCAP", WordArg(), encap_type).read_status(has_encap)
 	.read("BURST", _burst)
 	.read("TIMESTAMP", timestamp)
+	.read("FANOUT", fanout)
+	.read("FANOUT_MODE", WordArg(), fanout_mode)
+	.read("RING_BLOCKS", ring_blocks)
+	.read("RING_BLOCK_SIZE", ring_block_size)
+	.read("ZEROCOPY", zerocopy)
 	.complete() < 0)
 	return -1;
     if (_snaplen > 65535 || _snaplen < 14)
@@ -136,6 +152,10 @@ FromDevice::configure(Vector<String> &conf, ErrorHandler *errh)
     else if (capture == "LINUX")
 	_method = method_linux;
 #endif
+#if FROMDEVICE_ALLOW_LINUX_MMAP
+    else if (capture == "LINUX_MMAP")
+	_method = method_linux_mmap;
+#endif
 #if FROMDEVICE_ALLOW_PCAP
     else if (capture == "PCAP")
 	_method = method_pcap;
@@ -150,6 +170,20 @@ FromDevice::configure(Vector<String> &conf, ErrorHandler *errh)
     if (bpf_filter && _method != method_pcap)
 	errh->warning("not using METHOD PCAP, BPF filter ignored");
 
+#if FROMDEVICE_ALLOW_LINUX_MMAP
+    if (fanout > 0xFFFF)
+	return errh->error("FANOUT out of range");
+    if ((_fanout_mode = TPacketRing::parse_fanout_mode(fanout_mode)) < 0)
+	return errh->error("bad FANOUT_MODE");
+    if (ring_blocks <= 0 || ring_block_size <= 0)
+	return errh->error("RING_BLOCKS and RING_BLOCK_SIZE must be positive");
+    _fanout = fanout;
+    _ring_blocks = ring_blocks;
+    _ring_block_size = ring_block_size;
+    _zerocopy = zerocopy;
+    _select_off = false;
+#endif
+
     _sniffer = sniffer;
     _promisc = promisc;
     _outbound = outbound;
@@ -408,8 +442,43 @@ FromDevice::initialize(ErrorHandler *errh)
     }
 #endif
 
-#if FROMDEVICE_ALLOW_PCAP || FROMDEVICE_ALLOW_NETMAP
-    if (_method == method_pcap || _method == method_netmap)
+#if FROMDEVICE_ALLOW_LINUX_MMAP
+    if (_method == method_linux_mmap) {
+	_fd = _ring.open_rx(_ifname, _ring_block_size, _ring_blocks, errh);
+	if (_fd < 0)
+	    return -1;
+
+	// By default, LINUX_MMAP readers of one device share a fanout group.
+	int fanout = _fanout;
+	if (fanout < 0) {
+	    int nreaders = 0;
+	    for (int ei = 0; ei < router()->nelements(); ++ei) {
+		FromDevice *fd = (FromDevice *) router()->element(ei)->cast("FromDevice");
+		if (fd && fd->_ifname == _ifname && fd->_method == method_linux_mmap)
+		    ++nreaders;
+	    }
+	    if (nreaders > 1)
+		fanout = (getpid() ^ _ring.ifindex()) & 0xFFFF;
+	}
+	if (fanout >= 0 && _ring.join_fanout(fanout, _fanout_mode, errh) < 0)
+	    return -1;
+	_timer.initialize(this);
+
+	int promisc_ok = set_promiscuous(_fd, _ifname, _promisc);
+	if (promisc_ok < 0) {
+	    if (_promisc)
+		errh->warning("cannot set promiscuous mode");
+	    _was_promisc = -1;
+	} else
+	    _was_promisc = promisc_ok;
+
+	_datalink = FAKE_DLT_EN10MB;
+    }
+#endif
+
+#if FROMDEVICE_ALLOW_PCAP || FROMDEVICE_ALLOW_NETMAP || FROMDEVICE_ALLOW_LINUX_MMAP
+    if (_method == method_pcap || _method == method_netmap
+	|| _method == method_linux_mmap)
 	ScheduleInfo::initialize_task(this, &_task, false, errh);
 #endif
 #if FROMDEVICE_ALLOW_PCAP || FROMDEVICE_ALLOW_LINUX || FROMDEVICE_ALLOW_NETMAP
@@ -440,6 +509,13 @@ FromDevice::cleanup(CleanupStage stage)
 	close(_fd);
     }
 #endif
+#if FROMDEVICE_ALLOW_LINUX_MMAP
+    if (_fd >= 0 && _method == method_linux_mmap) {
+	if (_was_promisc >= 0)
+	    set_promiscuous(_fd, _ifname, _was_promisc);
+	_ring.close();
+    }
+#endif
 #if FROMDEVICE_ALLOW_PCAP
     if (_pcap)
 	pcap_close(_pcap);
@@ -468,7 +544,7 @@ FromDevice::emit_packet(WritablePacket *p, int extra_len, const Timestamp &ts)
     SET_EXTRA_LENGTH_ANNO(p, extra_len);
 
     if (!_force_ip || fake_pcap_force_ip(p, _datalink))
-	output(0).push(p);
+	_batch.append(p);
     else
 	checked_output_push(1, p);
 }
@@ -497,6 +573,37 @@ FromDevice_get_packet(u_char* clientdata,
 CLICK_DECLS
 #endif
 
+#if FROMDEVICE_ALLOW_LINUX_MMAP
+int
+FromDevice::linux_mmap_dispatch()
+{
+    TPacketRing::Frame f;
+    int n = 0;
+    while (n < _burst && _ring.next_frame(f)) {
+	if ((f.pkttype == PACKET_OUTGOING && !_outbound)
+	    || (_protocol != 0 && _protocol != f.protocol))
+	    continue;
+	if (f.caplen > (uint32_t) _snaplen)
+	    f.caplen = _snaplen;
+	WritablePacket *p = _ring.make_packet(f, _zerocopy, _headroom);
+	if (!p)
+	    continue;
+	p->set_packet_type_anno((Packet::PacketType) f.pkttype);
+	if (_timestamp)
+	    p->set_timestamp_anno(Timestamp::make_nsec(f.sec, f.nsec));
+	p->set_mac_header(p->data());
+	SET_EXTRA_LENGTH_ANNO(p, f.len - f.caplen);
+	if (f.vlan_valid)
+	    SET_VLAN_TCI_ANNO(p, htons(f.vlan_tci));
+	++n;
+	if (!_force_ip || fake_pcap_force_ip(p, _datalink))
+	    _batch.append(p);
+	else
+	    checked_output_push(1, p);
+    }
+    return n;
+}
+#endif
 
 void
 FromDevice::selected(int, int)
@@ -509,6 +616,7 @@ FromDevice::selected(int, int)
 	// Read and push() at most one burst of packets.
 	int r = _netmap.dispatch(_burst,
 		reinterpret_cast<nm_cb_t>(FromDevice_get_packet), (u_char *) this);
+	output(0).push_batch(&_batch);
 	if (r > 0) {
 	    _count += r;
 	    _task.reschedule();
@@ -521,6 +629,7 @@ FromDevice::selected(int, int)
     if (_method == method_pcap) {
 	// Read and push() at most one burst of packets.
 	int r = pcap_dispatch(_pcap, _burst, FromDevice_get_packet, (u_char *) this);
+	output(0).push_batch(&_batch);
 	if (r > 0) {
 	    _count += r;
 	    _task.reschedule();
@@ -528,8 +637,25 @@ FromDevice::selected(int, int)
 	    ErrorHandler::default_handler()->error("%p{element}: %s", this, pcap_geterr(_pcap));
     }
 #endif
+#if FROMDEVICE_ALLOW_LINUX_MMAP
+    if (_method == method_linux_mmap) {
+	int r = linux_mmap_dispatch();
+	output(0).push_batch(&_batch);
+	if (r > 0) {
+	    _count += r;
+	    _task.reschedule();
+	} else if (_ring.pinned()) {
+	    // The socket stays readable while its last block is held
+	    // downstream, so poll with the timer until the block is freed.
+	    remove_select(_fd, SELECT_READ);
+	    _select_off = true;
+	    _timer.schedule_after_msec(5);
+	}
+    }
+#endif
 #if FROMDEVICE_ALLOW_LINUX
     int nlinux = 0;
+    PacketBatch batch;
     while (_method == method_linux && nlinux < _burst) {
 	struct sockaddr_ll sa;
 	socklen_t fromlen = sizeof(sa);
@@ -548,7 +674,7 @@ FromDevice::selected(int, int)
 	    ++nlinux;
 	    ++_count;
 	    if (!_force_ip || fake_pcap_force_ip(p, _datalink))
-		output(0).push(p);
+		batch.append(p);
 	    else
 		checked_output_push(1, p);
 	} else {
@@ -558,10 +684,12 @@ FromDevice::selected(int, int)
 	    break;
 	}
     }
+    if (batch.count())
+	output(0).push_batch(&batch);
 #endif
 }
 
-#if FROMDEVICE_ALLOW_PCAP || FROMDEVICE_ALLOW_NETMAP
+#if FROMDEVICE_ALLOW_PCAP || FROMDEVICE_ALLOW_NETMAP || FROMDEVICE_ALLOW_LINUX_MMAP
 bool
 FromDevice::run_task(Task *)
 {
@@ -584,6 +712,20 @@ FromDevice::run_task(Task *)
 	    ErrorHandler::default_handler()->error("%p{element}: %s", this, pcap_geterr(_pcap));
     }
 # endif
+# if FROMDEVICE_ALLOW_LINUX_MMAP
+    if (_method == method_linux_mmap) {
+	r = linux_mmap_dispatch();
+	if (r <= 0 && _select_off) {
+	    if (_ring.pinned())
+		_timer.schedule_after_msec(5);
+	    else {
+		add_select(_fd, SELECT_READ);
+		_select_off = false;
+	    }
+	}
+    }
+# endif
+    output(0).push_batch(&_batch);
     if (r > 0) {
 	_count += r;
 	_task.fast_reschedule();
@@ -612,6 +754,10 @@ FromDevice::kernel_drops(bool& known, int& max_drops) const
             known = true, max_drops = stats.tp_drops;
     }
 #endif
+#if FROMDEVICE_ALLOW_LINUX_MMAP
+    if (_method == method_linux_mmap)
+	known = true, max_drops = _ring.kernel_drops();
+#endif
 }
 
 String
@@ -652,5 +798,5 @@ FromDevice::add_handlers()
 }
 
 CLICK_ENDDECLS
-ELEMENT_REQUIRES(userlevel FakePcap KernelFilter NetmapInfo)
+ELEMENT_REQUIRES(userlevel FakePcap KernelFilter NetmapInfo TPacketRing)
 EXPORT_ELEMENT(FromDevice)
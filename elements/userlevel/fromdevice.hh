@@ -5,6 +5,10 @@
 
 #ifdef __linux__
 # define FROMDEVICE_ALLOW_LINUX 1
+# define FROMDEVICE_ALLOW_LINUX_MMAP 1
+# include "elements/userlevel/tpacketring.hh"
+# include <click/task.hh>
+# include <click/timer.hh>
 #endif
 
 #if HAVE_PCAP
@@ -95,8 +99,18 @@ but the IP header annotation has been set appropriately.) Default is false.
 =item METHOD
 
 Word.  Defines the capture method FromDevice will use to read packets from the
-device.  Linux targets generally support PCAP and LINUX; other targets support
-only PCAP.  Defaults to PCAP.
+device.  Linux targets generally support PCAP, LINUX and LINUX_MMAP; other
+targets support only PCAP.  Defaults to PCAP.
+
+LINUX_MMAP reads from a TPACKET_V3 memory-mapped ring.  The kernel delivers
+packets a block at a time, and FromDevice emits them without copying: each
+packet's data points into the ring, and the block returns to the kernel once
+every packet from it has been freed.  Such packets have no headroom, so
+elements that push headers must copy them.  The kernel fills blocks in ring
+order and drops packets when it reaches a block that is still held, so
+configurations that keep packets for long (for example, in a Queue that
+builds up) should set ZEROCOPY false.  FromDevice also copies packets while
+more than half the ring is held.
 
 =item BPF_FILTER
 
@@ -118,7 +132,7 @@ false.
 =item PROTOCOL
 
 Integer. If set and nonzero, then only emit packets with this link-level
-protocol. Only affects METHOD LINUX. Default is 0.
+protocol. Only affects METHOD LINUX and LINUX_MMAP. Default is 0.
 
 =item HEADROOM
 
@@ -127,18 +141,53 @@ to roughly 28.
 
 =item BURST
 
-Integer. Maximum number of packets to read per scheduling. Defaults to 1.
+Integer. Maximum number of packets to read per scheduling. The packets read
+at once are pushed to output 0 as a single batch. Defaults to 1.
 
 =item TIMESTAMP
 
 Boolean. If false, then do not timestamp packets. Defaults to true.
 
+=item FANOUT
+
+Integer. PACKET_FANOUT group this FromDevice joins (METHOD LINUX_MMAP only).
+Sockets in one group share the device's packets, each packet going to one
+of them.  By default, LINUX_MMAP FromDevices on the same device in one
+configuration join a common group, so running one per thread spreads the
+load; a single FromDevice joins no group.
+
+=item FANOUT_MODE
+
+Word. How a fanout group spreads packets: HASH (by flow), LB (round robin),
+CPU (by receiving CPU), QM (by receive queue), or ROLLOVER.  Defaults to
+HASH.
+
+=item RING_BLOCKS
+
+Integer. Number of blocks in the LINUX_MMAP ring.  Defaults to 64.
+
+=item RING_BLOCK_SIZE
+
+Integer. Size of each LINUX_MMAP ring block in bytes, a multiple of the page
+size.  Defaults to 1048576.
+
+=item ZEROCOPY
+
+Boolean. If false, LINUX_MMAP copies each packet out of the ring.  Defaults to
+true.
+
 =back
 
 =e
 
   FromDevice(eth0) -> ...
 
+This configuration reads eth0 with two threads sharing the load:
+
+  fd0 :: FromDevice(eth0, METHOD LINUX_MMAP, BURST 32) -> ...
+  fd1 :: FromDevice(eth0, METHOD LINUX_MMAP, BURST 32) -> ...
+  StaticThreadSched(fd0 0, fd1 1)
+
 =n
 
 FromDevice sets packets' extra length annotations as appropriate.
@@ -202,11 +251,15 @@ class FromDevice : public Element { public:
     static int set_promiscuous(int, String, bool);
 #endif
 
+#if FROMDEVICE_ALLOW_LINUX_MMAP
+    bool linux_mmap() const		{ return _method == method_linux_mmap && _fd >= 0; }
+#endif
+
 #if FROMDEVICE_ALLOW_NETMAP
     const NetmapInfo *netmap() const { return _method == method_netmap ? &_netmap : 0; }
 #endif
 
-#if FROMDEVICE_ALLOW_NETMAP || FROMDEVICE_ALLOW_PCAP
+#if FROMDEVICE_ALLOW_NETMAP || FROMDEVICE_ALLOW_PCAP || FROMDEVICE_ALLOW_LINUX_MMAP
     bool run_task(Task *task);
 #endif
 
@@ -217,8 +270,9 @@ class FromDevice : public Element { public:
 #if FROMDEVICE_ALLOW_LINUX || FROMDEVICE_ALLOW_PCAP || FROMDEVICE_ALLOW_NETMAP
     int _fd;
 #endif
-#if FROMDEVICE_ALLOW_NETMAP || FROMDEVICE_ALLOW_PCAP
+#if FROMDEVICE_ALLOW_NETMAP || FROMDEVICE_ALLOW_PCAP || FROMDEVICE_ALLOW_LINUX_MMAP
     Task _task;
+    PacketBatch _batch;		// packets read by the current dispatch
 #endif
 #if FROMDEVICE_ALLOW_PCAP || FROMDEVICE_ALLOW_NETMAP
     void emit_packet(WritablePacket *p, int extra_len, const Timestamp &ts);
@@ -231,6 +285,17 @@ class FromDevice : public Element { public:
     NetmapInfo _netmap;
     int netmap_dispatch();
 #endif
+#if FROMDEVICE_ALLOW_LINUX_MMAP
+    TPacketRing _ring;
+    Timer _timer;
+    int _fanout;
+    int _fanout_mode;
+    int _ring_blocks;
+    int _ring_block_size;
+    bool _zerocopy;
+    bool _select_off;
+    int linux_mmap_dispatch();
+#endif
 #if FROMDEVICE_ALLOW_PCAP || FROMDEVICE_ALLOW_NETMAP
     friend void FromDevice_get_packet(u_char*, const struct pcap_pkthdr*,
                                       const u_char*);
@@ -259,7 +324,8 @@ class FromDevice : public Element { public:
     int _snaplen;
     uint16_t _protocol;
     unsigned _headroom;
-    enum { method_default, method_netmap, method_pcap, method_linux };
+    enum { method_default, method_netmap, method_pcap, method_linux,
+	   method_linux_mmap };
     int _method;
 #if FROMDEVICE_ALLOW_PCAP
     String _bpf_filter;
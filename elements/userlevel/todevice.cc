@@ -61,7 +61,7 @@
 CLICK_DECLS
 
 ToDevice::ToDevice()
-    : _task(this), _timer(&_task), _q(0), _pulls(0)
+    : _task(this), _timer(&_task), _pulls(0)
 {
 #if TODEVICE_ALLOW_PCAP
     _pcap = 0;
@@ -109,6 +109,10 @@ ToDevice::configure(Vector<String> &conf, ErrorHandler *errh)
     else if (method == "LINUX")
 	_method = method_linux;
 #endif
+#if TODEVICE_ALLOW_LINUX_MMAP
+    else if (method == "LINUX_MMAP")
+	_method = method_linux_mmap;
+#endif
 #if TODEVICE_ALLOW_DEVBPF
     else if (method == "DEVBPF")
 	_method = method_devbpf;
@@ -157,6 +161,10 @@ ToDevice::initialize(ErrorHandler *errh)
 #if FROMDEVICE_ALLOW_LINUX && TODEVICE_ALLOW_LINUX
 	if (fd->linux_fd() >= 0)
 	    _method = method_linux;
+#endif
+#if FROMDEVICE_ALLOW_LINUX_MMAP && TODEVICE_ALLOW_LINUX_MMAP
+	if (fd->linux_mmap())
+	    _method = method_linux_mmap;
 #endif
     }
 
@@ -236,6 +244,14 @@ ToDevice::initialize(ErrorHandler *errh)
     }
 #endif
 
+#if TODEVICE_ALLOW_LINUX_MMAP
+    if (_method == method_linux_mmap) {
+	_fd = _ring.open_tx(_ifname, errh);
+	if (_fd < 0)
+	    return -1;
+    }
+#endif
+
 #if TODEVICE_ALLOW_PCAPFD
     if (_method == method_default || _method == method_pcapfd) {
 	FromDevice *fd = find_fromdevice();
@@ -261,6 +277,7 @@ ToDevice::initialize(ErrorHandler *errh)
 void
 ToDevice::cleanup(CleanupStage)
 {
+    _q.kill();
 #if TODEVICE_ALLOW_PCAP
     if (_pcap && _my_pcap)
 	pcap_close(_pcap);
@@ -272,6 +289,10 @@ ToDevice::cleanup(CleanupStage)
 	_fd = -1;
     }
 #endif
+#if TODEVICE_ALLOW_LINUX_MMAP
+    if (_method == method_linux_mmap)
+	_ring.close();
+#endif
 #if TODEVICE_ALLOW_LINUX || TODEVICE_ALLOW_DEVBPF || TODEVICE_ALLOW_PCAPFD || TODEVICE_ALLOW_NETMAP
     if (_fd >= 0 && _my_fd)
 	close(_fd);
@@ -321,6 +342,11 @@ ToDevice::send_packet(Packet *p)
 	r = send(_fd, p->data(), p->length(), 0);
 #endif
 
+#if TODEVICE_ALLOW_LINUX_MMAP
+    if (_method == method_linux_mmap)
+	return _ring.send_packet(p);
+#endif
+
 #if TODEVICE_ALLOW_DEVBPF
     if (_method == method_devbpf)
 	if (write(_fd, p->data(), p->length()) != (ssize_t) p->length())
@@ -342,29 +368,30 @@ ToDevice::send_packet(Packet *p)
 bool
 ToDevice::run_task(Task *)
 {
-    Packet *p = _q;
-    _q = 0;
-    int count = 0, r = 0;
+    // _q holds the packets of the last batch that could not be sent yet
+    if (_q.empty()) {
+	++_pulls;
+	input(0).pull_batch(&_q, _burst);
+    }
 
-    do {
-	if (!p) {
-	    ++_pulls;
-	    if (!(p = input(0).pull()))
-		break;
-	}
-	if ((r = send_packet(p)) >= 0) {
-	    _backoff = 0;
-	    checked_output_push(0, p);
-	    ++count;
-	    p = 0;
-	} else
+    int count = 0, r = 0;
+    bool kicked = true;
+    PacketBatch sent;
+    while (Packet *p = _q.first()) {
+	if ((r = send_packet(p)) < 0)
 	    break;
-    } while (count < _burst);
+	_backoff = 0;
+	sent.append(_q.pop_front());
+	++count;
+    }
+#if TODEVICE_ALLOW_LINUX_MMAP
+    // one system call sends every frame queued by this batch
+    if (_method == method_linux_mmap)
+	kicked = _ring.kick();
+#endif
+    checked_output_push_batch(0, &sent);
 
     if (r == -ENOBUFS || r == -EAGAIN) {
-	assert(!_q);
-	_q = p;
-
 	if (!_backoff) {
 	    _backoff = 1;
 	    add_select(_fd, SELECT_WRITE);
@@ -380,11 +407,14 @@ ToDevice::run_task(Task *)
 	return count > 0;
     } else if (r < 0) {
 	click_chatter("ToDevice(%s): %s", _ifname.c_str(), strerror(-r));
-	checked_output_push(1, p);
+	checked_output_push(1, _q.pop_front());
     }
 
-    if (p || _signal)
+    if (!_q.empty() || _signal)
 	_task.fast_reschedule();
+    else if (!kicked)
+	// retry the frames still queued once the socket is writable
+	add_select(_fd, SELECT_WRITE);
     return count > 0;
 }
 
@@ -408,7 +438,7 @@ ToDevice::read_param(Element *e, void *thunk)
     case h_pulls:
 	return String(td->_pulls);
     case h_q:
-	return String((bool) td->_q);
+	return String(!td->_q.empty());
     default:
 	return String();
     }
@@ -444,5 +474,5 @@ ToDevice::add_handlers()
 }
 
 CLICK_ENDDECLS
-ELEMENT_REQUIRES(FromDevice userlevel)
+ELEMENT_REQUIRES(FromDevice TPacketRing userlevel)
 EXPORT_ELEMENT(ToDevice)
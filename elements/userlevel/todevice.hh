@@ -28,16 +28,22 @@ CLICK_DECLS
  *
  * =item BURST
  *
- * Integer. Maximum number of packets to pull per scheduling. Defaults to 1.
+ * Integer. Maximum number of packets to pull per scheduling, as one batch.
+ * Defaults to 1.
  *
  * =item METHOD
  *
  * Word. Defines the method ToDevice will use to write packets to the
- * device. Linux targets generally support PCAP and LINUX; other targets
- * support PCAP or, occasionally, other methods. Defaults to the method
- * specified for a matching L<FromDevice(n)>, or the first supported
+ * device. Linux targets generally support PCAP, LINUX and LINUX_MMAP; other
+ * targets support PCAP or, occasionally, other methods. Defaults to the
+ * method specified for a matching L<FromDevice(n)>, or the first supported
  * method among NETMAP, PCAP, DEVBPF, LINUX and PCAPFD otherwise.
  *
+ * LINUX_MMAP copies packets into a memory-mapped TPACKET_V2 transmit ring and
+ * asks the kernel to send the queued frames once per BURST, rather than
+ * making one system call per packet.  Packets larger than a ring frame (about
+ * 4 kB) fail.
+ *
  * =item DEBUG
  *
  * Boolean.  If true, print out debug messages.
@@ -82,6 +88,9 @@ extern "C" {
 #if FROMDEVICE_ALLOW_NETMAP
 # define TODEVICE_ALLOW_NETMAP 1
 #endif
+#if FROMDEVICE_ALLOW_LINUX_MMAP
+# define TODEVICE_ALLOW_LINUX_MMAP 1
+#endif
 
 class ToDevice : public Element { public:
 
@@ -120,11 +129,14 @@ class ToDevice : public Element { public:
 #if TODEVICE_ALLOW_NETMAP
     NetmapInfo _netmap;
 #endif
-    enum { method_default, method_netmap, method_linux, method_pcap, method_devbpf, method_pcapfd };
+#if TODEVICE_ALLOW_LINUX_MMAP
+    TPacketRing _ring;
+#endif
+    enum { method_default, method_netmap, method_linux, method_pcap, method_devbpf, method_pcapfd, method_linux_mmap };
     int _method;
     NotifierSignal _signal;
 
-    Packet *_q;
+    PacketBatch _q;
     int _burst;
 
     bool _debug;
@@ -0,0 +1,451 @@
+// -*- mode: c++; c-basic-offset: 4 -*-
+/*
+ * tpacketring.{cc,hh} -- memory-mapped AF_PACKET rings
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include <click/glue.hh>
+#ifdef __linux__
+#include "tpacketring.hh"
+#include <click/atomic.hh>
+#include <click/error.hh>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <net/if.h>
+#include <net/ethernet.h>
+#include <linux/if_packet.h>
+#include <unistd.h>
+#include <fcntl.h>
+#ifdef TPACKET3_HDRLEN		// tpacket_versions is an enum
+# define HAVE_TPACKET_V3 1
+#endif
+CLICK_DECLS
+
+// The kernel reads and writes ring headers from other CPUs, so a compiler
+// fence is not enough even in single-threaded builds.
+static inline void
+ring_barrier()
+{
+    __sync_synchronize();
+}
+
+struct TPacketRing::Block {
+    RxRing *rx;
+    unsigned char *base;
+    atomic_uint32_t refs;
+    uint32_t seq;
+};
+
+// The receive ring lives apart from TPacketRing so that zero-copy packets
+// may outlive close(): the mapping is released with the last reference.
+// "pinned" counts blocks with live references, plus one for the ring itself.
+struct TPacketRing::RxRing {
+    unsigned char *map;
+    size_t map_size;
+    int nblocks;
+    atomic_uint32_t pinned;
+    Block *blocks;
+};
+
+TPacketRing::TPacketRing()
+    : _fd(-1), _ifindex(0), _rx(0), _rx_cur(0), _rx_block(0), _rx_next(0),
+      _rx_remaining(0), _drops(0), _tx_map(0), _tx_map_size(0),
+      _frame_size(0), _nframes(0), _tx_cur(0), _tx_queued(0)
+{
+}
+
+TPacketRing::~TPacketRing()
+{
+    close();
+}
+
+int
+TPacketRing::open_socket(const String &ifname, int protocol, ErrorHandler *errh)
+{
+    _fd = socket(PF_PACKET, SOCK_RAW, protocol);
+    if (_fd < 0)
+	return errh->error("%s: socket: %s", ifname.c_str(), strerror(errno));
+
+    struct ifreq ifr;
+    memset(&ifr, 0, sizeof(ifr));
+    strncpy(ifr.ifr_name, ifname.c_str(), sizeof(ifr.ifr_name));
+    if (ioctl(_fd, SIOCGIFINDEX, &ifr) != 0) {
+	errh->error("%s: SIOCGIFINDEX: %s", ifname.c_str(), strerror(errno));
+	close();
+	return -1;
+    }
+    _ifindex = ifr.ifr_ifindex;
+    return 0;
+}
+
+unsigned char *
+TPacketRing::map_ring(int version, int option, const void *req, size_t reqlen,
+		      size_t size, const String &ifname, ErrorHandler *errh)
+{
+    if (setsockopt(_fd, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) < 0) {
+	errh->error("%s: PACKET_VERSION: %s", ifname.c_str(), strerror(errno));
+	return 0;
+    }
+    if (setsockopt(_fd, SOL_PACKET, option, req, reqlen) < 0) {
+	errh->error("%s: cannot allocate packet ring: %s", ifname.c_str(), strerror(errno));
+	return 0;
+    }
+    void *map = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+    if (map == MAP_FAILED) {
+	errh->error("%s: mmap: %s", ifname.c_str(), strerror(errno));
+	return 0;
+    }
+    return reinterpret_cast<unsigned char *>(map);
+}
+
+int
+TPacketRing::bind_socket(int protocol, const String &ifname, ErrorHandler *errh)
+{
+    struct sockaddr_ll sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sll_family = AF_PACKET;
+    sa.sll_protocol = protocol;
+    sa.sll_ifindex = _ifindex;
+    if (bind(_fd, (struct sockaddr *) &sa, sizeof(sa)) != 0)
+	return errh->error("%s: bind: %s", ifname.c_str(), strerror(errno));
+    fcntl(_fd, F_SETFL, O_NONBLOCK);
+    return 0;
+}
+
+int
+TPacketRing::open_rx(const String &ifname, int block_size, int nblocks,
+		     ErrorHandler *errh)
+{
+#if HAVE_TPACKET_V3
+    assert(_fd < 0);
+    long page = sysconf(_SC_PAGESIZE);
+    if (block_size <= 0 || block_size % page != 0 || nblocks <= 0)
+	return errh->error("bad ring geometry (block size must be a multiple of %ld)", page);
+    if (open_socket(ifname, htons(ETH_P_ALL), errh) < 0)
+	return -1;
+
+    // Frames are variable-length in TPACKET_V3; the frame size only sizes
+    // the kernel's bookkeeping.
+    struct tpacket_req3 req;
+    memset(&req, 0, sizeof(req));
+    req.tp_block_size = block_size;
+    req.tp_block_nr = nblocks;
+    req.tp_frame_size = TPACKET_ALIGNMENT << 7;
+    req.tp_frame_nr = (block_size / req.tp_frame_size) * nblocks;
+    req.tp_retire_blk_tov = 1;	// msec: bounds latency at low rates
+
+    size_t size = (size_t) block_size * nblocks;
+    unsigned char *map = map_ring(TPACKET_V3, PACKET_RX_RING, &req, sizeof(req),
+				  size, ifname, errh);
+    if (!map) {
+	close();
+	return -1;
+    }
+
+    _rx = new RxRing;
+    _rx->map = map;
+    _rx->map_size = size;
+    _rx->nblocks = nblocks;
+    _rx->pinned = 1;
+    _rx->blocks = new Block[nblocks];
+    for (int i = 0; i < nblocks; ++i) {
+	_rx->blocks[i].rx = _rx;
+	_rx->blocks[i].base = map + (size_t) i * block_size;
+	_rx->blocks[i].refs = 0;
+	_rx->blocks[i].seq = 0;
+    }
+    _rx_cur = 0;
+
+    if (bind_socket(htons(ETH_P_ALL), ifname, errh) < 0) {
+	close();
+	return -1;
+    }
+    return _fd;
+#else
+    (void) block_size, (void) nblocks;
+    return errh->error("%s: TPACKET_V3 rings not supported on this system", ifname.c_str());
+#endif
+}
+
+int
+TPacketRing::parse_fanout_mode(const String &str)
+{
+#ifdef PACKET_FANOUT
+    if (str == "HASH")
+	return PACKET_FANOUT_HASH;
+    else if (str == "LB")
+	return PACKET_FANOUT_LB;
+    else if (str == "CPU")
+	return PACKET_FANOUT_CPU;
+# ifdef PACKET_FANOUT_ROLLOVER
+    else if (str == "ROLLOVER")
+	return PACKET_FANOUT_ROLLOVER;
+# endif
+# ifdef PACKET_FANOUT_QM
+    else if (str == "QM")
+	return PACKET_FANOUT_QM;
+# endif
+#else
+    (void) str;
+#endif
+    return -1;
+}
+
+int
+TPacketRing::join_fanout(int group, int mode, ErrorHandler *errh)
+{
+#ifdef PACKET_FANOUT
+    int arg = (group & 0xFFFF) | (mode << 16);
+# ifdef PACKET_FANOUT_FLAG_DEFRAG
+    // keep fragments of one datagram together
+    if (mode == PACKET_FANOUT_HASH)
+	arg |= PACKET_FANOUT_FLAG_DEFRAG << 16;
+# endif
+    if (setsockopt(_fd, SOL_PACKET, PACKET_FANOUT, &arg, sizeof(arg)) < 0)
+	return errh->error("PACKET_FANOUT: %s", strerror(errno));
+    return 0;
+#else
+    (void) group, (void) mode;
+    return errh->error("PACKET_FANOUT not supported on this system");
+#endif
+}
+
+void
+TPacketRing::close()
+{
+    if (_rx) {
+	if (_rx_block)
+	    leave_block();
+	RxRing *rx = _rx;
+	_rx = 0;
+	if (rx->pinned.dec_and_test()) {
+	    munmap(rx->map, rx->map_size);
+	    delete[] rx->blocks;
+	    delete rx;
+	}
+    }
+    if (_tx_map) {
+	munmap(_tx_map, _tx_map_size);
+	_tx_map = 0;
+    }
+    if (_fd >= 0)
+	::close(_fd);
+    _fd = -1;
+    _rx_remaining = 0;
+}
+
+bool
+TPacketRing::pinned() const
+{
+    return _rx && _rx->pinned > 1;
+}
+
+#if HAVE_TPACKET_V3
+bool
+TPacketRing::next_frame(Frame &f)
+{
+    while (_rx_remaining == 0) {
+	if (_rx_block)
+	    leave_block();
+	if (!_rx)
+	    return false;
+	Block *b = &_rx->blocks[_rx_cur];
+	struct tpacket_block_desc *bd = reinterpret_cast<struct tpacket_block_desc *>(b->base);
+	// A block we walked stays TP_STATUS_USER until its last packet is
+	// freed; its sequence number tells it apart from a refilled block.
+	if (!(bd->hdr.bh1.block_status & TP_STATUS_USER)
+	    || bd->hdr.bh1.seq_num == b->seq)
+	    return false;
+	ring_barrier();
+	b->seq = bd->hdr.bh1.seq_num;
+	b->refs = 1;
+	_rx->pinned++;
+	_rx_block = b;
+	_rx_next = b->base + bd->hdr.bh1.offset_to_first_pkt;
+	_rx_remaining = bd->hdr.bh1.num_pkts;
+	if (++_rx_cur == _rx->nblocks)
+	    _rx_cur = 0;
+    }
+
+    struct tpacket3_hdr *h = reinterpret_cast<struct tpacket3_hdr *>(_rx_next);
+    const struct sockaddr_ll *sll = reinterpret_cast<const struct sockaddr_ll *>
+	(_rx_next + TPACKET_ALIGN(sizeof(struct tpacket3_hdr)));
+    f.data = _rx_next + h->tp_mac;
+    f.caplen = h->tp_snaplen;
+    f.len = h->tp_len;
+    f.sec = h->tp_sec;
+    f.nsec = h->tp_nsec;
+    f.protocol = sll->sll_protocol;
+    f.pkttype = sll->sll_pkttype;
+# ifdef TP_STATUS_VLAN_VALID
+    f.vlan_valid = (h->tp_status & TP_STATUS_VLAN_VALID) != 0;
+    f.vlan_tci = h->hv1.tp_vlan_tci;
+# else
+    f.vlan_valid = false;
+    f.vlan_tci = 0;
+# endif
+    _rx_next += h->tp_next_offset;
+    --_rx_remaining;
+    return true;
+}
+#else
+bool
+TPacketRing::next_frame(Frame &)
+{
+    return false;
+}
+#endif
+
+void
+TPacketRing::leave_block()
+{
+    Block *b = _rx_block;
+    _rx_block = 0;
+    _rx_remaining = 0;
+    release(b);
+}
+
+void
+TPacketRing::release(Block *b)
+{
+    if (b->refs.dec_and_test()) {
+	RxRing *rx = b->rx;
+#if HAVE_TPACKET_V3
+	struct tpacket_block_desc *bd = reinterpret_cast<struct tpacket_block_desc *>(b->base);
+	ring_barrier();
+	bd->hdr.bh1.block_status = TP_STATUS_KERNEL;
+	ring_barrier();
+#endif
+	if (rx->pinned.dec_and_test()) {
+	    munmap(rx->map, rx->map_size);
+	    delete[] rx->blocks;
+	    delete rx;
+	}
+    }
+}
+
+void
+TPacketRing::release_frame(unsigned char *, size_t, void *arg)
+{
+    release(static_cast<Block *>(arg));
+}
+
+WritablePacket *
+TPacketRing::make_packet(const Frame &f, bool zerocopy, unsigned headroom)
+{
+    // Copy once half the ring is held downstream, so the kernel always
+    // has blocks to fill.
+    if (zerocopy && _rx_block
+	&& (int) (_rx->pinned.value() - 1) * 2 <= _rx->nblocks) {
+	_rx_block->refs++;
+	WritablePacket *p = Packet::make(const_cast<unsigned char *>(f.data),
+					 f.caplen, release_frame, _rx_block);
+	if (!p)
+	    release(_rx_block);
+	return p;
+    }
+    return Packet::make(headroom, f.data, f.caplen, 0);
+}
+
+unsigned
+TPacketRing::kernel_drops() const
+{
+#if HAVE_TPACKET_V3
+    // the kernel resets its counters on every read
+    struct tpacket_stats_v3 stats;
+    socklen_t statsize = sizeof(stats);
+    if (_fd >= 0
+	&& getsockopt(_fd, SOL_PACKET, PACKET_STATISTICS, &stats, &statsize) >= 0)
+	_drops += stats.tp_drops;
+#endif
+    return _drops;
+}
+
+int
+TPacketRing::open_tx(const String &ifname, ErrorHandler *errh)
+{
+    assert(_fd < 0);
+    // A protocol of 0 keeps the kernel from queueing received packets on
+    // this socket.
+    if (open_socket(ifname, 0, errh) < 0)
+	return -1;
+
+    // Frames that the device rejects are dropped, not left for us to find.
+    int one = 1;
+    (void) setsockopt(_fd, SOL_PACKET, PACKET_LOSS, &one, sizeof(one));
+
+    struct tpacket_req req;
+    memset(&req, 0, sizeof(req));
+    req.tp_block_size = 1 << 16;
+    req.tp_block_nr = 64;
+    req.tp_frame_size = 1 << 12;
+    req.tp_frame_nr = (req.tp_block_size / req.tp_frame_size) * req.tp_block_nr;
+    _tx_map_size = (size_t) req.tp_block_size * req.tp_block_nr;
+    _tx_map = map_ring(TPACKET_V2, PACKET_TX_RING, &req, sizeof(req),
+		       _tx_map_size, ifname, errh);
+    if (!_tx_map || bind_socket(0, ifname, errh) < 0) {
+	close();
+	return -1;
+    }
+    _frame_size = req.tp_frame_size;
+    _nframes = req.tp_frame_nr;
+    _tx_cur = _tx_queued = 0;
+    return _fd;
+}
+
+int
+TPacketRing::send_packet(const Packet *p)
+{
+    // Without PACKET_TX_HAS_OFF, the kernel expects frame data right after
+    // the aligned header.
+    const uint32_t off = TPACKET_ALIGN(sizeof(struct tpacket2_hdr));
+    if (p->length() > _frame_size - off)
+	return -EMSGSIZE;
+
+    struct tpacket2_hdr *h = reinterpret_cast<struct tpacket2_hdr *>
+	(_tx_map + (size_t) _tx_cur * _frame_size);
+    uint32_t status = h->tp_status;
+    if (status != TP_STATUS_AVAILABLE && status != TP_STATUS_WRONG_FORMAT) {
+	if (!_tx_queued)
+	    return -ENOBUFS;
+	kick();
+	status = h->tp_status;
+	if (status != TP_STATUS_AVAILABLE && status != TP_STATUS_WRONG_FORMAT)
+	    return -ENOBUFS;
+    }
+    ring_barrier();
+
+    memcpy(reinterpret_cast<unsigned char *>(h) + off, p->data(), p->length());
+    h->tp_len = p->length();
+    ring_barrier();
+    h->tp_status = TP_STATUS_SEND_REQUEST;
+    if (++_tx_cur == _nframes)
+	_tx_cur = 0;
+    ++_tx_queued;
+    return 0;
+}
+
+bool
+TPacketRing::kick()
+{
+    // Frames stay queued if the kernel refuses; the next kick retries them.
+    if (_tx_queued && sendto(_fd, 0, 0, MSG_DONTWAIT, 0, 0) >= 0)
+	_tx_queued = 0;
+    return !_tx_queued;
+}
+
+CLICK_ENDDECLS
+#endif
+ELEMENT_PROVIDES(TPacketRing)
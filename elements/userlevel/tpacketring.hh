@@ -0,0 +1,101 @@
+#ifndef CLICK_TPACKETRING_HH
+#define CLICK_TPACKETRING_HH 1
+
+#ifdef __linux__
+#include <click/packet.hh>
+#include <click/string.hh>
+CLICK_DECLS
+class ErrorHandler;
+
+/* TPacketRing -- memory-mapped AF_PACKET rings.
+ *
+ * The receive side is a TPACKET_V3 ring: the kernel fills fixed-size blocks
+ * of variable-length frames and hands each block to user space whole.
+ * next_frame() walks the blocks in ring order.  A block goes back to the
+ * kernel once the reader has left it and every packet made from it by
+ * make_packet() has been freed, so zero-copy packets may travel anywhere in
+ * the configuration (and to other threads).  When more than half the blocks
+ * are pinned by live packets, make_packet() copies instead, so a slow
+ * consumer cannot stall the ring entirely.  The mapping outlives close()
+ * until the last such packet is freed.
+ *
+ * The transmit side is a TPACKET_V2 ring of fixed-size frames.  send_packet()
+ * copies into the next free frame; kick() asks the kernel to transmit every
+ * queued frame with one system call.  If the kernel refuses, kick() returns
+ * false and the frames stay queued for the next kick(). */
+
+class TPacketRing { public:
+
+    TPacketRing();
+    ~TPacketRing();
+
+    enum { default_block_size = 1 << 20, default_blocks = 64 };
+
+    int open_rx(const String &ifname, int block_size, int nblocks,
+		ErrorHandler *errh);
+    int open_tx(const String &ifname, ErrorHandler *errh);
+    int join_fanout(int group, int mode, ErrorHandler *errh);
+    static int parse_fanout_mode(const String &str);
+    void close();
+
+    int fd() const			{ return _fd; }
+    int ifindex() const			{ return _ifindex; }
+
+    struct Frame {
+	const unsigned char *data;
+	uint32_t caplen;
+	uint32_t len;
+	uint32_t sec;
+	uint32_t nsec;
+	uint16_t protocol;	// network byte order
+	uint8_t pkttype;
+	bool vlan_valid;
+	uint16_t vlan_tci;
+    };
+
+    bool next_frame(Frame &f);
+    WritablePacket *make_packet(const Frame &f, bool zerocopy, unsigned headroom);
+    bool pinned() const;
+    unsigned kernel_drops() const;
+
+    int send_packet(const Packet *p);
+    bool kick();
+
+  private:
+
+    struct RxRing;
+    struct Block;
+
+    int _fd;
+    int _ifindex;
+
+    // receive
+    RxRing *_rx;
+    int _rx_cur;
+    Block *_rx_block;
+    unsigned char *_rx_next;
+    uint32_t _rx_remaining;
+    mutable unsigned _drops;
+
+    // transmit
+    unsigned char *_tx_map;
+    size_t _tx_map_size;
+    uint32_t _frame_size;
+    uint32_t _nframes;
+    uint32_t _tx_cur;
+    uint32_t _tx_queued;
+
+    int open_socket(const String &ifname, int protocol, ErrorHandler *errh);
+    unsigned char *map_ring(int version, int option, const void *req,
+			    size_t reqlen, size_t size, const String &ifname,
+			    ErrorHandler *errh);
+    int bind_socket(int protocol, const String &ifname, ErrorHandler *errh);
+    void leave_block();
+    static void release(Block *b);
+    static void release_frame(unsigned char *, size_t, void *);
+
+};
+
+CLICK_ENDDECLS
+#endif
+#endif
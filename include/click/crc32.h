@@ -5,9 +5,27 @@
 extern "C" {
 #endif
 
+/** @brief Update a CRC-32 over a data block.
+ * @param crc_accum CRC so far; 0xFFFFFFFF to start an Ethernet CRC
+ * @param data_blk_ptr data
+ * @param data_blk_size number of bytes of data
+ *
+ * Uses the Ethernet polynomial, most significant bit first.  Long blocks
+ * are processed with slice-by-8 tables, or at user level on x86 with
+ * PCLMULQDQ folding when the CPU supports it. */
 uint32_t update_crc(uint32_t crc_accum, const char *data_blk_ptr,
 		    int data_blk_size);
 
+/** @brief Select the code used by update_crc().
+ * @param name "table", "slice8", or "pclmul"; null means the best supported
+ * @return 0 on success, -1 if @a name is unknown or unsupported
+ *
+ * The choice is global.  It is normally made automatically. */
+int click_crc32_set_impl(const char *name);
+
+/** @brief Return the name of the code used by update_crc(). */
+const char *click_crc32_impl(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -5,6 +5,7 @@
 #include <click/vector.hh>
 #include <click/string.hh>
 #include <click/packet.hh>
+#include <click/packetbatch.hh>
 #include <click/handler.hh>
 CLICK_DECLS
 class Router;
@@ -36,6 +37,8 @@ class Element { public:
     virtual void push(int port, Packet *p);
     virtual Packet *pull(int port) CLICK_WARN_UNUSED_RESULT;
     virtual Packet *simple_action(Packet *p);
+    virtual void push_batch(int port, PacketBatch *batch);
+    virtual void pull_batch(int port, PacketBatch *batch, unsigned max);
 
     virtual bool run_task(Task *task);	// return true iff did useful work
     virtual void run_timer(Timer *timer);
@@ -47,6 +50,7 @@ class Element { public:
 
     inline void checked_output_push(int port, Packet *p) const;
     inline Packet* checked_input_pull(int port) const;
+    inline void checked_output_push_batch(int port, PacketBatch *batch) const;
 
     // ELEMENT CHARACTERISTICS
     virtual const char *class_name() const = 0;
@@ -219,9 +223,13 @@ class Element { public:
 
 	inline void push(Packet* p) const;
 	inline Packet* pull() const;
+	inline void push_batch(PacketBatch *batch) const;
+	inline void pull_batch(PacketBatch *batch, unsigned max) const;
 
 #if CLICK_STATS >= 1
 	unsigned npackets() const	{ return _packets; }
+	unsigned nbatches() const	{ return _batches; }
+	unsigned nbatch_packets() const	{ return _batch_packets; }
 #endif
 
 	inline void assign(bool isoutput, Element *e, int port);
@@ -239,14 +247,23 @@ class Element { public:
 
 #if CLICK_STATS >= 1
 	mutable unsigned _packets;	// How many packets have we moved?
+	mutable unsigned _batches;	// How many batches have we moved?
+	mutable unsigned _batch_packets; // How many packets in those batches?
 #endif
-#if CLICK_STATS >= 2
+#if CLICK_STATS >= 2 || CLICK_PROFILING
 	Element* _owner;		// Whose input or output are we?
 #endif
 
 	inline Port();
 	inline void assign(bool isoutput, Element *owner, Element *e, int port);
 
+#if CLICK_PROFILING
+	void profile_push(Packet *p) const;
+	Packet *profile_pull() const;
+	void profile_push_batch(PacketBatch *batch) const;
+	void profile_pull_batch(PacketBatch *batch, unsigned max) const;
+#endif
+
 	friend class Element;
 
     };
@@ -268,6 +285,9 @@ class Element { public:
 
     Router* _router;
     int _eindex;
+#if CLICK_PROFILING
+    bool _profiled;		// Are transfers into this element profiled?
+#endif
 
 #if CLICK_STATS >= 2
     // STATISTICS
@@ -517,8 +537,12 @@ Element::input_is_push(int port) const
 
 #if CLICK_STATS >= 2
 # define PORT_ASSIGN(o) _packets = 0; _owner = (o)
+#elif CLICK_STATS >= 1 && CLICK_PROFILING
+# define PORT_ASSIGN(o) _packets = 0; _owner = (o)
 #elif CLICK_STATS >= 1
 # define PORT_ASSIGN(o) _packets = 0; (void) (o)
+#elif CLICK_PROFILING
+# define PORT_ASSIGN(o) _owner = (o)
 #else
 # define PORT_ASSIGN(o) (void) (o)
 #endif
@@ -528,6 +552,9 @@ Element::Port::Port()
     : _e(0), _port(-2)
 {
     PORT_ASSIGN(0);
+#if CLICK_STATS >= 1
+    _batches = _batch_packets = 0;
+#endif
 }
 
 inline void
@@ -553,6 +580,9 @@ inline void
 Element::Port::assign(bool isoutput, Element *owner, Element *e, int port)
 {
     PORT_ASSIGN(owner);
+#if CLICK_STATS >= 1
+    _batches = _batch_packets = 0;
+#endif
     assign(isoutput, e, port);
 }
 
@@ -609,6 +639,12 @@ inline void
 Element::Port::push(Packet* p) const
 {
     assert(_e && p);
+#if CLICK_PROFILING
+    if (unlikely(_e->_profiled)) {
+	profile_push(p);
+	return;
+    }
+#endif
 #if CLICK_STATS >= 1
     ++_packets;
 #endif
@@ -655,6 +691,10 @@ inline Packet*
 Element::Port::pull() const
 {
     assert(_e);
+#if CLICK_PROFILING
+    if (unlikely(_e->_profiled))
+	return profile_pull();
+#endif
 #if CLICK_STATS >= 2
     click_cycles_t start_cycles = click_get_cycles(),
 	old_child_cycles = _e->_child_cycles;
@@ -684,6 +724,95 @@ Element::Port::pull() const
     return p;
 }
 
+/** @brief Push the packets in @a batch over this port.
+ *
+ * Passes every packet in @a batch to the next element's @link
+ * Element::push_batch() push_batch() @endlink function in a single call.
+ * Elements that do not override push_batch() receive the packets one at a
+ * time through push().
+ *
+ * This port must be an active() push output port.  Like push(), this
+ * relinquishes control of the batch's packets; @a batch is empty when
+ * push_batch() returns.  Empty batches are not passed on.
+ */
+inline void
+Element::Port::push_batch(PacketBatch *batch) const
+{
+    assert(_e && batch);
+    if (batch->empty())
+	return;
+#if CLICK_PROFILING
+    if (unlikely(_e->_profiled)) {
+	profile_push_batch(batch);
+	return;
+    }
+#endif
+#if CLICK_STATS >= 1
+    ++_batches;
+    _batch_packets += batch->count();
+    _packets += batch->count();
+#endif
+#if CLICK_STATS >= 2
+    _e->input(_port)._packets += batch->count();
+    click_cycles_t start_cycles = click_get_cycles(),
+	start_child_cycles = _e->_child_cycles;
+    _e->push_batch(_port, batch);
+    click_cycles_t all_delta = click_get_cycles() - start_cycles,
+	own_delta = all_delta - (_e->_child_cycles - start_child_cycles);
+    _e->_xfer_calls += 1;
+    _e->_xfer_own_cycles += own_delta;
+    _owner->_child_cycles += all_delta;
+#else
+    _e->push_batch(_port, batch);
+#endif
+    batch->clear();
+}
+
+/** @brief Pull up to @a max packets over this port into @a batch.
+ *
+ * Calls the previous element's @link Element::pull_batch() pull_batch()
+ * @endlink function, which appends up to @a max packets to @a batch.
+ * Elements that do not override pull_batch() are pulled one packet at a time
+ * through pull().  Returns when upstream has no more packets or @a max
+ * packets were appended.
+ *
+ * This port must be an active() pull input port.
+ */
+inline void
+Element::Port::pull_batch(PacketBatch *batch, unsigned max) const
+{
+    assert(_e && batch);
+#if CLICK_PROFILING
+    if (unlikely(_e->_profiled)) {
+	profile_pull_batch(batch, max);
+	return;
+    }
+#endif
+#if CLICK_STATS >= 1
+    unsigned old_count = batch->count();
+#endif
+#if CLICK_STATS >= 2
+    click_cycles_t start_cycles = click_get_cycles(),
+	old_child_cycles = _e->_child_cycles;
+    _e->pull_batch(_port, batch, max);
+    _e->output(_port)._packets += batch->count() - old_count;
+    click_cycles_t all_delta = click_get_cycles() - start_cycles,
+	own_delta = all_delta - (_e->_child_cycles - old_child_cycles);
+    _e->_xfer_calls += 1;
+    _e->_xfer_own_cycles += own_delta;
+    _owner->_child_cycles += all_delta;
+#else
+    _e->pull_batch(_port, batch, max);
+#endif
+#if CLICK_STATS >= 1
+    if (unsigned n = batch->count() - old_count) {
+	++_batches;
+	_batch_packets += n;
+	_packets += n;
+    }
+#endif
+}
+
 /** @brief Push packet @a p to output @a port, or kill it if @a port is out of
  * range.
  *
@@ -724,6 +853,24 @@ Element::checked_input_pull(int port) const
 	return 0;
 }
 
+/** @brief Push the packets in @a batch to output @a port, or kill them if
+ * @a port is out of range.
+ *
+ * @param port output port number
+ * @param batch packets to push
+ *
+ * The batch equivalent of checked_output_push().  @a batch is empty when
+ * checked_output_push_batch() returns.
+ */
+inline void
+Element::checked_output_push_batch(int port, PacketBatch *batch) const
+{
+    if ((unsigned) port < (unsigned) noutputs())
+	_ports[1][port].push_batch(batch);
+    else
+	batch->kill();
+}
+
 #undef PORT_ASSIGN
 CLICK_ENDDECLS
 #endif
@@ -9,6 +9,15 @@ CLICK_DECLS
 // IP6 routing table.
 // Lookup by longest prefix.
 // Each entry contains a gateway and an output index.
+//
+// Routes are kept in a multibit trie with a stride of 8 bits, whose nodes
+// are compressed with bitmaps (a "tree bitmap"): a node stores the routes
+// whose prefix ends inside its 8 bits, and its children, in two arrays that
+// are indexed by counting the bits set in the node's bitmaps. A lookup
+// visits at most 17 nodes, whatever the number of routes; add() and del()
+// only touch the nodes on the path to the prefix. Masks must be prefixes:
+// add() and del() return -EINVAL for any other mask, and del() returns
+// -ENOENT when there is no such route.
 
 class IP6Table { public:
 
@@ -17,11 +26,13 @@ class IP6Table { public:
 
   bool lookup(const IP6Address &dst, IP6Address &gw, int &index) const;
 
-  void add(const IP6Address &dst, const IP6Address &mask, const IP6Address &gw, int index);
-  void del(const IP6Address &dst, const IP6Address &mask);
-  void clear()				{ _v.clear(); }
+  int add(const IP6Address &dst, const IP6Address &mask, const IP6Address &gw, int index);
+  int del(const IP6Address &dst, const IP6Address &mask);
+  void clear();
   String dump();
 
+  int size() const			{ return _v.size() - _free.size(); }
+
  private:
 
   struct Entry {
@@ -32,8 +43,38 @@ class IP6Table { public:
     int _valid;
   };
   Vector<Entry> _v;
+  Vector<int> _free;	// indexes of invalid entries in _v
+
+  enum { nwords = 256 / 32 };
+
+  struct Node {
+    // bit (1 << len) + (byte >> (8 - len)), 0 <= len < 8, is set in _route_bits
+    // when the node contains a route whose prefix ends len bits into the node
+    uint32_t _route_bits[nwords];
+    // bit byte is set in _child_bits when the node has a child for that byte
+    uint32_t _child_bits[nwords];
+    Vector<int> _routes;	// indexes into _v, in bit order
+    Vector<Node *> _children;	// in bit order
+
+    Node();
+    bool empty() const		{ return !_routes.size() && !_children.size(); }
+  };
+  Node *_root;
+
+  static inline bool test_bit(const uint32_t *bits, int i);
+  static inline int rank(const uint32_t *bits, int i);
+  static void free_node(Node *n);
+
+  IP6Table(const IP6Table &);
+  IP6Table &operator=(const IP6Table &);
 
 };
 
+inline bool
+IP6Table::test_bit(const uint32_t *bits, int i)
+{
+  return bits[i >> 5] & (1U << (i & 31));
+}
+
 CLICK_ENDDECLS
 #endif
@@ -121,6 +121,14 @@ class IPFlowID { public:
      * Equal IPFlowID objects always have equal hashcode() values. */
     inline hashcode_t hashcode() const;
 
+    /** @brief Direction-independent hash function.
+     * @return The hash value of this IPFlowID.
+     *
+     * A flow ID and its reverse() always have equal symmetric_hashcode()
+     * values, so this function can steer both directions of a connection to
+     * the same place. */
+    inline hashcode_t symmetric_hashcode() const;
+
     /** @brief Unparse this address into a String.
      *
      * Returns a string with formatted like "(SADDR, SPORT, DADDR, DPORT)". */
@@ -164,6 +172,19 @@ inline hashcode_t IPFlowID::hashcode() const
 
 #undef ROT
 
+inline hashcode_t IPFlowID::symmetric_hashcode() const
+{
+    uint32_t h = (_saddr.addr() ^ _daddr.addr())
+	+ ((uint32_t) ntohs(_sport) + ntohs(_dport)) * 0x9E3779B1U;
+    // final mix from MurmurHash3
+    h ^= h >> 16;
+    h *= 0x85EBCA6BU;
+    h ^= h >> 13;
+    h *= 0xC2B2AE35U;
+    h ^= h >> 16;
+    return h;
+}
+
 inline bool operator==(const IPFlowID &a, const IPFlowID &b)
 {
     return a.sport() == b.sport() && a.dport() == b.dport()
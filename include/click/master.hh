@@ -32,6 +32,11 @@ class Master { public:
     inline RouterThread *thread(int id) const;
     void wake_somebody();
 
+#if HAVE_MULTITHREAD
+    bool work_stealing() const			{ return _work_stealing; }
+    void set_work_stealing(bool ws)		{ _work_stealing = ws; }
+#endif
+
 #if CLICK_USERLEVEL
     int add_signal_handler(int signo, Router *router, String handler);
     int remove_signal_handler(int signo, Router *router, String handler);
@@ -59,6 +64,9 @@ class Master { public:
     // THREADS
     RouterThread **_threads;
     int _nthreads;
+#if HAVE_MULTITHREAD
+    volatile bool _work_stealing;
+#endif
 
     // ROUTERS
     Router *_routers;
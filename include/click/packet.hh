@@ -31,6 +31,10 @@ CLICK_DECLS
 
 class IP6Address;
 class WritablePacket;
+class PacketBatch;
+#if HAVE_CLICK_PACKET_POOL
+struct PacketPool;
+#endif
 
 class Packet { public:
 
@@ -67,10 +71,34 @@ class Packet { public:
 				buffer_destructor_type buffer_destructor,
                                 void* argument = (void*) 0) CLICK_WARN_UNUSED_RESULT;
 #endif
+    static unsigned make_batch(PacketBatch &batch, unsigned n,
+			       uint32_t headroom, uint32_t length,
+			       uint32_t tailroom);
 
     static void static_cleanup();
 
     inline void kill();
+    static void kill_batch(PacketBatch &batch);
+
+#if HAVE_CLICK_PACKET_POOL
+    /** @brief Packet pool statistics, summed over all threads. */
+    struct PoolStats {
+	uint64_t packet_hits;	///< packets taken from the thread's pool
+	uint64_t packet_misses;	///< packet allocations with an empty pool
+	uint64_t data_hits;	///< data buffers taken from the thread's pool
+	uint64_t data_misses;	///< buffer allocations with an empty pool
+	uint64_t global_gets;	///< batches moved from the global pool
+	uint64_t global_puts;	///< batches moved to the global pool
+	uint64_t cross_node_frees; ///< buffers freed off their NUMA node
+	uint64_t packets;	///< free packets currently pooled
+	uint64_t buffers;	///< free data buffers currently pooled
+	uint64_t chunks;	///< data buffer chunks allocated
+	uint64_t huge_chunks;	///< chunks backed by reserved huge pages
+    };
+    static void pool_stats(PoolStats &stats);
+    static unsigned pool_capacity();
+    static void set_pool_capacity(unsigned capacity);
+#endif
 
     inline bool shared() const;
     Packet *clone() CLICK_WARN_UNUSED_RESULT;
@@ -807,7 +835,11 @@ class WritablePacket : public Packet { public:
     ~WritablePacket() { }
 
 #if HAVE_CLICK_PACKET_POOL
-    static WritablePacket *pool_allocate(bool with_data);
+    static WritablePacket *pool_allocate();
+    static inline WritablePacket *pool_allocate(PacketPool &pool,
+						uint32_t headroom,
+						uint32_t length,
+						uint32_t tailroom);
     static WritablePacket *pool_allocate(uint32_t headroom, uint32_t length,
 					 uint32_t tailroom);
     static void recycle(WritablePacket *p);
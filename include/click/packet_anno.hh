@@ -119,6 +119,21 @@
 # define SET_IPSEC_SA_DATA_REFERENCE_ANNO(p, v) ((p)->set_anno_u32(IPSEC_SA_DATA_REFERENCE_ANNO_OFFSET, (v)))
 #endif
 
+// bytes 40-47: overlap PERFCTR_ANNO and IPSEC_SA_DATA_REFERENCE_ANNO, so
+// users must check IP6_NETWORK_OFFSET_ANNO against the packet (ip6helpers.cc)
+#define IP6_EXTHDR_ANNO_OFFSET		40
+#define IP6_EXTHDR_ANNO_SIZE		8
+#define IP6_PROTO_ANNO(p)		((p)->anno_u8(IP6_EXTHDR_ANNO_OFFSET))
+#define SET_IP6_PROTO_ANNO(p, v)	((p)->set_anno_u8(IP6_EXTHDR_ANNO_OFFSET, (v)))
+#define IP6_EXTHDR_FLAGS_ANNO(p)	((p)->anno_u8(IP6_EXTHDR_ANNO_OFFSET + 1))
+#define SET_IP6_EXTHDR_FLAGS_ANNO(p, v)	((p)->set_anno_u8(IP6_EXTHDR_ANNO_OFFSET + 1, (v)))
+#define IP6_TRANSPORT_OFFSET_ANNO(p)	((p)->anno_u16(IP6_EXTHDR_ANNO_OFFSET + 2))
+#define SET_IP6_TRANSPORT_OFFSET_ANNO(p, v) ((p)->set_anno_u16(IP6_EXTHDR_ANNO_OFFSET + 2, (v)))
+#define IP6_FRAG_OFFSET_ANNO(p)		((p)->anno_u16(IP6_EXTHDR_ANNO_OFFSET + 4))
+#define SET_IP6_FRAG_OFFSET_ANNO(p, v)	((p)->set_anno_u16(IP6_EXTHDR_ANNO_OFFSET + 4, (v)))
+#define IP6_NETWORK_OFFSET_ANNO(p)	((p)->anno_u16(IP6_EXTHDR_ANNO_OFFSET + 6))
+#define SET_IP6_NETWORK_OFFSET_ANNO(p, v) ((p)->set_anno_u16(IP6_EXTHDR_ANNO_OFFSET + 6, (v)))
+
 #if HAVE_INT64_TYPES
 // bytes 40-47
 # define PERFCTR_ANNO_OFFSET		40
@@ -0,0 +1,134 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_PACKETBATCH_HH
+#define CLICK_PACKETBATCH_HH
+#include <click/packet.hh>
+CLICK_DECLS
+
+/** @file <click/packetbatch.hh>
+ * @brief A run of packets transferred between elements in one call.
+ */
+
+/** @class PacketBatch
+ * @brief A run of packets transferred between elements in one call.
+ *
+ * A PacketBatch is an ordered list of packets, linked through their "next
+ * packet" and "previous packet" annotations.  Elements pass batches to each
+ * other with Element::Port::push_batch() and Element::Port::pull_batch(),
+ * which amortizes the cost of a virtual call over every packet in the batch.
+ *
+ * A PacketBatch only holds pointers to its first and last packets; it never
+ * owns packets on its own.  Whoever holds a nonempty batch is responsible
+ * for its packets, as for a single Packet pointer: it must push them on,
+ * store them, or kill() them.  Packets leave the batch through pop_front()
+ * with their "next packet" and "previous packet" annotations cleared. */
+class PacketBatch { public:
+
+    /** @brief Construct an empty batch. */
+    PacketBatch()
+	: _head(0), _tail(0), _count(0) {
+    }
+
+    /** @brief Return the first packet in the batch, or null. */
+    Packet *first() const {
+	return _head;
+    }
+    /** @brief Return the last packet in the batch, or null. */
+    Packet *last() const {
+	return _tail;
+    }
+    /** @brief Return the number of packets in the batch. */
+    unsigned count() const {
+	return _count;
+    }
+    /** @brief Return true iff the batch has no packets. */
+    bool empty() const {
+	return !_head;
+    }
+
+    inline void append(Packet *p);
+    inline void append(PacketBatch &x);
+    inline Packet *pop_front();
+    inline void clear();
+    inline void kill();
+
+  private:
+
+    Packet *_head;
+    Packet *_tail;
+    unsigned _count;
+
+};
+
+/** @brief Add packet @a p to the end of the batch.
+ *
+ * The batch takes over @a p's "next packet" and "previous packet"
+ * annotations. */
+inline void
+PacketBatch::append(Packet *p)
+{
+    p->set_next(0);
+    p->set_prev(_tail);
+    if (_tail)
+	_tail->set_next(p);
+    else
+	_head = p;
+    _tail = p;
+    ++_count;
+}
+
+/** @brief Move every packet of batch @a x to the end of this batch.
+ *
+ * @a x is empty afterwards. */
+inline void
+PacketBatch::append(PacketBatch &x)
+{
+    if (!x._head)
+	return;
+    x._head->set_prev(_tail);
+    if (_tail)
+	_tail->set_next(x._head);
+    else
+	_head = x._head;
+    _tail = x._tail;
+    _count += x._count;
+    x.clear();
+}
+
+/** @brief Remove the first packet from the batch and return it.
+ *
+ * Returns null if the batch is empty.  The returned packet's "next packet"
+ * and "previous packet" annotations are null. */
+inline Packet *
+PacketBatch::pop_front()
+{
+    Packet *p = _head;
+    if (p) {
+	if ((_head = p->next()))
+	    _head->set_prev(0);
+	else
+	    _tail = 0;
+	--_count;
+	p->set_next(0);
+	p->set_prev(0);
+    }
+    return p;
+}
+
+/** @brief Forget the packets in the batch without killing them. */
+inline void
+PacketBatch::clear()
+{
+    _head = _tail = 0;
+    _count = 0;
+}
+
+/** @brief Kill every packet in the batch, leaving it empty.
+ * @sa Packet::kill_batch */
+inline void
+PacketBatch::kill()
+{
+    Packet::kill_batch(*this);
+}
+
+CLICK_ENDDECLS
+#endif
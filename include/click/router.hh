@@ -105,6 +105,14 @@ class Router { public:
     void unparse_connections(StringAccum& sa, const String& indent = String()) const;
 
     String element_ports_string(const Element *e) const;
+
+#if CLICK_PROFILING
+    // PROFILING
+    inline bool profiling() const;
+    void set_profiling(bool profiling);
+    void reset_profile();
+    void profile_report(StringAccum &sa, bool json) const;
+#endif
     //@}
 
     // INITIALIZATION
@@ -190,6 +198,30 @@ class Router { public:
 	    return p[0] < x.p[0] || (p[0] == x.p[0] && p[1] < x.p[1]);
 	}
     };
+
+#if CLICK_PROFILING
+    // Needs to be public for Element::Port, but not useful outside
+    struct profile_element {
+	uint64_t calls;
+	click_cycles_t cycles;		// including downstream elements
+	click_cycles_t own_cycles;
+    };
+    // Each thread updates only its own profile_thread.  The padding keeps
+    // different threads' child_cycles on different cache lines.
+    struct profile_thread {
+	click_cycles_t child_cycles;	// cycles spent in callees so far
+	profile_element *elements;	// indexed by eindex
+	uint64_t *packets[2];		// indexed by global port number
+	char padding[CLICK_CACHE_LINE_SIZE - sizeof(click_cycles_t) - 3 * sizeof(void *)];
+    };
+    inline profile_thread *profile_thread_state() const {
+	return _profile[click_current_cpu_id()];
+    }
+    inline uint64_t &profile_packets(profile_thread *pt, bool isoutput,
+				     const Element *e, int port) const {
+	return pt->packets[isoutput][_element_gport_offset[isoutput][e->eindex()] + port];
+    }
+#endif
     /** @endcond never */
 
 #if CLICK_NS
@@ -296,6 +328,12 @@ class Router { public:
 
     Router* _next_router;
 
+#if CLICK_PROFILING
+    profile_thread **_profile;
+    int _nprofile;
+    bool _profiling;
+#endif
+
 #if CLICK_LINUXMODULE
     Vector<struct module*> _modules;
 #endif
@@ -372,6 +410,16 @@ Router::running() const
     return _running > 0;
 }
 
+#if CLICK_PROFILING
+/** @brief  Return true iff per-element profiling is on.
+ *  @sa set_profiling() */
+inline bool
+Router::profiling() const
+{
+    return _profiling;
+}
+#endif
+
 /** @brief  Return true iff the router has been successfully initialized. */
 inline bool
 Router::initialized() const
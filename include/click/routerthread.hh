@@ -68,6 +68,12 @@ class RouterThread { public:
     void set_cpu_share(unsigned min_share, unsigned max_share);
 #endif
 
+#if HAVE_MULTITHREAD
+    // Work stealing statistics; see Master::set_work_stealing().
+    uint32_t steals() const		{ return _steals.value(); }
+    uint32_t idles() const		{ return _idles; }
+#endif
+
 #if CLICK_LINUXMODULE || CLICK_BSDMODULE
     bool greedy() const			{ return _greedy; }
     void set_greedy(bool g)		{ _greedy = g; }
@@ -152,6 +158,16 @@ class RouterThread { public:
     Task::Pending *_pending_tail;
     SpinlockIRQ _pending_lock;
 
+#if HAVE_MULTITHREAD
+    // work stealing: an idle thread posts its ID + 1 in a busy thread's
+    // _steal_request; the busy thread hands it a task at its next iteration
+    atomic_uint32_t _steal_request;
+    RouterThread *_steal_victim;
+    bool _idle;
+    atomic_uint32_t _steals;
+    uint32_t _idles;
+#endif
+
     // SHARED STATE GROUP
     Master *_master CLICK_ALIGNED(CLICK_CACHE_LINE_SIZE);
     int _id;
@@ -221,6 +237,11 @@ class RouterThread { public:
     inline void run_tasks(int ntasks);
     inline void process_pending();
     inline void run_os();
+#if HAVE_MULTITHREAD
+    inline void balance_tasks();
+    void request_steal();
+    void grant_steal();
+#endif
 #if HAVE_ADAPTIVE_SCHEDULER
     void client_set_tickets(int client, int tickets);
     inline void client_update_pass(int client, const Timestamp &before);
@@ -7,7 +7,7 @@
 #include <click/vector.hh>
 #include <click/sync.hh>
 #include <unistd.h>
-#if !HAVE_ALLOW_SELECT && !HAVE_ALLOW_POLL && !HAVE_ALLOW_KQUEUE
+#if !HAVE_ALLOW_SELECT && !HAVE_ALLOW_POLL && !HAVE_ALLOW_KQUEUE && !HAVE_ALLOW_EPOLL
 # define HAVE_ALLOW_SELECT 1
 #endif
 #if defined(__APPLE__) && HAVE_ALLOW_SELECT && HAVE_ALLOW_POLL
@@ -18,16 +18,22 @@
 # include <poll.h>
 #else
 # undef HAVE_ALLOW_POLL
-# if !HAVE_ALLOW_SELECT && !HAVE_ALLOW_KQUEUE
+# if !HAVE_ALLOW_SELECT && !HAVE_ALLOW_KQUEUE && !HAVE_ALLOW_EPOLL
 #  error "poll is not supported on this system, try --enable-select"
 # endif
 #endif
 #if !HAVE_SYS_EVENT_H || !HAVE_KQUEUE
 # undef HAVE_ALLOW_KQUEUE
-# if !HAVE_ALLOW_SELECT && !HAVE_ALLOW_POLL
+# if !HAVE_ALLOW_SELECT && !HAVE_ALLOW_POLL && !HAVE_ALLOW_EPOLL
 #  error "kqueue is not supported on this system, try --enable-select"
 # endif
 #endif
+#if !HAVE_SYS_EPOLL_H || !HAVE_EPOLL_CREATE
+# undef HAVE_ALLOW_EPOLL
+# if !HAVE_ALLOW_SELECT && !HAVE_ALLOW_POLL && !HAVE_ALLOW_KQUEUE
+#  error "epoll is not supported on this system, try --enable-select"
+# endif
+#endif
 CLICK_DECLS
 class Element;
 class Router;
@@ -70,6 +76,9 @@ class SelectSet { public:
 #if HAVE_ALLOW_KQUEUE
     int _kqueue;
 #endif
+#if HAVE_ALLOW_EPOLL
+    int _epoll;
+#endif
 #if !HAVE_ALLOW_POLL
     struct pollfd {
 	int fd;
@@ -93,6 +102,10 @@ class SelectSet { public:
 #if HAVE_ALLOW_KQUEUE
     void run_selects_kqueue(RouterThread *thread);
 #endif
+#if HAVE_ALLOW_EPOLL
+    void update_epoll(int fd, int events);
+    void run_selects_epoll(RouterThread *thread);
+#endif
 #if HAVE_ALLOW_POLL
     void run_selects_poll(RouterThread *thread);
 #else
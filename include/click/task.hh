@@ -269,6 +269,29 @@ class Task : private TaskLink { public:
      */
     void move_thread(int new_thread_id);
 
+    /** @brief Return true iff the Task may be moved by work stealing.
+     *
+     * Tasks are not migratable by default.  A task becomes migratable when
+     * its element calls set_migratable(true), or when the router's
+     * ThreadSched says so at initialization, as WorkStealingThreadSched does
+     * for the elements it lists.  A thread running with work stealing
+     * enabled may move a migratable task from a busy thread's run queue to
+     * its own.  Explicit move_thread() calls are not affected.
+     * @sa set_migratable */
+    inline bool migratable() const {
+	return _migratable;
+    }
+
+    /** @brief Set whether the Task may be moved by work stealing.
+     *
+     * Only elements whose task may safely run on any thread, for example
+     * because it shares no unlocked state with other tasks on its thread,
+     * should call set_migratable(true).
+     * @sa migratable */
+    inline void set_migratable(bool migratable) {
+	_migratable = migratable;
+    }
+
 
 #if HAVE_STRIDE_SCHED
     inline int tickets() const;
@@ -330,6 +353,7 @@ class Task : private TaskLink { public:
     RouterThread *_thread;
 
     Element *_owner;
+    bool _migratable;
 
     union Pending {
 	Task *t;
@@ -395,7 +419,7 @@ Task::Task(TaskCallback f, void *user_data)
 #if HAVE_MULTITHREAD
       _cycle_runs(0),
 #endif
-      _thread(0), _owner(0)
+      _thread(0), _owner(0), _migratable(false)
 {
     _status.home_thread_id = -1;
     _status.is_scheduled = _status.is_strong_unscheduled = false;
@@ -418,7 +442,7 @@ Task::Task(Element* e)
 #if HAVE_MULTITHREAD
       _cycle_runs(0),
 #endif
-      _thread(0), _owner(0)
+      _thread(0), _owner(0), _migratable(false)
 {
     _status.home_thread_id = -1;
     _status.is_scheduled = _status.is_strong_unscheduled = false;
@@ -180,6 +180,15 @@ class Timer { public:
      * elements. */
     void initialize(Router *router);
 
+    /** @brief Move the timer to thread @a thread_id.
+     * @param thread_id the new home thread ID
+     * @pre initialized()
+     *
+     * By default, a timer runs on its owner element's home thread.  This
+     * function changes the thread that runs the timer's callback.  A
+     * scheduled timer stays scheduled with the same expiration time. */
+    void move_thread(int thread_id);
+
 
     /** @brief Schedule the timer to fire at @a when_steady.
      * @param when_steady expiration time according to the steady clock
@@ -346,6 +355,8 @@ class Timer { public:
     void *_thunk;
     Element *_owner;
     RouterThread *_thread;
+    Timer *_wheel_next;
+    Timer **_wheel_pprev;
 
     Timer &operator=(const Timer &x);
 
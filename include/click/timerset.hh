@@ -21,6 +21,9 @@ class TimerSet { public:
 
     Timer *next_timer();			// useful for benchmarking
 
+    bool timer_wheel() const			{ return _wheel; }
+    void set_timer_wheel(bool wheel);
+
     unsigned max_timer_stride() const		{ return _max_timer_stride; }
     unsigned timer_stride() const		{ return _timer_stride; }
     void set_max_timer_stride(unsigned timer_stride);
@@ -54,8 +57,18 @@ class TimerSet { public:
 	}
     };
 
+    // The optional timer wheel holds timers that will not expire until a
+    // later tick, where a tick is one millisecond of steady time.  Level L
+    // has wheel_slots slots, each covering wheel_slots^L ticks.  Scheduling
+    // and unscheduling a wheel timer take O(1) time.  When the wheel reaches
+    // a slot, its timers cascade to a lower level, or, at level 0, move to
+    // the heap, which orders them exactly.
+    enum { wheel_bits = 6, wheel_slots = 1 << wheel_bits, wheel_levels = 5,
+	   wheel_schedpos1 = -0x7FFFFFFF - 1 };
+
     // Most likely _timer_expiry now fits in a cache line
     Timestamp _timer_expiry CLICK_ALIGNED(8);
+    Timestamp _wheel_expiry;
 
     unsigned _max_timer_stride;
     unsigned _timer_stride;
@@ -71,6 +84,12 @@ class TimerSet { public:
     Timestamp _timer_check;
     uint32_t _timer_check_reports;
 
+    bool _wheel;
+    unsigned _wheel_count;
+    uint64_t _wheel_now;		// next tick to process
+    uint64_t _wheel_occupied[wheel_levels];
+    Timer *_wheel_slot[wheel_levels * wheel_slots];
+
     inline void run_one_timer(Timer *);
 
     void set_timer_expiry() {
@@ -78,9 +97,22 @@ class TimerSet { public:
 	    _timer_expiry = _timer_heap.unchecked_at(0).expiry_s;
 	else
 	    _timer_expiry = Timestamp();
+	if (_wheel_expiry && (!_timer_expiry || _wheel_expiry < _timer_expiry))
+	    _timer_expiry = _wheel_expiry;
     }
     void check_timer_expiry(Timer *t);
 
+    static uint64_t wheel_tick(const Timestamp &ts) {
+	return ts.msecval();
+    }
+    inline void heap_push(Timer *t);
+    void wheel_schedule(Timer *t);
+    void wheel_link(Timer *t, uint64_t tick);
+    void wheel_unlink(Timer *t);
+    void wheel_cascade(int level, int slot);
+    void wheel_advance(uint64_t tick);
+    uint64_t wheel_next_tick() const;
+
     inline void lock_timers();
     inline bool attempt_lock_timers();
     inline void unlock_timers();
@@ -149,14 +181,5 @@ TimerSet::fence()
     unlock_timers();
 }
 
-inline Timer *
-TimerSet::next_timer()
-{
-    lock_timers();
-    Timer *t = _timer_heap.empty() ? 0 : _timer_heap.unchecked_at(0).t;
-    unlock_timers();
-    return t;
-}
-
 CLICK_ENDDECLS
 #endif
@@ -122,20 +122,87 @@ struct click_ip {
 
 /* checksum functions */
 
+/** @brief Fold a partial Internet checksum into a checksum.
+ * @param sum partial checksum, as returned by click_in_cksum_partial()
+ *
+ * Returns the one's complement of the 16-bit one's complement sum that @a
+ * sum represents, ready to be stored in a header. */
+static inline uint16_t
+click_in_cksum_fold(uint32_t sum)
+{
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    return ~sum & 0xFFFF;
+}
+
 #if !CLICK_LINUXMODULE
 /** @brief Calculate an Internet checksum over a data range.
  * @param x data to checksum
  * @param len number of bytes to checksum
  *
- * @a x must be two-byte aligned. */
+ * @a x need not be aligned.  At user level on x86, the work is done by SSE2
+ * or AVX2 code when the CPU supports it. */
 uint16_t click_in_cksum(const unsigned char *x, int len);
+
+/** @brief Add a data range to a partial Internet checksum.
+ * @param x data to checksum
+ * @param len number of bytes to checksum
+ * @param sum partial checksum of preceding data, or 0
+ *
+ * Returns a 32-bit partial checksum; pass it to click_in_cksum_fold() to
+ * get the checksum proper.  A checksum can be built from several ranges,
+ * but every range except the last must have even length. */
+uint32_t click_in_cksum_partial(const unsigned char *x, int len, uint32_t sum);
+
+/** @brief Copy a data range and add it to a partial Internet checksum.
+ * @param dst destination
+ * @param src source
+ * @param len number of bytes to copy and checksum
+ * @param sum partial checksum of preceding data, or 0
+ *
+ * Equivalent to memcpy(@a dst, @a src, @a len) followed by
+ * click_in_cksum_partial(@a src, @a len, @a sum), but reads the data only
+ * once.  The ranges must not overlap. */
+uint32_t click_in_cksum_copy_partial(unsigned char *dst, const unsigned char *src, int len, uint32_t sum);
+
+/** @brief Select the code used for Internet checksums.
+ * @param name "generic", "sse2", or "avx2"; null means the best supported
+ * @return 0 on success, -1 if @a name is unknown or unsupported
+ *
+ * The choice is global.  It is normally made automatically. */
+int click_in_cksum_set_impl(const char *name);
+
+/** @brief Return the name of the code used for Internet checksums. */
+const char *click_in_cksum_impl(void);
+
 uint16_t click_in_cksum_pseudohdr_raw(uint32_t csum, uint32_t src, uint32_t dst, int proto, int packet_len);
 #else
 # define click_in_cksum(addr, len) \
 		ip_compute_csum((unsigned char *)(addr), (len))
+# define click_in_cksum_partial(addr, len, sum) \
+		((uint32_t) csum_partial((addr), (len), (__wsum) (sum)))
+static inline uint32_t
+click_in_cksum_copy_partial(unsigned char *dst, const unsigned char *src, int len, uint32_t sum)
+{
+    memcpy(dst, src, len);
+    return click_in_cksum_partial(dst, len, sum);
+}
 # define click_in_cksum_pseudohdr_raw(csum, src, dst, proto, transport_len) \
 		csum_tcpudp_magic((src), (dst), (transport_len), (proto), ~(csum) & 0xFFFF)
 #endif
+
+/** @brief Copy a data range and calculate its Internet checksum.
+ * @param dst destination
+ * @param src source
+ * @param len number of bytes to copy and checksum
+ *
+ * Equivalent to memcpy(@a dst, @a src, @a len) followed by
+ * click_in_cksum(@a src, @a len). */
+static inline uint16_t
+click_in_cksum_copy(unsigned char *dst, const unsigned char *src, int len)
+{
+    return click_in_cksum_fold(click_in_cksum_copy_partial(dst, src, len, 0));
+}
 uint16_t click_in_cksum_pseudohdr_hard(uint32_t csum, const struct click_ip *iph, int packet_len);
 void click_update_zero_in_cksum_hard(uint16_t *csum, const unsigned char *addr, int len);
 
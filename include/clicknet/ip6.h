@@ -60,6 +60,16 @@ struct click_ip6 {
 
 #define IP6_CHECK_V(hdr)	(((hdr).ip6_vfc & htonl(IP6_V_MASK)) == htonl(6 << IP6_V_SHIFT))
 
+/* next header values for extension headers */
+#ifndef IP6PROTO_HOPOPTS
+#define IP6PROTO_HOPOPTS	0
+#define IP6PROTO_ROUTING	43
+#define IP6PROTO_ESP		50
+#define IP6PROTO_AH		51
+#define IP6PROTO_NONE		59
+#define IP6PROTO_DSTOPTS	60
+#endif
+
 /* Hop-by-Hop options header */
 struct click_ip6_hbh {
     uint8_t  ip6h_nxt;        /* next header */
@@ -109,6 +119,19 @@ struct click_ip6_fragment {
 };
 
 
+/** @brief Adjust an Internet checksum according to an IPv6 pseudoheader.
+ * @param data_csum initial checksum (may be a 16-bit checksum)
+ * @param src source address
+ * @param dst final destination address
+ * @param proto upper-layer protocol
+ * @param packet_len upper-layer packet length, in host byte order
+ *
+ * Returns the upper-layer checksum, as for click_in_cksum_pseudohdr(). */
+uint16_t click_in6_cksum_pseudohdr(uint32_t data_csum,
+				   const struct in6_addr *src,
+				   const struct in6_addr *dst,
+				   int proto, uint32_t packet_len);
+
 uint16_t in6_fast_cksum(const struct in6_addr *saddr,
 			const struct in6_addr *daddr,
 			uint16_t len,
@@ -1,6 +1,14 @@
 /* -*- related-file-name: "../include/click/crc32.h" -*- */
 #include <click/config.h>
 #include <click/crc32.h>
+#if CLICK_LINUXMODULE
+# include <linux/string.h>
+#elif CLICK_BSDMODULE
+# include <sys/param.h>
+# include <sys/systm.h>
+#else
+# include <string.h>
+#endif
 
 /* crc32h.c -- package to compute 32-bit CRC one byte at a time using   */
 /*             the high-bit first (Big-Endian) bit ordering convention  */
@@ -40,7 +48,9 @@
 
 #define POLYNOMIAL 0x04c11db7L
 
-static uint32_t crc_table[256];
+/* crc_table[0] is the byte-at-a-time table.  crc_table[k][b] is the CRC
+   remainder of byte b followed by k zero bytes, for slice-by-8. */
+static uint32_t crc_table[8][256];
 
 static void
 gen_crc_table(void)
@@ -55,28 +65,205 @@ gen_crc_table(void)
                 else
                    crc_accum =
                      ( crc_accum << 1 ); }
-         crc_table[i] = crc_accum; }
+         crc_table[0][i] = crc_accum; }
+   for ( i = 0;  i < 256;  i++ )
+       for ( j = 1;  j < 8;  j++ )
+           crc_table[j][i] = ( crc_table[j-1][i] << 8 )
+               ^ crc_table[0][crc_table[j-1][i] >> 24];
    return; }
 
 /*
  * update the CRC on the data block one byte at a time
  */
-uint32_t
-update_crc(uint32_t crc_accum,
-           const char *data_blk_ptr,
-           int data_blk_size)
+static uint32_t
+update_crc_table(uint32_t crc_accum,
+                 const unsigned char *data_blk_ptr,
+                 int data_blk_size)
 {
   int i, j;
-  static int initialized = 0;
-
-  if(initialized == 0){
-    initialized = 1;
-    gen_crc_table();
-  }
 
   for ( j = 0;  j < data_blk_size;  j++ ){
     i = ( (uint32_t) ( crc_accum >> 24) ^ *data_blk_ptr++ ) & 0xff;
-    crc_accum = ( crc_accum << 8 ) ^ crc_table[i];
+    crc_accum = ( crc_accum << 8 ) ^ crc_table[0][i];
   }
   return crc_accum;
 }
+
+/*
+ * update the CRC on the data block eight bytes at a time
+ */
+static uint32_t
+update_crc_slice8(uint32_t crc, const unsigned char *p, int n)
+{
+    while (n >= 8) {
+	uint32_t a = crc ^ (((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16)
+			    | ((uint32_t) p[2] << 8) | p[3]);
+	crc = crc_table[7][a >> 24] ^ crc_table[6][(a >> 16) & 0xff]
+	    ^ crc_table[5][(a >> 8) & 0xff] ^ crc_table[4][a & 0xff]
+	    ^ crc_table[3][p[4]] ^ crc_table[2][p[5]]
+	    ^ crc_table[1][p[6]] ^ crc_table[0][p[7]];
+	p += 8;
+	n -= 8;
+    }
+    return update_crc_table(crc, p, n);
+}
+
+/*
+ * On x86 at user level, long blocks can be folded with carry-less
+ * multiplication (PCLMULQDQ).  Blocks are loaded byte-reversed, so that
+ * bit i of a 128-bit register is the coefficient of x^i.  The initial CRC
+ * is XORed into the first four bytes; then each 16-byte accumulator A is
+ * replaced by a value congruent to A * x^128 (or x^512, with four
+ * accumulators) modulo the polynomial, XORed with the next block.  The
+ * final 16 bytes and the tail go through the slice-by-8 code.
+ */
+#if CLICK_USERLEVEL && (defined(__x86_64__) || defined(__i386__)) \
+    && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9) || defined(__clang__))
+# define CLICK_CRC32_X86 1
+# include <immintrin.h>
+
+/* fold constants: x^n mod POLYNOMIAL for n = 128, 192, 512, 576 */
+static uint32_t crc_fold_k[4];
+
+static uint32_t
+crc_xpow_mod(int n)
+{
+    uint32_t r = 1;
+    while (n-- > 0)
+	r = (r & 0x80000000U) ? (r << 1) ^ POLYNOMIAL : r << 1;
+    return r;
+}
+
+__attribute__((target("pclmul,ssse3"))) static inline __m128i
+crc_fold(__m128i a, __m128i k)
+{
+    return _mm_xor_si128(_mm_clmulepi64_si128(a, k, 0x00),
+			 _mm_clmulepi64_si128(a, k, 0x11));
+}
+
+__attribute__((target("pclmul,ssse3"))) static uint32_t
+update_crc_pclmul(uint32_t crc, const unsigned char *p, int n)
+{
+    const __m128i bswap = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7,
+				       8, 9, 10, 11, 12, 13, 14, 15);
+    __m128i k128, k512, x0, x1, x2, x3;
+    unsigned char buf[16];
+
+    if (n < 128)
+	return update_crc_slice8(crc, p, n);
+
+    k128 = _mm_set_epi64x(crc_fold_k[1], crc_fold_k[0]);
+    k512 = _mm_set_epi64x(crc_fold_k[3], crc_fold_k[2]);
+    x0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) p), bswap);
+    x1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (p + 16)), bswap);
+    x2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (p + 32)), bswap);
+    x3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (p + 48)), bswap);
+    x0 = _mm_xor_si128(x0, _mm_slli_si128(_mm_cvtsi32_si128(crc), 12));
+    p += 64;
+    n -= 64;
+
+    while (n >= 64) {
+	x0 = _mm_xor_si128(crc_fold(x0, k512), _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) p), bswap));
+	x1 = _mm_xor_si128(crc_fold(x1, k512), _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (p + 16)), bswap));
+	x2 = _mm_xor_si128(crc_fold(x2, k512), _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (p + 32)), bswap));
+	x3 = _mm_xor_si128(crc_fold(x3, k512), _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (p + 48)), bswap));
+	p += 64;
+	n -= 64;
+    }
+
+    x1 = _mm_xor_si128(x1, crc_fold(x0, k128));
+    x2 = _mm_xor_si128(x2, crc_fold(x1, k128));
+    x3 = _mm_xor_si128(x3, crc_fold(x2, k128));
+    while (n >= 16) {
+	x3 = _mm_xor_si128(crc_fold(x3, k128), _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) p), bswap));
+	p += 16;
+	n -= 16;
+    }
+
+    _mm_storeu_si128((__m128i *) buf, _mm_shuffle_epi8(x3, bswap));
+    crc = update_crc_slice8(0, buf, 16);
+    return update_crc_slice8(crc, p, n);
+}
+
+static int
+crc_have_pclmul(void)
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("ssse3");
+}
+#endif
+
+struct crc_impl {
+    const char *name;
+    uint32_t (*update)(uint32_t, const unsigned char *, int);
+    int (*supported)(void);
+};
+
+/* in order of preference, best last */
+static const struct crc_impl crc_impls[] = {
+    { "table", update_crc_table, 0 },
+    { "slice8", update_crc_slice8, 0 },
+#if CLICK_CRC32_X86
+    { "pclmul", update_crc_pclmul, crc_have_pclmul },
+#endif
+};
+
+/* Until the first call builds the tables and picks an implementation,
+   crc_impl points at a resolver.  Racing resolvers store the same
+   values. */
+static uint32_t update_crc_resolve(uint32_t, const unsigned char *, int);
+static const struct crc_impl crc_resolver = { "table", update_crc_resolve, 0 };
+static const struct crc_impl *crc_impl = &crc_resolver;
+
+static void
+crc_init(void)
+{
+    static int initialized = 0;
+    if (!initialized) {
+	gen_crc_table();
+#if CLICK_CRC32_X86
+	crc_fold_k[0] = crc_xpow_mod(128);
+	crc_fold_k[1] = crc_xpow_mod(192);
+	crc_fold_k[2] = crc_xpow_mod(512);
+	crc_fold_k[3] = crc_xpow_mod(576);
+#endif
+	initialized = 1;
+    }
+}
+
+static uint32_t
+update_crc_resolve(uint32_t crc, const unsigned char *p, int n)
+{
+    click_crc32_set_impl(0);
+    return crc_impl->update(crc, p, n);
+}
+
+int
+click_crc32_set_impl(const char *name)
+{
+    int i = sizeof(crc_impls) / sizeof(crc_impls[0]);
+    crc_init();
+    while (--i >= 0)
+	if ((!name || strcmp(name, crc_impls[i].name) == 0)
+	    && (!crc_impls[i].supported || crc_impls[i].supported())) {
+	    crc_impl = &crc_impls[i];
+	    return 0;
+	}
+    return -1;
+}
+
+const char *
+click_crc32_impl(void)
+{
+    if (crc_impl == &crc_resolver)
+	click_crc32_set_impl(0);
+    return crc_impl->name;
+}
+
+uint32_t
+update_crc(uint32_t crc_accum,
+           const char *data_blk_ptr,
+           int data_blk_size)
+{
+    return crc_impl->update(crc_accum, (const unsigned char *) data_blk_ptr, data_blk_size);
+}
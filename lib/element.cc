@@ -418,6 +418,9 @@ void BetterIPCounter3::push(int port, Packet *p) {
 /** @brief Construct an Element. */
 Element::Element()
     : _router(0), _eindex(-1)
+#if CLICK_PROFILING
+    , _profiled(false)
+#endif
 {
     nelements_allocated++;
     _ports[0] = _ports[1] = &_inline_ports[0];
@@ -796,6 +799,118 @@ Element::connect_port(bool isoutput, int port, Element* e, int e_port)
 	return -1;
 }
 
+#if CLICK_PROFILING
+/* Profiled transfers.  Port::push() and friends call these instead of the
+   element directly while the router is profiling (Router::set_profiling()).
+   A thread's child_cycles accumulates the cycles spent in the current
+   callee's own callees, so the callee's own cycles are its total cycles
+   minus child_cycles when it returns. */
+
+static inline click_cycles_t
+profile_enter(Router::profile_thread *pt)
+{
+    click_cycles_t saved_child_cycles = pt->child_cycles;
+    pt->child_cycles = 0;
+    return saved_child_cycles;
+}
+
+static inline void
+profile_leave(Router::profile_thread *pt, const Element *e,
+	      click_cycles_t saved_child_cycles, click_cycles_t start_cycles)
+{
+    click_cycles_t all_cycles = click_get_cycles() - start_cycles;
+    Router::profile_element &pe = pt->elements[e->eindex()];
+    ++pe.calls;
+    pe.cycles += all_cycles;
+    pe.own_cycles += all_cycles - pt->child_cycles;
+    pt->child_cycles = saved_child_cycles + all_cycles;
+}
+
+void
+Element::Port::profile_push(Packet *p) const
+{
+    Router *r = _e->router();
+    Router::profile_thread *pt = r->profile_thread_state();
+    ++r->profile_packets(pt, true, _owner, this - _owner->_ports[1]);
+    ++r->profile_packets(pt, false, _e, _port);
+# if CLICK_STATS >= 1
+    ++_packets;
+# endif
+    click_cycles_t saved = profile_enter(pt);
+    click_cycles_t start_cycles = click_get_cycles();
+# if HAVE_BOUND_PORT_TRANSFER
+    _bound.push(_e, _port, p);
+# else
+    _e->push(_port, p);
+# endif
+    profile_leave(pt, _e, saved, start_cycles);
+}
+
+Packet *
+Element::Port::profile_pull() const
+{
+    Router *r = _e->router();
+    Router::profile_thread *pt = r->profile_thread_state();
+    click_cycles_t saved = profile_enter(pt);
+    click_cycles_t start_cycles = click_get_cycles();
+# if HAVE_BOUND_PORT_TRANSFER
+    Packet *p = _bound.pull(_e, _port);
+# else
+    Packet *p = _e->pull(_port);
+# endif
+    profile_leave(pt, _e, saved, start_cycles);
+    if (p) {
+	++r->profile_packets(pt, true, _e, _port);
+	++r->profile_packets(pt, false, _owner, this - _owner->_ports[0]);
+# if CLICK_STATS >= 1
+	++_packets;
+# endif
+    }
+    return p;
+}
+
+void
+Element::Port::profile_push_batch(PacketBatch *batch) const
+{
+    Router *r = _e->router();
+    Router::profile_thread *pt = r->profile_thread_state();
+    unsigned n = batch->count();
+    r->profile_packets(pt, true, _owner, this - _owner->_ports[1]) += n;
+    r->profile_packets(pt, false, _e, _port) += n;
+# if CLICK_STATS >= 1
+    ++_batches;
+    _batch_packets += n;
+    _packets += n;
+# endif
+    click_cycles_t saved = profile_enter(pt);
+    click_cycles_t start_cycles = click_get_cycles();
+    _e->push_batch(_port, batch);
+    profile_leave(pt, _e, saved, start_cycles);
+    batch->clear();
+}
+
+void
+Element::Port::profile_pull_batch(PacketBatch *batch, unsigned max) const
+{
+    Router *r = _e->router();
+    Router::profile_thread *pt = r->profile_thread_state();
+    unsigned old_count = batch->count();
+    click_cycles_t saved = profile_enter(pt);
+    click_cycles_t start_cycles = click_get_cycles();
+    _e->pull_batch(_port, batch, max);
+    profile_leave(pt, _e, saved, start_cycles);
+    if (unsigned n = batch->count() - old_count) {
+	r->profile_packets(pt, true, _e, _port) += n;
+	r->profile_packets(pt, false, _owner, this - _owner->_ports[0]) += n;
+# if CLICK_STATS >= 1
+	++_batches;
+	_batch_packets += n;
+	_packets += n;
+# endif
+    }
+}
+#endif
+
 
 // FLOW
 
@@ -2038,9 +2153,29 @@ Element::read_handlers_handler(Element *e, void *)
     return sa.take_string();
 }
 
-
 #if CLICK_STATS >= 1
 
+static String
+read_batch_sizes_handler(Element *e, void *)
+{
+    // one line per active port that moved batches: the port, the number of
+    // batches, the number of packets in them, and the average batch size
+    StringAccum sa;
+    for (int isoutput = 0; isoutput < 2; ++isoutput)
+	for (int i = 0; i < e->nports(isoutput); ++i) {
+	    const Element::Port &port = e->port(isoutput, i);
+	    if (!port.active() || !port.nbatches())
+		continue;
+	    unsigned avg100 = (unsigned) ((uint64_t) port.nbatch_packets() * 100 / port.nbatches());
+	    sa << (isoutput ? "output " : "input ") << i << '\t'
+	       << port.nbatches() << '\t' << port.nbatch_packets() << '\t'
+	       << (avg100 / 100) << '.';
+	    sa.snprintf(3, "%02u", avg100 % 100);
+	    sa << '\n';
+	}
+    return sa.take_string();
+}
+
 static String
 read_icounts_handler(Element *f, void *)
 {
@@ -2100,6 +2235,7 @@ Element::add_default_handlers(bool allow_write_config)
   add_read_handler("ports", read_ports_handler, 0, Handler::f_calm);
   add_read_handler("handlers", read_handlers_handler, 0, Handler::f_calm);
 #if CLICK_STATS >= 1
+  add_read_handler("batch_sizes", read_batch_sizes_handler, 0);
   add_read_handler("icounts", read_icounts_handler, 0);
   add_read_handler("ocounts", read_ocounts_handler, 0);
 # if CLICK_STATS >= 2
@@ -2971,6 +3107,54 @@ Element::simple_action(Packet *p)
     return p;
 }
 
+/** @brief Push a batch of packets onto push input @a port.
+ *
+ * @param port the input port number on which the packets arrive
+ * @param batch the packets
+ *
+ * An upstream element transferred the packets in @a batch to this element
+ * over a push connection, using Port::push_batch().  push_batch() must
+ * account for every packet in the batch, as push() does for a single packet.
+ * Packets in a batch are ordered; they should leave the element in that
+ * order wherever they leave by the same port.
+ *
+ * The default implementation pops each packet off the batch and passes it to
+ * push(), so elements that only implement push() or simple_action() work
+ * unchanged.  Elements on fast paths override push_batch() to process the
+ * whole batch at once and forward it with output(i).push_batch().
+ */
+void
+Element::push_batch(int port, PacketBatch *batch)
+{
+    while (Packet *p = batch->pop_front())
+	push(port, p);
+}
+
+/** @brief Pull up to @a max packets from pull output @a port.
+ *
+ * @param port the output port number receiving the pull request
+ * @param batch the batch to which packets are appended
+ * @param max the maximum number of packets to append
+ *
+ * A downstream element requested up to @a max packets over a pull
+ * connection, using Port::pull_batch().  pull_batch() should append the
+ * packets to @a batch in order.  It may append fewer than @a max packets,
+ * including none at all when no packet is available.
+ *
+ * The default implementation calls pull() until it returns null or @a max
+ * packets were appended.
+ */
+void
+Element::pull_batch(int port, PacketBatch *batch, unsigned max)
+{
+    for (; max; --max) {
+	Packet *p = pull(port);
+	if (!p)
+	    break;
+	batch->append(p);
+    }
+}
+
 /** @brief Run the element's task.
  *
  * @return true if the task accomplished some meaningful work, false otherwise
@@ -6,6 +6,7 @@
 
 #include <click/config.h>
 #include <clicknet/ip.h>
+#include <clicknet/ip6.h>
 #if CLICK_LINUXMODULE
 # include <linux/string.h>
 #elif CLICK_BSDMODULE
@@ -17,37 +18,306 @@
 #endif
 
 #if !CLICK_LINUXMODULE
-uint16_t
-click_in_cksum(const unsigned char *addr, int len)
-{
-    int nleft = len;
-    const uint16_t *w = (const uint16_t *)addr;
-    uint32_t sum = 0;
-    uint16_t answer = 0;
-
-    /*
-     * Our algorithm is simple, using a 32 bit accumulator (sum), we add
-     * sequential 16 bit words to it, and at the end, fold back all the
-     * carry bits from the top 16 bits into the lower 16 bits.
-     */
-    while (nleft > 1)  {
-	sum += *w++;
-	nleft -= 2;
-    }
+/*
+ * The checksum kernels.  All of them add 32-bit words into a 64-bit
+ * accumulator, which cannot overflow for any int length, and fold at the
+ * end; one's complement addition doesn't care how the words are grouped.
+ * x86 userlevel builds also have SSE2 and AVX2 kernels, chosen at run time
+ * by CPU support.  The kernel drivers may not touch vector registers, so
+ * they get only the portable kernel.
+ */
+#if CLICK_USERLEVEL && (defined(__x86_64__) || defined(__i386__)) \
+    && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9) || defined(__clang__))
+# define CLICK_IN_CKSUM_X86 1
+# include <immintrin.h>
+#endif
+
+/* Shorter ranges always use the portable kernel: the vector loops would
+   not run at all. */
+#define CKSUM_VECTOR_MIN	64
 
+static inline uint64_t
+cksum_fold64(uint64_t sum)
+{
+    sum = (sum & 0xFFFFFFFFU) + (sum >> 32);
+    sum = (sum & 0xFFFFFFFFU) + (sum >> 32);
+    return sum;
+}
+
+static inline uint64_t
+cksum_add_generic(const unsigned char *x, int len, uint64_t sum)
+{
+    uint64_t a, b, c, d;
+    uint32_t w;
+    uint16_t h;
+    while (len >= 32) {
+	memcpy(&a, x, 8);
+	memcpy(&b, x + 8, 8);
+	memcpy(&c, x + 16, 8);
+	memcpy(&d, x + 24, 8);
+	sum += (a & 0xFFFFFFFFU) + (a >> 32) + (b & 0xFFFFFFFFU) + (b >> 32)
+	    + (c & 0xFFFFFFFFU) + (c >> 32) + (d & 0xFFFFFFFFU) + (d >> 32);
+	x += 32;
+	len -= 32;
+    }
+    while (len >= 4) {
+	memcpy(&w, x, 4);
+	sum += w;
+	x += 4;
+	len -= 4;
+    }
+    if (len >= 2) {
+	memcpy(&h, x, 2);
+	sum += h;
+	x += 2;
+	len -= 2;
+    }
     /* mop up an odd byte, if necessary */
-    if (nleft == 1) {
-	*(unsigned char *)(&answer) = *(const unsigned char *)w ;
-	sum += answer;
+    if (len == 1) {
+	h = 0;
+	*(unsigned char *) &h = *x;
+	sum += h;
     }
+    return sum;
+}
 
-    /* add back carry outs from top 16 bits to low 16 bits */
-    sum = (sum & 0xffff) + (sum >> 16);
-    sum += (sum >> 16);
-    /* guaranteed now that the lower 16 bits of sum are correct */
+static inline uint64_t
+cksum_copy_generic(unsigned char *dst, const unsigned char *x, int len, uint64_t sum)
+{
+    uint64_t a, b, c, d;
+    uint32_t w;
+    uint16_t h;
+    while (len >= 32) {
+	memcpy(&a, x, 8);
+	memcpy(&b, x + 8, 8);
+	memcpy(&c, x + 16, 8);
+	memcpy(&d, x + 24, 8);
+	memcpy(dst, &a, 8);
+	memcpy(dst + 8, &b, 8);
+	memcpy(dst + 16, &c, 8);
+	memcpy(dst + 24, &d, 8);
+	sum += (a & 0xFFFFFFFFU) + (a >> 32) + (b & 0xFFFFFFFFU) + (b >> 32)
+	    + (c & 0xFFFFFFFFU) + (c >> 32) + (d & 0xFFFFFFFFU) + (d >> 32);
+	x += 32;
+	dst += 32;
+	len -= 32;
+    }
+    while (len >= 4) {
+	memcpy(&w, x, 4);
+	memcpy(dst, &w, 4);
+	sum += w;
+	x += 4;
+	dst += 4;
+	len -= 4;
+    }
+    if (len >= 2) {
+	memcpy(&h, x, 2);
+	memcpy(dst, &h, 2);
+	sum += h;
+	x += 2;
+	dst += 2;
+	len -= 2;
+    }
+    if (len == 1) {
+	h = 0;
+	*(unsigned char *) &h = *dst = *x;
+	sum += h;
+    }
+    return sum;
+}
 
-    answer = ~sum;              /* truncate to 16 bits */
-    return answer;
+static uint32_t
+cksum_partial_generic(const unsigned char *x, int len, uint32_t sum)
+{
+    return cksum_fold64(cksum_add_generic(x, len, sum));
+}
+
+static uint32_t
+cksum_copy_partial_generic(unsigned char *dst, const unsigned char *x, int len, uint32_t sum)
+{
+    return cksum_fold64(cksum_copy_generic(dst, x, len, sum));
+}
+
+#if CLICK_IN_CKSUM_X86
+/* Each 16-byte vector is split into four 32-bit words, zero-extended into
+   64-bit lanes, and added to two accumulators. */
+__attribute__((target("sse2"))) static uint32_t
+cksum_partial_sse2(const unsigned char *x, int len, uint32_t sum32)
+{
+    __m128i zero = _mm_setzero_si128(), acc0 = zero, acc1 = zero;
+    uint64_t lanes[2];
+    while (len >= 32) {
+	__m128i a = _mm_loadu_si128((const __m128i *) x);
+	__m128i b = _mm_loadu_si128((const __m128i *) (x + 16));
+	acc0 = _mm_add_epi64(acc0, _mm_unpacklo_epi32(a, zero));
+	acc1 = _mm_add_epi64(acc1, _mm_unpackhi_epi32(a, zero));
+	acc0 = _mm_add_epi64(acc0, _mm_unpacklo_epi32(b, zero));
+	acc1 = _mm_add_epi64(acc1, _mm_unpackhi_epi32(b, zero));
+	x += 32;
+	len -= 32;
+    }
+    _mm_storeu_si128((__m128i *) lanes, _mm_add_epi64(acc0, acc1));
+    return cksum_fold64(cksum_add_generic(x, len, (uint64_t) sum32 + lanes[0] + lanes[1]));
+}
+
+__attribute__((target("sse2"))) static uint32_t
+cksum_copy_partial_sse2(unsigned char *dst, const unsigned char *x, int len, uint32_t sum32)
+{
+    __m128i zero = _mm_setzero_si128(), acc0 = zero, acc1 = zero;
+    uint64_t lanes[2];
+    while (len >= 32) {
+	__m128i a = _mm_loadu_si128((const __m128i *) x);
+	__m128i b = _mm_loadu_si128((const __m128i *) (x + 16));
+	_mm_storeu_si128((__m128i *) dst, a);
+	_mm_storeu_si128((__m128i *) (dst + 16), b);
+	acc0 = _mm_add_epi64(acc0, _mm_unpacklo_epi32(a, zero));
+	acc1 = _mm_add_epi64(acc1, _mm_unpackhi_epi32(a, zero));
+	acc0 = _mm_add_epi64(acc0, _mm_unpacklo_epi32(b, zero));
+	acc1 = _mm_add_epi64(acc1, _mm_unpackhi_epi32(b, zero));
+	x += 32;
+	dst += 32;
+	len -= 32;
+    }
+    _mm_storeu_si128((__m128i *) lanes, _mm_add_epi64(acc0, acc1));
+    return cksum_fold64(cksum_copy_generic(dst, x, len, (uint64_t) sum32 + lanes[0] + lanes[1]));
+}
+
+__attribute__((target("avx2"))) static uint32_t
+cksum_partial_avx2(const unsigned char *x, int len, uint32_t sum32)
+{
+    __m256i zero = _mm256_setzero_si256(), acc0 = zero, acc1 = zero;
+    uint64_t lanes[4];
+    while (len >= 64) {
+	__m256i a = _mm256_loadu_si256((const __m256i *) x);
+	__m256i b = _mm256_loadu_si256((const __m256i *) (x + 32));
+	acc0 = _mm256_add_epi64(acc0, _mm256_unpacklo_epi32(a, zero));
+	acc1 = _mm256_add_epi64(acc1, _mm256_unpackhi_epi32(a, zero));
+	acc0 = _mm256_add_epi64(acc0, _mm256_unpacklo_epi32(b, zero));
+	acc1 = _mm256_add_epi64(acc1, _mm256_unpackhi_epi32(b, zero));
+	x += 64;
+	len -= 64;
+    }
+    _mm256_storeu_si256((__m256i *) lanes, _mm256_add_epi64(acc0, acc1));
+    return cksum_fold64(cksum_add_generic(x, len, (uint64_t) sum32 + lanes[0] + lanes[1] + lanes[2] + lanes[3]));
+}
+
+__attribute__((target("avx2"))) static uint32_t
+cksum_copy_partial_avx2(unsigned char *dst, const unsigned char *x, int len, uint32_t sum32)
+{
+    __m256i zero = _mm256_setzero_si256(), acc0 = zero, acc1 = zero;
+    uint64_t lanes[4];
+    while (len >= 64) {
+	__m256i a = _mm256_loadu_si256((const __m256i *) x);
+	__m256i b = _mm256_loadu_si256((const __m256i *) (x + 32));
+	_mm256_storeu_si256((__m256i *) dst, a);
+	_mm256_storeu_si256((__m256i *) (dst + 32), b);
+	acc0 = _mm256_add_epi64(acc0, _mm256_unpacklo_epi32(a, zero));
+	acc1 = _mm256_add_epi64(acc1, _mm256_unpackhi_epi32(a, zero));
+	acc0 = _mm256_add_epi64(acc0, _mm256_unpacklo_epi32(b, zero));
+	acc1 = _mm256_add_epi64(acc1, _mm256_unpackhi_epi32(b, zero));
+	x += 64;
+	dst += 64;
+	len -= 64;
+    }
+    _mm256_storeu_si256((__m256i *) lanes, _mm256_add_epi64(acc0, acc1));
+    return cksum_fold64(cksum_copy_generic(dst, x, len, (uint64_t) sum32 + lanes[0] + lanes[1] + lanes[2] + lanes[3]));
+}
+
+static int
+cksum_have_sse2(void)
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse2");
+}
+
+static int
+cksum_have_avx2(void)
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+#endif
+
+struct cksum_impl {
+    const char *name;
+    uint32_t (*partial)(const unsigned char *, int, uint32_t);
+    uint32_t (*copy_partial)(unsigned char *, const unsigned char *, int, uint32_t);
+    int (*supported)(void);
+};
+
+/* in order of preference, best last */
+static const struct cksum_impl cksum_impls[] = {
+    { "generic", cksum_partial_generic, cksum_copy_partial_generic, 0 },
+#if CLICK_IN_CKSUM_X86
+    { "sse2", cksum_partial_sse2, cksum_copy_partial_sse2, cksum_have_sse2 },
+    { "avx2", cksum_partial_avx2, cksum_copy_partial_avx2, cksum_have_avx2 },
+#endif
+};
+
+/* Until the first call picks a kernel, cksum_impl points at resolvers.
+   Racing resolvers store the same value. */
+static uint32_t cksum_partial_resolve(const unsigned char *, int, uint32_t);
+static uint32_t cksum_copy_partial_resolve(unsigned char *, const unsigned char *, int, uint32_t);
+static const struct cksum_impl cksum_resolver = {
+    "generic", cksum_partial_resolve, cksum_copy_partial_resolve, 0
+};
+static const struct cksum_impl *cksum_impl = &cksum_resolver;
+
+static uint32_t
+cksum_partial_resolve(const unsigned char *x, int len, uint32_t sum)
+{
+    click_in_cksum_set_impl(0);
+    return cksum_impl->partial(x, len, sum);
+}
+
+static uint32_t
+cksum_copy_partial_resolve(unsigned char *dst, const unsigned char *x, int len, uint32_t sum)
+{
+    click_in_cksum_set_impl(0);
+    return cksum_impl->copy_partial(dst, x, len, sum);
+}
+
+int
+click_in_cksum_set_impl(const char *name)
+{
+    int i = sizeof(cksum_impls) / sizeof(cksum_impls[0]);
+    while (--i >= 0)
+	if ((!name || strcmp(name, cksum_impls[i].name) == 0)
+	    && (!cksum_impls[i].supported || cksum_impls[i].supported())) {
+	    cksum_impl = &cksum_impls[i];
+	    return 0;
+	}
+    return -1;
+}
+
+const char *
+click_in_cksum_impl(void)
+{
+    if (cksum_impl == &cksum_resolver)
+	click_in_cksum_set_impl(0);
+    return cksum_impl->name;
+}
+
+uint32_t
+click_in_cksum_partial(const unsigned char *x, int len, uint32_t sum)
+{
+    if (len < CKSUM_VECTOR_MIN)
+	return cksum_partial_generic(x, len, sum);
+    return cksum_impl->partial(x, len, sum);
+}
+
+uint32_t
+click_in_cksum_copy_partial(unsigned char *dst, const unsigned char *src, int len, uint32_t sum)
+{
+    if (len < CKSUM_VECTOR_MIN)
+	return cksum_copy_partial_generic(dst, src, len, sum);
+    return cksum_impl->copy_partial(dst, src, len, sum);
+}
+
+uint16_t
+click_in_cksum(const unsigned char *x, int len)
+{
+    return click_in_cksum_fold(click_in_cksum_partial(x, len, 0));
 }
 
 uint16_t
@@ -110,6 +380,24 @@ click_in_cksum_pseudohdr_hard(uint32_t csum, const struct click_ip *iph, int pac
     return click_in_cksum_pseudohdr_raw(csum, iph->ip_src.s_addr, iph->ip_dst.s_addr, iph->ip_p, packet_len);
 }
 
+uint16_t
+click_in6_cksum_pseudohdr(uint32_t csum, const struct in6_addr *src,
+			  const struct in6_addr *dst, int proto,
+			  uint32_t packet_len)
+{
+    uint64_t sum = ~csum & 0xFFFF;
+    uint32_t w[8];
+    int i;
+    memcpy(w, src, 16);
+    memcpy(w + 4, dst, 16);
+    for (i = 0; i < 8; ++i)
+	sum += w[i];
+    sum += htonl(packet_len) + (uint64_t) htonl(proto);
+    sum = (sum & 0xFFFFFFFFU) + (sum >> 32);
+    sum = (sum & 0xFFFFFFFFU) + (sum >> 32);
+    return click_in_cksum_fold(sum);
+}
+
 void
 click_update_zero_in_cksum_hard(uint16_t *csum, const unsigned char *x, int len)
 {
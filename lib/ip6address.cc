@@ -196,9 +196,10 @@ IP6Address::unparse_expanded() const
 // payloadlength from the IPv6 header, minus the length of any extension
 // header present between the IPv6 header and the upper-layer header.
 
-// The following methods only differ at how it deal with ip6 address, i.e. add 32 bit
-// a time or 16 bits a time.
-
+// in6_fast_cksum uses the Internet checksum kernels from in_cksum.c;
+// in6_cksum adds 16 bits at a time.  Both return the checksum in host byte
+// order.  ori_csum, the checksum field's current value, is removed from the
+// result, since it is part of the data.
 
 uint16_t
 in6_fast_cksum(const struct in6_addr *saddr,
@@ -209,59 +210,10 @@ in6_fast_cksum(const struct in6_addr *saddr,
                const unsigned char *addr,
                uint16_t len2)
 {
-	uint16_t ulen;
-	uint16_t uproto;
-	uint16_t answer = 0;
-	uint32_t csum =0;
-	uint32_t carry;
-        const uint32_t *saddr32 = (const uint32_t *)&saddr->s6_addr[0];
-        const uint32_t *daddr32 = (const uint32_t *)&daddr->s6_addr[0];
-
-	//get the sum of source and destination address
-	for (int i=0; i<4; i++) {
-
-	  csum += ntohl(saddr32[i]);
-	  carry = (csum < ntohl(saddr32[i]));
-	  csum += carry;
-	}
-
-	for (int i=0; i<4; i++) {
-
-	   csum += ntohl(daddr32[i]);
-	   carry = (csum < ntohl(daddr32[i]));
-	   csum += carry;
-	}
-
-	//get the sum of other fields:  packet length, protocal
-	ulen = ntohs(len);
-	csum += ulen;
-
-	uproto = proto;
-	csum += uproto;
-
-	//get the sum of the ICMP6 package
-	uint16_t nleft = ntohs(len2);
-	const uint16_t *w = (const uint16_t *)addr;
-	while (nleft > 1)  {
-	    uint16_t w2=*w++;
-	    csum += ntohs(w2);
-	    nleft -=2;
-	 }
-
-	 //mop up an odd byte, if necessary
-	  if (nleft == 1) {
-	    *(unsigned char *)(&answer) = *(const unsigned char *)w ;
-	    csum += ntohs(answer);
-	  }
-	  csum -= ntohs(ori_csum); //get rid of the effect of ori_csum in the calculation
-
-	  // fold >=32-bit csum to 16-bits
-	  while (csum>>16) {
-	    csum = (csum & 0xffff) + (csum >> 16);
-	  }
-
-	  answer = ~csum;          // truncate to 16 bits
-	  return answer;
+    uint16_t neg_ori_csum = ~ori_csum;
+    uint32_t csum = click_in_cksum_partial((const unsigned char *) &neg_ori_csum, 2, 0);
+    csum = click_in_cksum_partial(addr, ntohs(len2), csum);
+    return ntohs(click_in6_cksum_pseudohdr(click_in_cksum_fold(csum), saddr, daddr, proto, ntohs(len)));
 }
 
 
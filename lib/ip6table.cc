@@ -1,6 +1,6 @@
 // -*- c-basic-offset: 2; related-file-name: "../include/click/ip6table.hh" -*-
 /*
- * ip6table.{cc,hh} -- a stupid IP6 routing table, best for small routing tables
+ * ip6table.{cc,hh} -- IP6 routing table, a multibit trie compressed with bitmaps
  * Peilei Fan, Robert Morris
  *
  * Copyright (c) 1999-2000 Massachusetts Institute of Technology
@@ -21,65 +21,196 @@
 #include <click/straccum.hh>
 CLICK_DECLS
 
+IP6Table::Node::Node()
+{
+  memset(_route_bits, 0, sizeof(_route_bits));
+  memset(_child_bits, 0, sizeof(_child_bits));
+}
+
 IP6Table::IP6Table()
+  : _root(new Node)
 {
 }
 
 IP6Table::~IP6Table()
 {
+  free_node(_root);
+}
+
+void
+IP6Table::free_node(Node *n)
+{
+  for (int i = 0; i < n->_children.size(); i++)
+    free_node(n->_children[i]);
+  delete n;
+}
+
+static inline int
+popcount(uint32_t x)
+{
+  x = x - ((x >> 1) & 0x55555555);
+  x = (x & 0x33333333) + ((x >> 2) & 0x33333333);
+  return (((x + (x >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24;
+}
+
+// Returns the number of bits set in bits before bit i.
+inline int
+IP6Table::rank(const uint32_t *bits, int i)
+{
+  int r = popcount(bits[i >> 5] & ((1U << (i & 31)) - 1));
+  for (int w = 0; w < (i >> 5); w++)
+    r += popcount(bits[w]);
+  return r;
+}
+
+// The route bit for a prefix that ends len bits into a node, 0 <= len < 8,
+// where byte holds the address bits covered by the node.
+static inline int
+route_bit(int len, int byte)
+{
+  return (1 << len) + (len ? byte >> (8 - len) : 0);
 }
 
 bool
 IP6Table::lookup(const IP6Address &dst, IP6Address &gw, int &index) const
 {
-  int best = -1;
+  const unsigned char *a = dst.data();
+  const Node *n = _root;
+  const Node *best_node = 0;
+  int best_bit = 0;
 
-  for (int i = 0; i < _v.size(); i++)
-    if (_v[i]._valid && dst.matches_prefix(_v[i]._dst, _v[i]._mask)) {
-      if (best < 0 || _v[i]._mask.mask_as_specific(_v[best]._mask))
-        best = i;
-    }
+  for (int depth = 0; ; depth++) {
+    int byte = (depth < 16 ? a[depth] : 0);
+
+    // the longest prefix ending in this node is the best match so far; its
+    // route is only fetched once the walk is over, to save cache misses
+    if (n->_routes.size())
+      for (int len = (depth < 16 ? 7 : 0); len >= 0; len--) {
+	int bit = route_bit(len, byte);
+	if (test_bit(n->_route_bits, bit)) {
+	  best_node = n;
+	  best_bit = bit;
+	  break;
+	}
+      }
+
+    if (depth == 16 || !test_bit(n->_child_bits, byte))
+      break;
+    n = n->_children[rank(n->_child_bits, byte)];
+  }
 
-  if (best < 0)
+  if (!best_node)
     return false;
   else {
-    gw = _v[best]._gw;
-    index = _v[best]._index;
+    const Entry &e = _v[best_node->_routes[rank(best_node->_route_bits, best_bit)]];
+    gw = e._gw;
+    index = e._index;
     return true;
   }
 }
 
-void
+int
 IP6Table::add(const IP6Address &dst, const IP6Address &mask,
 	      const IP6Address &gw, int index)
 {
+  int prefix_len = mask.mask_to_prefix_len();
+  if (prefix_len < 0)
+    return -EINVAL;
+  IP6Address dstnet = dst & mask;
+  const unsigned char *a = dstnet.data();
+
+  // find the node the prefix ends in, creating nodes on the way
+  Node *n = _root;
+  for (int depth = 0; depth < (prefix_len >> 3); depth++) {
+    int r = rank(n->_child_bits, a[depth]);
+    if (!test_bit(n->_child_bits, a[depth])) {
+      n->_children.insert(n->_children.begin() + r, new Node);
+      n->_child_bits[a[depth] >> 5] |= 1U << (a[depth] & 31);
+    }
+    n = n->_children[r];
+  }
+
+  int bit = route_bit(prefix_len & 7, prefix_len < 128 ? a[prefix_len >> 3] : 0);
+  int r = rank(n->_route_bits, bit);
+  if (test_bit(n->_route_bits, bit)) {
+    // Just in case, so we never encounter duplicate routes...
+    Entry &e = _v[n->_routes[r]];
+    e._gw = gw;
+    e._index = index;
+    return 0;
+  }
+
   struct Entry e;
 
-  e._dst = dst & mask;
+  e._dst = dstnet;
   e._mask = mask;
   e._gw = gw;
   e._index = index;
   e._valid = 1;
 
-  // Just in case, so we never encounter duplicate routes...
-  del(dst, mask);
+  int i;
+  if (_free.size()) {
+    i = _free.back();
+    _free.pop_back();
+    _v[i] = e;
+  } else {
+    i = _v.size();
+    _v.push_back(e);
+  }
 
-  for (int i = 0; i < _v.size(); i++)
-    if (!_v[i]._valid) {
-      _v[i] = e;
-      return;
-    }
-  _v.push_back(e);
+  n->_routes.insert(n->_routes.begin() + r, i);
+  n->_route_bits[bit >> 5] |= 1U << (bit & 31);
+  return 0;
 }
 
-void
+int
 IP6Table::del(const IP6Address &dst, const IP6Address &mask)
 {
+  int prefix_len = mask.mask_to_prefix_len();
+  if (prefix_len < 0)
+    return -EINVAL;
   IP6Address dstnet = dst & mask;
+  const unsigned char *a = dstnet.data();
+
+  Node *path[17];
+  Node *n = _root;
+  int depth;
+  for (depth = 0; depth < (prefix_len >> 3); depth++) {
+    if (!test_bit(n->_child_bits, a[depth]))
+      return -ENOENT;
+    path[depth] = n;
+    n = n->_children[rank(n->_child_bits, a[depth])];
+  }
+
+  int bit = route_bit(prefix_len & 7, prefix_len < 128 ? a[prefix_len >> 3] : 0);
+  if (!test_bit(n->_route_bits, bit))
+    return -ENOENT;
+  int r = rank(n->_route_bits, bit);
+  int i = n->_routes[r];
+  _v[i]._valid = 0;
+  _free.push_back(i);
+  n->_routes.erase(n->_routes.begin() + r);
+  n->_route_bits[bit >> 5] &= ~(1U << (bit & 31));
 
-  for (int i = 0; i < _v.size(); i++)
-    if (_v[i]._valid && (_v[i]._dst == dstnet) && (_v[i]._mask == mask))
-      _v[i]._valid = 0;
+  // remove the nodes that became empty
+  while (depth > 0 && n->empty()) {
+    depth--;
+    Node *parent = path[depth];
+    parent->_children.erase(parent->_children.begin() + rank(parent->_child_bits, a[depth]));
+    parent->_child_bits[a[depth] >> 5] &= ~(1U << (a[depth] & 31));
+    delete n;
+    n = parent;
+  }
+  return 0;
+}
+
+void
+IP6Table::clear()
+{
+  free_node(_root);
+  _root = new Node;
+  _v.clear();
+  _free.clear();
 }
 
 String
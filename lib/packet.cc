@@ -21,12 +21,19 @@
 #include <click/config.h>
 #define CLICK_PACKET_DEPRECATED_ENUM
 #include <click/packet.hh>
+#include <click/packetbatch.hh>
 #include <click/packet_anno.hh>
 #include <click/glue.hh>
 #include <click/sync.hh>
 #if CLICK_USERLEVEL || CLICK_MINIOS
 # include <unistd.h>
 #endif
+#if CLICK_USERLEVEL && ALLOW_MMAP
+# include <sys/mman.h>
+#endif
+#if CLICK_USERLEVEL && defined(__linux__)
+# include <sys/syscall.h>
+#endif
 CLICK_DECLS
 
 /** @file packet.hh
@@ -233,30 +240,49 @@ Packet::~Packet()
 // pre-initialized Packet objects, either with or without data, for fast
 // reuse. It can support multithreaded deployments: each thread has its own
 // pool, with a global pool to even out imbalance.
+//
+// Pooled data buffers are carved out of large chunks, each one huge page if
+// the system allows. The thread that needs a chunk maps it and touches
+// every buffer itself, so the kernel's first-touch policy places the chunk
+// on that thread's NUMA node. A pooled buffer's packet carries
+// pool_data_destructor, with the buffer's node as its argument. Chunks are
+// never unmapped before static_cleanup(), so the pools map only enough
+// chunks to fill every thread's pool and the global pool. Past that limit,
+// packets get ordinary new[] buffers, which are freed as usual, so a
+// traffic burst does not keep its peak memory.
 
 #  define CLICK_PACKET_POOL_BUFSIZ		2048
 #  define CLICK_PACKET_POOL_SIZE		1000 // see LIMIT in packetpool-01.testie
 #  define CLICK_GLOBAL_PACKET_POOL_COUNT	16
+#  define CLICK_PACKET_POOL_CHUNKSIZ		(2 << 20) // one x86 huge page
 
 namespace {
 struct PacketData {
     PacketData* next;           // link to next free data buffer in pool
+    int node;                   // NUMA node of this buffer's chunk
 #  if HAVE_MULTITHREAD
     PacketData* batch_next;     // link to next buffer batch
     unsigned batch_pdcount;     // # buffers in this batch
 #  endif
 };
 
+struct PacketDataChunk {
+    PacketDataChunk* next;      // link to next allocated chunk
+    bool huge;                  // true iff backed by reserved huge pages
+};
+}
+
 struct PacketPool {
     WritablePacket* p;          // free packets, linked by p->next()
     unsigned pcount;            // # packets in `p` list
     PacketData* pd;             // free data buffers, linked by pd->next
     unsigned pdcount;           // # buffers in `pd` list
+    int node;                   // NUMA node of the owning thread
+    Packet::PoolStats stats;    // this pool's counters
 #  if HAVE_MULTITHREAD
     PacketPool* thread_pool_next; // link to next per-thread pool
 #  endif
 };
-}
 
 #  if HAVE_MULTITHREAD
 static __thread PacketPool *thread_packet_pool;
@@ -276,6 +302,38 @@ static GlobalPacketPool global_packet_pool;
 static PacketPool global_packet_pool;
 #  endif
 
+static unsigned packet_pool_capacity = CLICK_PACKET_POOL_SIZE;
+static PacketDataChunk* packet_data_chunks; // protected by global pool lock
+static unsigned packet_data_nchunks;
+static unsigned packet_data_nhuge;
+#  if HAVE_MULTITHREAD
+static unsigned packet_pool_nthreads;   // # thread pools
+#  endif
+
+static inline void lock_global_packet_pool() {
+#  if HAVE_MULTITHREAD
+    while (atomic_uint32_t::swap(global_packet_pool.lock, 1) == 1)
+	/* do nothing */;
+#  endif
+}
+
+static inline void unlock_global_packet_pool() {
+#  if HAVE_MULTITHREAD
+    click_compiler_fence();
+    global_packet_pool.lock = 0;
+#  endif
+}
+
+/** @brief Return the NUMA node of the CPU running this thread. */
+static int current_numa_node() {
+#  if CLICK_USERLEVEL && defined(__linux__) && defined(SYS_getcpu)
+    unsigned cpu, node;
+    if (syscall(SYS_getcpu, &cpu, &node, (void *) 0) == 0)
+	return node;
+#  endif
+    return 0;
+}
+
 /** @brief Return the local packet pool for this thread.
     @pre make_local_packet_pool() has succeeded on this thread. */
 static inline PacketPool& local_packet_pool() {
@@ -293,13 +351,13 @@ static inline PacketPool* make_local_packet_pool() {
     PacketPool *pp = thread_packet_pool;
     if (!pp && (pp = new PacketPool)) {
 	memset(pp, 0, sizeof(PacketPool));
-	while (atomic_uint32_t::swap(global_packet_pool.lock, 1) == 1)
-	    /* do nothing */;
+	pp->node = current_numa_node();
+	lock_global_packet_pool();
 	pp->thread_pool_next = global_packet_pool.thread_pools;
 	global_packet_pool.thread_pools = pp;
+	++packet_pool_nthreads;
 	thread_packet_pool = pp;
-	click_compiler_fence();
-	global_packet_pool.lock = 0;
+	unlock_global_packet_pool();
     }
     return pp;
 #  else
@@ -307,156 +365,373 @@ static inline PacketPool* make_local_packet_pool() {
 #  endif
 }
 
-WritablePacket *
-WritablePacket::pool_allocate(bool with_data)
-{
-    PacketPool& packet_pool = *make_local_packet_pool();
-    (void) with_data;
+/** @brief Return the maximum number of data buffer chunks.
+
+    That is enough buffers to fill every thread's pool and every batch of
+    the global pool. */
+static unsigned packet_data_chunk_limit() {
+    const unsigned per_chunk =
+	CLICK_PACKET_POOL_CHUNKSIZ / CLICK_PACKET_POOL_BUFSIZ - 1;
+#  if HAVE_MULTITHREAD
+    unsigned npools = packet_pool_nthreads + CLICK_GLOBAL_PACKET_POOL_COUNT;
+#  else
+    unsigned npools = 1;
+#  endif
+    uint64_t n = (uint64_t) npools * packet_pool_capacity;
+    return (n + per_chunk - 1) / per_chunk;
+}
+
+/** @brief Map a new data buffer chunk, or return null.
+    @param[out] huge set to true iff the chunk uses reserved huge pages */
+static unsigned char* map_packet_data_chunk(bool& huge) {
+    const size_t size = CLICK_PACKET_POOL_CHUNKSIZ;
+    huge = false;
+#  if ALLOW_MMAP
+    void* x = MAP_FAILED;
+#   ifdef MAP_HUGETLB
+    x = mmap(0, size, PROT_READ | PROT_WRITE,
+	     MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    huge = (x != MAP_FAILED);
+#   endif
+    if (x == MAP_FAILED) {
+	// No reserved huge pages. Transparent huge pages need an aligned
+	// region, so map twice the size and trim.
+	x = mmap(0, 2 * size, PROT_READ | PROT_WRITE,
+		 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (x == MAP_FAILED)
+	    return 0;
+	uintptr_t a = reinterpret_cast<uintptr_t>(x);
+	uintptr_t aligned = (a + size - 1) & ~(uintptr_t) (size - 1);
+	if (aligned != a)
+	    munmap(x, aligned - a);
+	munmap(reinterpret_cast<void*>(aligned + size), a + size - aligned);
+	x = reinterpret_cast<void*>(aligned);
+#   if HAVE_MADVISE && defined(MADV_HUGEPAGE)
+	(void) madvise(x, size, MADV_HUGEPAGE);
+#   endif
+    }
+    return reinterpret_cast<unsigned char*>(x);
+#  else
+    return new unsigned char[size];
+#  endif
+}
+
+/** @brief Fill @a pp's empty data buffer list with a new chunk.
+    @return true on success, false if out of memory or past the chunk limit */
+static bool allocate_packet_data_chunk(PacketPool& pp) {
+    const size_t size = CLICK_PACKET_POOL_CHUNKSIZ;
+    if (packet_data_nchunks >= packet_data_chunk_limit())
+	return false;
+    lock_global_packet_pool();
+    bool reserved = packet_data_nchunks < packet_data_chunk_limit();
+    if (reserved)
+	++packet_data_nchunks;
+    unlock_global_packet_pool();
+    if (!reserved)
+	return false;
+
+    bool huge;
+    unsigned char* m = map_packet_data_chunk(huge);
+    if (!m) {
+	lock_global_packet_pool();
+	--packet_data_nchunks;
+	unlock_global_packet_pool();
+	return false;
+    }
+
+    // Write every buffer from this thread, placing the chunk on our node.
+    // The first buffer's space holds the chunk header.
+    int node = current_numa_node();
+    PacketData* head = 0;
+    unsigned n = 0;
+    for (size_t off = size - CLICK_PACKET_POOL_BUFSIZ; off != 0;
+	 off -= CLICK_PACKET_POOL_BUFSIZ, ++n) {
+	PacketData* pd = reinterpret_cast<PacketData*>(m + off);
+	pd->next = head;
+	pd->node = node;
+	head = pd;
+    }
+
+    PacketDataChunk* c = reinterpret_cast<PacketDataChunk*>(m);
+    c->huge = huge;
+    lock_global_packet_pool();
+    c->next = packet_data_chunks;
+    packet_data_chunks = c;
+    packet_data_nhuge += huge;
+    unlock_global_packet_pool();
+
+    pp.node = node;
+    pp.pd = head;
+    pp.pdcount = n;
+    return true;
+}
+
+/** @brief Prefetch free list entry @a x, which the next take will unlink.
 
+    Bulk allocations such as Packet::make_batch() then find each entry's
+    link already in cache. */
+static inline void pool_prefetch(const void* x) {
+#  ifdef __GNUC__
+    __builtin_prefetch(x, 1);
+#  else
+    (void) x;
+#  endif
+}
+
+/** @brief Take a free packet from @a pp, or return null. */
+static inline WritablePacket* pool_take_packet(PacketPool& pp) {
+    if (!pp.p) {
+	++pp.stats.packet_misses;
 #  if HAVE_MULTITHREAD
-    // Steal packets and/or data from the global pool if there's nothing on
-    // the local pool.
-    if ((!packet_pool.p && global_packet_pool.pbatch)
-	|| (with_data && !packet_pool.pd && global_packet_pool.pdbatch)) {
-	while (atomic_uint32_t::swap(global_packet_pool.lock, 1) == 1)
-	    /* do nothing */;
-
-	WritablePacket *pp;
-	if (!packet_pool.p && (pp = global_packet_pool.pbatch)) {
-	    global_packet_pool.pbatch = static_cast<WritablePacket *>(pp->prev());
-	    --global_packet_pool.pbatchcount;
-	    packet_pool.p = pp;
-	    packet_pool.pcount = pp->anno_u32(0);
+	// Steal a batch from the global pool.
+	if (global_packet_pool.pbatch) {
+	    lock_global_packet_pool();
+	    if (WritablePacket* pb = global_packet_pool.pbatch) {
+		global_packet_pool.pbatch = static_cast<WritablePacket*>(pb->prev());
+		--global_packet_pool.pbatchcount;
+		pp.p = pb;
+		pp.pcount = pb->anno_u32(0);
+		++pp.stats.global_gets;
+	    }
+	    unlock_global_packet_pool();
 	}
+#  endif
+	if (!pp.p)
+	    return 0;
+    } else
+	++pp.stats.packet_hits;
+    WritablePacket* p = pp.p;
+    pp.p = static_cast<WritablePacket*>(p->next());
+    --pp.pcount;
+    if (pp.p)
+	pool_prefetch(pp.p);
+    return p;
+}
 
-	PacketData *pd;
-	if (with_data && !packet_pool.pd && (pd = global_packet_pool.pdbatch)) {
-	    global_packet_pool.pdbatch = pd->batch_next;
-	    --global_packet_pool.pdbatchcount;
-	    packet_pool.pd = pd;
-	    packet_pool.pdcount = pd->batch_pdcount;
+/** @brief Take a free data buffer from @a pp, or return null. */
+static inline PacketData* pool_take_data(PacketPool& pp) {
+    if (!pp.pd) {
+	++pp.stats.data_misses;
+#  if HAVE_MULTITHREAD
+	if (global_packet_pool.pdbatch) {
+	    lock_global_packet_pool();
+	    if (PacketData* pdb = global_packet_pool.pdbatch) {
+		global_packet_pool.pdbatch = pdb->batch_next;
+		--global_packet_pool.pdbatchcount;
+		pp.pd = pdb;
+		pp.pdcount = pdb->batch_pdcount;
+		++pp.stats.global_gets;
+	    }
+	    unlock_global_packet_pool();
 	}
+#  endif
+	if (!pp.pd && !allocate_packet_data_chunk(pp))
+	    return 0;
+    } else
+	++pp.stats.data_hits;
+    PacketData* pd = pp.pd;
+    pp.pd = pd->next;
+    --pp.pdcount;
+    if (pp.pd)
+	pool_prefetch(pp.pd);
+    return pd;
+}
 
-	click_compiler_fence();
-	global_packet_pool.lock = 0;
+/** @brief Return the free packets @a head...@a tail, @a n of them, to @a pp.
+    @pre The packets are linked by p->next(). */
+static inline void pool_put_packets(PacketPool& pp, WritablePacket* head,
+				    WritablePacket* tail, unsigned n) {
+    if (pp.pcount + n > packet_pool_capacity) {
+#  if HAVE_MULTITHREAD
+	if (pp.p) {
+	    lock_global_packet_pool();
+	    if (global_packet_pool.pbatchcount >= CLICK_GLOBAL_PACKET_POOL_COUNT) {
+		while (WritablePacket* p = pp.p) {
+		    pp.p = static_cast<WritablePacket*>(p->next());
+		    ::operator delete((void*) p);
+		}
+	    } else {
+		pp.p->set_prev(global_packet_pool.pbatch);
+		pp.p->set_anno_u32(0, pp.pcount);
+		global_packet_pool.pbatch = pp.p;
+		++global_packet_pool.pbatchcount;
+		++pp.stats.global_puts;
+		pp.p = 0;
+	    }
+	    unlock_global_packet_pool();
+	    pp.pcount = 0;
+	}
+#  else
+	while (n && pp.pcount + n > packet_pool_capacity) {
+	    WritablePacket* p = head;
+	    head = static_cast<WritablePacket*>(p->next());
+	    ::operator delete((void*) p);
+	    --n;
+	}
+	if (!n)
+	    return;
+#  endif
     }
-#  endif /* HAVE_MULTITHREAD */
+    tail->set_next(pp.p);
+    pp.p = head;
+    pp.pcount += n;
+}
 
-    WritablePacket *p = packet_pool.p;
-    if (p) {
-	packet_pool.p = static_cast<WritablePacket*>(p->next());
-	--packet_pool.pcount;
-    } else
+/** @brief Return pooled data buffer @a buf, from NUMA node @a node_arg, to
+    @a pp. */
+static inline void pool_put_data(PacketPool& pp, unsigned char* buf,
+				 void* node_arg) {
+    PacketData* pd = reinterpret_cast<PacketData*>(buf);
+    pd->node = static_cast<int>(reinterpret_cast<intptr_t>(node_arg));
+    if (pd->node != pp.node)
+	++pp.stats.cross_node_frees;
+#  if HAVE_MULTITHREAD
+    // Chunks are not freed. When the global pool is full too, a full pool
+    // keeps its buffers; packet_data_chunk_limit() bounds how many exist.
+    if (pp.pd && pp.pdcount >= packet_pool_capacity
+	&& global_packet_pool.pdbatchcount < CLICK_GLOBAL_PACKET_POOL_COUNT) {
+	lock_global_packet_pool();
+	if (global_packet_pool.pdbatchcount < CLICK_GLOBAL_PACKET_POOL_COUNT) {
+	    pp.pd->batch_next = global_packet_pool.pdbatch;
+	    pp.pd->batch_pdcount = pp.pdcount;
+	    global_packet_pool.pdbatch = pp.pd;
+	    ++global_packet_pool.pdbatchcount;
+	    ++pp.stats.global_puts;
+	    pp.pd = 0;
+	    pp.pdcount = 0;
+	}
+	unlock_global_packet_pool();
+    }
+#  endif
+    pd->next = pp.pd;
+    pp.pd = pd;
+    ++pp.pdcount;
+}
+
+static void
+pool_data_destructor(unsigned char* buf, size_t, void* node_arg)
+{
+    pool_put_data(*make_local_packet_pool(), buf, node_arg);
+}
+
+WritablePacket *
+WritablePacket::pool_allocate()
+{
+    PacketPool& packet_pool = *make_local_packet_pool();
+    WritablePacket *p = pool_take_packet(packet_pool);
+    if (!p)
 	p = new WritablePacket;
     return p;
 }
 
-WritablePacket *
-WritablePacket::pool_allocate(uint32_t headroom, uint32_t length,
-			      uint32_t tailroom)
+inline WritablePacket *
+WritablePacket::pool_allocate(PacketPool& packet_pool, uint32_t headroom,
+			      uint32_t length, uint32_t tailroom)
 {
     uint32_t n = headroom + length + tailroom;
     if (n < CLICK_PACKET_POOL_BUFSIZ)
 	n = CLICK_PACKET_POOL_BUFSIZ;
-    WritablePacket *p = pool_allocate(n == CLICK_PACKET_POOL_BUFSIZ);
-    if (p) {
-	p->initialize();
-	PacketData *pd;
-	PacketPool& packet_pool = local_packet_pool();
-	if (n == CLICK_PACKET_POOL_BUFSIZ && (pd = packet_pool.pd)) {
-	    packet_pool.pd = pd->next;
-	    --packet_pool.pdcount;
-	    p->_head = reinterpret_cast<unsigned char *>(pd);
-	} else if ((p->_head = new unsigned char[n]))
-	    /* OK */;
-	else {
-	    delete p;
-	    return 0;
-	}
-	p->_data = p->_head + headroom;
-	p->_tail = p->_data + length;
-	p->_end = p->_head + n;
+    WritablePacket *p = pool_take_packet(packet_pool);
+    if (!p && !(p = new WritablePacket))
+	return 0;
+    p->initialize();
+    PacketData *pd;
+    if (n == CLICK_PACKET_POOL_BUFSIZ && (pd = pool_take_data(packet_pool))) {
+	p->_head = reinterpret_cast<unsigned char *>(pd);
+	p->_destructor = pool_data_destructor;
+	p->_destructor_argument = reinterpret_cast<void *>(static_cast<intptr_t>(pd->node));
+    } else if ((p->_head = new unsigned char[n]))
+	/* OK */;
+    else {
+	delete p;
+	return 0;
     }
+    p->_data = p->_head + headroom;
+    p->_tail = p->_data + length;
+    p->_end = p->_head + n;
     return p;
 }
 
+WritablePacket *
+WritablePacket::pool_allocate(uint32_t headroom, uint32_t length,
+			      uint32_t tailroom)
+{
+    return pool_allocate(*make_local_packet_pool(), headroom, length, tailroom);
+}
+
 void
 WritablePacket::recycle(WritablePacket *p)
 {
-    unsigned char *data = 0;
-    if (!p->_data_packet && p->_head && !p->_destructor
-	&& p->_end - p->_head == CLICK_PACKET_POOL_BUFSIZ) {
-	data = p->_head;
+    PacketPool& packet_pool = *make_local_packet_pool();
+    if (!p->_data_packet && p->_destructor == pool_data_destructor) {
+	pool_put_data(packet_pool, p->_head, p->_destructor_argument);
 	p->_head = 0;
     }
     p->~WritablePacket();
+    pool_put_packets(packet_pool, p, p, 1);
+}
 
-    PacketPool& packet_pool = *make_local_packet_pool();
-#  if HAVE_MULTITHREAD
-    if ((packet_pool.p && packet_pool.pcount == CLICK_PACKET_POOL_SIZE)
-	|| (data && packet_pool.pd && packet_pool.pdcount == CLICK_PACKET_POOL_SIZE)) {
-	while (atomic_uint32_t::swap(global_packet_pool.lock, 1) == 1)
-	    /* do nothing */;
-
-	if (packet_pool.p && packet_pool.pcount == CLICK_PACKET_POOL_SIZE) {
-	    if (global_packet_pool.pbatchcount == CLICK_GLOBAL_PACKET_POOL_COUNT) {
-		while (WritablePacket *p = packet_pool.p) {
-		    packet_pool.p = static_cast<WritablePacket *>(p->next());
-		    ::operator delete((void *) p);
-		}
-	    } else {
-		packet_pool.p->set_prev(global_packet_pool.pbatch);
-                packet_pool.p->set_anno_u32(0, packet_pool.pcount);
-		global_packet_pool.pbatch = packet_pool.p;
-		++global_packet_pool.pbatchcount;
-		packet_pool.p = 0;
-	    }
-	    packet_pool.pcount = 0;
-	}
+/** @brief Return the capacity of each thread's packet pool.
+ *
+ * A thread's pool holds up to this many free packets and this many free
+ * data buffers; beyond that, it returns a batch to the global pool, which
+ * holds a fixed number of batches. Data buffers come from chunks that are
+ * never freed, so the capacity also limits the chunks: there are at most
+ * enough to fill every pool. Past that limit, new packets get ordinary
+ * data buffers, and a full pool whose global pool is full keeps its extra
+ * pooled buffers. */
+unsigned
+Packet::pool_capacity()
+{
+    return packet_pool_capacity;
+}
 
-	if (data && packet_pool.pd && packet_pool.pdcount == CLICK_PACKET_POOL_SIZE) {
-	    if (global_packet_pool.pdbatchcount == CLICK_GLOBAL_PACKET_POOL_COUNT) {
-		while (PacketData *pd = packet_pool.pd) {
-		    packet_pool.pd = pd->next;
-		    delete[] reinterpret_cast<unsigned char *>(pd);
-		}
-	    } else {
-		packet_pool.pd->batch_next = global_packet_pool.pdbatch;
-                packet_pool.pd->batch_pdcount = packet_pool.pdcount;
-		global_packet_pool.pdbatch = packet_pool.pd;
-		++global_packet_pool.pdbatchcount;
-		packet_pool.pd = 0;
-	    }
-	    packet_pool.pdcount = 0;
-	}
+/** @brief Set the capacity of each thread's packet pool.
+ * @param capacity new capacity, at least 1
+ * @sa pool_capacity() */
+void
+Packet::set_pool_capacity(unsigned capacity)
+{
+    packet_pool_capacity = capacity ? capacity : 1;
+}
 
-	click_compiler_fence();
-	global_packet_pool.lock = 0;
-    }
-#  else /* !HAVE_MULTITHREAD */
-    if (packet_pool.pcount == CLICK_PACKET_POOL_SIZE) {
-	::operator delete((void *) p);
-	p = 0;
-    }
-    if (data && packet_pool.pdcount == CLICK_PACKET_POOL_SIZE) {
-	delete[] data;
-	data = 0;
-    }
-#  endif /* HAVE_MULTITHREAD */
+static void
+add_pool_stats(Packet::PoolStats& stats, const PacketPool* pp)
+{
+    stats.packet_hits += pp->stats.packet_hits;
+    stats.packet_misses += pp->stats.packet_misses;
+    stats.data_hits += pp->stats.data_hits;
+    stats.data_misses += pp->stats.data_misses;
+    stats.global_gets += pp->stats.global_gets;
+    stats.global_puts += pp->stats.global_puts;
+    stats.cross_node_frees += pp->stats.cross_node_frees;
+    stats.packets += pp->pcount;
+    stats.buffers += pp->pdcount;
+}
 
-    if (p) {
-	++packet_pool.pcount;
-	p->set_next(packet_pool.p);
-	packet_pool.p = p;
-	assert(packet_pool.pcount <= CLICK_PACKET_POOL_SIZE);
-    }
-    if (data) {
-	++packet_pool.pdcount;
-	PacketData *pd = reinterpret_cast<PacketData *>(data);
-	pd->next = packet_pool.pd;
-	packet_pool.pd = pd;
-	assert(packet_pool.pdcount <= CLICK_PACKET_POOL_SIZE);
-    }
+/** @brief Collect packet pool statistics into @a stats.
+ *
+ * Counters are summed over every thread's pool. Other threads may be
+ * updating their counters at the same time, so the result is approximate. */
+void
+Packet::pool_stats(PoolStats& stats)
+{
+    memset(&stats, 0, sizeof(stats));
+    lock_global_packet_pool();
+#  if HAVE_MULTITHREAD
+    for (PacketPool* pp = global_packet_pool.thread_pools; pp;
+	 pp = pp->thread_pool_next)
+	add_pool_stats(stats, pp);
+    for (Packet* p = global_packet_pool.pbatch; p; p = p->prev())
+	stats.packets += p->anno_u32(0);
+    for (PacketData* pd = global_packet_pool.pdbatch; pd; pd = pd->batch_next)
+	stats.buffers += pd->batch_pdcount;
+#  else
+    add_pool_stats(stats, &global_packet_pool);
+#  endif
+    stats.chunks = packet_data_nchunks;
+    stats.huge_chunks = packet_data_nhuge;
+    unlock_global_packet_pool();
 }
 
 # endif /* HAVE_PACKET_POOL */
@@ -571,6 +846,80 @@ Packet::make(uint32_t headroom, const void *data,
 #endif
 }
 
+/** @brief Create up to @a n new packets and append them to @a batch.
+ * @param batch batch to hold the new packets
+ * @param n number of packets to create
+ * @param headroom headroom in each new packet
+ * @param length length of each packet
+ * @param tailroom tailroom in each new packet
+ * @return number of packets created
+ *
+ * Each new packet is as if created by make(@a headroom, 0, @a length, @a
+ * tailroom): its data is uninitialized, its annotations are cleared, and
+ * its header pointers are null. Fewer than @a n packets are created only if
+ * memory runs out. With packet pools, the thread's pool is looked up once
+ * for the whole batch. */
+unsigned
+Packet::make_batch(PacketBatch &batch, unsigned n, uint32_t headroom,
+		   uint32_t length, uint32_t tailroom)
+{
+#if HAVE_CLICK_PACKET_POOL
+    PacketPool& packet_pool = *make_local_packet_pool();
+#endif
+    unsigned i;
+    for (i = 0; i != n; ++i) {
+#if HAVE_CLICK_PACKET_POOL
+	WritablePacket *p = WritablePacket::pool_allocate(packet_pool, headroom, length, tailroom);
+#else
+	WritablePacket *p = make(headroom, 0, length, tailroom);
+#endif
+	if (!p)
+	    break;
+	batch.append(p);
+    }
+    return i;
+}
+
+/** @brief Kill every packet in @a batch, leaving it empty.
+ *
+ * This is equivalent to calling kill() on each packet. With packet pools,
+ * the freed packets return to the thread's pool as one list, so the pool
+ * is looked up, and its capacity checked, once per batch. */
+void
+Packet::kill_batch(PacketBatch &batch)
+{
+    Packet *next;
+#if HAVE_CLICK_PACKET_POOL
+    PacketPool& packet_pool = *make_local_packet_pool();
+    WritablePacket *head = 0, *tail = 0;
+    unsigned n = 0;
+    for (Packet *p = batch.first(); p; p = next) {
+	next = p->next();
+	if (p->_use_count.dec_and_test()) {
+	    WritablePacket *q = static_cast<WritablePacket *>(p);
+	    if (!q->_data_packet && q->_destructor == pool_data_destructor) {
+		pool_put_data(packet_pool, q->_head, q->_destructor_argument);
+		q->_head = 0;
+	    }
+	    q->~WritablePacket();
+	    q->set_next(head);
+	    head = q;
+	    if (!tail)
+		tail = q;
+	    ++n;
+	}
+    }
+    if (n)
+	pool_put_packets(packet_pool, head, tail, n);
+#else
+    for (Packet *p = batch.first(); p; p = next) {
+	next = p->next();
+	p->kill();
+    }
+#endif
+    batch.clear();
+}
+
 #if CLICK_USERLEVEL || CLICK_MINIOS
 /** @brief Create and return a new packet (userlevel).
  * @param data data used in the new packet
@@ -594,7 +943,7 @@ Packet::make(unsigned char *data, uint32_t length,
 	     buffer_destructor_type destructor, void* argument)
 {
 # if HAVE_CLICK_PACKET_POOL
-    WritablePacket *p = WritablePacket::pool_allocate(false);
+    WritablePacket *p = WritablePacket::pool_allocate();
 # else
     WritablePacket *p = new WritablePacket;
 # endif
@@ -648,7 +997,7 @@ Packet::clone()
 
     // timing: .31-.39 normal, .43-.55 two allocs, .55-.58 two memcpys
 # if HAVE_CLICK_PACKET_POOL
-    Packet *p = WritablePacket::pool_allocate(false);
+    Packet *p = WritablePacket::pool_allocate();
 # else
     Packet *p = new WritablePacket; // no initialization
 # endif
@@ -965,14 +1314,12 @@ cleanup_pool(PacketPool *pp, int global)
 	pp->p = static_cast<WritablePacket *>(p->next());
 	::operator delete((void *) p);
     }
-    while (PacketData *pd = pp->pd) {
+    // Data buffers are freed with their chunks.
+    for (PacketData *pd = pp->pd; pd; pd = pd->next)
 	++pdcount;
-	pp->pd = pd->next;
-	delete[] reinterpret_cast<unsigned char *>(pd);
-    }
-    assert(pcount <= CLICK_PACKET_POOL_SIZE);
-    assert(pdcount <= CLICK_PACKET_POOL_SIZE);
+    pp->pd = 0;
     assert(global || (pcount == pp->pcount && pdcount == pp->pdcount));
+    (void) global;
 }
 #endif
 
@@ -989,7 +1336,8 @@ Packet::static_cleanup()
     unsigned rounds = global_packet_pool.pbatchcount;
     if (rounds < global_packet_pool.pdbatchcount)
         rounds = global_packet_pool.pdbatchcount;
-    assert(rounds <= CLICK_GLOBAL_PACKET_POOL_COUNT);
+    assert(global_packet_pool.pbatchcount <= CLICK_GLOBAL_PACKET_POOL_COUNT
+	   && global_packet_pool.pdbatchcount <= CLICK_GLOBAL_PACKET_POOL_COUNT);
     PacketPool fake_pool;
     while (global_packet_pool.pbatch || global_packet_pool.pdbatch) {
         if ((fake_pool.p = global_packet_pool.pbatch))
@@ -1000,8 +1348,22 @@ Packet::static_cleanup()
 	--rounds;
     }
     assert(rounds == 0);
+    global_packet_pool.pbatchcount = global_packet_pool.pdbatchcount = 0;
 # else
     cleanup_pool(&global_packet_pool, 0);
+    global_packet_pool.pcount = global_packet_pool.pdcount = 0;
+# endif
+    while (PacketDataChunk* c = packet_data_chunks) {
+	packet_data_chunks = c->next;
+# if ALLOW_MMAP
+	munmap(c, CLICK_PACKET_POOL_CHUNKSIZ);
+# else
+	delete[] reinterpret_cast<unsigned char*>(c);
+# endif
+    }
+    packet_data_nchunks = packet_data_nhuge = 0;
+# if HAVE_MULTITHREAD
+    packet_pool_nthreads = 0;
 # endif
 #endif
 }
@@ -84,6 +84,9 @@ Router::Router(const String &configuration, Master *master)
       _notifier_signals(0),
       _arena_factory(new HashMap_ArenaFactory),
       _hotswap_router(0), _thread_sched(0), _name_info(0), _next_router(0)
+#if CLICK_PROFILING
+    , _profile(0), _nprofile(0), _profiling(false)
+#endif
 {
     _refcount = 0;
     _runcount = 0;
@@ -151,6 +154,15 @@ Router::~Router()
 	delete ns;
     }
     delete _name_info;
+#if CLICK_PROFILING
+    for (int i = 0; i < _nprofile; ++i) {
+	delete[] _profile[i]->elements;
+	delete[] _profile[i]->packets[0];
+	delete[] _profile[i]->packets[1];
+	delete _profile[i];
+    }
+    delete[] _profile;
+#endif
     if (_master)
 	_master->unregister_router(this);
 }
@@ -1945,6 +1957,12 @@ ThreadSched::initial_home_thread_id(const Element *)
     return 0;
 }
 
+bool
+ThreadSched::initial_migratable(const Element *)
+{
+    return false;
+}
+
 /** @cond never */
 /** @brief  Create (if necessary) and return the NameInfo object for this router.
  *
@@ -2168,6 +2186,134 @@ Router::element_ports_string(const Element *e) const
 }
 
 
+// PROFILING
+
+#if CLICK_PROFILING
+/** @brief  Turn per-element profiling on or off.
+ *
+ *  While profiling is on, every push, pull, push_batch, and pull_batch
+ *  transfer between the router's elements is counted and timed: the callee
+ *  element's call count, its cycles including and excluding the elements it
+ *  calls in turn, and the packets crossing each port.  Each thread keeps its
+ *  own counters, which are summed only when read (see profile_report()).
+ *  Turning profiling off preserves the counters collected so far.
+ *
+ *  Profiling is available only when Click is configured with
+ *  --enable-profiling; otherwise transfers carry no profiling code at all. */
+void
+Router::set_profiling(bool profiling)
+{
+    if (profiling && !_profile) {
+	int nprofile = click_max_cpu_ids();
+	_profile = new profile_thread *[nprofile];
+	for (int i = 0; i < nprofile; ++i) {
+	    profile_thread *pt = new profile_thread;
+	    pt->elements = new profile_element[nelements()];
+	    pt->packets[0] = new uint64_t[ngports(false)];
+	    pt->packets[1] = new uint64_t[ngports(true)];
+	    _profile[i] = pt;
+	}
+	_nprofile = nprofile;
+	reset_profile();
+	click_write_fence();
+    }
+    _profiling = profiling;
+    for (Element **ep = _elements.begin(); ep != _elements.end(); ++ep)
+	(*ep)->_profiled = profiling;
+}
+
+/** @brief  Reset the profiling counters to zero. */
+void
+Router::reset_profile()
+{
+    for (int i = 0; i < _nprofile; ++i) {
+	profile_thread *pt = _profile[i];
+	pt->child_cycles = 0;
+	memset(pt->elements, 0, sizeof(profile_element) * nelements());
+	memset(pt->packets[0], 0, sizeof(uint64_t) * ngports(false));
+	memset(pt->packets[1], 0, sizeof(uint64_t) * ngports(true));
+    }
+}
+
+/** @brief  Report the profiling counters, summed over all threads.
+ *  @param  sa  destination
+ *  @param  json  if true, report in JSON form
+ *
+ *  The text form has one tab-separated line per element that was called or
+ *  moved packets: name, class, calls, cycles including downstream elements,
+ *  own cycles, own cycles per call, and per-port packet counts for inputs
+ *  and outputs, separated by commas.  The JSON form is an object whose
+ *  "elements" member is an array of objects with the same information. */
+void
+Router::profile_report(StringAccum &sa, bool json) const
+{
+    if (json)
+	sa << "{\"active\":" << (_profiling ? "true" : "false")
+	   << ",\"elements\":[";
+    else
+	sa << "# element\tclass\tcalls\tcycles\town_cycles\tcycles_per_call\tin_packets\tout_packets\n";
+
+    Vector<uint64_t> packets[2];
+    const char *sep = "";
+    for (int ei = 0; ei < nelements() && _nprofile; ++ei) {
+	Element *e = _elements[ei];
+	profile_element pe;
+	memset(&pe, 0, sizeof(pe));
+	bool any_packets = false;
+	for (int isout = 0; isout < 2; ++isout) {
+	    packets[isout].assign(e->nports(isout), 0);
+	    for (int i = 0; i < _nprofile; ++i) {
+		const uint64_t *pp = _profile[i]->packets[isout] + _element_gport_offset[isout][ei];
+		for (int port = 0; port < e->nports(isout); ++port)
+		    if (pp[port]) {
+			packets[isout][port] += pp[port];
+			any_packets = true;
+		    }
+	    }
+	}
+	for (int i = 0; i < _nprofile; ++i) {
+	    const profile_element &x = _profile[i]->elements[ei];
+	    pe.calls += x.calls;
+	    pe.cycles += x.cycles;
+	    pe.own_cycles += x.own_cycles;
+	}
+	if (!pe.calls && !any_packets)
+	    continue;
+
+	if (json) {
+	    sa << sep << "\n{\"name\":\"" << _element_names[ei].encode_json()
+	       << "\",\"class\":\"" << String(e->class_name()).encode_json()
+	       << "\",\"calls\":" << pe.calls
+	       << ",\"cycles\":" << pe.cycles
+	       << ",\"own_cycles\":" << pe.own_cycles;
+	    for (int isout = 0; isout < 2; ++isout) {
+		sa << (isout ? "],\"outputs\":[" : ",\"inputs\":[");
+		for (int port = 0; port < packets[isout].size(); ++port)
+		    sa << (port ? "," : "") << packets[isout][port];
+	    }
+	    sa << "]}";
+	    sep = ",";
+	} else {
+	    sa << _element_names[ei] << '\t' << e->class_name() << '\t'
+	       << pe.calls << '\t' << pe.cycles << '\t' << pe.own_cycles << '\t'
+	       << int_divide(pe.own_cycles, pe.calls ? pe.calls : 1);
+	    for (int isout = 0; isout < 2; ++isout) {
+		sa << '\t';
+		if (!packets[isout].size())
+		    sa << '-';
+		for (int port = 0; port < packets[isout].size(); ++port)
+		    sa << (port ? "," : "") << packets[isout][port];
+	    }
+	    sa << '\n';
+	}
+    }
+
+    if (json)
+	sa << "\n]}\n";
+}
+#endif
+
+
 // STATIC INITIALIZATION, DEFAULT GLOBAL HANDLERS
 
 /** @brief  Returns the router's initial configuration string.
@@ -2187,7 +2333,9 @@ Router::configuration_string() const
 enum { GH_VERSION, GH_CONFIG, GH_FLATCONFIG, GH_LIST, GH_REQUIREMENTS,
        GH_DRIVER, GH_ACTIVE_PORTS, GH_ACTIVE_PORT_STATS, GH_STRING_PROFILE,
        GH_STRING_PROFILE_LONG, GH_SCHEDULING_PROFILE, GH_STOP,
-       GH_ELEMENT_CYCLES, GH_CLASS_CYCLES, GH_RESET_CYCLES };
+       GH_ELEMENT_CYCLES, GH_CLASS_CYCLES, GH_RESET_CYCLES,
+       GH_PROFILE, GH_PROFILE_JSON, GH_PROFILE_ACTIVE, GH_RESET_PROFILE,
+       GH_PACKET_POOL, GH_PACKET_POOL_CAPACITY };
 
 #if CLICK_STATS >= 2
 struct stats_info {
@@ -2374,6 +2522,42 @@ Router::router_read_handler(Element *e, void *thunk)
     }
 #endif
 
+#if CLICK_PROFILING
+    case GH_PROFILE:
+    case GH_PROFILE_JSON:
+	if (r)
+	    r->profile_report(sa, reinterpret_cast<intptr_t>(thunk) == GH_PROFILE_JSON);
+	break;
+
+    case GH_PROFILE_ACTIVE:
+	if (r)
+	    return String(r->profiling());
+	break;
+#endif
+
+#if HAVE_CLICK_PACKET_POOL
+    case GH_PACKET_POOL: {
+	Packet::PoolStats ps;
+	Packet::pool_stats(ps);
+	sa << "capacity " << Packet::pool_capacity() << '\n'
+	   << "packet_hits " << ps.packet_hits << '\n'
+	   << "packet_misses " << ps.packet_misses << '\n'
+	   << "data_hits " << ps.data_hits << '\n'
+	   << "data_misses " << ps.data_misses << '\n'
+	   << "global_gets " << ps.global_gets << '\n'
+	   << "global_puts " << ps.global_puts << '\n'
+	   << "cross_node_frees " << ps.cross_node_frees << '\n'
+	   << "free_packets " << ps.packets << '\n'
+	   << "free_buffers " << ps.buffers << '\n'
+	   << "chunks " << ps.chunks << '\n'
+	   << "huge_chunks " << ps.huge_chunks << '\n';
+	break;
+    }
+
+    case GH_PACKET_POOL_CAPACITY:
+	return String(Packet::pool_capacity());
+#endif
+
     }
     return sa.take_string();
 }
@@ -2382,8 +2566,6 @@ int
 Router::router_write_handler(const String &s, Element *e, void *thunk, ErrorHandler *errh)
 {
     Router *r = (e ? e->router() : 0);
-    if (!r)
-	return 0;
     switch ((uintptr_t) thunk) {
     case GH_STOP: {
 	int n = 1;
@@ -2399,6 +2581,30 @@ Router::router_write_handler(const String &s, Element *e, void *thunk, ErrorHand
 	for (int i = 0; i < (r ? r->nelements() : 0); i++)
 	    r->_elements[i]->reset_cycles();
 	break;
+#endif
+#if CLICK_PROFILING
+    case GH_PROFILE_ACTIVE: {
+	bool active;
+	if (!BoolArg().parse(s, active))
+	    return errh->error("syntax error");
+	if (!r)
+	    return errh->error("no router to profile");
+	r->set_profiling(active);
+	break;
+    }
+    case GH_RESET_PROFILE:
+	if (r)
+	    r->reset_profile();
+	break;
+#endif
+#if HAVE_CLICK_PACKET_POOL
+    case GH_PACKET_POOL_CAPACITY: {
+	unsigned capacity;
+	if (!IntArg().parse(s, capacity) || capacity == 0)
+	    return errh->error("expected positive integer");
+	Packet::set_pool_capacity(capacity);
+	break;
+    }
 #endif
     default:
 	break;
@@ -2436,6 +2642,18 @@ Router::static_initialize()
         add_read_handler(0, "element_cycles.csv", router_read_handler, (void *)GH_ELEMENT_CYCLES);
         add_read_handler(0, "class_cycles.csv", router_read_handler, (void *)GH_CLASS_CYCLES);
         add_write_handler(0, "reset_cycles", router_write_handler, (void *)GH_RESET_CYCLES);
+#endif
+#if CLICK_PROFILING
+	add_read_handler(0, "profile", router_read_handler, (void *) GH_PROFILE);
+	add_read_handler(0, "profile.json", router_read_handler, (void *) GH_PROFILE_JSON);
+	add_read_handler(0, "profile_active", router_read_handler, (void *) GH_PROFILE_ACTIVE, Handler::f_checkbox);
+	add_write_handler(0, "profile_active", router_write_handler, (void *) GH_PROFILE_ACTIVE);
+	add_write_handler(0, "reset_profile", router_write_handler, (void *) GH_RESET_PROFILE, Handler::f_button);
+#endif
+#if HAVE_CLICK_PACKET_POOL
+	add_read_handler(0, "packet_pool", router_read_handler, (void *) GH_PACKET_POOL);
+	add_read_handler(0, "packet_pool_capacity", router_read_handler, (void *) GH_PACKET_POOL_CAPACITY);
+	add_write_handler(0, "packet_pool_capacity", router_write_handler, (void *) GH_PACKET_POOL_CAPACITY);
 #endif
     }
 }
@@ -83,6 +83,13 @@ RouterThread::RouterThread(Master *master, int id)
 
     _task_blocker = 0;
     _task_blocker_waiting = 0;
+#if HAVE_MULTITHREAD
+    _steal_request = 0;
+    _steal_victim = 0;
+    _idle = false;
+    _steals = 0;
+    _idles = 0;
+#endif
 #if HAVE_ADAPTIVE_SCHEDULER
     _max_click_share = 80 * Task::MAX_UTILIZATION / 100;
     _min_click_share = Task::MAX_UTILIZATION / 200;
@@ -558,6 +565,106 @@ RouterThread::run_os()
     driver_lock_tasks();
 }
 
+#if HAVE_MULTITHREAD
+/* Work stealing.  Stealing directly from a busy thread's run queue would
+   contend with its driver, which holds the task lock while it runs tasks.
+   Instead, an idle thread posts a request on one busy peer, and the peer
+   moves one of its tasks over with Task::move_thread() at its next driver
+   iteration, where the move needs no locking. */
+
+void
+RouterThread::request_steal()
+{
+    int n = _master->nthreads();
+    for (int i = 1; i < n; ++i) {
+	RouterThread *victim = _master->thread((_id + i) % n);
+	if (!victim->_idle
+	    && victim->_steal_request.compare_swap(0, _id + 1) == 0) {
+	    _steal_victim = victim;
+	    return;
+	}
+    }
+}
+
+void
+RouterThread::grant_steal()
+{
+    uint32_t request = _steal_request.value();
+    if (likely(!request))
+	return;
+    RouterThread *thief = _master->thread(request - 1);
+
+    Task::Status want_status;
+    want_status.home_thread_id = thread_id();
+    want_status.is_scheduled = true;
+    want_status.is_strong_unscheduled = false;
+
+    // Give away the first migratable task, but never our only task.  Only
+    // the head of the list is scanned; tasks move through it as they run,
+    // so a migratable task further back is found by a later request.
+    enum { max_steal_scan = 16 };
+    Task *steal = 0;
+    Task *first = task_begin();
+    if (first != task_end() && task_next(first) != task_end()) {
+	int n = 0;
+	for (Task *t = first; t != task_end() && n < max_steal_scan;
+	     t = task_next(t), ++n)
+	    if (t->_migratable && t->_status.status == want_status.status) {
+		steal = t;
+		break;
+	    }
+    }
+
+    // The thief may withdraw its request at any time.
+    if (steal) {
+	if (_steal_request.compare_swap(request, 0) != request)
+	    return;
+	// We are the running thread, so this moves the task immediately, and
+	// wakes the thief through its pending list.
+	steal->move_thread(thief->thread_id());
+	++thief->_steals;
+    } else {
+	// We have nothing to give; let the thief try somewhere else.
+	if (_steal_request.compare_swap(request, 0) == request)
+	    thief->wake();
+    }
+}
+
+inline void
+RouterThread::balance_tasks()
+{
+    grant_steal();
+    if (!active()) {
+	if (!_idle) {
+	    _idle = true;
+	    ++_idles;
+	}
+	// our request may have been granted or refused since we posted it
+	if (_steal_victim
+	    && _steal_victim->_steal_request.value() != (uint32_t) _id + 1)
+	    _steal_victim = 0;
+	if (!_steal_victim)
+	    request_steal();
+    } else {
+	if (_idle) {
+	    // Idle threads only post requests on busy threads, so those
+	    // that went idle while we were idle may be waiting for us.
+	    _idle = false;
+	    int n = _master->nthreads();
+	    for (int tid = 0; tid < n; ++tid) {
+		RouterThread *thief = _master->thread(tid);
+		if (thief != this && thief->_idle && !thief->_steal_victim)
+		    thief->wake();
+	    }
+	}
+	if (_steal_victim) {
+	    _steal_victim->_steal_request.compare_swap(_id + 1, 0);
+	    _steal_victim = 0;
+	}
+    }
+}
+#endif
+
 void
 RouterThread::process_pending()
 {
@@ -649,6 +756,12 @@ RouterThread::driver()
 	    run_tasks(_tasks_per_iter);
 	} while (0);
 
+#if HAVE_MULTITHREAD
+	// share tasks with idle threads
+	if (_master->_work_stealing)
+	    balance_tasks();
+#endif
+
 #if CLICK_USERLEVEL
 	// run signals
 	run_signals();
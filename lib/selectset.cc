@@ -33,6 +33,9 @@
 #  define EV_SET_UDATA_CAST	/* nothing */
 # endif
 #endif
+#if HAVE_ALLOW_EPOLL
+# include <sys/epoll.h>
+#endif
 CLICK_DECLS
 
 namespace {
@@ -58,6 +61,17 @@ SelectSet::SelectSet()
 # endif
 #endif
 
+#if HAVE_ALLOW_EPOLL
+    // Prefer kqueue if both are available.
+# if HAVE_ALLOW_KQUEUE
+    if (_kqueue >= 0)
+	_epoll = -1;
+    else
+# endif
+    if ((_epoll = epoll_create(64)) >= 0)
+	fcntl(_epoll, F_SETFD, FD_CLOEXEC);
+#endif
+
 #if !HAVE_ALLOW_POLL
     FD_ZERO(&_read_select_fd_set);
     FD_ZERO(&_write_select_fd_set);
@@ -85,6 +99,10 @@ SelectSet::~SelectSet()
 #if HAVE_ALLOW_KQUEUE
     if (_kqueue >= 0)
 	close(_kqueue);
+#endif
+#if HAVE_ALLOW_EPOLL
+    if (_epoll >= 0)
+	close(_epoll);
 #endif
     if (_wake_pipe[0] >= 0) {
 	close(_wake_pipe[0]);
@@ -168,6 +186,11 @@ SelectSet::register_select(int fd, bool add_read, bool add_write)
     }
 #endif
 
+#if HAVE_ALLOW_EPOLL
+    if (_epoll >= 0)
+	update_epoll(fd, _pollfds[pi].events);
+#endif
+
 #if !HAVE_ALLOW_POLL
     // Add 'mask' to the fd_sets
     if (fd < FD_SETSIZE) {
@@ -181,6 +204,9 @@ SelectSet::register_select(int fd, bool add_read, bool add_write)
 	static int warned = 0;
 # if HAVE_ALLOW_KQUEUE
 	if (_kqueue < 0)
+# endif
+# if HAVE_ALLOW_EPOLL
+	if (_epoll < 0)
 # endif
 	    if (!warned) {
 		click_chatter("SelectSet::add_select(%d): fd >= FD_SETSIZE", fd);
@@ -268,6 +294,11 @@ SelectSet::remove_pollfd(int pi, int event)
 	    click_chatter("SelectSet::remove_pollfd(fd %d): kevent: %s", _pollfds[pi].fd, strerror(errno));
     }
 #endif
+#if HAVE_ALLOW_EPOLL
+    // modify or remove epoll registration
+    if (_epoll >= 0)
+	update_epoll(fd, _pollfds[pi].events);
+#endif
 #if !HAVE_ALLOW_POLL
     // remove event from select list
     if (fd < FD_SETSIZE) {
@@ -424,6 +455,78 @@ SelectSet::run_selects_kqueue(RouterThread *thread)
 }
 #endif /* HAVE_ALLOW_KQUEUE */
 
+#if HAVE_ALLOW_EPOLL
+void
+SelectSet::update_epoll(int fd, int events)
+{
+    // Registration is incremental: the kernel keeps the interest set, so
+    // each add_select() or remove_select() costs one epoll_ctl() call.
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    if (events & POLLIN)
+	ev.events |= EPOLLIN;
+    if (events & POLLOUT)
+	ev.events |= EPOLLOUT;
+    ev.data.fd = fd;
+    int r;
+    if (!events) {
+	r = epoll_ctl(_epoll, EPOLL_CTL_DEL, fd, &ev);
+	// The fd may have been closed already, which removes it.
+	if (r < 0 && (errno == EBADF || errno == ENOENT))
+	    r = 0;
+    } else if ((r = epoll_ctl(_epoll, EPOLL_CTL_MOD, fd, &ev)) < 0
+	       && errno == ENOENT)
+	r = epoll_ctl(_epoll, EPOLL_CTL_ADD, fd, &ev);
+    if (r < 0) {
+	// Not all file descriptors are epollable (regular files, for
+	// instance).  So if we encounter a problem, fall back to select() or
+	// poll(), which always track the full set in _pollfds.
+	close(_epoll);
+	_epoll = -1;
+    }
+}
+
+void
+SelectSet::run_selects_epoll(RouterThread *thread)
+{
+# if HAVE_MULTITHREAD
+    click_fence();
+    _select_lock.release();
+# endif
+
+    // Decide how long to wait.
+    int timeout;
+    Timestamp t;
+    int delay_type = thread->timer_set().next_timer_delay(thread->active(), t);
+    if (delay_type == 0)
+	timeout = 0;
+    else if (delay_type > 0)
+	timeout = (t.sec() >= INT_MAX / 1000 ? INT_MAX - 1000 : t.msecval());
+    else
+	timeout = -1;
+    thread->set_thread_state_for_blocking(delay_type);
+
+    struct epoll_event ev[256];
+    int n = epoll_wait(_epoll, &ev[0], 256, timeout);
+    int was_errno = errno;
+
+    if (post_select(thread, true))
+	return;
+
+    thread->set_thread_state(RouterThread::S_RUNSELECT);
+    if (n < 0 && was_errno != EINTR)
+	perror("epoll_wait");
+    else if (n > 0)
+	// Each fd appears at most once.  call_selected() looks up the current
+	// selectors, so fds removed by an earlier callback are ignored.
+	for (struct epoll_event *p = &ev[0]; p < &ev[n]; ++p) {
+	    int mask = (p->events & ~EPOLLOUT ? Element::SELECT_READ : 0)
+		+ (p->events & ~EPOLLIN ? Element::SELECT_WRITE : 0);
+	    call_selected(p->data.fd, mask);
+	}
+}
+#endif /* HAVE_ALLOW_EPOLL */
+
 #if HAVE_ALLOW_POLL
 void
 SelectSet::run_selects_poll(RouterThread *thread)
@@ -577,6 +680,12 @@ SelectSet::run_selects(RouterThread *thread)
 	    break;
 	}
 #endif
+#if HAVE_ALLOW_EPOLL
+	if (_epoll >= 0) {
+	    run_selects_epoll(thread);
+	    break;
+	}
+#endif
 #if HAVE_ALLOW_POLL
 	run_selects_poll(thread);
 #else
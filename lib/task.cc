@@ -25,6 +25,7 @@
 #include <click/router.hh>
 #include <click/routerthread.hh>
 #include <click/master.hh>
+#include <click/standard/threadsched.hh>
 CLICK_DECLS
 
 /** @file task.hh
@@ -192,6 +193,8 @@ Task::initialize(Element *owner, bool schedule)
     // Master::thread() returns the quiescent thread if its argument is out of
     // range
     _thread = router->master()->thread(tid);
+    if (ThreadSched *ts = router->thread_sched())
+	_migratable = _migratable || ts->initial_migratable(owner);
 
     // set _owner last, since it is used to determine whether task is
     // initialized
@@ -163,7 +163,9 @@ CLICK_DECLS
 
  The Click core stores timers in a heap, so most timer operations (including
  scheduling and unscheduling) take @e O(log @e n) time and Click can handle
- very large numbers of timers.
+ very large numbers of timers.  A RouterThread's TimerSet can instead use a
+ hierarchical timer wheel (TimerSet::set_timer_wheel()), which schedules and
+ unschedules timers in @e O(1) time.
 
  Timers generally run in increasing order by expiration time.  That is, if
  timer @a a's expiry() is less than timer @a b's expiry(), then @a a will
@@ -246,6 +248,18 @@ Timer::initialize(Element *owner, bool quiet)
     _thread = owner->master()->thread(tid);
 }
 
+void
+Timer::move_thread(int thread_id)
+{
+    assert(_owner && initialized());
+    bool was_scheduled = scheduled();
+    if (was_scheduled)
+	unschedule();
+    _thread = _owner->master()->thread(thread_id);
+    if (was_scheduled)
+	schedule_at_steady(_expiry_s);
+}
+
 int
 Timer::home_thread_id() const
 {
@@ -267,6 +281,12 @@ Timer::schedule_at_steady(const Timestamp &when)
     _expiry_s = when ? when : Timestamp::epsilon();
     ts.check_timer_expiry(this);
 
+    if (ts._wheel) {
+	ts.wheel_schedule(this);
+	ts.unlock_timers();
+	return;
+    }
+
     // manipulate list; this is essentially a "decrease-key" operation
     // any reschedule removes a timer from the runchunk (XXX -- even backwards
     // reschedulings)
@@ -306,7 +326,9 @@ Timer::unschedule()
     TimerSet &ts = _thread->timer_set();
     ts.lock_timers();
     int old_schedpos1 = _schedpos1;
-    if (_schedpos1 > 0) {
+    if (_schedpos1 == TimerSet::wheel_schedpos1)
+	ts.wheel_unlink(this);
+    else if (_schedpos1 > 0) {
 	remove_heap<4>(ts._timer_heap.begin(), ts._timer_heap.end(),
 		       ts._timer_heap.begin() + _schedpos1 - 1,
 		       TimerSet::heap_less(), TimerSet::heap_place());
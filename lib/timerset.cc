@@ -24,6 +24,7 @@
 #include <click/routerthread.hh>
 #include <click/heap.hh>
 #include <click/master.hh>
+#include <click/integers.hh>
 CLICK_DECLS
 
 TimerSet::TimerSet()
@@ -48,6 +49,12 @@ TimerSet::TimerSet()
 #endif
     _timer_check = Timestamp::now_steady();
     _timer_check_reports = 0;
+
+    _wheel = false;
+    _wheel_count = 0;
+    _wheel_now = 0;
+    memset(_wheel_occupied, 0, sizeof(_wheel_occupied));
+    memset(_wheel_slot, 0, sizeof(_wheel_slot));
 }
 
 void
@@ -66,10 +73,219 @@ TimerSet::kill_router(Router *router)
 	    t->_schedpos1 = 0;
 	}
     }
+    if (_wheel_count) {
+	for (Timer **slot = _wheel_slot;
+	     slot != _wheel_slot + wheel_levels * wheel_slots; ++slot)
+	    for (Timer *t = *slot, *next; t; t = next) {
+		next = t->_wheel_next;
+		if (t->router() == router) {
+		    wheel_unlink(t);
+		    t->_owner = 0;
+		}
+	    }
+	_wheel_expiry = Timestamp();
+	if (_wheel_count)
+	    _wheel_expiry = Timestamp::make_msec(wheel_next_tick());
+    }
     set_timer_expiry();
     unlock_timers();
 }
 
+Timer *
+TimerSet::next_timer()
+{
+    lock_timers();
+    Timer *t = _timer_heap.empty() ? 0 : _timer_heap.unchecked_at(0).t;
+    // The first pending slot on each wheel level holds that level's
+    // earliest timers.
+    for (int level = 0; level < wheel_levels && _wheel_count; ++level)
+	if (uint64_t occ = _wheel_occupied[level]) {
+	    int shift = wheel_bits * level;
+	    uint64_t start = (_wheel_now + (uint64_t(1) << shift) - 1) >> shift;
+	    int s0 = start & (wheel_slots - 1);
+	    if (s0)
+		occ = (occ >> s0) | (occ << (wheel_slots - s0));
+	    int slot = (s0 + ffs_lsb(occ) - 1) & (wheel_slots - 1);
+	    for (Timer *x = _wheel_slot[level * wheel_slots + slot];
+		 x; x = x->_wheel_next)
+		if (!t || x->_expiry_s < t->_expiry_s)
+		    t = x;
+	}
+    unlock_timers();
+    return t;
+}
+
+/** @brief Select whether this set uses a timer wheel.
+ *
+ * By default, timers are kept in a heap, and scheduling and unscheduling
+ * take O(log n) time for n scheduled timers.  With a timer wheel, timers
+ * that expire at least a millisecond in the future take O(1) time to
+ * schedule and unschedule.  This pays off with many long-lived timers that
+ * are frequently rescheduled or canceled, such as per-flow timeouts.
+ * Timers fire at the same times either way.  */
+void
+TimerSet::set_timer_wheel(bool wheel)
+{
+    lock_timers();
+    if (wheel && !_wheel) {
+	_wheel = true;
+	_wheel_now = wheel_tick(Timestamp::now_steady());
+    } else if (!wheel && _wheel) {
+	for (Timer **slot = _wheel_slot;
+	     slot != _wheel_slot + wheel_levels * wheel_slots; ++slot)
+	    while (Timer *t = *slot) {
+		wheel_unlink(t);
+		heap_push(t);
+	    }
+	_wheel = false;
+	_wheel_expiry = Timestamp();
+	set_timer_expiry();
+    }
+    unlock_timers();
+}
+
+inline void
+TimerSet::heap_push(Timer *t)
+{
+    t->_schedpos1 = _timer_heap.size() + 1;
+    _timer_heap.push_back(heap_element(t));
+    push_heap<4>(_timer_heap.begin(), _timer_heap.end(),
+		 heap_less(), heap_place());
+}
+
+void
+TimerSet::wheel_link(Timer *t, uint64_t tick)
+{
+    uint64_t delta = tick - _wheel_now;
+    int level = 0;
+    while (level < wheel_levels - 1
+	   && (delta >> (wheel_bits * (level + 1))) != 0)
+	++level;
+    if (level == wheel_levels - 1
+	&& (delta >> (wheel_bits * wheel_levels)) != 0)
+	// too far in the future: park it in the last slot, from which it
+	// will cascade back to this level
+	tick = _wheel_now + (uint64_t(1) << (wheel_bits * wheel_levels)) - 1;
+
+    int shift = wheel_bits * level;
+    int slot = (tick >> shift) & (wheel_slots - 1);
+    Timer **head = &_wheel_slot[level * wheel_slots + slot];
+    if ((t->_wheel_next = *head))
+	t->_wheel_next->_wheel_pprev = &t->_wheel_next;
+    *head = t;
+    t->_wheel_pprev = head;
+    t->_schedpos1 = wheel_schedpos1;
+    _wheel_occupied[level] |= uint64_t(1) << slot;
+    ++_wheel_count;
+
+    // the slot is reached at the first tick it covers
+    Timestamp reached = Timestamp::make_msec((tick >> shift) << shift);
+    if (!_wheel_expiry || reached < _wheel_expiry)
+	_wheel_expiry = reached;
+}
+
+void
+TimerSet::wheel_unlink(Timer *t)
+{
+    Timer **pprev = t->_wheel_pprev;
+    if ((*pprev = t->_wheel_next))
+	t->_wheel_next->_wheel_pprev = pprev;
+    else if (pprev >= _wheel_slot
+	     && pprev < _wheel_slot + wheel_levels * wheel_slots) {
+	int i = pprev - _wheel_slot;
+	_wheel_occupied[i / wheel_slots] &= ~(uint64_t(1) << (i % wheel_slots));
+    }
+    t->_schedpos1 = 0;
+    --_wheel_count;
+}
+
+void
+TimerSet::wheel_schedule(Timer *t)
+{
+    Timestamp old_expiry = _timer_expiry;
+    if (t->_schedpos1 == wheel_schedpos1)
+	wheel_unlink(t);
+    else if (t->_schedpos1 > 0) {
+	remove_heap<4>(_timer_heap.begin(), _timer_heap.end(),
+		       _timer_heap.begin() + t->_schedpos1 - 1,
+		       heap_less(), heap_place());
+	_timer_heap.pop_back();
+    } else if (t->_schedpos1 < 0)
+	_timer_runchunk[-t->_schedpos1 - 1] = 0;
+
+    uint64_t tick = wheel_tick(t->_expiry_s);
+    if (tick < _wheel_now)
+	heap_push(t);
+    else
+	wheel_link(t, tick);
+    set_timer_expiry();
+
+    // if we moved the timeout earlier, wake up the thread
+    if (!old_expiry || _timer_expiry < old_expiry)
+	t->_thread->wake();
+}
+
+void
+TimerSet::wheel_cascade(int level, int slot)
+{
+    Timer **head = &_wheel_slot[level * wheel_slots + slot];
+    while (Timer *t = *head) {
+	wheel_unlink(t);
+	uint64_t tick = wheel_tick(t->_expiry_s);
+	if (level == 0 || tick < _wheel_now)
+	    heap_push(t);
+	else
+	    wheel_link(t, tick);
+    }
+}
+
+/* Returns the next tick at which the wheel reaches an occupied slot.  A slot
+   on level L is reached at the first tick it covers; the pending slots on
+   that level cover the wheel_slots blocks of 2^(wheel_bits*L) ticks that
+   start at or after _wheel_now. */
+uint64_t
+TimerSet::wheel_next_tick() const
+{
+    uint64_t next = ~uint64_t(0);
+    for (int level = 0; level < wheel_levels; ++level)
+	if (uint64_t occ = _wheel_occupied[level]) {
+	    int shift = wheel_bits * level;
+	    uint64_t start = (_wheel_now + (uint64_t(1) << shift) - 1) >> shift;
+	    int s0 = start & (wheel_slots - 1);
+	    if (s0)
+		occ = (occ >> s0) | (occ << (wheel_slots - s0));
+	    uint64_t reached = (start + ffs_lsb(occ) - 1) << shift;
+	    if (reached < next)
+		next = reached;
+	}
+    return next;
+}
+
+/* Processes every wheel tick up to and including tick, moving timers that
+   expire by then to the heap. */
+void
+TimerSet::wheel_advance(uint64_t tick)
+{
+    uint64_t t;
+    while (_wheel_count && (t = wheel_next_tick()) <= tick) {
+	_wheel_now = t;
+	for (int level = wheel_levels - 1; level > 0; --level) {
+	    int shift = wheel_bits * level;
+	    if (!(t & ((uint64_t(1) << shift) - 1)))
+		wheel_cascade(level, (t >> shift) & (wheel_slots - 1));
+	}
+	wheel_cascade(0, t & (wheel_slots - 1));
+	_wheel_now = t + 1;
+    }
+    if (_wheel_now <= tick)
+	_wheel_now = tick + 1;
+    if (_wheel_count)
+	_wheel_expiry = Timestamp::make_msec(wheel_next_tick());
+    else
+	_wheel_expiry = Timestamp();
+    set_timer_expiry();
+}
+
 void
 TimerSet::set_max_timer_stride(unsigned timer_stride)
 {
@@ -115,7 +331,8 @@ TimerSet::run_timers(RouterThread *thread, Master *master)
 {
     if (!_timer_lock.attempt())
 	return;
-    if (!master->paused() && _timer_heap.size() > 0 && !thread->stop_flag()) {
+    if (!master->paused() && (_timer_heap.size() > 0 || _wheel)
+	&& !thread->stop_flag()) {
 	thread->set_thread_state(RouterThread::S_RUNTIMER);
 #if CLICK_LINUXMODULE
 	_timer_task = current;
@@ -123,9 +340,11 @@ TimerSet::run_timers(RouterThread *thread, Master *master)
 	_timer_processor = click_current_processor();
 #endif
 	_timer_check = Timestamp::now_steady();
+	if (_wheel && (!_wheel_count || _wheel_expiry <= _timer_check))
+	    wheel_advance(wheel_tick(_timer_check));
 	heap_element *th = _timer_heap.begin();
 
-	if (th->expiry_s <= _timer_check) {
+	if (_timer_heap.size() > 0 && th->expiry_s <= _timer_check) {
 	    // potentially adjust timer stride
 	    Timestamp adj_expiry = th->expiry_s + Timer::adjustment();
 	    if (adj_expiry <= _timer_check) {